@@ -0,0 +1,608 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * This is the final stage Onramp archiver.
+ *
+ * It reads the whole archive into memory as a list of members, applies the
+ * requested operation and writes the archive back out. Every archive it writes
+ * starts with a symbol index member which the final stage linker uses to load
+ * only the members it needs. See docs/object-code.md.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The name of the index member. This can't be the name of a real file.
+#define INDEX_NAME "/"
+
+#define BINARY_HEADER_SIZE 4
+#define BINARY_END 0x00
+#define BINARY_STRING 0x01
+#define BINARY_BYTES 0x02
+#define BINARY_LINES 0x03
+#define BINARY_SYMBOL 0x04
+#define BINARY_LABEL 0x05
+#define BINARY_INVOKE 0x06
+#define BINARY_LINE 0x07
+#define BINARY_MANUAL 0x08
+#define BINARY_INCREMENT 0x09
+#define BINARY_DEBUG 0x0A
+
+#define BINARY_SYMBOL_STATIC 1
+#define BINARY_SYMBOL_CONSTRUCTOR 8
+#define BINARY_SYMBOL_DESTRUCTOR 16
+
+static const char binary_header[BINARY_HEADER_SIZE] = {0x7F, 'o', 'o', 0x01};
+
+static _Noreturn void fatal(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fputs("ERROR: ", stderr);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+static void* checked_realloc(void* pointer, size_t size) {
+    pointer = realloc(pointer, size);
+    if (pointer == NULL)
+        fatal("Out of memory.");
+    return pointer;
+}
+
+static char* checked_strndup(const char* bytes, size_t length) {
+    char* copy = malloc(length + 1);
+    if (copy == NULL)
+        fatal("Out of memory.");
+    memcpy(copy, bytes, length);
+    copy[length] = 0;
+    return copy;
+}
+
+/**
+ * Reads the given file into memory. Returns false if it can't be opened.
+ */
+static bool read_file(const char* filename, char** out_bytes, size_t* out_size) {
+    FILE* file = fopen(filename, "rb");
+    char* bytes = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    if (file == NULL)
+        return false;
+    for (;;) {
+        size_t step;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            bytes = checked_realloc(bytes, capacity);
+        }
+        step = fread(bytes + count, 1, capacity - count, file);
+        if (step == 0) {
+            if (ferror(file))
+                fatal("Failed to read file: %s", filename);
+            break;
+        }
+        count += step;
+    }
+    fclose(file);
+
+    *out_bytes = bytes;
+    *out_size = count;
+    return true;
+}
+
+
+
+/*
+ * Members
+ */
+
+typedef struct member_t {
+    char* name;
+    char* contents;
+    size_t size;
+} member_t;
+
+static member_t* members;
+static size_t members_count;
+static size_t members_capacity;
+
+static member_t* members_find(const char* name) {
+    size_t i;
+    for (i = 0; i < members_count; ++i)
+        if (0 == strcmp(members[i].name, name))
+            return members + i;
+    return NULL;
+}
+
+static member_t* members_append(const char* name) {
+    member_t* member;
+    if (members_count == members_capacity) {
+        members_capacity = members_capacity ? members_capacity * 2 : 16;
+        members = checked_realloc(members, members_capacity * sizeof(member_t));
+    }
+    member = members + members_count++;
+    member->name = checked_strndup(name, strlen(name));
+    member->contents = NULL;
+    member->size = 0;
+    return member;
+}
+
+static void members_remove(member_t* member) {
+    free(member->name);
+    free(member->contents);
+    memmove(member, member + 1, (members + members_count - (member + 1)) * sizeof(member_t));
+    --members_count;
+}
+
+
+
+/*
+ * Scanning object code
+ *
+ * We scan object code for global symbol definitions to build the index. We
+ * don't validate it; the linker does that. We do need to understand binary
+ * objects since they can contain arbitrary bytes (including `%` at the start
+ * of a line.)
+ */
+
+static const char* scan_pos;
+static const char* scan_end;
+
+// The global symbols defined by the member being scanned
+static const char** scan_names;
+static size_t* scan_name_lengths;
+static size_t scan_names_count;
+static size_t scan_names_capacity;
+
+// Whether the member being scanned has constructors or destructors
+static bool scan_keep;
+
+// The string table of the binary object being scanned
+static const char** scan_strings;
+static size_t* scan_string_lengths;
+static size_t scan_strings_count;
+static size_t scan_strings_capacity;
+
+static bool is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+static void scan_add_name(const char* name, size_t length) {
+    if (scan_names_count == scan_names_capacity) {
+        scan_names_capacity = scan_names_capacity ? scan_names_capacity * 2 : 64;
+        scan_names = checked_realloc(scan_names, scan_names_capacity * sizeof(char*));
+        scan_name_lengths = checked_realloc(scan_name_lengths,
+                scan_names_capacity * sizeof(size_t));
+    }
+    scan_names[scan_names_count] = name;
+    scan_name_lengths[scan_names_count] = length;
+    ++scan_names_count;
+}
+
+static uint8_t scan_byte(void) {
+    if (scan_pos == scan_end)
+        fatal("Unexpected end of binary object.");
+    return (uint8_t)*scan_pos++;
+}
+
+static uint32_t scan_number(void) {
+    uint32_t value = 0;
+    int shift = 0;
+    for (;;) {
+        uint8_t byte = scan_byte();
+        if (shift > 28)
+            fatal("Number in binary object is out of bounds.");
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+        shift += 7;
+    }
+}
+
+static const char* scan_bytes(size_t length) {
+    const char* bytes = scan_pos;
+    if ((size_t)(scan_end - scan_pos) < length)
+        fatal("Unexpected end of binary object.");
+    scan_pos += length;
+    return bytes;
+}
+
+static void scan_binary_string(void) {
+    if (scan_strings_count == scan_strings_capacity) {
+        scan_strings_capacity = scan_strings_capacity ? scan_strings_capacity * 2 : 64;
+        scan_strings = checked_realloc(scan_strings, scan_strings_capacity * sizeof(char*));
+        scan_string_lengths = checked_realloc(scan_string_lengths,
+                scan_strings_capacity * sizeof(size_t));
+    }
+    scan_string_lengths[scan_strings_count] = scan_number();
+    scan_strings[scan_strings_count] = scan_bytes(scan_string_lengths[scan_strings_count]);
+    ++scan_strings_count;
+}
+
+/** Scans a binary object. The header has been consumed. */
+static void scan_binary(void) {
+    scan_strings_count = 0;
+    for (;;) {
+        uint8_t type = scan_byte();
+        uint32_t flags;
+        uint32_t index;
+        switch (type) {
+            case BINARY_END:
+                return;
+            case BINARY_STRING:
+                scan_binary_string();
+                break;
+            case BINARY_BYTES:
+                scan_bytes(scan_number());
+                break;
+            case BINARY_LINES:
+            case BINARY_LABEL:
+                scan_number();
+                break;
+            case BINARY_SYMBOL:
+                flags = scan_number();
+                if (flags & BINARY_SYMBOL_CONSTRUCTOR)
+                    scan_number();
+                if (flags & BINARY_SYMBOL_DESTRUCTOR)
+                    scan_number();
+                index = scan_number();
+                if (index >= scan_strings_count)
+                    fatal("Invalid string index in binary object.");
+                if (flags & (BINARY_SYMBOL_CONSTRUCTOR | BINARY_SYMBOL_DESTRUCTOR))
+                    scan_keep = true;
+                if (!(flags & BINARY_SYMBOL_STATIC))
+                    scan_add_name(scan_strings[index], scan_string_lengths[index]);
+                break;
+            case BINARY_INVOKE:
+                scan_number();
+                scan_number();
+                scan_number();
+                break;
+            case BINARY_LINE:
+                scan_number();
+                scan_number();
+                break;
+            case BINARY_MANUAL:
+            case BINARY_INCREMENT:
+                break;
+            case BINARY_DEBUG:
+                scan_number();
+                break;
+            default:
+                fatal("Invalid record type in binary object.");
+        }
+    }
+}
+
+/** Scans a symbol definition in plain text. The `=` or `@` is next. */
+static void scan_text_symbol(void) {
+    bool global = *scan_pos++ == '=';
+    const char* name;
+
+    while (scan_pos != scan_end) {
+        char c = *scan_pos;
+        if (c == '{' || c == '}')
+            scan_keep = true;
+        else if (c != '?' && c != '+' && !(c >= '0' && c <= '9'))
+            break;
+        ++scan_pos;
+    }
+
+    name = scan_pos;
+    while (scan_pos != scan_end && is_name_char(*scan_pos))
+        ++scan_pos;
+    if (global && scan_pos != name)
+        scan_add_name(name, scan_pos - name);
+}
+
+/**
+ * Scans the contents of a member (or of an archive being split into members),
+ * stopping at a `%` at the start of a line.
+ */
+static void scan(void) {
+    bool line_start = true;
+    while (scan_pos != scan_end) {
+        char c = *scan_pos;
+        if (c == '%' && line_start)
+            return;
+        if (c == '\n' || c == '\r') {
+            line_start = true;
+            ++scan_pos;
+            continue;
+        }
+        line_start = false;
+
+        if (c == ';' || c == '#') {
+            while (scan_pos != scan_end && *scan_pos != '\n' && *scan_pos != '\r')
+                ++scan_pos;
+        } else if (c == '=' || c == '@') {
+            scan_text_symbol();
+        } else if (c == binary_header[0] && scan_end - scan_pos >= BINARY_HEADER_SIZE &&
+                0 == memcmp(scan_pos, binary_header, BINARY_HEADER_SIZE))
+        {
+            scan_pos += BINARY_HEADER_SIZE;
+            scan_binary();
+        } else if (is_name_char(c)) {
+            // skip the rest of a name or hex byte so a name can't be confused
+            // with anything else
+            while (scan_pos != scan_end && is_name_char(*scan_pos))
+                ++scan_pos;
+        } else {
+            ++scan_pos;
+        }
+    }
+}
+
+static void scan_member(member_t* member) {
+    scan_pos = member->contents;
+    scan_end = member->contents + member->size;
+    scan_names_count = 0;
+    scan_keep = false;
+    scan(); // a `%` line in a member ends the scan; the linker will reject it
+}
+
+
+
+/*
+ * Reading and writing archives
+ */
+
+/** Reads the archive with the given filename, if it exists. */
+static bool read_archive(const char* filename) {
+    char* bytes;
+    size_t size;
+
+    if (!read_file(filename, &bytes, &size))
+        return false;
+
+    scan_pos = bytes;
+    scan_end = bytes + size;
+    scan();
+    if (scan_pos != bytes)
+        fatal("Archive does not start with a member: %s", filename);
+
+    while (scan_pos != scan_end) {
+        const char* name = ++scan_pos;
+        const char* contents;
+        member_t* member;
+
+        while (scan_pos != scan_end && *scan_pos != '\n' && *scan_pos != '\r')
+            ++scan_pos;
+        member = members_append("");
+        free(member->name);
+        member->name = checked_strndup(name, scan_pos - name);
+        if (scan_pos != scan_end && *scan_pos++ == '\r' && scan_pos != scan_end && *scan_pos == '\n')
+            ++scan_pos;
+
+        contents = scan_pos;
+        scan();
+        member->size = scan_pos - contents;
+        // remove the line ending we added after the file contents
+        if (member->size != 0 && contents[member->size - 1] == '\n')
+            --member->size;
+        member->contents = checked_strndup(contents, member->size);
+
+        if (0 == strcmp(member->name, INDEX_NAME))
+            members_remove(member);
+    }
+
+    free(bytes);
+    return true;
+}
+
+static void write_member(FILE* file, const char* name, const char* contents, size_t size) {
+    fputc('%', file);
+    fputs(name, file);
+    fputc('\n', file);
+    fwrite(contents, 1, size, file);
+    // always add a line ending in case the file doesn't end with one
+    fputc('\n', file);
+}
+
+/** Writes the index member. */
+static void write_index(FILE* file) {
+    size_t offset = 0;
+    size_t i, j;
+
+    fputc('%', file);
+    fputs(INDEX_NAME, file);
+    fputc('\n', file);
+    fprintf(file, ";index %u\n", (unsigned)members_count);
+
+    for (i = 0; i < members_count; ++i) {
+        member_t* member = members + i;
+        size_t size = 1 + strlen(member->name) + 1 + member->size + 1;
+
+        scan_member(member);
+        fprintf(file, ";member %u %u%s\n", (unsigned)offset, (unsigned)size,
+                scan_keep ? " keep" : "");
+        for (j = 0; j < scan_names_count; ++j) {
+            fputs(";define ", file);
+            fwrite(scan_names[j], 1, scan_name_lengths[j], file);
+            fputc('\n', file);
+        }
+
+        offset += size;
+    }
+}
+
+static void write_archive(const char* filename, bool index) {
+    FILE* file = fopen(filename, "wb");
+    size_t i;
+
+    if (file == NULL)
+        fatal("Failed to open archive for writing: %s", filename);
+    if (index)
+        write_index(file);
+    for (i = 0; i < members_count; ++i)
+        write_member(file, members[i].name, members[i].contents, members[i].size);
+    if (fclose(file) != 0)
+        fatal("Failed to write archive: %s", filename);
+}
+
+
+
+/*
+ * Operations
+ */
+
+/** Replaces or adds the given files. */
+static void replace(const char** filenames) {
+    for (; *filenames; ++filenames) {
+        member_t* member = members_find(*filenames);
+        if (member == NULL)
+            member = members_append(*filenames);
+        free(member->contents);
+        if (!read_file(*filenames, &member->contents, &member->size))
+            fatal("Failed to open input file: %s", *filenames);
+    }
+}
+
+/** Deletes the given members. */
+static void delete(const char** names) {
+    for (; *names; ++names) {
+        member_t* member = members_find(*names);
+        if (member == NULL)
+            fatal("No such member in archive: %s", *names);
+        members_remove(member);
+    }
+}
+
+static bool is_named(const char* name, const char** names) {
+    if (*names == NULL)
+        return true;
+    for (; *names; ++names)
+        if (0 == strcmp(name, *names))
+            return true;
+    return false;
+}
+
+/** Lists the given members, or all members if none are given. */
+static void list(const char** names) {
+    size_t i;
+    for (i = 0; i < members_count; ++i)
+        if (is_named(members[i].name, names))
+            puts(members[i].name);
+}
+
+/** Extracts the given members, or all members if none are given. */
+static void extract(const char** names) {
+    size_t i;
+    for (i = 0; i < members_count; ++i) {
+        FILE* file;
+        if (!is_named(members[i].name, names))
+            continue;
+        file = fopen(members[i].name, "wb");
+        if (file == NULL)
+            fatal("Failed to open output file: %s", members[i].name);
+        fwrite(members[i].contents, 1, members[i].size, file);
+        if (fclose(file) != 0)
+            fatal("Failed to write output file: %s", members[i].name);
+    }
+}
+
+static _Noreturn void usage(void) {
+    fputs("Usage: ar <operation>[modifiers] <archive> [file...]\n", stderr);
+    fputs("Operations:\n", stderr);
+    fputs("    r    Replace or add files\n", stderr);
+    fputs("    d    Delete members\n", stderr);
+    fputs("    t    List members\n", stderr);
+    fputs("    x    Extract members\n", stderr);
+    fputs("    s    Write the symbol index only\n", stderr);
+    fputs("Modifiers:\n", stderr);
+    fputs("    c    Don't warn when creating the archive\n", stderr);
+    fputs("    s    Write the symbol index (the default)\n", stderr);
+    fputs("    S    Don't write the symbol index\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char** argv) {
+    const char* key;
+    const char* archive;
+    const char** files;
+    char operation = 0;
+    bool create = false;
+    bool index = true;
+    bool exists;
+
+    if (argc < 3)
+        usage();
+    key = argv[1];
+    archive = argv[2];
+    files = argv + 3;
+
+    // POSIX allows a leading dash on the key
+    if (*key == '-')
+        ++key;
+    for (; *key; ++key) {
+        switch (*key) {
+            case 'r': case 'd': case 't': case 'x':
+                if (operation != 0 && operation != 's')
+                    usage();
+                operation = *key;
+                break;
+            case 's':
+                // `s` alone is an operation; otherwise it's a modifier
+                if (operation == 0)
+                    operation = 's';
+                index = true;
+                break;
+            case 'S':
+                index = false;
+                break;
+            case 'c':
+                create = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    if (operation == 0)
+        usage();
+
+    exists = read_archive(archive);
+    if (!exists && operation != 'r')
+        fatal("Failed to open archive: %s", archive);
+    if (!exists && !create)
+        fprintf(stderr, "ar: creating %s\n", archive);
+
+    switch (operation) {
+        case 'r': replace(files); break;
+        case 'd': delete(files); break;
+        case 't': list(files); return EXIT_SUCCESS;
+        case 'x': extract(files); return EXIT_SUCCESS;
+        case 's': break;
+    }
+
+    write_archive(archive, index);
+    return EXIT_SUCCESS;
+}
@@ -40,6 +40,12 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/as/2-full/src/emit.c \
     -o build/intermediate/as-2-full/emit.oo
 
+echo Compiling as/2-full immediate.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/as/2-full/build-ccargs \
+    -c core/as/2-full/src/immediate.c \
+    -o build/intermediate/as-2-full/immediate.oo
+
 echo Compiling as/2-full main.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/as/2-full/build-ccargs \
@@ -58,13 +64,21 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/as/2-full/src/parse.c \
     -o build/intermediate/as-2-full/parse.oo
 
+echo Compiling as/2-full relax.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/as/2-full/build-ccargs \
+    -c core/as/2-full/src/relax.c \
+    -o build/intermediate/as-2-full/relax.oo
+
 echo Linking as/2-full
 onrampvm build/intermediate/ld-2-full/ld.oe \
     build/intermediate/libc-3-full/libc.oa \
     build/intermediate/libo-1-opc/libo.oa \
     build/intermediate/as-2-full/common.oo \
     build/intermediate/as-2-full/emit.oo \
+    build/intermediate/as-2-full/immediate.oo \
     build/intermediate/as-2-full/main.oo \
     build/intermediate/as-2-full/opcodes.oo \
     build/intermediate/as-2-full/parse.oo \
+    build/intermediate/as-2-full/relax.oo \
     -o build/intermediate/as-2-full/as.oe
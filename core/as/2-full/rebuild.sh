@@ -40,6 +40,12 @@ onrampvm build/output/bin/cc.oe \
     -c core/as/2-full/src/emit.c \
     -o build/intermediate/as-2-full-re/emit.oo
 
+echo Compiling as/2-full immediate.c
+onrampvm build/output/bin/cc.oe \
+    @core/as/2-full/rebuild-ccargs \
+    -c core/as/2-full/src/immediate.c \
+    -o build/intermediate/as-2-full-re/immediate.oo
+
 echo Compiling as/2-full main.c
 onrampvm build/output/bin/cc.oe \
     @core/as/2-full/rebuild-ccargs \
@@ -58,13 +64,21 @@ onrampvm build/output/bin/cc.oe \
     -c core/as/2-full/src/parse.c \
     -o build/intermediate/as-2-full-re/parse.oo
 
+echo Compiling as/2-full relax.c
+onrampvm build/output/bin/cc.oe \
+    @core/as/2-full/rebuild-ccargs \
+    -c core/as/2-full/src/relax.c \
+    -o build/intermediate/as-2-full-re/relax.oo
+
 echo Linking as/2-full
 onrampvm build/output/bin/cc.oe \
     @core/as/2-full/rebuild-ccargs \
     build/intermediate/libo-1-opc-re/libo.oa \
     build/intermediate/as-2-full-re/common.oo \
     build/intermediate/as-2-full-re/emit.oo \
+    build/intermediate/as-2-full-re/immediate.oo \
     build/intermediate/as-2-full-re/main.oo \
     build/intermediate/as-2-full-re/opcodes.oo \
     build/intermediate/as-2-full-re/parse.oo \
+    build/intermediate/as-2-full-re/relax.oo \
     -o build/output/bin/as.oe
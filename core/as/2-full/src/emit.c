@@ -24,10 +24,214 @@
 
 #include "emit.h"
 
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "immediate.h"
 #include "parse.h"
+#include "relax.h"
 
 FILE* output_file;
 size_t output_alignment;
+bool output_binary;
+
+
+
+/*
+ * Binary output
+ *
+ * In binary mode, consecutive bytes and consecutive line endings are
+ * accumulated and written as a single record. Names are written to the string
+ * table the first time they are used.
+ */
+
+#define BINARY_END 0x00
+#define BINARY_STRING 0x01
+#define BINARY_BYTES 0x02
+#define BINARY_LINES 0x03
+#define BINARY_SYMBOL 0x04
+#define BINARY_LABEL 0x05
+#define BINARY_INVOKE 0x06
+#define BINARY_LINE 0x07
+#define BINARY_MANUAL 0x08
+#define BINARY_INCREMENT 0x09
+#define BINARY_DEBUG 0x0A
+
+#define BINARY_SYMBOL_STATIC 1
+#define BINARY_SYMBOL_WEAK 2
+#define BINARY_SYMBOL_ZERO 4
+#define BINARY_SYMBOL_CONSTRUCTOR 8
+#define BINARY_SYMBOL_DESTRUCTOR 16
+
+#define PENDING_BYTES_SIZE 256
+
+static char label_type_to_char(label_type_t type);
+
+static uint8_t pending_bytes[PENDING_BYTES_SIZE];
+static size_t pending_bytes_count;
+static unsigned pending_lines;
+
+typedef struct binary_string_t {
+    char* name;
+    uint32_t hash;
+    unsigned index;
+} binary_string_t;
+
+static binary_string_t* strings;
+static size_t strings_capacity; // always a power of two
+static size_t strings_count;
+
+static void emit_number(uint32_t value) {
+    while (value >= 0x80) {
+        fputc((int)((value & 0x7F) | 0x80), output_file);
+        value >>= 7;
+    }
+    fputc((int)value, output_file);
+}
+
+static void emit_flush(void) {
+    if (pending_bytes_count != 0) {
+        fputc(BINARY_BYTES, output_file);
+        emit_number(pending_bytes_count);
+        fwrite(pending_bytes, 1, pending_bytes_count, output_file);
+        pending_bytes_count = 0;
+    }
+    if (pending_lines != 0) {
+        fputc(BINARY_LINES, output_file);
+        emit_number(pending_lines);
+        pending_lines = 0;
+    }
+}
+
+static void strings_grow(void) {
+    binary_string_t* old_strings = strings;
+    size_t old_capacity = strings_capacity;
+
+    strings_capacity = old_capacity ? old_capacity * 2 : 256;
+    strings = calloc(strings_capacity, sizeof(binary_string_t));
+    if (strings == NULL) {
+        fatal("Out of memory.");
+    }
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+        binary_string_t* string = old_strings + i;
+        if (string->name == NULL)
+            continue;
+        size_t index = string->hash & (strings_capacity - 1);
+        while (strings[index].name != NULL)
+            index = (index + 1) & (strings_capacity - 1);
+        strings[index] = *string;
+    }
+    free(old_strings);
+}
+
+/**
+ * Returns the string table index of the given name, writing a string record
+ * if it's not in the table yet.
+ */
+static unsigned emit_string(const char* name) {
+    if (strings_count * 2 >= strings_capacity) {
+        strings_grow();
+    }
+
+    uint32_t hash = fnv1a_cstr(name);
+    size_t index = hash & (strings_capacity - 1);
+    for (;;) {
+        binary_string_t* string = strings + index;
+        if (string->name == NULL)
+            break;
+        if (string->hash == hash && 0 == strcmp(string->name, name))
+            return string->index;
+        index = (index + 1) & (strings_capacity - 1);
+    }
+
+    binary_string_t* string = strings + index;
+    string->name = strdup(name);
+    if (string->name == NULL) {
+        fatal("Out of memory.");
+    }
+    string->hash = hash;
+    string->index = strings_count++;
+
+    emit_flush();
+    size_t length = strlen(name);
+    fputc(BINARY_STRING, output_file);
+    emit_number(length);
+    fwrite(name, 1, length, output_file);
+    return string->index;
+}
+
+void emit_begin(void) {
+    if (output_binary) {
+        static const uint8_t header[4] = {0x7F, 'o', 'o', 0x01};
+        fwrite(header, 1, sizeof(header), output_file);
+    }
+}
+
+void emit_end(void) {
+    relax_flush();
+    if (output_binary) {
+        emit_flush();
+        fputc(BINARY_END, output_file);
+        for (size_t i = 0; i < strings_capacity; ++i) {
+            free(strings[i].name);
+        }
+        free(strings);
+        strings = NULL;
+        strings_capacity = 0;
+        strings_count = 0;
+    }
+}
+
+static void emit_binary_label(const char* name, label_type_t type, int flags,
+        int constructor_priority, int destructor_priority)
+{
+    unsigned index = emit_string(name);
+    emit_flush();
+
+    switch (type) {
+        case label_type_definition_label:
+            fputc(BINARY_LABEL, output_file);
+            break;
+
+        case label_type_definition_symbol:
+        case label_type_definition_static: {
+            unsigned binary_flags = 0;
+            if (type == label_type_definition_static)
+                binary_flags |= BINARY_SYMBOL_STATIC;
+            if (flags & LABEL_FLAG_WEAK)
+                binary_flags |= BINARY_SYMBOL_WEAK;
+            if (flags & LABEL_FLAG_ZERO)
+                binary_flags |= BINARY_SYMBOL_ZERO;
+            if (flags & LABEL_FLAG_CONSTRUCTOR)
+                binary_flags |= BINARY_SYMBOL_CONSTRUCTOR;
+            if (flags & LABEL_FLAG_DESTRUCTOR)
+                binary_flags |= BINARY_SYMBOL_DESTRUCTOR;
+            fputc(BINARY_SYMBOL, output_file);
+            emit_number(binary_flags);
+            if (flags & LABEL_FLAG_CONSTRUCTOR)
+                emit_number(constructor_priority + 1);
+            if (flags & LABEL_FLAG_DESTRUCTOR)
+                emit_number(destructor_priority + 1);
+            break;
+        }
+
+        default:
+            fputc(BINARY_INVOKE, output_file);
+            emit_number(label_type_to_char(type));
+            emit_number((flags & LABEL_FLAG_WEAK) ? 2 : 0);
+            break;
+    }
+
+    emit_number(index);
+}
+
+
+
+/*
+ * Output
+ */
 
 static char label_type_to_char(label_type_t type) {
     switch (type) {
@@ -51,7 +255,14 @@ static void emit_priority(int priority) {
 void emit_label(const char* name, label_type_t type, int flags,
         int constructor_priority, int destructor_priority)
 {
+    if (relax_is_recording()) {
+        relax_add_label(name, type, flags, constructor_priority, destructor_priority);
+    } else if (output_binary) {
+        emit_binary_label(name, type, flags, constructor_priority, destructor_priority);
+    }
+
     // track alignment
+    immediate_observe_label(type);
     switch (type) {
         case label_type_invocation_high: // fallthrouh
         case label_type_invocation_low: // fallthrouh
@@ -66,6 +277,10 @@ void emit_label(const char* name, label_type_t type, int flags,
             break;
     }
 
+    if (relax_is_recording() || output_binary) {
+        return;
+    }
+
     // emit label
     emit_char(label_type_to_char(type));
     if (flags & LABEL_FLAG_WEAK)
@@ -109,9 +324,20 @@ void emit_char(char c) {
 }
 
 void emit_hex_byte(uint8_t byte) {
+    immediate_observe_byte(byte);
+    output_alignment = (output_alignment + 1) & 3;
+    if (relax_is_recording()) {
+        relax_add_byte(byte);
+        return;
+    }
+    if (output_binary) {
+        if (pending_lines != 0 || pending_bytes_count == PENDING_BYTES_SIZE)
+            emit_flush();
+        pending_bytes[pending_bytes_count++] = byte;
+        return;
+    }
     emit_char(int_to_hex(byte >> 4));
     emit_char(int_to_hex(byte & 0xF));
-    output_alignment = (output_alignment + 1) & 3;
 }
 
 void emit_hex_bytes(const uint8_t* bytes, size_t count) {
@@ -120,7 +346,97 @@ void emit_hex_bytes(const uint8_t* bytes, size_t count) {
     }
 }
 
+void emit_newline(void) {
+    if (relax_is_recording()) {
+        relax_add_newline();
+        return;
+    }
+    if (output_binary) {
+        if (pending_bytes_count != 0)
+            emit_flush();
+        ++pending_lines;
+        return;
+    }
+    emit_char('\n');
+}
+
+void emit_debug_line(const char* text) {
+    if (relax_is_recording()) {
+        relax_add_debug_line(text);
+        return;
+    }
+    if (!output_binary) {
+        emit_char('#');
+        fputs(text, output_file);
+        return;
+    }
+
+    // a bare `#` is a line increment
+    const char* p = text;
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    if (*p == 0) {
+        emit_flush();
+        fputc(BINARY_INCREMENT, output_file);
+        return;
+    }
+
+    // `#line manual`, `#line <number>` and `#line <number> "<filename>"`
+    if (0 == strncmp(p, "line", 4) && (p[4] == ' ' || p[4] == '\t')) {
+        const char* q = p + 4;
+        while (*q == ' ' || *q == '\t')
+            ++q;
+        if (0 == strcmp(q, "manual")) {
+            emit_flush();
+            fputc(BINARY_MANUAL, output_file);
+            return;
+        }
+        if (isdigit((unsigned char)*q)) {
+            int line = 0;
+            while (isdigit((unsigned char)*q))
+                line = line * 10 + (*q++ - '0');
+            while (*q == ' ' || *q == '\t')
+                ++q;
+            if (*q == 0) {
+                emit_line_directive(line, NULL);
+                return;
+            }
+            const char* end = strchr(q + 1, '"');
+            if (*q == '"' && end != NULL && end[1] == 0) {
+                char* filename = strndup(q + 1, end - (q + 1));
+                if (filename == NULL)
+                    fatal("Out of memory.");
+                emit_line_directive(line, filename);
+                free(filename);
+                return;
+            }
+        }
+    }
+
+    // anything else is kept verbatim
+    unsigned index = emit_string(text);
+    emit_flush();
+    fputc(BINARY_DEBUG, output_file);
+    emit_number(index);
+}
+
 void emit_line_directive(int line, const char* /*nullable*/ filename) {
+    if (relax_is_recording()) {
+        relax_add_line_directive(line, filename);
+        return;
+    }
+    if (output_binary) {
+        unsigned index = filename ? emit_string(filename) + 1 : 0;
+        emit_flush();
+        fputc(BINARY_LINE, output_file);
+        emit_number(line);
+        emit_number(index);
+
+        // the plain text directive ends with a line ending
+        ++pending_lines;
+        return;
+    }
+
     fputs("#line ", output_file);
     fprintf(output_file, "%i", line);
     if (filename) {
@@ -25,6 +25,7 @@
 #ifndef EMIT_H_INCLUDED
 #define EMIT_H_INCLUDED
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -34,6 +35,19 @@
 extern FILE* output_file;
 extern size_t output_alignment;
 
+//! Whether to output binary object code rather than plain text
+extern bool output_binary;
+
+/**
+ * Starts the output. In binary mode this writes the header.
+ */
+void emit_begin(void);
+
+/**
+ * Ends the output. In binary mode this writes the end record.
+ */
+void emit_end(void);
+
 void emit_label(const char* name, label_type_t type, int flags,
         int constructor_priority, int destructor_priority);
 
@@ -45,6 +59,14 @@ void emit_hex_bytes(const uint8_t* bytes, size_t count);
 
 void emit_char(char c);
 
+void emit_newline(void);
+
+/**
+ * Emits a debug line. The given text follows the `#` and excludes the line
+ * ending.
+ */
+void emit_debug_line(const char* text);
+
 void emit_line_directive(int line, const char* /*nullable*/ filename);
 
 #endif
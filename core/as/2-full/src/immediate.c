@@ -0,0 +1,165 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "immediate.h"
+
+#include "emit.h"
+
+bool immediate_enabled;
+
+// We track the numbered registers and the scratch registers.
+#define IMMEDIATE_REGISTERS 12
+#define IMMEDIATE_R0 0x80
+#define IMMEDIATE_RIP 0x8F
+
+// The opcodes we need to decode
+#define IMMEDIATE_STW 0x79
+#define IMMEDIATE_STB 0x7B
+#define IMMEDIATE_JZ 0x7E
+#define IMMEDIATE_SYS 0x7F
+
+static bool known[IMMEDIATE_REGISTERS];
+static int32_t values[IMMEDIATE_REGISTERS];
+
+// The bytes of the instruction currently being emitted
+static uint8_t instruction[4];
+static bool instruction_known[4];
+
+void immediate_reset(void) {
+    for (int i = 0; i < IMMEDIATE_REGISTERS; ++i)
+        known[i] = false;
+}
+
+static void immediate_clobber(uint8_t reg) {
+    if (reg >= IMMEDIATE_R0 && reg < IMMEDIATE_R0 + IMMEDIATE_REGISTERS)
+        known[reg - IMMEDIATE_R0] = false;
+}
+
+static void immediate_decode(void) {
+    // if we can't tell what it is, assume the worst
+    if (!instruction_known[0] || !instruction_known[1]) {
+        immediate_reset();
+        return;
+    }
+
+    switch (instruction[0]) {
+        case IMMEDIATE_STW:
+        case IMMEDIATE_STB:
+            // stores don't write to a register
+            return;
+
+        case IMMEDIATE_JZ:
+        case IMMEDIATE_SYS:
+            // a jump ends the basic block
+            immediate_reset();
+            return;
+
+        default:
+            break;
+    }
+
+    if (instruction[0] < 0x70 || instruction[0] > 0x7F || instruction[1] == IMMEDIATE_RIP) {
+        // data or a jump
+        immediate_reset();
+        return;
+    }
+    immediate_clobber(instruction[1]);
+}
+
+// The given offset is from the current output position.
+static void immediate_observe(size_t offset, uint8_t byte, bool is_known) {
+    size_t index = (output_alignment + offset) & 3;
+    instruction[index] = byte;
+    instruction_known[index] = is_known;
+    if (index == 3)
+        immediate_decode();
+}
+
+void immediate_observe_byte(uint8_t byte) {
+    if (immediate_enabled)
+        immediate_observe(0, byte, true);
+}
+
+void immediate_observe_label(label_type_t type) {
+    if (!immediate_enabled)
+        return;
+    switch (type) {
+        case label_type_invocation_absolute:
+            immediate_observe(0, 0, false);
+            immediate_observe(1, 0, false);
+            immediate_observe(2, 0, false);
+            immediate_observe(3, 0, false);
+            break;
+
+        case label_type_invocation_high:
+        case label_type_invocation_low:
+        case label_type_invocation_relative:
+            immediate_observe(0, 0, false);
+            immediate_observe(1, 0, false);
+            break;
+
+        case label_type_definition_label:
+        case label_type_definition_symbol:
+        case label_type_definition_static:
+            // something else may jump here
+            immediate_reset();
+            break;
+    }
+}
+
+void immediate_set(uint8_t reg, int32_t value) {
+    if (reg >= IMMEDIATE_R0 && reg < IMMEDIATE_R0 + IMMEDIATE_REGISTERS) {
+        known[reg - IMMEDIATE_R0] = true;
+        values[reg - IMMEDIATE_R0] = value;
+    }
+}
+
+bool immediate_get(uint8_t reg, int32_t* out_value) {
+    if (reg < IMMEDIATE_R0 || reg >= IMMEDIATE_R0 + IMMEDIATE_REGISTERS)
+        return false;
+    if (!known[reg - IMMEDIATE_R0])
+        return false;
+    *out_value = values[reg - IMMEDIATE_R0];
+    return true;
+}
+
+bool immediate_find(int32_t value, uint8_t* out_reg, int32_t* out_delta) {
+    bool found = false;
+    for (int i = 0; i < IMMEDIATE_REGISTERS; ++i) {
+        if (!known[i])
+            continue;
+        // unsigned to avoid overflow
+        int32_t delta = (int32_t)((uint32_t)value - (uint32_t)values[i]);
+        if (delta < -112 || delta > 127)
+            continue;
+        if (!found || delta == 0) {
+            *out_reg = (uint8_t)(IMMEDIATE_R0 + i);
+            *out_delta = delta;
+            found = true;
+            if (delta == 0)
+                break;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef IMMEDIATE_H_INCLUDED
+#define IMMEDIATE_H_INCLUDED
+
+/*
+ * Immediate tracking
+ *
+ * With -O, the assembler decodes the instructions it emits to keep track of
+ * the constants loaded by `imw` into registers. Within a basic block, `imw`
+ * can then be assembled to a shorter instruction that reuses one of them.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+//! Whether to track register values (the -O option)
+extern bool immediate_enabled;
+
+/**
+ * Observes an emitted byte. This must be called before the output alignment
+ * is updated.
+ */
+void immediate_observe_byte(uint8_t byte);
+
+/**
+ * Observes an emitted label. A definition starts a new basic block. As above,
+ * this must be called before the output alignment is updated.
+ */
+void immediate_observe_label(label_type_t type);
+
+/**
+ * Forgets all known register values.
+ */
+void immediate_reset(void);
+
+/**
+ * Records that the given register now contains the given value. This must be
+ * called after emitting the instruction that loads it.
+ */
+void immediate_set(uint8_t reg, int32_t value);
+
+/**
+ * Gets the known value of the given register, returning false if it isn't
+ * known.
+ */
+bool immediate_get(uint8_t reg, int32_t* out_value);
+
+/**
+ * Finds a register whose value is within mix-type range of the given value,
+ * preferring an exact match. The difference (value minus the register's
+ * value) is returned in out_delta.
+ */
+bool immediate_find(int32_t value, uint8_t* out_reg, int32_t* out_delta);
+
+#endif
@@ -35,53 +35,85 @@
 
 #include "common.h"
 #include "emit.h"
+#include "immediate.h"
 #include "parse.h"
 #include "opcodes.h"
+#include "relax.h"
 
 int main(int argc, const char** argv) {
 
     // Parse arguments
     const char* usage = "Incorrect arguments.\n"
-            "Usage: <as> <input> -o <output>";
-    if (argc != 4) {
-        fatal(usage);
+            "Usage: <as> [-binary] [-O] <input> -o <output>";
+    const char* input_filename = NULL;
+    const char* output_filename = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-binary")) {
+            output_binary = true;
+            continue;
+        }
+        if (0 == strcmp(argv[i], "-O")) {
+            relax_enabled = true;
+            immediate_enabled = true;
+            continue;
+        }
+        if (0 == strcmp(argv[i], "-o")) {
+            if (output_filename != NULL || i + 1 == argc) {
+                fatal(usage);
+            }
+            output_filename = argv[++i];
+            continue;
+        }
+        if (input_filename != NULL) {
+            fatal(usage);
+        }
+        input_filename = argv[i];
     }
-    const char* input_filename;
-    const char* output_filename;
-    if (0 == strcmp(argv[1], "-o")) {
-        output_filename = argv[2];
-        input_filename = argv[3];
-    } else if (0 == strcmp(argv[2], "-o")) {
-        input_filename = argv[1];
-        output_filename = argv[3];
-    } else {
+    if (input_filename == NULL || output_filename == NULL) {
         fatal(usage);
     }
 
-    // Open files
-    input_file = fopen(input_filename, "rb");
-    if (input_file == NULL) {
-        fatal("Failed to open input file.");
+    // Open files. `-` is standard input or output.
+    if (0 == strcmp(input_filename, "-")) {
+        input_file = stdin;
+    } else {
+        input_file = fopen(input_filename, "rb");
+        if (input_file == NULL) {
+            fatal("Failed to open input file.");
+        }
     }
     read_char();
-    output_file = fopen(output_filename, "wb");
-    if (output_file == NULL) {
-        fatal("Failed to open output file.");
+    if (0 == strcmp(output_filename, "-")) {
+        output_file = stdout;
+    } else {
+        output_file = fopen(output_filename, "wb");
+        if (output_file == NULL) {
+            fatal("Failed to open output file.");
+        }
     }
 
     // Prepare
     opcodes_init();
     set_current_filename(input_filename);
-    emit_line_directive(1, input_filename);
+    emit_begin();
+    parse_begin(input_filename);
     current_line = 1;
 
     // Run parse loop
     while (parse()) {}
 
     // Clean up
-    fclose(output_file);
-    fclose(input_file);
+    emit_end();
+    if (output_file == stdout) {
+        fflush(output_file);
+    } else {
+        fclose(output_file);
+    }
+    if (input_file != stdin) {
+        fclose(input_file);
+    }
     set_current_filename(NULL);
+    relax_destroy();
     opcodes_destroy();
 
     return 0;
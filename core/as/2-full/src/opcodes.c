@@ -29,6 +29,8 @@
 
 #include "parse.h"
 #include "emit.h"
+#include "immediate.h"
+#include "relax.h"
 
 #include "libo-util.h"
 
@@ -63,53 +65,80 @@
  * Helpers
  */
 
-// Parses and emits the offset (destination) of a jz instruction.
-static void parse_and_emit_jump_offset(void) {
-    if (try_parse_invocation_relative()) {
-        emit_label(identifier, label_type_invocation_relative, label_flags, -1, -1);
+// Parses the destination of a relative jump and emits it. With -O the jump is
+// recorded instead so it can be optimized once the symbol is complete.
+static void opcode_jump(jump_type_t type, uint8_t predicate) {
+    if (!try_parse_invocation_relative()) {
+        fatal("Expected relative label as jump destination.");
+    }
+    if (relax_is_recording()) {
+        // The jump won't be emitted until later so we end the basic block
+        // here.
+        immediate_reset();
+        relax_add_jump(type, predicate, identifier, label_flags);
         return;
     }
-    fatal("Expected relative label as jump destination.");
+    opcodes_emit_jump(type, predicate, identifier, label_flags);
 }
 
-// TODO these jump instructions are slow, the ones in as/1 are better
+void opcodes_emit_jump(jump_type_t type, uint8_t predicate, const char* label, int flags) {
+    switch (type) {
+        case jump_type_jz: {
+            uint8_t bytes[] = {
+                JZ, predicate,              // jz pred label
+            };
+            emit_hex_bytes(bytes, sizeof(bytes));
+            break;
+        }
 
-static void opcode_jz_je(uint8_t pred) {
-    emit_hex_byte(JZ);  // jz
-    emit_hex_byte(pred);  // pred
-    parse_and_emit_jump_offset();
-}
+        case jump_type_jnz: {
+            uint8_t bytes[] = {
+                JZ, predicate, 0x01, 0x00,  // jz pred +1
+                JZ, 0x00,                   // jz 0 label
+            };
+            emit_hex_bytes(bytes, sizeof(bytes));
+            break;
+        }
 
-static void opcode_jnz_jne(uint8_t pred) {
-    uint8_t bytes[] = {
-        JZ, pred, 0x01, 0x00,  // jz pred +1
-        JZ, 0x00,              // jz 0 label
-    };
-    emit_hex_bytes(bytes, sizeof(bytes));
-    parse_and_emit_jump_offset();
-}
+        // Jumps if the value matches
+        case jump_type_jg:
+        case jump_type_jl: {
+            uint8_t value = type == jump_type_jg ? 0x01 : 0xFF;
+            uint8_t bytes[] = {
+                CMPU, RB, predicate, value, // cmpu rb reg value
+                JZ, RB,                     // jz rb label
+            };
+            emit_hex_bytes(bytes, sizeof(bytes));
+            break;
+        }
 
-// Jumps if the value matches
-static void opcode_jg_jl(uint8_t value) {
-    uint8_t reg = parse_register_non_scratch();
-    uint8_t bytes[] = {
-        CMPU, RB, reg, value,  // cmpu rb reg value
-        JZ, RB,              // jz rb label
-    };
-    emit_hex_bytes(bytes, sizeof(bytes));
-    parse_and_emit_jump_offset();
+        // Jumps if the value *doesn't* match
+        case jump_type_jge:
+        case jump_type_jle: {
+            uint8_t value = type == jump_type_jge ? 0xFF : 0x01;
+            uint8_t bytes[] = {
+                CMPU, RB, predicate, value, // cmpu rb reg value
+                JZ, RB, 0x01, 0x00,         // jz rb +1
+                JZ, 0x00,                   // jz 0 label
+            };
+            emit_hex_bytes(bytes, sizeof(bytes));
+            break;
+        }
+    }
+
+    emit_label(label, label_type_invocation_relative, flags, -1, -1);
 }
 
-// Jumps if the value *doesn't* match
-static void opcode_jge_jle(uint8_t value) {
-    uint8_t reg = parse_register_non_scratch();
-    uint8_t bytes[] = {
-        CMPU, RB, reg, value,  // cmpu rb reg value
-        JZ, RB, 0x01, 0x00,    // jz 0 +1
-        JZ, 0x00,              // jz rb label
-    };
-    emit_hex_bytes(bytes, sizeof(bytes));
-    parse_and_emit_jump_offset();
+int opcodes_jump_size(jump_type_t type) {
+    switch (type) {
+        case jump_type_jz: return 4;
+        case jump_type_jnz: return 8;
+        case jump_type_jg: return 8;
+        case jump_type_jl: return 8;
+        case jump_type_jge: return 12;
+        case jump_type_jle: return 12;
+    }
+    fatal("Internal error: invalid jump type");
 }
 
 static void opcode_reg_mix_mix(uint8_t opcode) {
@@ -703,7 +732,7 @@ static void opcode_cmpu(void) {
 }
 
 static void opcode_jz(void) {
-    opcode_jz_je(parse_mix());
+    opcode_jump(jump_type_jz, parse_mix());
 }
 
 static void opcode_sys(void) {
@@ -723,6 +752,77 @@ static void opcode_sys(void) {
     emit_hex_bytes(bytes, sizeof(bytes));
 }
 
+static bool is_mix_immediate(int32_t value) {
+    return value >= -112 && value <= 127;
+}
+
+// With -O, tries to load the value with a single instruction.
+static bool try_emit_imw_number_short(uint8_t reg, int32_t value) {
+
+    // a mix-type byte
+    if (is_mix_immediate(value)) {
+        uint8_t bytes[] = {ADD, reg, 0x00, (uint8_t)value};  // add reg 0 value
+        emit_hex_bytes(bytes, sizeof(bytes));
+        return true;
+    }
+    if (value < 0 && value != INT32_MIN && is_mix_immediate(-value)) {
+        uint8_t bytes[] = {SUB, reg, 0x00, (uint8_t)-value}; // sub reg 0 -value
+        emit_hex_bytes(bytes, sizeof(bytes));
+        return true;
+    }
+
+    // a mix-type byte shifted left
+    int32_t mantissa = value;
+    uint8_t shift = 0;
+    while (mantissa != 0 && (mantissa & 1) == 0) {
+        mantissa /= 2;
+        ++shift;
+    }
+    if (mantissa != 0 && is_mix_immediate(mantissa)) {
+        uint8_t bytes[] = {SHL, reg, (uint8_t)mantissa, shift};  // shl reg mantissa shift
+        emit_hex_bytes(bytes, sizeof(bytes));
+        return true;
+    }
+
+    // a register that's already loaded with a nearby value
+    uint8_t src;
+    int32_t delta;
+    if (immediate_find(value, &src, &delta)) {
+        if (src == reg && delta == 0) {
+            // it's already loaded
+            return true;
+        }
+        uint8_t bytes[] = {ADD, reg, src, (uint8_t)delta};  // add reg src delta
+        emit_hex_bytes(bytes, sizeof(bytes));
+        return true;
+    }
+
+    // the register already contains the high bits
+    int32_t old_value;
+    if (immediate_get(reg, &old_value) &&
+            ((uint32_t)old_value << 16) == ((uint32_t)value & 0xFFFF0000u))
+    {
+        uint8_t bytes[] = {
+            IMS, reg, (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF),  // ims reg byte1 byte2
+        };
+        emit_hex_bytes(bytes, sizeof(bytes));
+        return true;
+    }
+
+    return false;
+}
+
+static void emit_imw_number(uint8_t reg, int32_t value) {
+    if (!immediate_enabled || !try_emit_imw_number_short(reg, value)) {
+        uint8_t bytes[] = {
+            IMS, reg, (uint8_t)((value >> 16) & 0xFF), (uint8_t)((value >> 24) & 0xFF),  // ims reg byte3 byte4
+            IMS, reg, (uint8_t)((value      ) & 0xFF), (uint8_t)((value >>  8) & 0xFF),  // ims reg byte1 byte2
+        };
+        emit_hex_bytes(bytes, sizeof(bytes));
+    }
+    immediate_set(reg, value);
+}
+
 static void opcode_imw(void) {
     uint8_t reg = parse_register();
     if (reg == RIP) {
@@ -736,11 +836,7 @@ static void opcode_imw(void) {
     // number
     int32_t value;
     if (try_parse_number(&value)) {
-        uint8_t bytes[] = {
-            IMS, reg, (uint8_t)((value >> 16) & 0xFF), (uint8_t)((value >> 24) & 0xFF),  // ims reg byte3 byte4
-            IMS, reg, (uint8_t)((value      ) & 0xFF), (uint8_t)((value >>  8) & 0xFF),  // ims reg byte1 byte2
-        };
-        emit_hex_bytes(bytes, sizeof(bytes));
+        emit_imw_number(reg, value);
         return;
     }
 
@@ -768,11 +864,8 @@ static void opcode_imw(void) {
             try_parse_character_or_quoted_byte(&c) &&
             try_parse_character_or_quoted_byte(&d))
     {
-        uint8_t bytes[] = {
-            IMS, reg, c, d,  // ims reg c d
-            IMS, reg, a, b,  // ims reg a b
-        };
-        emit_hex_bytes(bytes, sizeof(bytes));
+        emit_imw_number(reg, (int32_t)((uint32_t)a | ((uint32_t)b << 8) |
+                ((uint32_t)c << 16) | ((uint32_t)d << 24)));
         return;
     }
 
@@ -823,7 +916,7 @@ static void opcode_lts(void) {
 }
 
 static void opcode_jnz(void) {
-    opcode_jnz_jne(parse_mix());
+    opcode_jump(jump_type_jnz, parse_mix());
 }
 
 static void opcode_jmp(void) {
@@ -839,37 +932,33 @@ static void opcode_jmp(void) {
     }
 
     // relative
-    emit_hex_byte(JZ);  // jz
-    emit_hex_byte(0x00);  // 0
-    parse_and_emit_jump_offset();
+    opcode_jump(jump_type_jz, 0x00);  // jz 0 label
 }
 
 static void opcode_je(void) {
     // same as jz except we only accept a register as predicate, not a mix-type
-    opcode_jz_je(parse_register());
+    opcode_jump(jump_type_jz, parse_register());
 }
 
 static void opcode_jne(void) {
     // same as jnz except we only accept a register as predicate, not a mix-type
-    opcode_jnz_jne(parse_register());
+    opcode_jump(jump_type_jnz, parse_register());
 }
 
 static void opcode_jg(void) {
-    opcode_jg_jl(0x01);
+    opcode_jump(jump_type_jg, parse_register_non_scratch());
 }
 
 static void opcode_jl(void) {
-    opcode_jg_jl(0xFF);
+    opcode_jump(jump_type_jl, parse_register_non_scratch());
 }
 
 static void opcode_jge(void) {
-    // The value is what we *don't* want to jump on
-    opcode_jge_jle(0xFF);
+    opcode_jump(jump_type_jge, parse_register_non_scratch());
 }
 
 static void opcode_jle(void) {
-    // The value is what we *don't* want to jump on
-    opcode_jge_jle(0x01);
+    opcode_jump(jump_type_jle, parse_register_non_scratch());
 }
 
 static void opcode_enter(void) {
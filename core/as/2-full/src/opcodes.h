@@ -25,8 +25,35 @@
 #ifndef OPCODES_H_INCLUDED
 #define OPCODES_H_INCLUDED
 
+#include <stdint.h>
+
+/**
+ * The relative jump instructions. (An unconditional `jmp` to a relative label
+ * is a `jz` with an immediate zero predicate.)
+ */
+typedef enum jump_type_t {
+    jump_type_jz,  // jumps if the predicate is zero
+    jump_type_jnz, // jumps if the predicate is not zero
+    jump_type_jg,  // jumps if the predicate register is 1
+    jump_type_jl,  // jumps if the predicate register is -1
+    jump_type_jge, // jumps if the predicate register is not -1
+    jump_type_jle, // jumps if the predicate register is not 1
+} jump_type_t;
+
 void opcodes_init(void);
 void opcodes_destroy(void);
 void opcodes_dispatch(const char* name);
 
+/**
+ * Emits the instructions for a relative jump of the given type to the given
+ * label.
+ */
+void opcodes_emit_jump(jump_type_t type, uint8_t predicate, const char* label, int flags);
+
+/**
+ * Returns the size in bytes of the instructions emitted for a relative jump of
+ * the given type.
+ */
+int opcodes_jump_size(jump_type_t type);
+
 #endif
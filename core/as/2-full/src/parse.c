@@ -49,6 +49,10 @@ label_type_t label_type;
 int label_constructor_priority;
 int label_destructor_priority;
 
+// The filename of the initial `#line` directive, or null once it's emitted
+// (or left out.)
+static const char* initial_filename;
+
 
 
 /*
@@ -93,7 +97,7 @@ static bool try_parse_whitespace(void) {
 
     bool was_carriage_return = current_char == '\r';
     if (was_carriage_return || current_char == '\n') {
-        emit_char('\n');
+        emit_newline();
         ++current_line;
     }
     read_char();
@@ -120,23 +124,68 @@ static bool try_parse_comment(void) {
     return true;
 }
 
+/**
+ * Emits the initial `#line` directive naming the input if it hasn't been
+ * emitted yet, given the text of the first debug line (or null.)
+ *
+ * An input that starts with `#line manual` (such as the output of cci) gives
+ * every location itself so we leave out the initial directive. This keeps the
+ * name of the input, which is usually a temporary file, out of the output.
+ */
+static void emit_initial_line_directive(const char* /*nullable*/ text) {
+    if (initial_filename == NULL) {
+        return;
+    }
+    if (text == NULL || 0 != strcmp(text, "line manual")) {
+        emit_line_directive(1, initial_filename);
+    }
+    initial_filename = NULL;
+}
+
 static bool try_parse_debug(void) {
     if (current_char != '#')
         return false;
 
     // debug line found. consume it and feed it verbatim to the output
     // TODO also parse the line info, handle manual mode
-    do {
-        emit_char(current_char);
+    static char* text;
+    static size_t capacity;
+    size_t length = 0;
+    for (;;) {
         read_char();
-    } while (current_char != '\r' && current_char != '\n');
+        if (current_char == '\r' || current_char == '\n' || current_char == -1)
+            break;
+        if (length + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 128;
+            text = realloc(text, capacity);
+            if (text == NULL)
+                fatal("Out of memory.");
+        }
+        text[length++] = current_char;
+    }
+    if (text == NULL) {
+        // bare `#` at the start of the file
+        emit_initial_line_directive("");
+        emit_debug_line("");
+        return true;
+    }
+    text[length] = 0;
+    emit_initial_line_directive(text);
+    emit_debug_line(text);
 
     // as above, we don't consume the line ending.
 
     return true;
 }
 
+void parse_begin(const char* filename) {
+    initial_filename = filename;
+}
+
 void consume_whitespace_and_comments(void) {
+    if (current_char != '#') {
+        emit_initial_line_directive(NULL);
+    }
     for (;;) {
         if (try_parse_whitespace())
             continue;
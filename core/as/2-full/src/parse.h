@@ -68,6 +68,10 @@ uint8_t parse_mix(void);
 uint8_t parse_mix_non_scratch(void); // excludes scratch registers required for implementing compound instructions
 uint8_t parse_syscall_number(void);
 
+//! Prepares to parse the given input file. The output starts with a `#line`
+//! directive naming it unless the input starts with `#line manual`.
+void parse_begin(const char* filename);
+
 //! Performs one step of parsing. Returns false at end-of-file.
 bool parse(void);
 
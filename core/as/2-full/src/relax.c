@@ -0,0 +1,591 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "relax.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emit.h"
+
+bool relax_enabled;
+
+// Set while the recorded output is being emitted.
+static bool replaying;
+
+// A jump can be retargeted through at most this many unconditional jumps.
+#define RELAX_MAX_THREADING 16
+
+// Jumps are only retargeted within symbols smaller than this so that they
+// stay within range of the relative jump offset.
+#define RELAX_MAX_THREADING_SIZE 0x8000
+
+typedef enum relax_op_type_t {
+    relax_op_none,              // removed
+    relax_op_bytes,
+    relax_op_label,
+    relax_op_newline,
+    relax_op_debug_line,
+    relax_op_line_directive,
+    relax_op_jump,
+} relax_op_type_t;
+
+typedef struct relax_op_t {
+    relax_op_type_t type;
+    size_t bytes_start;         // bytes: index into relax_bytes
+    size_t bytes_count;         // bytes: number of bytes
+    uint8_t predicate;
+    label_type_t label_type;
+    jump_type_t jump_type;
+    int flags;
+    int constructor_priority;
+    int destructor_priority;
+    int line;
+    size_t symbol;              // number of symbols defined before this op
+    char* name;                 // label, jump target, debug text or filename
+} relax_op_t;
+
+static relax_op_t* ops;
+static size_t ops_count;
+static size_t ops_capacity;
+
+static uint8_t* relax_bytes;
+static size_t relax_bytes_count;
+static size_t relax_bytes_capacity;
+
+static size_t symbols_count;
+
+// A hashtable of the labels and symbols defined or invoked in the recorded
+// output. It uses open addressing with linear probing.
+typedef struct relax_name_t {
+    const char* name;
+    uint32_t hash;
+    size_t definition;          // index of the defining op, or ops_count
+    size_t references;          // number of invocations
+} relax_name_t;
+
+static relax_name_t* names;
+static size_t names_capacity; // always a power of two
+
+// The size in bytes of each symbol
+static size_t* symbol_sizes;
+
+// Names replaced by retargeting. The names table may still point to them so
+// they're freed when we're done.
+static char** garbage;
+static size_t garbage_count;
+static size_t garbage_capacity;
+
+bool relax_is_recording(void) {
+    return relax_enabled && !replaying;
+}
+
+static relax_op_t* relax_add(relax_op_type_t type) {
+    if (ops_count == ops_capacity) {
+        ops_capacity = ops_capacity ? ops_capacity * 2 : 256;
+        ops = realloc(ops, ops_capacity * sizeof(relax_op_t));
+        if (ops == NULL) {
+            fatal("Out of memory.");
+        }
+    }
+    relax_op_t* op = ops + ops_count++;
+    memset(op, 0, sizeof(relax_op_t));
+    op->type = type;
+    op->symbol = symbols_count;
+    return op;
+}
+
+static char* relax_strdup(const char* str) {
+    char* ret = strdup(str);
+    if (ret == NULL) {
+        fatal("Out of memory.");
+    }
+    return ret;
+}
+
+void relax_add_byte(uint8_t byte) {
+    if (relax_bytes_count == relax_bytes_capacity) {
+        relax_bytes_capacity = relax_bytes_capacity ? relax_bytes_capacity * 2 : 4096;
+        relax_bytes = realloc(relax_bytes, relax_bytes_capacity);
+        if (relax_bytes == NULL) {
+            fatal("Out of memory.");
+        }
+    }
+    relax_bytes[relax_bytes_count] = byte;
+
+    // consecutive bytes are accumulated into a single op
+    if (ops_count == 0 || ops[ops_count - 1].type != relax_op_bytes) {
+        relax_op_t* op = relax_add(relax_op_bytes);
+        op->bytes_start = relax_bytes_count;
+    }
+    ++ops[ops_count - 1].bytes_count;
+    ++relax_bytes_count;
+}
+
+void relax_add_label(const char* name, label_type_t type, int flags,
+        int constructor_priority, int destructor_priority)
+{
+    if (type == label_type_definition_symbol || type == label_type_definition_static)
+        ++symbols_count;
+    relax_op_t* op = relax_add(relax_op_label);
+    op->name = relax_strdup(name);
+    op->label_type = type;
+    op->flags = flags;
+    op->constructor_priority = constructor_priority;
+    op->destructor_priority = destructor_priority;
+}
+
+void relax_add_newline(void) {
+    relax_add(relax_op_newline);
+}
+
+void relax_add_debug_line(const char* text) {
+    relax_op_t* op = relax_add(relax_op_debug_line);
+    op->name = relax_strdup(text);
+}
+
+void relax_add_line_directive(int line, const char* /*nullable*/ filename) {
+    relax_op_t* op = relax_add(relax_op_line_directive);
+    op->line = line;
+    if (filename != NULL)
+        op->name = relax_strdup(filename);
+}
+
+void relax_add_jump(jump_type_t type, uint8_t predicate, const char* label, int flags) {
+    relax_op_t* op = relax_add(relax_op_jump);
+    op->jump_type = type;
+    op->predicate = predicate;
+    op->name = relax_strdup(label);
+    op->flags = flags;
+}
+
+
+
+/*
+ * Analysis
+ */
+
+static bool relax_is_label(relax_op_t* op) {
+    return op->type == relax_op_label && op->label_type == label_type_definition_label;
+}
+
+static bool relax_is_symbol(relax_op_t* op) {
+    return op->type == relax_op_label && (
+            op->label_type == label_type_definition_symbol ||
+            op->label_type == label_type_definition_static);
+}
+
+static bool relax_is_definition(relax_op_t* op) {
+    return relax_is_label(op) || relax_is_symbol(op);
+}
+
+static bool relax_is_invocation(relax_op_t* op) {
+    return op->type == relax_op_jump ||
+            (op->type == relax_op_label && !relax_is_definition(op));
+}
+
+// Returns true if the op emits bytes.
+static bool relax_is_code(relax_op_t* op) {
+    return op->type == relax_op_bytes || relax_is_invocation(op);
+}
+
+// Returns true if the op is a jump we're allowed to modify.
+static bool relax_is_jump(relax_op_t* op) {
+    return op->type == relax_op_jump && op->flags == 0;
+}
+
+// Returns true if the op is a jump that is always taken.
+static bool relax_is_unconditional(relax_op_t* op) {
+    return relax_is_jump(op) && op->jump_type == jump_type_jz && op->predicate == 0x00;
+}
+
+static bool relax_is_immediate(uint8_t mix) {
+    return mix < 0x80 || mix >= 0x90;
+}
+
+static size_t relax_op_size(relax_op_t* op) {
+    if (op->type == relax_op_bytes)
+        return op->bytes_count;
+    if (op->type == relax_op_jump)
+        return opcodes_jump_size(op->jump_type);
+    if (relax_is_invocation(op))
+        return op->label_type == label_type_invocation_absolute ? 4 : 2;
+    return 0;
+}
+
+// Returns the index of the first op at or after the given index that emits
+// bytes or starts a new symbol, or ops_count if there isn't one.
+static size_t relax_next_code(size_t index) {
+    while (index < ops_count && !relax_is_code(ops + index) && !relax_is_symbol(ops + index))
+        ++index;
+    return index;
+}
+
+static relax_name_t* relax_find_name(const char* name) {
+    size_t mask = names_capacity - 1;
+    uint32_t hash = fnv1a_cstr(name);
+    size_t index = hash & mask;
+    for (;;) {
+        relax_name_t* entry = names + index;
+        if (entry->name == NULL) {
+            entry->name = name;
+            entry->hash = hash;
+            entry->definition = ops_count;
+            return entry;
+        }
+        if (entry->hash == hash && 0 == strcmp(entry->name, name))
+            return entry;
+        index = (index + 1) & mask;
+    }
+}
+
+// Returns the index of the op that defines the given label, or ops_count if
+// it isn't defined in this file.
+static size_t relax_find_definition(const char* name) {
+    return relax_find_name(name)->definition;
+}
+
+static bool relax_is_referenced(relax_op_t* op) {
+    // symbols can be referenced from other files
+    return !relax_is_label(op) || relax_find_name(op->name)->references != 0;
+}
+
+// Returns true if the given label is defined between the given indices
+// (exclusive of end.)
+static bool relax_defines(const char* name, size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+        relax_op_t* op = ops + i;
+        if (relax_is_definition(op) && 0 == strcmp(op->name, name))
+            return true;
+    }
+    return false;
+}
+
+// Returns true if any label defined between the given indices (exclusive of
+// end) is referenced.
+static bool relax_defines_referenced(size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+        relax_op_t* op = ops + i;
+        if (relax_is_definition(op) && relax_is_referenced(op))
+            return true;
+    }
+    return false;
+}
+
+// Builds the table of names and measures the symbols.
+static void relax_analyze(void) {
+    size_t count = 0;
+    for (size_t i = 0; i < ops_count; ++i)
+        if (ops[i].type == relax_op_label || ops[i].type == relax_op_jump)
+            ++count;
+
+    if (count * 2 >= names_capacity) {
+        free(names);
+        names_capacity = 256;
+        while (count * 2 >= names_capacity)
+            names_capacity *= 2;
+        names = malloc(names_capacity * sizeof(relax_name_t));
+        if (names == NULL) {
+            fatal("Out of memory.");
+        }
+    }
+    memset(names, 0, names_capacity * sizeof(relax_name_t));
+
+    free(symbol_sizes);
+    symbol_sizes = calloc(symbols_count + 1, sizeof(size_t));
+    if (symbol_sizes == NULL) {
+        fatal("Out of memory.");
+    }
+
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        symbol_sizes[op->symbol] += relax_op_size(op);
+        if (op->type != relax_op_label && op->type != relax_op_jump)
+            continue;
+        relax_name_t* name = relax_find_name(op->name);
+        if (!relax_is_definition(op)) {
+            ++name->references;
+        } else if (name->definition == ops_count) {
+            // if it's defined twice the linker will report it; we just use
+            // the first one
+            name->definition = i;
+        }
+    }
+}
+
+static void relax_remove(relax_op_t* op) {
+    // the name may still be in the names table so we keep it until we're done
+    op->type = relax_op_none;
+}
+
+static void relax_retarget(relax_op_t* op, const char* name) {
+    if (garbage_count == garbage_capacity) {
+        garbage_capacity = garbage_capacity ? garbage_capacity * 2 : 64;
+        garbage = realloc(garbage, garbage_capacity * sizeof(char*));
+        if (garbage == NULL) {
+            fatal("Out of memory.");
+        }
+    }
+    garbage[garbage_count++] = op->name;
+    op->name = relax_strdup(name);
+}
+
+
+
+/*
+ * Passes
+ *
+ * Each pass returns true if it changed anything.
+ */
+
+// A jz or jnz whose predicate is an immediate either always jumps or never
+// jumps.
+static bool relax_constant_predicates(void) {
+    bool changed = false;
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        if (!relax_is_jump(op) || !relax_is_immediate(op->predicate))
+            continue;
+        if (op->jump_type != jump_type_jz && op->jump_type != jump_type_jnz)
+            continue;
+        if (relax_is_unconditional(op))
+            continue;
+        bool taken = (op->predicate == 0x00) == (op->jump_type == jump_type_jz);
+        if (taken) {
+            op->jump_type = jump_type_jz;
+            op->predicate = 0x00;
+        } else {
+            relax_remove(op);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+// A jump to a label that is defined before the next instruction does nothing.
+static bool relax_remove_jumps_to_next(void) {
+    bool changed = false;
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        if (!relax_is_jump(op))
+            continue;
+        if (relax_defines(op->name, i + 1, relax_next_code(i + 1))) {
+            relax_remove(op);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// A jump that follows an unconditional jump can't be reached unless a label
+// that something jumps to is defined in between.
+static bool relax_remove_unreachable_jumps(void) {
+    bool changed = false;
+    for (size_t i = 0; i < ops_count; ++i) {
+        if (!relax_is_unconditional(ops + i))
+            continue;
+        size_t next = relax_next_code(i + 1);
+        if (next == ops_count || !relax_is_jump(ops + next))
+            continue;
+        if (relax_defines_referenced(i + 1, next))
+            continue;
+        relax_remove(ops + next);
+        changed = true;
+    }
+    return changed;
+}
+
+// A conditional jump over an unconditional jump can be inverted to replace
+// both of them. We only do this where the inverted jump is smaller.
+static bool relax_invert_jumps(void) {
+    bool changed = false;
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        if (!relax_is_jump(op))
+            continue;
+
+        jump_type_t inverted;
+        if (op->jump_type == jump_type_jnz) {
+            inverted = jump_type_jz;
+        } else if (op->jump_type == jump_type_jge) {
+            inverted = jump_type_jl;
+        } else if (op->jump_type == jump_type_jle) {
+            inverted = jump_type_jg;
+        } else {
+            continue;
+        }
+
+        // the next instruction must be an unconditional jump that nothing
+        // else jumps to
+        size_t next = relax_next_code(i + 1);
+        if (next == ops_count || !relax_is_unconditional(ops + next))
+            continue;
+        if (relax_defines_referenced(i + 1, next))
+            continue;
+
+        // our target must follow it
+        if (!relax_defines(op->name, next + 1, relax_next_code(next + 1)))
+            continue;
+
+        op->jump_type = inverted;
+        relax_retarget(op, ops[next].name);
+        relax_remove(ops + next);
+        changed = true;
+    }
+    return changed;
+}
+
+// A jump to a label whose first instruction is an unconditional jump is
+// retargeted to the destination of that jump.
+static bool relax_thread_jumps(void) {
+    bool changed = false;
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        if (!relax_is_jump(op))
+            continue;
+        if (symbol_sizes[op->symbol] >= RELAX_MAX_THREADING_SIZE)
+            continue;
+
+        const char* target = op->name;
+        int hops = 0;
+        for (; hops < RELAX_MAX_THREADING; ++hops) {
+            size_t definition = relax_find_definition(target);
+            if (definition == ops_count || ops[definition].symbol != op->symbol)
+                break;
+            size_t next = relax_next_code(definition + 1);
+            if (next == ops_count || !relax_is_unconditional(ops + next))
+                break;
+            const char* next_target = ops[next].name;
+            if (0 == strcmp(next_target, target))
+                break; // jumps to itself
+            definition = relax_find_definition(next_target);
+            if (definition == ops_count || ops[definition].symbol != op->symbol)
+                break; // it may be out of range
+            target = next_target;
+        }
+
+        // if we gave up, there's probably a cycle
+        if (hops == RELAX_MAX_THREADING || target == op->name)
+            continue;
+        relax_retarget(op, target);
+        changed = true;
+    }
+    return changed;
+}
+
+
+
+/*
+ * Output
+ */
+
+static void relax_replay(void) {
+    replaying = true;
+    for (size_t i = 0; i < ops_count; ++i) {
+        relax_op_t* op = ops + i;
+        switch (op->type) {
+            case relax_op_none:
+                break;
+            case relax_op_bytes:
+                emit_hex_bytes(relax_bytes + op->bytes_start, op->bytes_count);
+                break;
+            case relax_op_label:
+                emit_label(op->name, op->label_type, op->flags,
+                        op->constructor_priority, op->destructor_priority);
+                break;
+            case relax_op_newline:
+                emit_newline();
+                break;
+            case relax_op_debug_line:
+                emit_debug_line(op->name);
+                break;
+            case relax_op_line_directive:
+                emit_line_directive(op->line, op->name);
+                break;
+            case relax_op_jump:
+                opcodes_emit_jump(op->jump_type, op->predicate, op->name, op->flags);
+                break;
+        }
+    }
+    replaying = false;
+}
+
+void relax_flush(void) {
+    if (ops_count == 0)
+        return;
+
+    bool changed = true;
+    while (changed) {
+        relax_analyze();
+        changed = false;
+        if (relax_constant_predicates())
+            changed = true;
+        if (relax_remove_jumps_to_next())
+            changed = true;
+        if (relax_remove_unreachable_jumps())
+            changed = true;
+
+        // Inversion goes before threading since threading can retarget the
+        // jump we would have inverted. Threading goes last since it leaves
+        // the reference counts stale.
+        if (relax_invert_jumps())
+            changed = true;
+        if (relax_thread_jumps())
+            changed = true;
+    }
+
+    // Every jump sequence is a whole number of instructions so removing and
+    // resizing them doesn't change the alignment of the output.
+    size_t alignment = output_alignment;
+    relax_replay();
+    output_alignment = alignment;
+
+    for (size_t i = 0; i < ops_count; ++i)
+        free(ops[i].name);
+    for (size_t i = 0; i < garbage_count; ++i)
+        free(garbage[i]);
+    ops_count = 0;
+    garbage_count = 0;
+    relax_bytes_count = 0;
+    symbols_count = 0;
+}
+
+void relax_destroy(void) {
+    free(ops);
+    ops = NULL;
+    ops_count = 0;
+    ops_capacity = 0;
+    free(relax_bytes);
+    relax_bytes = NULL;
+    relax_bytes_count = 0;
+    relax_bytes_capacity = 0;
+    free(names);
+    names = NULL;
+    names_capacity = 0;
+    free(symbol_sizes);
+    symbol_sizes = NULL;
+    free(garbage);
+    garbage = NULL;
+    garbage_capacity = 0;
+}
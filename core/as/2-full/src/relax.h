@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RELAX_H_INCLUDED
+#define RELAX_H_INCLUDED
+
+/*
+ * Branch relaxation
+ *
+ * With -O, the output is recorded rather than emitted. When the input ends,
+ * relative jumps are rewritten into shorter sequences where possible and the
+ * result is emitted. See the README for details.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "opcodes.h"
+
+//! Whether to optimize relative jumps (the -O option)
+extern bool relax_enabled;
+
+/**
+ * Returns true if output should be recorded for relaxation rather than
+ * emitted.
+ */
+bool relax_is_recording(void);
+
+void relax_add_byte(uint8_t byte);
+
+void relax_add_label(const char* name, label_type_t type, int flags,
+        int constructor_priority, int destructor_priority);
+
+void relax_add_newline(void);
+
+void relax_add_debug_line(const char* text);
+
+void relax_add_line_directive(int line, const char* /*nullable*/ filename);
+
+void relax_add_jump(jump_type_t type, uint8_t predicate, const char* label, int flags);
+
+/**
+ * Optimizes the jumps in the recorded output and emits it.
+ */
+void relax_flush(void);
+
+/**
+ * Frees the recording buffer.
+ */
+void relax_destroy(void);
+
+#endif
@@ -37,6 +37,10 @@
 # `scripts/posix/build.sh`.
 #
 # See `docs/bootstrap-path.md` to follow what this script does.
+#
+# The stages below are also listed with their dependencies in
+# `scripts/posix/bootstrap.mk` for parallel and incremental builds. Keep the
+# two in sync.
 
 
 
@@ -89,8 +93,10 @@ sh core/cci/2-full/rebuild.sh
 sh core/cpp/2-full/rebuild.sh
 
 ## # Build the last few tools we need
+sh core/ar/1-unix/build.sh
 sh core/hex/1-c89/build.sh
-# TODO: The final stage archive tool does not exist yet. For now we provide the
-# previous stage.
-## sh core/ar/1-unix/build.sh
-cp build/intermediate/ar-0-cat/ar.oe build/output/bin/ar.oe
+sh core/objconv/build.sh
+
+# Index the final libc so the linker only loads the members it needs
+echo Indexing libc
+onrampvm build/output/bin/ar.oe s build/output/lib/libc.oa
@@ -52,6 +52,7 @@
 #include <unistd.h>
 
 #ifndef __onramp__
+    #include <time.h>
     #include <unistd.h>
     #include <sys/wait.h>
 #endif
@@ -74,6 +75,14 @@ extern int* __process_info_table;
 #define PIT_ENVIRON 7
 #define PIT_WORKDIR 8
 
+#ifdef __onramp__
+// VM syscalls (from libc/0 or libc/2)
+int __sys_fopen(const char* path, bool writeable);
+int __sys_fclose(int handle);
+int __sys_fseek(int handle, int base, int offset_low, int offset_high);
+int __sys_time(int* buffer);
+#endif
+
 static void parse_options(char** argv);
 
 
@@ -114,8 +123,17 @@ static bool nostddef;
 static bool debug_info;
 static bool optimize;
 static bool dump_macros;
+static bool use_pipe;
+static int jobs;
+static bool pipe_compile;   // pipe only cci and as (for the cache)
 static char* wrap_header;
 
+// dependency options
+static char* deps_mode;     // -M, -MM, -MD or -MMD
+static char* deps_file;     // -MF
+static char* deps_target;   // -MT
+static bool deps_phony;     // -MP
+
 // tools and libc files to use
 static char* tool_cpp;
 static char* tool_cci;
@@ -149,6 +167,39 @@ static char** objects;
 static size_t objects_count;
 static size_t objects_capacity;
 
+// array of the current file for each input as it passes through each phase
+// of translation (parallel to inputs)
+static char** stages;
+static size_t stages_count;
+static size_t stages_capacity;
+
+// array of arguments to the compiler for files awaiting compilation
+static char** compile_args;
+static size_t compile_args_count;
+static size_t compile_args_capacity;
+
+// array of output files named after their inputs (owning allocated strings)
+static char** named_outputs;
+static size_t named_outputs_count;
+static size_t named_outputs_capacity;
+
+// compilation cache directory (from ONRAMP_CACHE_DIR), or NULL if disabled
+static const char* cache_dir;
+static char* cache_buffer;
+
+// array of the cache entry for each input, or NULL if it isn't cached
+// (parallel to inputs, owning allocated strings)
+static char** cache_entries;
+static size_t cache_entries_count;
+static size_t cache_entries_capacity;
+
+// array of the output of each input that has already been fully translated
+// by the cache or by a pipeline, or NULL if it still needs to be compiled and
+// assembled (parallel to inputs, non-owning)
+static char** translated;
+static size_t translated_count;
+static size_t translated_capacity;
+
 
 
 /*
@@ -275,6 +326,29 @@ static bool try_parse_output(char*** argv) {
     return true;
 }
 
+static bool try_parse_jobs(char*** argv) {
+    if (!starts_with(**argv, "-j")) {
+        return false;
+    }
+
+    // The number of jobs can be provided as the next option or appended
+    // directly to -j.
+    char* count = (**argv + 2);
+    if (*count == 0) {
+        *argv = (*argv + 1);
+        if (**argv == 0) {
+            fatal_cleanup("-j must be followed by a number of jobs.");
+        }
+        count = **argv;
+    }
+    jobs = atoi(count);
+    if (jobs < 1) {
+        fatal_cleanup("-j must be followed by a positive number of jobs.");
+    }
+    *argv = (*argv + 1);
+    return true;
+}
+
 static bool try_parse_mode(char*** argv) {
     if (0 == strcmp(**argv, "-E")) {
         if (mode != MODE_LINK) {
@@ -345,16 +419,18 @@ static bool try_parse_cpp_opts(char*** argv) {
 
 static bool try_parse_include(char*** argv) {
 
-    // add -include
+    // add -include or -isystem
     if (0 != strcmp("-include", **argv)) {
-        return false;
+        if (0 != strcmp("-isystem", **argv)) {
+            return false;
+        }
     }
     string_array_append(&cpp_opts, &cpp_opts_count, &cpp_opts_capacity, **argv);
     *argv = (*argv + 1);
 
-    // add the filename
+    // add the filename or path
     if (**argv == NULL) {
-        fatal_cleanup("`-include` must be followed by an include file.");
+        fatal_cleanup("`-include` and `-isystem` must be followed by a path.");
     }
     string_array_append(&cpp_opts, &cpp_opts_count, &cpp_opts_capacity, **argv);
     *argv = (*argv + 1);
@@ -362,6 +438,55 @@ static bool try_parse_include(char*** argv) {
     return true;
 }
 
+// Parses -MF or -MT. The filename can be provided as the next option or
+// appended directly.
+static bool try_parse_dependency_string(char*** argv, const char* option, char** str) {
+    if (!starts_with(**argv, option)) {
+        return false;
+    }
+    if (*str != NULL) {
+        fatal_cleanup("-MF and -MT can only be specified once.");
+    }
+    size_t len = strlen(option);
+    if (*(**argv + len) != 0) {
+        *str = (**argv + len);
+        *argv = (*argv + 1);
+        return true;
+    }
+    *argv = (*argv + 1);
+    if (**argv == NULL) {
+        fatal_cleanup("-MF and -MT must be followed by a filename.");
+    }
+    *str = **argv;
+    *argv = (*argv + 1);
+    return true;
+}
+
+static bool try_parse_dependencies(char*** argv) {
+    char* arg = **argv;
+    if (!starts_with(arg, "-M")) {
+        return false;
+    }
+    if (((0 == strcmp(arg, "-M")) | (0 == strcmp(arg, "-MM"))) |
+            ((0 == strcmp(arg, "-MD")) | (0 == strcmp(arg, "-MMD"))))
+    {
+        if (deps_mode != NULL) {
+            fatal_cleanup("Only one of -M, -MM, -MD and -MMD can be provided.");
+        }
+        deps_mode = arg;
+        *argv = (*argv + 1);
+        return true;
+    }
+    if (0 == strcmp(arg, "-MP")) {
+        deps_phony = true;
+        *argv = (*argv + 1);
+        return true;
+    }
+    if (try_parse_dependency_string(argv, "-MF", &deps_file)) {return true;}
+    if (try_parse_dependency_string(argv, "-MT", &deps_target)) {return true;}
+    return false;
+}
+
 static bool is_cci_option(char* arg) {
     // Check if it's an option cci cares about. We accept everything starting
     // with `-f` or `-W`; we let cci sort out the details.
@@ -447,6 +572,7 @@ static bool try_parse_misc(char*** argv) {
     if (try_parse_misc_option(argv, "-nostdlib", &nostdlib)) {return true;}
     if (try_parse_misc_option(argv, "-nostddef", &nostddef)) {return true;}
     if (try_parse_misc_option(argv, "-dM", &dump_macros)) {return true;}
+    if (try_parse_misc_option(argv, "-pipe", &use_pipe)) {return true;}
 
     if (try_parse_misc_option(argv, "-###", &disable_run)) {
         // -### implies -v
@@ -491,6 +617,7 @@ static void set_default_options(const char* cc_filename) {
 
     // the default mode is link if no other options are specified
     mode = MODE_LINK;
+    jobs = 1;
 
     // the default toolchain is relative to the path of cc
     const char* path_end = strrchr(cc_filename, '/');
@@ -506,6 +633,14 @@ static void set_default_options(const char* cc_filename) {
     tool_ld = create_tool_path(cc_filename, path_len, "ld.oe");
     libc_archive = create_tool_path(cc_filename, path_len, "../lib/libc.oa");
     libc_include = create_tool_path(cc_filename, path_len, "../include");
+
+    // the compilation cache is enabled by the environment
+    cache_dir = getenv("ONRAMP_CACHE_DIR");
+    if (cache_dir != NULL) {
+        if (*cache_dir == 0) {
+            cache_dir = NULL;
+        }
+    }
 }
 
 static void parse_options_file(const char* filename) {
@@ -581,6 +716,9 @@ static void parse_options(char** argv) {
             if (try_parse_mode(&argv)) {
                 continue;
             }
+            if (try_parse_jobs(&argv)) {
+                continue;
+            }
             if (try_parse_warnings(&argv)) {
                 continue;
             }
@@ -590,6 +728,9 @@ static void parse_options(char** argv) {
             if (try_parse_include(&argv)) {
                 continue;
             }
+            if (try_parse_dependencies(&argv)) {
+                continue;
+            }
             if (try_parse_cci_opts(&argv)) {
                 continue;
             }
@@ -616,19 +757,48 @@ static void parse_options(char** argv) {
     }
 }
 
+/**
+ * Returns true if we're only generating dependencies (-M or -MM).
+ */
+static bool deps_only(void) {
+    if (deps_mode == NULL) {
+        return false;
+    }
+    return (0 == strcmp(deps_mode, "-M")) | (0 == strcmp(deps_mode, "-MM"));
+}
+
 static void check_options(void) {
     if (inputs_count == 0) {
         fatal_cleanup("No input files.");
     }
 
+    // -M and -MM imply -E. The dependencies are written to the output file
+    // unless -MF is given.
+    if (deps_only()) {
+        mode = MODE_PREPROCESS;
+    }
+    if ((deps_mode != NULL) & (inputs_count != 1)) {
+        if ((deps_file != NULL) | (deps_target != NULL)) {
+            fatal_cleanup("-MF and -MT cannot be used with multiple input files.");
+        }
+    }
+
+    // Multiple input files are allowed with -c and -S. Each output is named
+    // after its input and placed in the working directory.
+    bool named_outputs_allowed = false;
     if (mode != MODE_LINK) {
         if (inputs_count != 1) {
-            //printf("%zi %s %s\n",inputs_count,*inputs,*(inputs+1));
-            fatal_cleanup("Exactly one input file must be specified if using -c, -E or -S.");
+            if (mode == MODE_PREPROCESS) {
+                fatal_cleanup("Exactly one input file must be specified if using -E.");
+            }
+            if (output_filename != NULL) {
+                fatal_cleanup("-o cannot be specified with multiple input files if using -c or -S.");
+            }
+            named_outputs_allowed = true;
         }
     }
 
-    if (output_filename == NULL) {
+    if ((output_filename == NULL) & !named_outputs_allowed) {
         // TODO we should default to a.out if we're wrapped for posix.
         // otherwise we should default to the input filename basename plus .exe
         // or .oe.
@@ -641,9 +811,10 @@ static void check_options(void) {
         }
     }
 
-    // Default include paths.
+    // Default include paths. These are system paths so their headers are
+    // left out of -MM and -MMD dependencies.
     if (!nostdinc) {
-        string_array_append(&cpp_opts, &cpp_opts_count, &cpp_opts_capacity, "-I");
+        string_array_append(&cpp_opts, &cpp_opts_count, &cpp_opts_capacity, "-isystem");
         string_array_append(&cpp_opts, &cpp_opts_count, &cpp_opts_capacity, libc_include);
     }
 
@@ -667,6 +838,12 @@ static void check_options(void) {
     if (dump_macros & (mode != MODE_PREPROCESS)) {
         fatal_cleanup("-dM requires -E.");
     }
+
+    // Tools spawned in the VM run to completion one at a time so -j has no
+    // effect there.
+    #ifdef __onramp__
+    jobs = 1;
+    #endif
 }
 
 static void free_options(void) {
@@ -679,6 +856,11 @@ static void free_options(void) {
     free(tool_ld);
     free(fileargs_buffer);
     string_array_free(fileargs, fileargs_count);
+    free(stages);
+    string_array_free(named_outputs, named_outputs_count);
+    string_array_free(cache_entries, cache_entries_count);
+    free(translated);
+    free(cache_buffer);
 }
 
 
@@ -820,6 +1002,113 @@ static char* make_temp_filename(const char* input, const char* extension) {
     return ret;
 }
 
+/**
+ * Makes an output filename for the given input file by replacing its path and
+ * extension.
+ *
+ * This is used when translating multiple files with -c or -S. As in other
+ * compilers, the output is placed in the working directory.
+ */
+static char* make_named_output_filename(const char* input, const char* extension) {
+
+    // remove the path and extension from the filename
+    const char* filename = strrchr(input, '/');
+    if (filename != NULL) {
+        filename = (filename + 1);
+    }
+    if (filename == NULL) {
+        filename = input;
+    }
+    const char* filename_end = strrchr(filename, '.');
+    size_t filename_len;
+    if (filename_end != NULL) {
+        filename_len = (filename_end - filename);
+    }
+    if (filename_end == NULL) {
+        filename_len = strlen(filename);
+    }
+
+    // assemble the filename
+    size_t extension_len = strlen(extension);
+    char* ret = malloc((filename_len + extension_len) + 1);
+    if (ret == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    memcpy(ret, filename, filename_len);
+    memcpy(ret + filename_len, extension, extension_len);
+    *(ret + (filename_len + extension_len)) = 0;
+
+    string_array_append(&named_outputs, &named_outputs_count, &named_outputs_capacity, ret);
+    return ret;
+}
+
+/**
+ * Returns the output filename for the given input file in the given phase of
+ * translation.
+ *
+ * If this is the last phase, this is the output file; otherwise it's a
+ * temporary file.
+ */
+static char* make_phase_output_filename(const char* input, const char* extension, int phase) {
+    if (mode != phase) {
+        return make_temp_filename(input, extension);
+    }
+    if (output_filename != NULL) {
+        return (char*)output_filename;
+    }
+    return make_named_output_filename(input, extension);
+}
+
+/**
+ * Returns the default dependency filename for -MD and -MMD.
+ *
+ * If an output file was given, this is the output file with its extension
+ * replaced by `.d`. Otherwise it's named after the input and placed in the
+ * working directory.
+ */
+static char* make_dependency_filename(const char* input) {
+    if ((output_filename == NULL) | (mode == MODE_LINK)) {
+        return make_named_output_filename(input, ".d");
+    }
+
+    // find the extension of the output basename
+    const char* filename = strrchr(output_filename, '/');
+    if (filename == NULL) {
+        filename = output_filename;
+    }
+    const char* filename_end = strrchr(filename, '.');
+    size_t len;
+    if (filename_end != NULL) {
+        len = (filename_end - output_filename);
+    }
+    if (filename_end == NULL) {
+        len = strlen(output_filename);
+    }
+
+    char* ret = malloc(len + 3);
+    if (ret == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    memcpy(ret, output_filename, len);
+    memcpy(ret + len, ".d", 3);
+    string_array_append(&named_outputs, &named_outputs_count, &named_outputs_capacity, ret);
+    return ret;
+}
+
+/**
+ * Returns the default target of the dependency rule: the object file if we're
+ * writing one, otherwise the input basename with a `.o` extension.
+ */
+static char* make_dependency_target(const char* input) {
+    if (mode == MODE_ASSEMBLE) {
+        if (output_filename != NULL) {
+            return (char*)output_filename;
+        }
+        return make_named_output_filename(input, ".oo");
+    }
+    return make_named_output_filename(input, ".o");
+}
+
 static void delete_temp_files(void) {
     while (temp_files_count > 0) {
         temp_files_count = (temp_files_count - 1);
@@ -834,7 +1123,11 @@ static void delete_temp_files(void) {
 }
 
 #ifdef __onramp__
-static void run_onramp(size_t argc, char** argv) {
+/**
+ * Runs the given tool in our VM with the given VM file handles as its standard
+ * input and output.
+ */
+static void run_onramp(size_t argc, char** argv, int input, int output) {
 //    fputs("spawning: ", stdout);
 //    puts(*argv);
 
@@ -885,6 +1178,8 @@ static void run_onramp(size_t argc, char** argv) {
 
     // setup the child pit
     *(child_pit + PIT_BREAK) = (int)child_break;
+    *(child_pit + PIT_INPUT) = input;
+    *(child_pit + PIT_OUTPUT) = output;
     *(child_pit + PIT_ARGS) = (int)argv;
     *(child_pit + PIT_ENVIRON) = (int)environ;
 
@@ -905,7 +1200,10 @@ static void run_onramp(size_t argc, char** argv) {
 #endif
 
 #ifndef __onramp__
-static void run_posix(size_t argc, char** argv) {
+/**
+ * Spawns the given tool with the given file actions, returning its pid.
+ */
+static pid_t spawn_posix(size_t argc, char** argv, const posix_spawn_file_actions_t* actions) {
     char** old_argv = argv;
     char** new_argv = NULL;
 
@@ -914,7 +1212,7 @@ static void run_posix(size_t argc, char** argv) {
     if (len > 3 && 0 == strcmp(*argv + len - 3, ".oe")) {
 
         // It does. Insert "onrampvm" at the front of the args.
-        char** new_argv = malloc(sizeof(char*) * (argc + 2));
+        new_argv = malloc(sizeof(char*) * (argc + 2));
         *new_argv = "onrampvm";
         memcpy(new_argv + 1, argv, sizeof(char*) * argc);
         *(new_argv + (1 + argc)) = NULL;
@@ -923,18 +1221,29 @@ static void run_posix(size_t argc, char** argv) {
 
     // Run the subprocess
     pid_t pid;
-    if (0 != (new_argv ? posix_spawnp : posix_spawn)(&pid, *argv, NULL, NULL, argv, environ)) {
+    if (0 != (new_argv ? posix_spawnp : posix_spawn)(&pid, *argv, actions, NULL, argv, environ)) {
         fputs("Attempting to run: ", stderr);
         fputs(*old_argv, stderr);
         fputc('\n', stderr);
         fatal_cleanup("Failed to spawn subprocess");
     }
     free(new_argv);
+    return pid;
+}
 
-    // Wait until it's done
+/**
+ * Waits for the given subprocess, returning its exit code.
+ */
+static int wait_posix(pid_t pid) {
     int status;
-    wait(&status);
-    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    if (waitpid(pid, &status, 0) != pid) {
+        return 1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static void run_posix(size_t argc, char** argv) {
+    int exit_code = wait_posix(spawn_posix(argc, argv, NULL));
     if (exit_code) {
         // Assume the subprocess printed some kind of error. We don't print
         // anything; just exit.
@@ -944,16 +1253,20 @@ static void run_posix(size_t argc, char** argv) {
 }
 #endif
 
+static void print_command(size_t argc, char** argv) {
+    size_t i = 0;
+    while (i < argc) {
+        if (i > 0) {
+            fputc(' ', stdout);
+        }
+        fputs(*(argv + i), stdout);
+        i = (i + 1);
+    }
+}
+
 static void run(size_t argc, char** argv) {
     if (verbose) {
-        size_t i = 0;
-        while (i < argc) {
-            if (i > 0) {
-                fputc(' ', stdout);
-            }
-            fputs(*(argv + i), stdout);
-            i = (i + 1);
-        }
+        print_command(argc, argv);
         fputc('\n', stdout);
     }
 
@@ -965,7 +1278,8 @@ static void run(size_t argc, char** argv) {
     // make for nicer error messages
 
     #ifdef __onramp__
-    run_onramp(argc, argv);
+    int* pit = __process_info_table;
+    run_onramp(argc, argv, *(pit + PIT_INPUT), *(pit + PIT_OUTPUT));
     #endif
 
     #ifndef __onramp__
@@ -973,136 +1287,1007 @@ static void run(size_t argc, char** argv) {
     #endif
 }
 
-static void preprocess_file(const char* input, const char* output) {
-    char** args = 0;
-    size_t args_count = 0;
-    size_t args_capacity = 0;
 
-    string_array_append(&args, &args_count, &args_capacity, tool_cpp);
 
-    if (dump_macros) {
-        string_array_append(&args, &args_count, &args_capacity, "-dM");
-    }
+/*
+ * Pipes
+ *
+ * With -pipe, each C file is preprocessed, compiled and assembled by a
+ * pipeline of tools that each read the previous tool's output from standard
+ * input rather than from a temporary file. Only the final output is written
+ * to disk. (In link mode that's still a temporary object file because ld
+ * reads its inputs by name.)
+ *
+ * Natively the tools are connected by host pipes and run concurrently. In
+ * the VM they run one at a time so each tool writes to an anonymous file
+ * which is rewound and given to the next tool as its standard input. If the
+ * VM doesn't support anonymous files we fall back to temporary files.
+ */
 
-    size_t i = 0;
-    while (i < cpp_opts_count) {
-        string_array_append(&args, &args_count, &args_capacity, *(cpp_opts + i));
-        i = (i + 1);
+/**
+ * Returns true if we can run pipelines.
+ */
+static bool pipes_supported(void) {
+    #ifdef __onramp__
+    int handle = __sys_fopen(NULL, true);
+    if (handle < 0) {
+        return false;
     }
-
-    string_array_append(&args, &args_count, &args_capacity, (char*)input);
-    string_array_append(&args, &args_count, &args_capacity, "-o");
-    string_array_append(&args, &args_count, &args_capacity, (char*)output);
-
-    string_array_append(&args, &args_count, &args_capacity, NULL);
-    run(args_count - 1, args);
-
-    free(args);
+    __sys_fclose(handle);
+    #endif
+    return true;
 }
 
-static void compile_file(const char* input, const char* output) {
-    char** args = 0;
-    size_t args_count = 0;
-    size_t args_capacity = 0;
+#ifdef __onramp__
+static void run_pipeline_onramp(size_t count, char*** commands) {
+    int* pit = __process_info_table;
+    int input = *(pit + PIT_INPUT);
+    size_t i = 0;
+    while (i < count) {
+        bool last = ((i + 1) == count);
+        int output = *(pit + PIT_OUTPUT);
+        if (!last) {
+            output = __sys_fopen(NULL, true);
+            if (output < 0) {
+                fatal_cleanup("Failed to open anonymous file.");
+            }
+        }
 
-    string_array_append(&args, &args_count, &args_capacity, tool_cci);
+        // argc isn't used by run_onramp()
+        run_onramp(0, *(commands + i), input, output);
 
-    if (debug_info) {
-        string_array_append(&args, &args_count, &args_capacity, "-g");
-    }
-    if (optimize) {
-        string_array_append(&args, &args_count, &args_capacity, "-O");
+        if (i > 0) {
+            __sys_fclose(input);
+        }
+        if (!last) {
+            __sys_fseek(output, 0, 0, 0);
+        }
+        input = output;
+        i = (i + 1);
     }
-
-    string_array_append(&args, &args_count, &args_capacity, (char*)input);
-    string_array_append(&args, &args_count, &args_capacity, "-o");
-    string_array_append(&args, &args_count, &args_capacity, (char*)output);
-
-    string_array_append(&args, &args_count, &args_capacity, NULL);
-    run(args_count - 1, args);
-
-    free(args);
 }
+#endif
 
-static void assemble_file(const char* input, const char* output) {
-    char** args = 0;
-    size_t args_count = 0;
-    size_t args_capacity = 0;
-
-    string_array_append(&args, &args_count, &args_capacity, tool_as);
-
-    /*TODO
-    if (debug_info) {
-        string_array_append(&args, &args_count, &args_capacity, "-g");
+#ifndef __onramp__
+/**
+ * Removes the final output of a failed pipeline. Its last tool runs at the
+ * same time as the others so it may have created a truncated output that
+ * would look up-to-date to make.
+ */
+static void remove_pipeline_output(size_t count, char*** commands) {
+    char** argv = commands[count - 1];
+    size_t argc = 0;
+    while (argv[argc] != NULL) {
+        ++argc;
     }
-    if (optimize) {
-        string_array_append(&args, &args_count, &args_capacity, "-O");
+    const char* output = argv[argc - 1];
+    if (0 != strcmp(output, "-")) {
+        remove(output);
     }
-    */
-
-    string_array_append(&args, &args_count, &args_capacity, (char*)input);
-    string_array_append(&args, &args_count, &args_capacity, "-o");
-    string_array_append(&args, &args_count, &args_capacity, (char*)output);
-
-    string_array_append(&args, &args_count, &args_capacity, NULL);
-    run(args_count - 1, args);
-
-    free(args);
 }
 
-static void translate_file(const char* input) {
+/**
+ * Spawns all tools of a pipeline at once, storing their pids in the given
+ * array. If error is not -1, it's used as the standard error of all tools.
+ */
+static void spawn_pipeline_posix(size_t count, char*** commands, int error, pid_t* pids) {
+    int input = -1;
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        int fds[2] = {-1, -1};
+        if (i + 1 < count && 0 != pipe(fds)) {
+            fatal_cleanup("Failed to create pipe.");
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (error != -1) {
+            posix_spawn_file_actions_adddup2(&actions, error, 2);
+        }
+        if (input != -1) {
+            posix_spawn_file_actions_adddup2(&actions, input, 0);
+            posix_spawn_file_actions_addclose(&actions, input);
+        }
+        if (fds[1] != -1) {
+            posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+            posix_spawn_file_actions_addclose(&actions, fds[1]);
+            posix_spawn_file_actions_addclose(&actions, fds[0]);
+        }
 
-    // figure out what stage based on the file extension
-    // TODO we should support -xc or -xassembler later
-    int type = file_type(input);
+        char** argv = commands[i];
+        size_t argc = 0;
+        while (argv[argc] != NULL) {
+            ++argc;
+        }
+        pids[i] = spawn_posix(argc, argv, &actions);
+        posix_spawn_file_actions_destroy(&actions);
 
-    // preprocess
-    if (type == TYPE_C) {
-        if (mode == MODE_PREPROCESS) {
-            preprocess_file(input, output_filename);
-            return;
+        // Close our copies so that each tool sees end-of-file when the
+        // previous one exits
+        if (input != -1) {
+            close(input);
         }
-        if (mode != MODE_PREPROCESS) {
-            char* output = make_temp_filename(input, ".i");
-            preprocess_file(input, output);
-            input = output;
+        if (fds[1] != -1) {
+            close(fds[1]);
         }
+        input = fds[0];
     }
+}
 
-    // compile
-    if (type >= TYPE_I) {
-        if (mode == MODE_COMPILE) {
-            compile_file(input, output_filename);
-            return;
-        }
-        if (mode != MODE_COMPILE) {
-            char* output = make_temp_filename(input, ".os");
-            compile_file(input, output);
-            input = output;
+static void run_pipeline_posix(size_t count, char*** commands) {
+    pid_t* pids = malloc(sizeof(pid_t) * count);
+    if (pids == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    spawn_pipeline_posix(count, commands, -1, pids);
+
+    // Wait for all of them. We report the first failure since later tools
+    // usually fail only because their input was cut short.
+    int exit_code = 0;
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        int tool_exit_code = wait_posix(pids[i]);
+        if (exit_code == 0) {
+            exit_code = tool_exit_code;
         }
     }
+    free(pids);
+    if (exit_code) {
+        remove_pipeline_output(count, commands);
+        delete_temp_files();
+        _Exit(exit_code);
+    }
+}
+#endif
 
-    // assemble
-    if (type >= TYPE_OS) {
-        if (mode == MODE_ASSEMBLE) {
-            assemble_file(input, output_filename);
-            return;
+static void print_pipeline(size_t count, char*** commands) {
+    size_t i = 0;
+    while (i < count) {
+        if (i > 0) {
+            fputs(" | ", stdout);
         }
-        if (mode != MODE_ASSEMBLE) {
-            char* output = make_temp_filename(input, ".oo");
-            assemble_file(input, output);
-            input = output;
+        char** argv = *(commands + i);
+        size_t argc = 0;
+        while (*(argv + argc) != NULL) {
+            argc = (argc + 1);
         }
+        print_command(argc, argv);
+        i = (i + 1);
     }
-
-    // link mode. add file to linker inputs
-    string_array_append(&objects, &objects_count, &objects_capacity, (char*)input);
+    fputc('\n', stdout);
 }
 
-static void translate_files(void) {
+static void free_pipeline(size_t count, char*** commands) {
+    while (count > 0) {
+        count = (count - 1);
+        free(*(commands + count));
+    }
+    free(commands);
+}
+
+/**
+ * Runs the given null-terminated commands as a pipeline.
+ */
+static void run_pipeline(size_t count, char*** commands) {
+    if (verbose) {
+        print_pipeline(count, commands);
+    }
+
+    if (disable_run) {
+        return;
+    }
+
+    #ifdef __onramp__
+    run_pipeline_onramp(count, commands);
+    #endif
+
+    #ifndef __onramp__
+    run_pipeline_posix(count, commands);
+    #endif
+}
+
+
+
+#ifndef __onramp__
+/*
+ * Parallel jobs
+ *
+ * With -j, the pipelines of all C files are queued and then run with up to the
+ * given number of them at once. (Each .oe tool runs in its own VM process.)
+ * The standard error of each job is captured in a temporary file and printed
+ * when the job finishes so diagnostics of different files aren't interleaved.
+ * This only works natively; in the VM, -j is ignored.
+ */
+
+struct job {
+    char*** commands;
+    size_t commands_count;
+    pid_t pids[3];
+    size_t running;     // number of tools that haven't exited
+    int exit_code;      // first non-zero exit code of its tools
+    FILE* log;
+};
+
+static struct job* queued_jobs;
+static size_t queued_jobs_count;
+
+static void queue_job(size_t count, char*** commands) {
+    if (queued_jobs == NULL) {
+        // there is at most one job per input
+        queued_jobs = malloc(sizeof(struct job) * inputs_count);
+        if (queued_jobs == NULL) {
+            fatal_cleanup("Out of memory.");
+        }
+    }
+    struct job* job = &queued_jobs[queued_jobs_count++];
+    job->commands = commands;
+    job->commands_count = count;
+}
+
+static void start_job(struct job* job) {
+    if (verbose) {
+        print_pipeline(job->commands_count, job->commands);
+        fflush(stdout);
+    }
+    job->log = tmpfile();
+    if (job->log == NULL) {
+        fatal_cleanup("Failed to create temporary file.");
+    }
+    spawn_pipeline_posix(job->commands_count, job->commands, fileno(job->log), job->pids);
+    job->running = job->commands_count;
+    job->exit_code = 0;
+}
+
+static void finish_job(struct job* job) {
+    char buffer[4096];
+    size_t step;
+    rewind(job->log);
+    while ((step = fread(buffer, 1, sizeof(buffer), job->log)) > 0) {
+        fwrite(buffer, 1, step, stderr);
+    }
+    fclose(job->log);
+    job->log = NULL;
+    if (job->exit_code != 0) {
+        remove_pipeline_output(job->commands_count, job->commands);
+    }
+}
+
+/**
+ * Runs all queued jobs. If any fails, no more are started; we wait for those
+ * already running, then exit with the first failure's exit code. The output
+ * of each failed job is removed when it finishes.
+ */
+static void run_jobs(void) {
+    size_t next = 0;
+    size_t running = 0;
+    int exit_code = 0;
+
+    if (disable_run) {
+        for (next = 0; next < queued_jobs_count; ++next) {
+            print_pipeline(queued_jobs[next].commands_count, queued_jobs[next].commands);
+        }
+        next = queued_jobs_count;
+    }
+
+    while (next < queued_jobs_count || running > 0) {
+        while (exit_code == 0 && running < (size_t)jobs && next < queued_jobs_count) {
+            start_job(&queued_jobs[next++]);
+            ++running;
+        }
+        if (running == 0) {
+            break;
+        }
+
+        // Wait for any tool to exit and find its job
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1) {
+            fatal_cleanup("Failed to wait for subprocess.");
+        }
+        size_t i;
+        for (i = 0; i < next; ++i) {
+            struct job* job = &queued_jobs[i];
+            size_t j;
+            bool found = false;
+            for (j = 0; j < job->commands_count; ++j) {
+                if (job->running > 0 && job->pids[j] == pid) {
+                    found = true;
+                }
+            }
+            if (!found) {
+                continue;
+            }
+
+            int tool_exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+            if (job->exit_code == 0) {
+                job->exit_code = tool_exit_code;
+            }
+            if (--job->running == 0) {
+                --running;
+                finish_job(job);
+                if (exit_code == 0) {
+                    exit_code = job->exit_code;
+                }
+            }
+            break;
+        }
+    }
+
+    size_t i;
+    for (i = 0; i < queued_jobs_count; ++i) {
+        free_pipeline(queued_jobs[i].commands_count, queued_jobs[i].commands);
+    }
+    free(queued_jobs);
+    queued_jobs = NULL;
+    queued_jobs_count = 0;
+
+    if (exit_code) {
+        delete_temp_files();
+        _Exit(exit_code);
+    }
+}
+#endif
+
+/**
+ * Appends the preprocessor and its options for the given input file to args
+ * (without any files.)
+ */
+static void append_preprocess_options(char*** args, size_t* args_count, size_t* args_capacity,
+        const char* input)
+{
+    string_array_append(args, args_count, args_capacity, tool_cpp);
+
+    if (dump_macros) {
+        string_array_append(args, args_count, args_capacity, "-dM");
+    }
+
+    size_t i = 0;
+    while (i < cpp_opts_count) {
+        string_array_append(args, args_count, args_capacity, *(cpp_opts + i));
+        i = (i + 1);
+    }
+
+    // Dependency options. With -M and -MM, cpp writes the dependencies to its
+    // output file unless -MF is given.
+    if (deps_mode != NULL) {
+        string_array_append(args, args_count, args_capacity, deps_mode);
+        if (deps_phony) {
+            string_array_append(args, args_count, args_capacity, "-MP");
+        }
+        char* file = deps_file;
+        if ((file == NULL) & !deps_only()) {
+            file = make_dependency_filename(input);
+        }
+        if (file != NULL) {
+            string_array_append(args, args_count, args_capacity, "-MF");
+            string_array_append(args, args_count, args_capacity, file);
+        }
+        char* target = deps_target;
+        if (target == NULL) {
+            target = make_dependency_target(input);
+        }
+        string_array_append(args, args_count, args_capacity, "-MT");
+        string_array_append(args, args_count, args_capacity, target);
+    }
+}
+
+static void preprocess_file(const char* input, const char* output) {
+    char** args = 0;
+    size_t args_count = 0;
+    size_t args_capacity = 0;
+
+    append_preprocess_options(&args, &args_count, &args_capacity, input);
+    string_array_append(&args, &args_count, &args_capacity, (char*)input);
+    string_array_append(&args, &args_count, &args_capacity, "-o");
+    string_array_append(&args, &args_count, &args_capacity, (char*)output);
+
+    string_array_append(&args, &args_count, &args_capacity, NULL);
+
+    #ifndef __onramp__
+    if (jobs > 1) {
+        char*** commands = malloc(sizeof(char**));
+        if (commands == NULL) {
+            fatal_cleanup("Out of memory.");
+        }
+        *commands = args;
+        queue_job(1, commands);
+        return;
+    }
+    #endif
+
+    run(args_count - 1, args);
+
+    free(args);
+}
+
+/**
+ * Runs the compiler on all files added with compile_file() since the last
+ * flush (if any.)
+ */
+static void flush_compile(void) {
+    if (compile_args_count == 0) {
+        return;
+    }
+    string_array_append(&compile_args, &compile_args_count, &compile_args_capacity, NULL);
+    run((compile_args_count - 1), compile_args);
+    compile_args_count = 0;
+}
+
+/**
+ * Appends the compiler and its options to args (without any files.)
+ */
+static void append_compile_options(char*** args, size_t* args_count, size_t* args_capacity) {
+    string_array_append(args, args_count, args_capacity, tool_cci);
+    if (debug_info) {
+        string_array_append(args, args_count, args_capacity, "-g");
+    }
+    if (optimize) {
+        string_array_append(args, args_count, args_capacity, "-O");
+    }
+
+    // Pass along `-f` flags. cci ignores flags it doesn't know.
+    // TODO pass `-W` as well once cci supports all the warnings we accept
+    size_t i = 0;
+    while (i < cci_opts_count) {
+        if (starts_with(*(cci_opts + i), "-f")) {
+            string_array_append(args, args_count, args_capacity, *(cci_opts + i));
+        }
+        i = (i + 1);
+    }
+}
+
+/**
+ * Adds a file to be compiled by the next flush_compile().
+ *
+ * cci/2 accepts any number of input and output pairs. Each one is compiled as
+ * a separate translation unit in a single run of the compiler.
+ */
+static void compile_file(const char* input, const char* output) {
+    if (compile_args_count == 0) {
+        append_compile_options(&compile_args, &compile_args_count, &compile_args_capacity);
+    }
+
+    string_array_append(&compile_args, &compile_args_count, &compile_args_capacity, (char*)input);
+    string_array_append(&compile_args, &compile_args_count, &compile_args_capacity, "-o");
+    string_array_append(&compile_args, &compile_args_count, &compile_args_capacity, (char*)output);
+}
+
+/**
+ * Appends the assembler and its options to args (without any files.)
+ */
+static void append_assemble_options(char*** args, size_t* args_count, size_t* args_capacity) {
+    string_array_append(args, args_count, args_capacity, tool_as);
+
+    /*TODO
+    if (debug_info) {
+        string_array_append(args, args_count, args_capacity, "-g");
+    }
+    */
+    if (optimize) {
+        string_array_append(args, args_count, args_capacity, "-O");
+    }
+}
+
+static void assemble_file(const char* input, const char* output) {
+    char** args = 0;
+    size_t args_count = 0;
+    size_t args_capacity = 0;
+
+    append_assemble_options(&args, &args_count, &args_capacity);
+    string_array_append(&args, &args_count, &args_capacity, (char*)input);
+    string_array_append(&args, &args_count, &args_capacity, "-o");
+    string_array_append(&args, &args_count, &args_capacity, (char*)output);
+
+    string_array_append(&args, &args_count, &args_capacity, NULL);
+    run(args_count - 1, args);
+
+    free(args);
+}
+
+/**
+ * Translates an input file with a pipeline (for -pipe and -j), returning the
+ * name of the final output.
+ *
+ * If preprocessed is null, the input is a C file and the pipeline starts with
+ * the preprocessor. Otherwise the pipeline starts by compiling the given
+ * preprocessed file. (The outputs are still named after the input.)
+ */
+static char* pipe_file(const char* input, const char* /*nullable*/ preprocessed) {
+    char*** commands = malloc(sizeof(char**) * 3);
+    if (commands == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    size_t commands_count = 0;
+
+    char** args = NULL;
+    size_t args_count = 0;
+    size_t args_capacity = 0;
+    const char* compile_input = preprocessed;
+    if (preprocessed == NULL) {
+        append_preprocess_options(&args, &args_count, &args_capacity, input);
+        string_array_append(&args, &args_count, &args_capacity, (char*)input);
+        string_array_append(&args, &args_count, &args_capacity, "-o");
+        string_array_append(&args, &args_count, &args_capacity, "-");
+        string_array_append(&args, &args_count, &args_capacity, NULL);
+        *commands = args;
+        commands_count = 1;
+        compile_input = "-";
+    }
+
+    // With -S the compiler writes the final output.
+    char* output = "-";
+    if (mode == MODE_COMPILE) {
+        output = make_phase_output_filename(input, ".os", MODE_COMPILE);
+    }
+    args = NULL;
+    args_count = 0;
+    args_capacity = 0;
+    append_compile_options(&args, &args_count, &args_capacity);
+    string_array_append(&args, &args_count, &args_capacity, (char*)compile_input);
+    string_array_append(&args, &args_count, &args_capacity, "-o");
+    string_array_append(&args, &args_count, &args_capacity, output);
+    string_array_append(&args, &args_count, &args_capacity, NULL);
+    *(commands + commands_count) = args;
+    commands_count = (commands_count + 1);
+
+    if (mode != MODE_COMPILE) {
+        output = make_phase_output_filename(input, ".oo", MODE_ASSEMBLE);
+        args = NULL;
+        args_count = 0;
+        args_capacity = 0;
+        append_assemble_options(&args, &args_count, &args_capacity);
+        string_array_append(&args, &args_count, &args_capacity, "-");
+        string_array_append(&args, &args_count, &args_capacity, "-o");
+        string_array_append(&args, &args_count, &args_capacity, output);
+        string_array_append(&args, &args_count, &args_capacity, NULL);
+        *(commands + commands_count) = args;
+        commands_count = (commands_count + 1);
+    }
+
+    #ifndef __onramp__
+    if (jobs > 1) {
+        queue_job(commands_count, commands);
+        return output;
+    }
+    #endif
+
+    run_pipeline(commands_count, commands);
+    free_pipeline(commands_count, commands);
+    return output;
+}
+
+
+
+/*
+ * Compilation cache
+ *
+ * If ONRAMP_CACHE_DIR is set, each object file we compile is stored in it
+ * under a 64-bit hash of the preprocessed source, the contents of cci and as,
+ * and the options we pass to them. If a matching entry already exists, it is
+ * copied to the output instead of running cci and as.
+ *
+ * The bootstrap rebuilds the same libc sources with the same tools several
+ * times; with a cache these rebuilds are nearly instant.
+ */
+
+#define CACHE_BUFFER_SIZE 4096
+
+/**
+ * Adds the contents of the given file to the hash, returning false if it
+ * can't be opened.
+ */
+static bool cache_hash_file(int32_t* hash, const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    while (1) {
+        size_t step = fread(cache_buffer, 1, CACHE_BUFFER_SIZE, file);
+        if (step == 0) {
+            break;
+        }
+        fnv1a64_bytes(hash, cache_buffer, step);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Adds the given string to the hash, including its null-terminator so that
+ * consecutive strings can't run together.
+ */
+static void cache_hash_string(int32_t* hash, const char* string) {
+    fnv1a64_bytes(hash, string, (strlen(string) + 1));
+}
+
+/**
+ * Writes a word in hexadecimal (without a null-terminator.)
+ */
+static void format_hex_word(char* p, int32_t word) {
+    int i = 8;
+    while (i > 0) {
+        i = (i - 1);
+        int digit = (word & 15);
+        if (digit < 10) {
+            *(p + i) = ('0' + digit);
+        }
+        if (digit >= 10) {
+            *(p + i) = ('a' + (digit - 10));
+        }
+        word = (word >> 4);
+    }
+}
+
+/**
+ * Returns the path of the cache entry with the given hash and suffix.
+ */
+static char* make_cache_filename(int32_t* hash, const char* suffix) {
+    size_t dir_len = strlen(cache_dir);
+    size_t suffix_len = strlen(suffix);
+    char* ret = malloc((dir_len + suffix_len) + 18);
+    if (ret == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    memcpy(ret, cache_dir, dir_len);
+    *(ret + dir_len) = '/';
+    format_hex_word((ret + (dir_len + 1)), *(hash + 1));
+    format_hex_word((ret + (dir_len + 9)), *hash);
+    memcpy((ret + (dir_len + 17)), suffix, (suffix_len + 1));
+    return ret;
+}
+
+/**
+ * Copies the remaining contents of the given file to a new file, returning
+ * false if it can't be created.
+ */
+static bool copy_file(FILE* input, const char* filename) {
+    FILE* output = fopen(filename, "wb");
+    if (output == NULL) {
+        return false;
+    }
+    while (1) {
+        size_t step = fread(cache_buffer, 1, CACHE_BUFFER_SIZE, input);
+        if (step == 0) {
+            break;
+        }
+        // libc/0 doesn't return a reliable count from fwrite() so we don't
+        // check it.
+        fwrite(cache_buffer, 1, step, output);
+    }
+    fclose(output);
+    return true;
+}
+
+static bool is_translated(size_t index) {
+    if (translated == NULL) {
+        return false;
+    }
+    return *(translated + index) != NULL;
+}
+
+/**
+ * Records that the given input has been translated to its final output.
+ */
+static void mark_translated(size_t index, char* output) {
+    while (translated_count < inputs_count) {
+        string_array_append(&translated, &translated_count, &translated_capacity, NULL);
+    }
+    *(translated + index) = output;
+}
+
+/**
+ * Returns true if object files will be looked up in the cache.
+ */
+static bool cache_usable(void) {
+    if (cache_dir == NULL) {
+        return false;
+    }
+    // entries are object files so they're no use with -S
+    return !disable_run & (mode != MODE_COMPILE);
+}
+
+/**
+ * Looks up each preprocessed file in the cache. Hits are copied to their
+ * object file outputs and skipped by the compile and assemble phases.
+ */
+static void cache_lookup_files(void) {
+    if (!cache_usable()) {
+        return;
+    }
+    // with -pipe, C files were already translated by their pipelines
+    if (translated != NULL) {
+        return;
+    }
+
+    cache_buffer = malloc(CACHE_BUFFER_SIZE);
+    int32_t* tools_hash = malloc(sizeof(int32_t) * 2);
+    int32_t* hash = malloc(sizeof(int32_t) * 2);
+    if ((cache_buffer == NULL) | ((tools_hash == NULL) | (hash == NULL))) {
+        fatal_cleanup("Out of memory.");
+    }
+
+    // Hash the tools and the options that affect their output. If a tool
+    // can't be read we don't cache anything; running it will report the
+    // error.
+    fnv1a64_init(tools_hash);
+    bool tools_found = cache_hash_file(tools_hash, tool_cci);
+    if (tools_found) {
+        tools_found = cache_hash_file(tools_hash, tool_as);
+    }
+    if (!tools_found) {
+        free(tools_hash);
+        free(hash);
+        return;
+    }
+    if (debug_info) {
+        cache_hash_string(tools_hash, "-g");
+    }
+    if (optimize) {
+        cache_hash_string(tools_hash, "-O");
+    }
+    size_t i = 0;
+    while (i < cci_opts_count) {
+        if (starts_with(*(cci_opts + i), "-f")) {
+            cache_hash_string(tools_hash, *(cci_opts + i));
+        }
+        i = (i + 1);
+    }
+
+    i = 0;
+    while (i < inputs_count) {
+        char* entry = NULL;
+        char* hit = NULL;
+
+        if (file_type(*(inputs + i)) >= TYPE_I) {
+            *hash = *tools_hash;
+            *(hash + 1) = *(tools_hash + 1);
+            if (cache_hash_file(hash, *(stages + i))) {
+                entry = make_cache_filename(hash, ".oo");
+            }
+        }
+
+        if (entry != NULL) {
+            FILE* file = fopen(entry, "rb");
+            if (file != NULL) {
+                if (verbose) {
+                    fputs("Using cached ", stdout);
+                    puts(entry);
+                }
+                char* output = make_phase_output_filename(*(inputs + i), ".oo", MODE_ASSEMBLE);
+                if (!copy_file(file, output)) {
+                    fclose(file);
+                    fatal_cleanup("Failed to open output file.");
+                }
+                fclose(file);
+                *(stages + i) = output;
+                hit = output;
+
+                // there's nothing to store for a hit
+                free(entry);
+                entry = NULL;
+            }
+        }
+
+        string_array_append(&cache_entries, &cache_entries_count, &cache_entries_capacity, entry);
+        string_array_append(&translated, &translated_count, &translated_capacity, hit);
+        i = (i + 1);
+    }
+
+    free(tools_hash);
+    free(hash);
+}
+
+/**
+ * Returns a word that differs between concurrent runs of cc, for naming
+ * temporary files in the cache.
+ *
+ * Natively this is our pid mixed with the time. In the VM we have no pid so
+ * we use the time in nanoseconds.
+ */
+static int32_t make_unique_word(void) {
+    #ifdef __onramp__
+    int* buffer = malloc(12);
+    if (buffer == NULL) {
+        fatal_cleanup("Out of memory.");
+    }
+    __sys_time(buffer);
+    int32_t word = (*(buffer + 2) ^ *buffer);
+    free(buffer);
+    return word;
+    #endif
+
+    #ifndef __onramp__
+    return (int32_t)(((unsigned)time(NULL) << 16) ^ (unsigned)getpid());
+    #endif
+}
+
+/**
+ * Stores the object files of all cache misses. (Hits have no entry.)
+ *
+ * Each entry is written to a temporary file in the cache directory and then
+ * renamed into place so that concurrent builds never see a partial entry. The
+ * temporary file name contains a word unique to this run of cc so that two
+ * builds storing the same entry write separate files. If the temporary file
+ * exists anyway, we don't store the entry rather than truncate a file someone
+ * else may be writing. Failures are ignored; the entry will just be compiled
+ * again next time.
+ */
+static void cache_store_files(void) {
+    int32_t unique = make_unique_word();
+    size_t i = 0;
+    while (i < cache_entries_count) {
+        char* entry = *(cache_entries + i);
+        if (entry != NULL) {
+            FILE* input = fopen(*(stages + i), "rb");
+            if (input != NULL) {
+                size_t entry_len = strlen(entry);
+                char* temp = malloc(entry_len + 14);
+                if (temp == NULL) {
+                    fatal_cleanup("Out of memory.");
+                }
+                memcpy(temp, entry, entry_len);
+                *(temp + entry_len) = '.';
+                format_hex_word((temp + (entry_len + 1)), unique);
+                memcpy((temp + (entry_len + 9)), ".tmp", 5);
+                bool copied = false;
+                FILE* existing = fopen(temp, "rb");
+                if (existing != NULL) {
+                    fclose(existing);
+                }
+                if (existing == NULL) {
+                    copied = copy_file(input, temp);
+                }
+                fclose(input);
+                if (copied) {
+                    if (0 != rename(temp, entry)) {
+                        remove(temp);
+                    }
+                }
+                free(temp);
+            }
+        }
+        i = (i + 1);
+    }
+}
+
+static void preprocess_files(void) {
+
+    // With -pipe or -j, C files are translated all the way here. Pipelines
+    // don't help with -E since there's only one tool to run.
+    bool piped = ((use_pipe | (jobs > 1)) & (mode != MODE_PREPROCESS));
+    if (piped & !disable_run) {
+        piped = pipes_supported();
+    }
+
+    // The cache needs the preprocessed source to look up each file. In that
+    // case C files are preprocessed here (in parallel with -j) and only cci
+    // and as are piped, in compile_files().
+    if (piped & cache_usable()) {
+        piped = false;
+        pipe_compile = true;
+    }
+
+    size_t i = 0;
+    while (i < inputs_count) {
+        char* input = *(inputs + i);
+        char* done = NULL;
+
+        // figure out what stage based on the file extension
+        // TODO we should support -xc or -xassembler later
+        if (file_type(input) == TYPE_C) {
+            if (piped) {
+                input = pipe_file(input, NULL);
+                done = input;
+            }
+            if (!piped) {
+                char* output = make_phase_output_filename(input, ".i", MODE_PREPROCESS);
+                preprocess_file(input, output);
+                input = output;
+            }
+        }
+
+        string_array_append(&stages, &stages_count, &stages_capacity, input);
+        if (piped) {
+            string_array_append(&translated, &translated_count, &translated_capacity, done);
+        }
+        i = (i + 1);
+    }
+
+    #ifndef __onramp__
+    if (queued_jobs != NULL) {
+        run_jobs();
+    }
+    #endif
+}
+
+/**
+ * Compiles and assembles each preprocessed file that wasn't found in the cache
+ * with a pipeline.
+ */
+static void pipe_compile_files(void) {
+    size_t i = 0;
+    while (i < inputs_count) {
+        if (file_type(*(inputs + i)) >= TYPE_I) {
+            if (!is_translated(i)) {
+                char* output = pipe_file(*(inputs + i), *(stages + i));
+                *(stages + i) = output;
+                mark_translated(i, output);
+            }
+        }
+        i = (i + 1);
+    }
+
+    #ifndef __onramp__
+    if (queued_jobs != NULL) {
+        run_jobs();
+    }
+    #endif
+}
+
+static void compile_files(void) {
+    if (pipe_compile) {
+        pipe_compile_files();
+        return;
+    }
+
+    // With -c or -S, all files are compiled in a single run of the compiler
+    // to avoid paying its startup cost for each one. This requires cci/2. In
+    // link mode each file is compiled separately so that any stage of cci can
+    // be used.
+    size_t i = 0;
+    while (i < inputs_count) {
+        if (file_type(*(inputs + i)) >= TYPE_I) {
+            if (!is_translated(i)) {
+                char* output = make_phase_output_filename(*(inputs + i), ".os", MODE_COMPILE);
+                compile_file(*(stages + i), output);
+                *(stages + i) = output;
+                if (mode == MODE_LINK) {
+                    flush_compile();
+                }
+            }
+        }
+        i = (i + 1);
+    }
+    flush_compile();
+    free(compile_args);
+}
+
+static void assemble_files(void) {
+    size_t i = 0;
+    while (i < inputs_count) {
+        if (file_type(*(inputs + i)) >= TYPE_OS) {
+            if (!is_translated(i)) {
+                char* output = make_phase_output_filename(*(inputs + i), ".oo", MODE_ASSEMBLE);
+                assemble_file(*(stages + i), output);
+                *(stages + i) = output;
+            }
+        }
+        i = (i + 1);
+    }
+}
+
+static void translate_files(void) {
+
+    // Each phase runs on all files before the next phase begins.
+    preprocess_files();
+    if (mode == MODE_PREPROCESS) {
+        return;
+    }
+    cache_lookup_files();
+    compile_files();
+    if (mode == MODE_COMPILE) {
+        return;
+    }
+    assemble_files();
+    cache_store_files();
+    if (mode == MODE_ASSEMBLE) {
+        return;
+    }
+
+    // link mode. add files to linker inputs
     size_t i = 0;
     while (i < inputs_count) {
-        translate_file(*(inputs + i));
+        string_array_append(&objects, &objects_count, &objects_capacity, *(stages + i));
         i = (i + 1);
     }
 }
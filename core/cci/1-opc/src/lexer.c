@@ -49,6 +49,12 @@ static size_t lexer_token_capacity;
 
 static FILE* lexer_file;
 
+// Whether we still need to emit a #line directive for the input file. We put
+// it off until the first token so that we can leave it out if the input starts
+// with its own #line directive. (The input is usually a temporary file so its
+// name shouldn't leak into the debug info.)
+static bool lexer_line_directive_pending;
+
 const char* lexer_type_to_string(lexer_type_t type) {
     if (type == lexer_type_alphanumeric) {return "lexer_type_alphanumeric";}
     if (type == lexer_type_number) {return "lexer_type_number";}
@@ -135,7 +141,7 @@ void lexer_init(const char* filename) {
 
     current_line = 1;
     current_filename = strdup(filename);
-    emit_line_directive();
+    lexer_line_directive_pending = true;
 
     // Prime the current char with a newline so the first line can be a #line
     // directive or #pragma.
@@ -365,6 +371,7 @@ static void lexer_handle_line_directive(void) {
     lexer_consume_end_of_line();
 
     emit_line_directive();
+    lexer_line_directive_pending = false;
 }
 
 static void lexer_parse_directive(void) {
@@ -411,6 +418,10 @@ void lexer_consume(void) {
     // Skip whitespace and handle #line directives. This brings us to the start
     // of the next real token.
     lexer_consume_whitespace_and_directives();
+    if (lexer_line_directive_pending) {
+        emit_line_directive();
+        lexer_line_directive_pending = false;
+    }
 
     // Check for end of file
     if (lexer_char == EOF) {
@@ -41,6 +41,7 @@ static block_t* block_new_impl(void) {
     block->instructions_count = 0;
     block->instructions_capacity = 0;
     block->emitted = false;
+    block->has_volatile = false;
     return block;
 }
 
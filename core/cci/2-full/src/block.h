@@ -45,6 +45,7 @@ typedef struct block_t {
     size_t instructions_count;
     size_t instructions_capacity;
     bool emitted;
+    bool has_volatile; // contains a volatile access so loads can't be merged
 } block_t;
 
 block_t* block_new(int label);
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
 
 #include "block.h"
 #include "common.h"
@@ -40,18 +41,28 @@ static FILE* output_file;
 static token_t* current_location;
 
 void emit_init(const char* output_filename) {
-    output_file = fopen(output_filename, "wb");
-    if (output_file == NULL) {
-        fatal("ERROR: Failed to open output file.");
+    if (0 == strcmp(output_filename, "-")) {
+        output_file = stdout;
+    } else {
+        output_file = fopen(output_filename, "wb");
+        if (output_file == NULL) {
+            fatal("ERROR: Failed to open output file.");
+        }
     }
     emit_cstr("#line manual\n");
     emit_global_divider();
 }
 
 void emit_destroy(void) {
-    if (current_location)
+    if (current_location) {
         token_deref(current_location);
-    fclose(output_file);
+        current_location = NULL;
+    }
+    if (output_file == stdout) {
+        fflush(output_file);
+    } else {
+        fclose(output_file);
+    }
 }
 
 void emit_char(char c) {
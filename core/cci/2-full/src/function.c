@@ -42,6 +42,7 @@ function_t* function_new(type_t* type, token_t* name,
     vector_init(&function->blocks);
     function->variadic_offset = -1;
     function->name_label = -1;
+    function->tail_calls = false;
     return function;
 }
 
@@ -25,6 +25,8 @@
 #ifndef FUNCTION_H_INCLUDED
 #define FUNCTION_H_INCLUDED
 
+#include <stdbool.h>
+
 #include "libo-vector.h"
 #include "libo-string.h"
 
@@ -44,6 +46,7 @@ typedef struct function_t {
     vector_t blocks;
     int variadic_offset; // offset above rfp where variadic args start
     int name_label; // label for __func__ string
+    bool tail_calls; // true if sibling calls can be generated as jumps
     struct symbol_t* symbol;
 } function_t;
 
@@ -53,7 +53,11 @@ static void generate_builtin(node_t* node, int reg_out);
 static void generate_builtin_location(node_t* node, int reg_out);
 
 void generate_init(void) {
+    current_function = NULL;
+    current_block = NULL;
+    next_label = 0;
     register_next = R0;
+    register_loop_count = 0;
 }
 
 void generate_destroy(void) {
@@ -315,6 +319,35 @@ static int generate_variable_offsets(node_t* node, int offset, int frame_size) {
     return frame_size;
 }
 
+/**
+ * Returns true if the given tree could leak a pointer into the stack frame,
+ * i.e. it takes the address of a local variable (including implicitly by
+ * array decay) or calls va_start().
+ *
+ * A function that does this can't make sibling calls because the callee
+ * could still be using the pointer after our frame is gone. This is
+ * conservative: any local variable accessed anywhere under an address-of
+ * counts, even if it's only used as an array index.
+ */
+static bool generate_exposes_frame(node_t* node, bool address_taken) {
+    if (node->kind == NODE_ADDRESS_OF)
+        address_taken = true;
+
+    if (node->kind == NODE_ACCESS &&
+            node->symbol->kind == symbol_kind_variable &&
+            !symbol_is_global(node->symbol) &&
+            (address_taken || type_is_array(node->symbol->type)))
+        return true;
+
+    if (node->kind == NODE_BUILTIN && node->builtin == BUILTIN_VA_START)
+        return true;
+
+    for (node_t* child = node->first_child; child; child = child->right_sibling)
+        if (generate_exposes_frame(child, address_taken))
+            return true;
+    return false;
+}
+
 void generate_function(function_t* function) {
     node_t* root = function->root;
     emit_source_location(root->token);
@@ -324,6 +357,11 @@ void generate_function(function_t* function) {
     frame_size = generate_variable_offsets(root, -frame_size, frame_size);
     frame_size = (frame_size + 3) & ~3;
 
+    // sibling calls reuse our frame so they're only possible if nothing can
+    // point into it
+    function->tail_calls = flag_enabled(flag_optimize_sibling_calls) &&
+            !generate_exposes_frame(root->last_child, false);
+
     // generate the preamble
     current_function = function;
     current_block = block_new(-1);
@@ -367,10 +405,15 @@ void generate_function(function_t* function) {
     generate_node(root->last_child, reg);
     register_free(root->token, reg);
 
-    // If the last block doesn't end in 'ret', we add a return. If the function
-    // is main, we have to return 0.
+    // If the last block doesn't end in 'ret' (or a sibling call), we add a
+    // return. If the function is main, we have to return 0.
     size_t count = block_count(current_block);
-    if (count == 0 || block_at(current_block, count - 1)->opcode != RET) {
+    instruction_t* last = NULL;
+    if (count != 0)
+        last = block_at(current_block, count - 1);
+    if (last == NULL || !(last->opcode == RET ||
+                (last->opcode == JMP && last->invocation_type == '^')))
+    {
         token_t* end_token = root->first_child->end_token;
         if (string_equal_cstr(function->asm_name, "main")) {
             block_append(current_block, end_token, ZERO, R0);
@@ -385,8 +428,13 @@ void generate_function(function_t* function) {
  *
  * The return value is placed in reg_out, or if passed indirectly, reg_out
  * contains a pointer to storage for the return value.
+ *
+ * If tail is true, this is a sibling call: instead of calling the function,
+ * we move the stack arguments into our own incoming argument area, tear down
+ * our frame and jump to it. The callee then returns directly to our caller.
+ * See generate_tail_call().
  */
-static void generate_call(node_t* call, int reg_out) {
+static void generate_call_impl(node_t* call, int reg_out, bool tail) {
     node_t* function = call->first_child;
     type_t* function_type = function->type;
     if (type_is_pointer(function_type))
@@ -394,8 +442,11 @@ static void generate_call(node_t* call, int reg_out) {
     if (!type_is_function(function_type))
         fatal_token(function->token, "Internal error: cannot generate call for non-function");
 
-    // push all registers (except for the return register)
+    // push all registers (except for the return register). We don't need to
+    // preserve anything for a sibling call since we aren't coming back.
     int last_pushed_register = register_loop_count ? R9 : register_next - 1;
+    if (tail)
+        last_pushed_register = R0 - 1;
     for (int i = R0; i <= last_pushed_register; ++i) {
         if (i != reg_out) {
             block_append(current_block, call->token, PUSH, i);
@@ -479,6 +530,25 @@ static void generate_call(node_t* call, int reg_out) {
             break;
     }
 
+    // for a sibling call, copy the stack arguments up into our incoming
+    // argument area (which we've already checked is large enough), then
+    // destroy our frame and jump to the function. the register arguments are
+    // already in place.
+    if (tail) {
+        int reg_temp = register_alloc(call->token);
+        for (int offset = 0; offset < stack_space; offset += 4) {
+            block_append(current_block, call->token, LDW, reg_temp, RSP, offset);
+            block_append(current_block, call->token, STW, reg_temp, RFP, offset + 8);
+        }
+        register_free(call->token, reg_temp);
+        block_append(current_block, call->token, LEAVE);
+        block_append(current_block, call->token, JMP, '^', string_cstr(function->symbol->asm_name), -1);
+
+        register_next = old_register_next;
+        register_loop_count = old_register_loop_count;
+        return;
+    }
+
     // call the function directly if we can
     if (function->kind == NODE_ACCESS && type_is_function(function->type)) {
         block_append(current_block, call->token, CALL, ARGTYPE_NAME, '^', string_cstr(function->symbol->asm_name));
@@ -517,6 +587,64 @@ static void generate_call(node_t* call, int reg_out) {
     }
 }
 
+static void generate_call(node_t* call, int reg_out) {
+    generate_call_impl(call, reg_out, false);
+}
+
+/**
+ * Returns the number of bytes of stack arguments needed to call the given
+ * function, not including the indirect return pointer.
+ */
+static int generate_call_stack_space(node_t* call, type_t* function_type) {
+    int stack_space = 0;
+    int register_args = 0;
+    uint32_t arg_count = 0;
+    for (node_t* arg = call->first_child->right_sibling; arg; arg = arg->right_sibling) {
+        if (register_args < 4 && arg_count < function_type->count &&
+                !type_is_passed_indirectly(arg->type))
+        {
+            ++register_args;
+        } else {
+            stack_space += ((int)type_size(arg->type) + 3) & ~3;
+        }
+        ++arg_count;
+    }
+    return stack_space;
+}
+
+bool generate_tail_call(node_t* node) {
+    if (!current_function->tail_calls)
+        return false;
+    if (node->kind != NODE_CALL)
+        return false;
+
+    // We can only jump to a function by name.
+    node_t* function = node->first_child;
+    if (function->kind != NODE_ACCESS || !type_is_function(function->type))
+        return false;
+
+    // Indirect return values are stored in the caller's frame.
+    if (type_is_passed_indirectly(node->type) ||
+            type_is_passed_indirectly(current_function->root->type))
+        return false;
+
+    // The stack arguments have to fit in the area where our own named stack
+    // arguments were passed. We also keep the copy short and within mix-type
+    // offsets. We need to allocate a temporary register after all the
+    // arguments so we limit the argument count as well.
+    int argument_count = 0;
+    for (node_t* arg = function->right_sibling; arg; arg = arg->right_sibling)
+        ++argument_count;
+    if (argument_count > 8)
+        return false;
+    int stack_space = generate_call_stack_space(node, function->type);
+    if (stack_space > current_function->variadic_offset - 8 || stack_space > 96)
+        return false;
+
+    generate_call_impl(node, R0, true);
+    return true;
+}
+
 /**
  * Generates a cast between integers in a register.
  *
@@ -788,7 +916,7 @@ void generate_initializer_scalar(node_t* expr, type_t* target, int reg_base, siz
         // to zero out the rest of the array.
         if (array_count > string_count) {
             block_append_op_imm(current_block, expr->token, ADD, reg_loc, reg_loc, string_count);
-            generate_zero_array(expr->token, target, array_count - string_count, reg_loc);
+            generate_zero_array(expr->token, target->ref, array_count - string_count, reg_loc);
         }
 
         register_free(expr->token, reg_loc);
@@ -844,7 +972,7 @@ void generate_initializer_list(node_t* list, type_t* type, int reg_base, size_t
 
         node_t* child = vector_at(&list->children, i);
         if (!child) {
-            generate_zero_scalar(list->token, type, reg_base, offset);
+            generate_zero_scalar(list->token, child_type, reg_base, offset);
         } else if (child->kind == NODE_INITIALIZER_LIST) {
             generate_initializer_list(child, child_type, reg_base, offset);
         } else {
@@ -1050,6 +1178,15 @@ static void generate_address_of(node_t* node, int reg_out) {
 int debug_depth;
 #endif
 
+/**
+ * Marks the current block if the given node is a volatile access. The
+ * optimizer won't merge or forward loads in a marked block.
+ */
+static void generate_mark_volatile(node_t* node) {
+    if (current_block && node->type && node->type->is_volatile)
+        current_block->has_volatile = true;
+}
+
 void generate_node(node_t* node, int reg_out) {
     #ifdef GENERATE_DEBUG
     for (int i = 0; i < debug_depth; ++i)
@@ -1058,6 +1195,8 @@ void generate_node(node_t* node, int reg_out) {
     ++debug_depth;
     #endif
 
+    generate_mark_volatile(node);
+
     switch (node->kind) {
         case NODE_INVALID:
             fatal("Internal error: cannot generate unrecognized node.");
@@ -1162,6 +1301,9 @@ void generate_node(node_t* node, int reg_out) {
         case NODE_BUILTIN: generate_builtin(node, reg_out); break;
     }
 
+    // The current block may have changed while generating the node.
+    generate_mark_volatile(node);
+
     #ifdef GENERATE_DEBUG
     --debug_depth;
     #endif
@@ -1175,6 +1317,8 @@ void generate_location(node_t* node, int reg_out) {
     ++debug_depth;
     #endif
 
+    generate_mark_volatile(node);
+
     switch (node->kind) {
         case NODE_ACCESS: generate_access_location(node->token, node->symbol, reg_out); break;
         case NODE_DEREFERENCE: generate_node(node->first_child, reg_out); break;
@@ -1188,6 +1332,9 @@ void generate_location(node_t* node, int reg_out) {
             break;
     }
 
+    // The current block may have changed while generating the node.
+    generate_mark_volatile(node);
+
     #ifdef GENERATE_DEBUG
     --debug_depth;
     #endif
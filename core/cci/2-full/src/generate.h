@@ -111,6 +111,16 @@ void generate_location(struct node_t* node, int reg_out);
  */
 void generate_dereference_impl(struct node_t* node, int reg_out, int reg_ptr, int offset);
 
+/**
+ * Generates a sibling call for a `return` statement if possible. This is a
+ * call that reuses the current stack frame and jumps to the callee rather
+ * than calling it.
+ *
+ * If the given return value is not a call, or if a sibling call is not
+ * possible for it, nothing is generated and false is returned.
+ */
+bool generate_tail_call(struct node_t* node);
+
 /**
  * Generates a variable with static storage duration, i.e. a global variable
  * not marked `extern` or a local variable marked `static`.
@@ -31,6 +31,7 @@
 #include "block.h"
 #include "type.h"
 #include "token.h"
+#include "symbol.h"
 
 /**
  * Generates an arithmetic or other binary calculation that must be done with a
@@ -115,6 +116,168 @@ static void generate_arithmetic_function(node_t* parent,
     }
 }
 
+/**
+ * Returns true if the given node is a simple integer constant that fits in a
+ * register, placing its value in out.
+ *
+ * This is not a full constant expression evaluator (see node_eval_32()); it
+ * just finds numbers that are possibly wrapped in casts, which is what the
+ * parser gives us for most literal operands after arithmetic conversions.
+ */
+static bool generate_is_constant(node_t* node, uint32_t* out) {
+    if (!type_is_integer(node->type) || type_size(node->type) != 4)
+        return false;
+    switch (node->kind) {
+        case NODE_NUMBER:
+        case NODE_CHARACTER:
+            *out = node->u32;
+            return true;
+        case NODE_CAST:
+            return generate_is_constant(node->first_child, out);
+        case NODE_SIZEOF:
+            *out = type_size(node->first_child->type);
+            return true;
+        case NODE_ACCESS:
+            if (node->symbol->kind != symbol_kind_constant)
+                return false;
+            *out = node->symbol->u32;
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+/**
+ * Returns the base-2 logarithm of a power of two.
+ */
+static int log2_pow2(uint32_t value) {
+    int shift = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++shift;
+    }
+    return shift;
+}
+
+/**
+ * Shifts a register right arithmetically by the given constant (1-31).
+ *
+ * The assembler's `shrs` is a compound instruction with branches. With a
+ * constant shift we can do it with a straight sequence of native
+ * instructions: do an unsigned shift, then fill the top bits with the sign.
+ */
+static void generate_shrs_constant(token_t* token, int reg, int shift) {
+    int reg_sign = register_alloc(token);
+    block_append(current_block, token, SHRU, reg_sign, reg, 31);
+    block_append(current_block, token, SUB, reg_sign, 0, reg_sign);
+    block_append(current_block, token, SHL, reg_sign, reg_sign, 32 - shift);
+    block_append(current_block, token, SHRU, reg, reg, shift);
+    block_append(current_block, token, OR, reg, reg, reg_sign);
+    register_free(token, reg_sign);
+}
+
+/**
+ * Places the rounding bias for a signed division by 2^shift into reg_bias.
+ * This is 2^shift-1 if reg is negative and 0 otherwise. Adding it to the
+ * dividend before shifting makes the shift round towards zero as C requires.
+ */
+static void generate_signed_bias(token_t* token, int reg, int reg_bias, int shift) {
+    block_append(current_block, token, SHRU, reg_bias, reg, 31);
+    block_append(current_block, token, SUB, reg_bias, 0, reg_bias);
+    block_append(current_block, token, SHRU, reg_bias, reg_bias, 32 - shift);
+}
+
+/**
+ * Generates a multiply, divide or modulo of reg by a constant, placing the
+ * result in the same register. Returns false if nothing special can be done,
+ * in which case nothing is generated.
+ *
+ * Our VM only has native multiply and unsigned divide. Signed division and
+ * both kinds of modulo are expanded by the assembler into long sequences
+ * (with branches, in the signed case), so division and modulo by powers of
+ * two are replaced with shifts and masks. Multiplication by a power of two
+ * becomes a shift; multiplication by anything else stays a single `mul`.
+ */
+static bool generate_arithmetic_constant(token_t* token, int reg,
+        opcode_t opcode, uint32_t value)
+{
+    // Division by zero is undefined. We leave it alone so the VM traps.
+    if (value == 0) {
+        if (opcode != MUL)
+            return false;
+        block_append(current_block, token, ZERO, reg);
+        return true;
+    }
+
+    // Signed shifts by a constant don't need the general compound shift.
+    if (opcode == SHRS) {
+        if (value == 0 || value > 31)
+            return false;
+        generate_shrs_constant(token, reg, (int)value);
+        return true;
+    }
+
+    // For signed ops we only handle positive divisors, except that the sign
+    // of the divisor doesn't matter for modulo.
+    if (opcode == MODS && (int32_t)value < 0 && value != 0x80000000u)
+        value = -value;
+    if ((opcode == DIVS || opcode == MODS) && (int32_t)value < 0)
+        return false;
+
+    if (!is_pow2((int)value))
+        return false;
+    int shift = log2_pow2(value);
+
+    switch (opcode) {
+        case MUL:
+            if (shift != 0)
+                block_append(current_block, token, SHL, reg, reg, shift);
+            return true;
+
+        case DIVU:
+            if (shift != 0)
+                block_append(current_block, token, SHRU, reg, reg, shift);
+            return true;
+
+        case MODU:
+            if (shift == 0) {
+                block_append(current_block, token, ZERO, reg);
+            } else {
+                block_append_op_imm(current_block, token, AND, reg, reg, (int)(value - 1));
+            }
+            return true;
+
+        case DIVS:
+            if (shift != 0) {
+                int reg_bias = register_alloc(token);
+                generate_signed_bias(token, reg, reg_bias, shift);
+                block_append(current_block, token, ADD, reg, reg, reg_bias);
+                register_free(token, reg_bias);
+                generate_shrs_constant(token, reg, shift);
+            }
+            return true;
+
+        case MODS:
+            // x - ((x + bias) & -2^shift)
+            if (shift == 0) {
+                block_append(current_block, token, ZERO, reg);
+            } else {
+                int reg_temp = register_alloc(token);
+                generate_signed_bias(token, reg, reg_temp, shift);
+                block_append(current_block, token, ADD, reg_temp, reg, reg_temp);
+                block_append_op_imm(current_block, token, AND, reg_temp, reg_temp, -(int)value);
+                block_append(current_block, token, SUB, reg, reg, reg_temp);
+                register_free(token, reg_temp);
+            }
+            return true;
+
+        default:
+            break;
+    }
+    return false;
+}
+
 /**
  * Generates a simple arithmetic calculation.
  */
@@ -132,14 +295,29 @@ static void generate_simple_arithmetic(node_t* node, int reg_left,
 
     if (function) {
         generate_arithmetic_function(node, node->first_child, node->last_child, reg_left, function);
-    } else {
-        generate_node(node->first_child, reg_left);
-        int reg_right = register_alloc(node->token);
-        assert(!type_is_passed_indirectly(node->last_child->type));
-        generate_node(node->last_child, reg_right);
-        block_append(current_block, node->token, opcode, reg_left, reg_left, reg_right);
-        register_free(node->token, reg_right);
+        return;
+    }
+
+    generate_node(node->first_child, reg_left);
+
+    // If the right side is a constant, we may be able to do something
+    // cheaper than the general instruction, or at least avoid loading the
+    // constant into a register.
+    uint32_t value;
+    if (generate_is_constant(node->last_child, &value)) {
+        if (generate_arithmetic_constant(node->token, reg_left, opcode, value))
+            return;
+        if ((int32_t)value <= 127 && (int32_t)value >= -112) {
+            block_append(current_block, node->token, opcode, reg_left, reg_left, (int)value);
+            return;
+        }
     }
+
+    int reg_right = register_alloc(node->token);
+    assert(!type_is_passed_indirectly(node->last_child->type));
+    generate_node(node->last_child, reg_right);
+    block_append(current_block, node->token, opcode, reg_left, reg_left, reg_right);
+    register_free(node->token, reg_right);
 }
 
 /**
@@ -154,9 +332,6 @@ static void generate_simple_arithmetic(node_t* node, int reg_left,
  * the given register.)
  */
 static void generate_pointer_add_sub_impl(node_t* node, opcode_t op, int reg_left) {
-    int reg_right = register_alloc(node->token);
-    assert(!type_is_passed_indirectly(node->last_child->type));
-    generate_node(node->last_child, reg_right);
 
     // One side is a pointer and the other side is an int offset. The offset
     // needs to be shifted or multiplied by the pointer size.
@@ -167,21 +342,29 @@ static void generate_pointer_add_sub_impl(node_t* node, opcode_t op, int reg_lef
     if (!type_is_complete(ptr_type->ref))
         fatal_token(node->token, "Cannot perform pointer arithmetic on a pointer to an incomplete type.");
     size_t size = type_size(ptr_type->ref);
-    int reg_int = is_left_ptr ? (reg_right) : reg_left;
-
-    // Shift or multiply the offset
     if (size == 0) {
         fatal("Internal error: cannot perform arithmetic on pointer to zero-size element");
     }
+
+    // If the offset is constant, we scale it now and add it directly. This
+    // is the common case of indexing an array or struct pointer with a
+    // literal.
+    uint32_t value;
+    if (is_left_ptr && generate_is_constant(node->last_child, &value)) {
+        block_append_op_imm(current_block, node->token, op, reg_left, reg_left,
+                (int)(value * (uint32_t)size));
+        return;
+    }
+
+    int reg_right = register_alloc(node->token);
+    assert(!type_is_passed_indirectly(node->last_child->type));
+    generate_node(node->last_child, reg_right);
+    int reg_int = is_left_ptr ? (reg_right) : reg_left;
+
+    // Shift or multiply the offset
     if (size != 1) {
         if (is_pow2(size)) {
-            // TODO use fls() or clz() or similar function
-            int shift = 0;
-            while (size) {
-                size >>= 1;
-                ++shift;
-            }
-            block_append(current_block, node->token, SHL, reg_int, reg_int, shift - 1);
+            block_append(current_block, node->token, SHL, reg_int, reg_int, log2_pow2(size));
         } else {
             block_append_op_imm(current_block, node->token, MUL, reg_int, reg_int, size);
         }
@@ -212,23 +395,29 @@ static void generate_pointers_sub(node_t* node, int reg_left) {
     // Perform the subtraction
     block_append(current_block, node->token, SUB, reg_left, reg_left, reg_right);
 
-    // Shift or divide the result
-    size_t size = type_size(node->first_child->type->ref);
+    // Divide the result by the element size. The difference is always an
+    // exact multiple of it so we don't need a real division. We split the
+    // size into an odd factor and a power of two. Multiplying by the inverse
+    // of the odd factor (mod 2^32) divides it out exactly, then we shift out
+    // the power of two.
+    uint32_t size = type_size(node->first_child->type->ref);
     if (size == 0) {
         fatal("Internal error: cannot perform arithmetic on pointer to zero-size element");
     }
+    int shift = 0;
+    while (!(size & 1)) {
+        size >>= 1;
+        ++shift;
+    }
     if (size != 1) {
-        if (is_pow2(size)) {
-            // TODO use fls() or clz() or similar function
-            int shift = 0;
-            while (size) {
-                size >>= 1;
-                ++shift;
-            }
-            block_append(current_block, node->token, SHRS, reg_left, reg_left, shift - 1);
-        } else {
-            block_append_op_imm(current_block, node->token, DIVS, reg_left, reg_left, size);
-        }
+        // Newton's method; each step doubles the number of correct bits
+        uint32_t inverse = size;
+        for (int i = 0; i < 5; ++i)
+            inverse *= 2 - size * inverse;
+        block_append_op_imm(current_block, node->token, MUL, reg_left, reg_left, (int)inverse);
+    }
+    if (shift != 0) {
+        generate_shrs_constant(node->token, reg_left, shift);
     }
 
     register_free(node->token, reg_right);
@@ -541,57 +730,183 @@ void generate_not_equal(node_t* node, int reg_out) {
  * We check both size and alignment to decide on a step size because this is
  * used to zero out strings in initializers among other things.
  */
-void generate_zero_array(token_t* token, type_t* type, size_t count, int reg_loc) {
-    size_t size = type_size(type);
-    size_t total = count * size;
-    size_t align = type_alignment(type);
-
-    // choose a step size
-    size_t step;
-    size_t steps;
-    int store;
-    if (0 == (total & 3) && 0 == (align & 3)) {
-        step = 4;
-        steps = count >> 2;
-        store = STW;
-    } else if (0 == (total & 1) && 0 == (align & 1)) {
-        step = 2;
-        steps = count >> 1;
-        store = STS;
-    } else {
-        step = 1;
-        steps = count;
-        store = STB;
+/*
+ * Block copy and zero
+ *
+ * Copying and zeroing of aggregates (struct assignment, struct arguments and
+ * return values, array initializers) goes through generate_block(). We use
+ * the largest step size allowed by the alignment of the type and handle the
+ * remaining bytes with smaller steps at the end.
+ *
+ * Small blocks are completely unrolled. Medium blocks use a loop that moves
+ * pointers through the block BLOCK_UNROLL steps at a time. Large word-aligned
+ * blocks call a helper in the libc which does the same thing with a larger
+ * unroll, so we don't bloat the code with a loop at every struct copy.
+ */
+
+// Blocks of up to this many steps are unrolled completely.
+#define BLOCK_INLINE_STEPS 8
+
+// The number of steps in each iteration of an inline loop.
+#define BLOCK_UNROLL 4
+
+// Word-aligned blocks of at least this many bytes call the libc helpers
+// __block_copy() and __block_zero().
+#define BLOCK_CALL_BYTES 256
+
+/**
+ * Emits straight-line copies or zeroes of count steps of the given size from
+ * reg_src to reg_dest at the given offset, returning the offset after them.
+ *
+ * If reg_src is -1, the destination is zeroed.
+ */
+static int generate_block_steps(token_t* token, int step, int count,
+        int reg_src, int reg_dest, int reg_temp, int offset)
+{
+    int load = step == 4 ? LDW : step == 2 ? LDS : LDB;
+    int store = step == 4 ? STW : step == 2 ? STS : STB;
+    for (int i = 0; i < count; ++i) {
+        if (reg_src == -1) {
+            block_append(current_block, token, store, 0, reg_dest, offset);
+        } else {
+            block_append(current_block, token, load, reg_temp, reg_src, offset);
+            block_append(current_block, token, store, reg_temp, reg_dest, offset);
+        }
+        offset += step;
+    }
+    return offset;
+}
+
+/**
+ * Emits the bytes that don't fill a whole step at the end of a block.
+ */
+static void generate_block_tail(token_t* token, int tail,
+        int reg_src, int reg_dest, int reg_temp, int offset)
+{
+    if (tail >= 2) {
+        offset = generate_block_steps(token, 2, 1, reg_src, reg_dest, reg_temp, offset);
+        tail -= 2;
     }
+    generate_block_steps(token, 1, tail, reg_src, reg_dest, reg_temp, offset);
+}
+
+/**
+ * Calls __block_copy() or __block_zero() in the libc. These take the
+ * destination in r0, the source (for copy) in r1 and the size in the next
+ * register. The size must be a multiple of four and both pointers must be
+ * word-aligned.
+ */
+static void generate_block_call(token_t* token, uint32_t size,
+        int reg_src, int reg_dest)
+{
+    // push all registers. we don't have an output register; everything is
+    // preserved.
+    int last_pushed_register = register_loop_count ? R9 : register_next - 1;
+    for (int i = R0; i <= last_pushed_register; ++i)
+        block_append(current_block, token, PUSH, i);
+
+    // place the arguments. we go through the stack since the source and
+    // destination could be in either of r0 and r1.
+    if (reg_src != -1)
+        block_append(current_block, token, PUSH, reg_src);
+    block_append(current_block, token, PUSH, reg_dest);
+    block_append(current_block, token, POP, R0);
+    if (reg_src != -1)
+        block_append(current_block, token, POP, R1);
+    block_append(current_block, token, IMW, ARGTYPE_NUMBER, reg_src == -1 ? R1 : R2, size);
+
+    block_append(current_block, token, CALL, ARGTYPE_NAME, '^',
+            reg_src == -1 ? "__block_zero" : "__block_copy");
+
+    for (int i = last_pushed_register; i >= R0; --i)
+        block_append(current_block, token, POP, i);
+}
+
+/**
+ * Copies or zeroes a block of the given total size and alignment from reg_src
+ * to reg_dest. If reg_src is -1, the destination is zeroed.
+ */
+static void generate_block(token_t* token, uint32_t total, uint32_t align,
+        int reg_src, int reg_dest)
+{
+    // Choose a step size. This is determined by alignment only; the
+    // remainder is handled at the end.
+    int step = (0 == (align & 3)) ? 4 : (0 == (align & 1)) ? 2 : 1;
+    int steps = (int)(total / (uint32_t)step);
+    int tail = (int)(total % (uint32_t)step);
+    int reg_temp = reg_src == -1 ? -1 : register_alloc(token);
 
     // If the number of steps is small, unroll it.
-    if (steps <= 8) {
-        for (size_t i = 0; i < count; i += step) {
-            block_append(current_block, token, store, 0, reg_loc, i);
-        }
+    if (steps <= BLOCK_INLINE_STEPS) {
+        int offset = generate_block_steps(token, step, steps, reg_src, reg_dest, reg_temp, 0);
+        generate_block_tail(token, tail, reg_src, reg_dest, reg_temp, offset);
+        if (reg_temp != -1)
+            register_free(token, reg_temp);
+        return;
+    }
+
+    // Otherwise we walk pointers through the block. The tail is relative to
+    // them.
+    int reg_src_ptr = reg_src == -1 ? -1 : register_alloc(token);
+    int reg_dest_ptr = register_alloc(token);
+    int rest;
+
+    if (step == 4 && total >= BLOCK_CALL_BYTES) {
+        // Large word-aligned blocks call into the libc.
+        generate_block_call(token, (uint32_t)steps * 4, reg_src, reg_dest);
+        if (reg_src != -1)
+            block_append(current_block, token, MOV, reg_src_ptr, reg_src);
+        block_append(current_block, token, MOV, reg_dest_ptr, reg_dest);
+        if (reg_src != -1)
+            block_append_op_imm(current_block, token, ADD, reg_src_ptr, reg_src_ptr, steps * 4);
+        block_append_op_imm(current_block, token, ADD, reg_dest_ptr, reg_dest_ptr, steps * 4);
+        rest = 0;
 
-    // Otherwise insert a loop.
     } else {
-        int reg_i = register_alloc(token);
+        // Medium blocks get an unrolled loop.
+        int reg_count = register_alloc(token);
         block_t* loop_block = block_new(next_label++);
         block_t* end_block = block_new(next_label++);
         function_add_block(current_function, loop_block);
         function_add_block(current_function, end_block);
 
-        block_append(current_block, token, IMW, ARGTYPE_NUMBER, reg_i, count);
+        if (reg_src != -1)
+            block_append(current_block, token, MOV, reg_src_ptr, reg_src);
+        block_append(current_block, token, MOV, reg_dest_ptr, reg_dest);
+        block_append(current_block, token, IMW, ARGTYPE_NUMBER, reg_count, steps / BLOCK_UNROLL);
         block_append(current_block, token, JMP, '&', JUMP_LABEL_PREFIX, loop_block->label);
 
+        // There's always at least one iteration so the test is at the end.
         current_block = loop_block;
-        block_append(current_block, token, JZ, reg_i, '&', JUMP_LABEL_PREFIX, end_block->label);
-        block_append(current_block, token, SUB, reg_i, reg_i, step);
-        block_append(current_block, token, store, 0, reg_loc, reg_i);
-        block_append(current_block, token, JMP, '&', JUMP_LABEL_PREFIX, loop_block->label);
+        int size = generate_block_steps(token, step, BLOCK_UNROLL,
+                reg_src_ptr, reg_dest_ptr, reg_temp, 0);
+        if (reg_src != -1)
+            block_append(current_block, token, ADD, reg_src_ptr, reg_src_ptr, size);
+        block_append(current_block, token, ADD, reg_dest_ptr, reg_dest_ptr, size);
+        block_append(current_block, token, SUB, reg_count, reg_count, 1);
+        block_append(current_block, token, JNZ, reg_count, '&', JUMP_LABEL_PREFIX, loop_block->label);
+        block_append(current_block, token, JMP, '&', JUMP_LABEL_PREFIX, end_block->label);
 
         current_block = end_block;
-        register_free(token, reg_i);
+        register_free(token, reg_count);
+        rest = steps % BLOCK_UNROLL;
+    }
+
+    int offset = generate_block_steps(token, step, rest, reg_src_ptr, reg_dest_ptr, reg_temp, 0);
+    generate_block_tail(token, tail, reg_src_ptr, reg_dest_ptr, reg_temp, offset);
+
+    register_free(token, reg_dest_ptr);
+    if (reg_src != -1) {
+        register_free(token, reg_src_ptr);
+        register_free(token, reg_temp);
     }
 }
 
+void generate_zero_array(token_t* token, type_t* type, size_t count, int reg_loc) {
+    generate_block(token, (uint32_t)(count * type_size(type)),
+            (uint32_t)type_alignment(type), -1, reg_loc);
+}
+
 void generate_zero_scalar(struct token_t* token, struct type_t* type, int reg_base, int offset) {
     if (offset == 0) {
         generate_zero_array(token, type, 1, reg_base);
@@ -607,63 +922,10 @@ void generate_zero_scalar(struct token_t* token, struct type_t* type, int reg_ba
 void generate_copy(token_t* token, type_t* type, uint32_t count,
         int reg_src, int reg_dest)
 {
-    int reg_temp = register_alloc(token);
-    uint32_t align = type_alignment(type);
-    uint32_t total = count * type_size(type);
-
-    // Choose a step size. We check both size and alignment because this is
-    // used to copy strings in initializers among other things.
-    uint32_t step;
-    uint32_t steps;
-    int load;
-    int store;
-    if (0 == (total & 3) && 0 == (align & 3)) {
-        step = 4;
-        steps = total >> 2;
-        load = LDW;
-        store = STW;
-    } else if (0 == (total & 1) && 0 == (align & 1)) {
-        step = 2;
-        steps = total >> 1;
-        load = LDS;
-        store = STS;
-    } else {
-        step = 1;
-        steps = total;
-        load = LDB;
-        store = STB;
-    }
-
-    // If the number of steps is small, unroll it.
-    if (steps <= 4) {
-        for (uint32_t i = 0; i < total; i += step) {
-            block_append(current_block, token, load, reg_temp, reg_src, i);
-            block_append(current_block, token, store, reg_temp, reg_dest, i);
-        }
-
-    // Otherwise insert a loop.
-    } else {
-        int reg_i = register_alloc(token);
-        block_t* loop_block = block_new(next_label++);
-        block_t* end_block = block_new(next_label++);
-        function_add_block(current_function, loop_block);
-        function_add_block(current_function, end_block);
-
-        block_append(current_block, token, IMW, ARGTYPE_NUMBER, reg_i, total);
-        block_append(current_block, token, JMP, '&', JUMP_LABEL_PREFIX, loop_block->label);
-
-        current_block = loop_block;
-        block_append(current_block, token, JZ, reg_i, '&', JUMP_LABEL_PREFIX, end_block->label);
-        block_append(current_block, token, SUB, reg_i, reg_i, step);
-        block_append(current_block, token, load, reg_temp, reg_src, reg_i);
-        block_append(current_block, token, store, reg_temp, reg_dest, reg_i);
-        block_append(current_block, token, JMP, '&', JUMP_LABEL_PREFIX, loop_block->label);
-
-        current_block = end_block;
-        register_free(token, reg_i);
-    }
-
-    register_free(token, reg_temp);
+    // We check both size and alignment because this is used to copy strings
+    // in initializers among other things.
+    generate_block(token, count * (uint32_t)type_size(type),
+            (uint32_t)type_alignment(type), reg_src, reg_dest);
 }
 
 // Generates a store for a direct value in reg_val into the address in reg_loc
@@ -39,6 +39,8 @@ void generate_return(node_t* node, int reg_out) {
     (void)reg_out;
 
     assert(node->kind == NODE_RETURN);
+    if (node->first_child && generate_tail_call(node->first_child))
+        return;
     if (node->first_child) {
         if (type_is_passed_indirectly(current_function->root->type)) {
             // The pointer to storage for the return value was pushed just
@@ -25,6 +25,7 @@
 #include "lexer.h"
 
 #include <ctype.h>
+#include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
@@ -124,9 +125,13 @@ static int lexer_read_char(void) {
  * Initializes the lexer, opening the given `.i` preprocessed C source file.
  */
 void lexer_init(const char* filename) {
-    lexer_file = fopen(filename, "r");
-    if (lexer_file == NULL) {
-        fatal("Failed to open input file: %s", filename);
+    if (0 == strcmp(filename, "-")) {
+        lexer_file = stdin;
+    } else {
+        lexer_file = fopen(filename, "r");
+        if (lexer_file == NULL) {
+            fatal("Failed to open input file: %s", filename);
+        }
     }
 
     lexer_filename = string_intern_cstr(filename);
@@ -143,16 +148,23 @@ void lexer_init(const char* filename) {
  * Destroys the lexer.
  */
 void lexer_destroy(void) {
-    fclose(lexer_file);
+    if (lexer_file != stdin) {
+        fclose(lexer_file);
+    }
     if (queued_token) {
         token_deref(queued_token);
+        queued_token = NULL;
     }
     if (lexer_token) {
         token_deref(lexer_token);
+        lexer_token = NULL;
     }
     current_filename = NULL;
     string_deref(lexer_filename);
     free(lexer_buffer);
+    lexer_buffer = NULL;
+    lexer_buffer_capacity = 0;
+    lexer_buffer_length = 0;
 }
 
 static void lexer_consume_literal_char(void) {
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "libo-string.h"
+#include "libo-vector.h"
 #include "parse_expr.h"
 #include "parse_decl.h"
 #include "parse_stmt.h"
@@ -40,32 +41,43 @@
 #include "type.h"
 #include "symbol.h"
 
-static const char* input_filename;
-static const char* output_filename;
+// Input and output filenames, paired by index. cci can compile any number of
+// translation units in one run to avoid paying the startup cost of the
+// compiler for each one. Each -o must directly follow its input, except that
+// a single input may have its -o anywhere.
+static vector_t input_filenames;
+static vector_t output_filenames;
 
 static void usage(const char* name) {
-    fprintf(stderr, "\nUsage: %s <input_file> -o <output_file>\n", name);
+    fprintf(stderr, "\nUsage: %s <input_file> -o <output_file> [<input_file> -o <output_file> ...]\n", name);
     _Exit(1);
 }
 
 static void parse_command_line(char** argv) {
     const char* executable_name = *argv++;
+    bool after_input = false;   // the previous argument is an input filename
+    bool loose_output = false;  // an -o that doesn't follow its input
 
     while (*argv) {
 
         // output filename
         if (0 == strcmp("-o", *argv)) {
-            if (output_filename != NULL) {
-                fputs("ERROR: -o cannot be specified twice.\n", stderr);
-                usage(executable_name);
-            }
             if (!*++argv) {
                 fputs("ERROR: -o must be followed by a filename.\n", stderr);
                 usage(executable_name);
             }
-            output_filename = *argv++;
+            if (!after_input) {
+                if (!vector_is_empty(&output_filenames)) {
+                    fputs("ERROR: Each -o must directly follow its input filename.\n", stderr);
+                    usage(executable_name);
+                }
+                loose_output = true;
+            }
+            vector_append(&output_filenames, *argv++);
+            after_input = false;
             continue;
         }
+        after_input = false;
 
         // other options
         if (options_parse(*argv)) {
@@ -73,39 +85,43 @@ static void parse_command_line(char** argv) {
             continue;
         }
 
-        // unrecognized option
-        if (**argv == '-') {
+        // unrecognized option (`-` alone is standard input)
+        if (**argv == '-' && *(*argv + 1) != 0) {
             fprintf(stderr, "ERROR: Unsupported option: %s", *argv);
             usage(executable_name);
         }
 
         // input filename
-        if (input_filename != NULL) {
-            fputs("ERROR: Only one input filename can be provided.", stderr);
-            usage(*argv);
-        }
-        input_filename = *argv++;
+        vector_append(&input_filenames, *argv++);
+        after_input = true;
 
     }
 
-    if (input_filename == NULL) {
+    if (vector_is_empty(&input_filenames)) {
         fputs("ERROR: Input filename not specified.", stderr);
         usage(executable_name);
     }
-    if (output_filename == NULL) {
+    if (vector_is_empty(&output_filenames)) {
         fputs("ERROR: Output filename not specified.", stderr);
         usage(executable_name);
     }
+    if (loose_output && vector_count(&input_filenames) != 1) {
+        fputs("ERROR: Each -o must directly follow its input filename.", stderr);
+        usage(executable_name);
+    }
+    if (vector_count(&input_filenames) != vector_count(&output_filenames)) {
+        fputs("ERROR: Each input filename must have exactly one output filename.", stderr);
+        usage(executable_name);
+    }
 }
 
-int main(int argc, char** argv) {
-    string_table_init();
-    options_init();
-
-    parse_command_line(argv);
-    options_resolve();
-
-    strings_init();
+/**
+ * Compiles a single translation unit.
+ *
+ * Everything specific to a translation unit is created and destroyed here.
+ * Interned strings, options and builtins are shared by all of them.
+ */
+static void compile(const char* input_filename, const char* output_filename) {
     scope_global_init();
     parse_decl_init();
     parse_expr_init();
@@ -114,9 +130,6 @@ int main(int argc, char** argv) {
     lexer_init(input_filename);
     generate_init();
 
-    type_create_builtins();
-    symbol_create_builtins();
-
     while (lexer_token->type != token_type_end) {
         parse_global();
     }
@@ -126,12 +139,35 @@ int main(int argc, char** argv) {
     generate_destroy();
     lexer_destroy();
     emit_destroy();
-    parse_stmt_init();
-    parse_expr_init();
-    parse_decl_init();
+    parse_stmt_destroy();
+    parse_expr_destroy();
+    parse_decl_destroy();
     scope_global_destroy();
+}
+
+int main(int argc, char** argv) {
+    string_table_init();
+    options_init();
+    vector_init(&input_filenames);
+    vector_init(&output_filenames);
+
+    parse_command_line(argv);
+    options_resolve();
+
+    strings_init();
+    scope_builtin_init();
+    type_create_builtins();
+    symbol_create_builtins();
+
+    for (size_t i = 0; i < vector_count(&input_filenames); ++i) {
+        compile(vector_at(&input_filenames, i), vector_at(&output_filenames, i));
+    }
+
+    scope_builtin_destroy();
     strings_destroy();
 
+    vector_destroy(&output_filenames);
+    vector_destroy(&input_filenames);
     options_destroy();
     string_table_destroy();
     return 0;
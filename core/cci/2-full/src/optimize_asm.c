@@ -24,7 +24,420 @@
 
 #include "optimize_asm.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "libo-error.h"
 #include "function.h"
+#include "block.h"
+#include "instruction.h"
+
+/*
+ * Local value numbering
+ *
+ * The code generator computes every expression from scratch, so a statement
+ * like `p[i].x = p[i].y` loads `p` and `i` and scales `i` twice. We walk each
+ * basic block tracking which value every register r0-r9 holds. Each distinct
+ * computation (an opcode applied to the value numbers of its inputs) gets a
+ * value number. If an instruction computes a value that is still held in some
+ * register, we replace it with a `mov` from that register (or delete it if it
+ * is the same register.)
+ *
+ * Loads are values too, but they're only valid until something might write
+ * the memory they read. A store into a local variable slot (a constant offset
+ * from `rfp`) only invalidates loads of overlapping slots and loads through
+ * pointers (which could point to a local.) It also makes the stored value
+ * available to a subsequent load of the same slot. Any other store, push,
+ * call or system call invalidates all loads.
+ *
+ * A volatile access must read memory every time, so in a block containing one
+ * (as marked by the code generator) no load is ever reused and every load
+ * invalidates all others, as though it were a store.
+ *
+ * We start fresh at the top of each block since we don't know how we got
+ * there. (Mid-block conditional jumps are fine; they don't change anything.)
+ */
+
+// Operands are encoded as ints: mix-type immediates are stored as-is (they
+// are in the range -112..127) and value numbers are offset by this.
+#define OPERAND_VALUE 1000
+
+// Value numbers for registers that don't change within a function body.
+#define VALUE_RFP 1
+#define VALUE_RPP 2
+#define VALUE_FIRST 3
+
+typedef struct value_t {
+    opcode_t opcode;
+    int operand1;
+    int operand2;
+
+    // for imw
+    instruction_argtypes_t argtypes;
+    int number;
+    char invocation_type;
+    const char* label;
+
+    // for loads
+    bool is_load;
+    bool is_slot;  // load from a constant offset from rfp
+    int offset;
+    int size;
+
+    int value_number;
+    bool valid;
+} value_t;
+
+static value_t* values;
+static size_t values_count;
+static size_t values_capacity;
+
+// The value number held in each of r0-r9, or 0 if unknown.
+static int registers[10];
+
+static int next_value_number;
+
+// Whether the current block contains a volatile access.
+static bool block_volatile;
+
+static int new_value_number(void) {
+    return next_value_number++;
+}
+
+static void reset_registers(void) {
+    for (int i = 0; i < 10; ++i)
+        registers[i] = new_value_number();
+}
+
+static bool is_tracked(int reg) {
+    return reg >= R0 && reg <= R9;
+}
+
+static bool is_register(int8_t arg) {
+    return (uint8_t)arg >= R0 && (uint8_t)arg <= RIP;
+}
+
+/**
+ * Returns the encoded operand for a mix-type argument.
+ */
+static int operand(int8_t arg) {
+    int reg = (uint8_t)arg;
+    if (is_tracked(reg))
+        return OPERAND_VALUE + registers[reg - R0];
+    if (reg == RFP)
+        return OPERAND_VALUE + VALUE_RFP;
+    if (reg == RPP)
+        return OPERAND_VALUE + VALUE_RPP;
+    if (is_register(arg))
+        // rsp and the scratch registers change on their own so every use is
+        // a different value.
+        return OPERAND_VALUE + new_value_number();
+    return arg;
+}
+
+static int load_size(opcode_t opcode) {
+    return opcode == LDW ? 4 : opcode == LDS ? 2 : 1;
+}
+
+static bool is_commutative(opcode_t opcode) {
+    return opcode == ADD || opcode == MUL || opcode == AND ||
+        opcode == OR || opcode == XOR;
+}
+
+/**
+ * Returns true for opcodes that compute arg1 purely from arg2 and arg3.
+ */
+static bool is_pure_binary(opcode_t opcode) {
+    switch (opcode) {
+        case ADD: case SUB: case MUL: case DIVU: case DIVS: case MODU:
+        case MODS: case AND: case OR: case XOR: case SHL: case SHRU:
+        case SHRS: case ROL: case ROR: case LTU: case LTS:
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+/**
+ * Returns true for opcodes that compute arg1 purely from arg2.
+ */
+static bool is_pure_unary(opcode_t opcode) {
+    switch (opcode) {
+        case SXS: case SXB: case TRS: case TRB: case BOOL: case ISZ:
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+static void invalidate_loads(bool slots) {
+    for (size_t i = 0; i < values_count; ++i) {
+        value_t* value = values + i;
+        if (value->is_load && (slots || !value->is_slot))
+            value->valid = false;
+    }
+}
+
+static void invalidate_slot(int offset, int size) {
+    for (size_t i = 0; i < values_count; ++i) {
+        value_t* value = values + i;
+        if (value->is_slot && value->offset < offset + size &&
+                offset < value->offset + value->size)
+            value->valid = false;
+    }
+}
+
+static bool value_matches(value_t* a, value_t* b) {
+    if (a->opcode != b->opcode || a->operand1 != b->operand1 ||
+            a->operand2 != b->operand2 || a->is_load != b->is_load)
+        return false;
+    if (a->opcode != IMW)
+        return true;
+    if (a->argtypes != b->argtypes || a->number != b->number)
+        return false;
+    if (a->argtypes == ARGTYPE_NUMBER)
+        return true;
+    return a->invocation_type == b->invocation_type &&
+        0 == strcmp(a->label, b->label);
+}
+
+static value_t* value_find(value_t* key) {
+    for (size_t i = 0; i < values_count; ++i) {
+        value_t* value = values + i;
+        if (value->valid && value_matches(value, key))
+            return value;
+    }
+    return NULL;
+}
+
+static value_t* value_add(value_t* key, int value_number) {
+    if (values_count == values_capacity) {
+        values_capacity = values_capacity ? values_capacity * 2 : 32;
+        values = realloc(values, values_capacity * sizeof(value_t));
+        if (!values)
+            fatal("Out of memory.");
+    }
+    value_t* value = values + values_count++;
+    memcpy(value, key, sizeof(value_t));
+    value->value_number = value_number;
+    value->valid = true;
+    return value;
+}
+
+/**
+ * Finds a register (r0-r9) that holds the given value number, or returns -1.
+ * The given register is preferred.
+ */
+static int register_holding(int value_number, int preferred) {
+    if (registers[preferred - R0] == value_number)
+        return preferred;
+    for (int i = 0; i < 10; ++i)
+        if (registers[i] == value_number)
+            return R0 + i;
+    return -1;
+}
+
+/**
+ * Handles an instruction that computes a value into a tracked register. If
+ * the value is already in a register, the instruction is replaced.
+ */
+static void compute(instruction_t* instruction, value_t* key, int dest) {
+    value_t* found = value_find(key);
+    if (found) {
+        int source = register_holding(found->value_number, dest);
+        if (source == dest) {
+            instruction->opcode = NOP;
+            return;
+        }
+        if (source != -1) {
+            instruction_set(instruction, instruction->token, MOV, dest, source);
+            registers[dest - R0] = found->value_number;
+            return;
+        }
+        registers[dest - R0] = found->value_number;
+        return;
+    }
+
+    int value_number = new_value_number();
+    value_add(key, value_number);
+    registers[dest - R0] = value_number;
+}
+
+/**
+ * Handles an instruction that we don't understand in detail, assuming it may
+ * overwrite arg1.
+ */
+static void clobber(int reg) {
+    if (is_tracked(reg))
+        registers[reg - R0] = new_value_number();
+}
+
+static void optimize_instruction(instruction_t* instruction) {
+    opcode_t opcode = instruction->opcode;
+    int dest = (uint8_t)instruction->arg1;
+    value_t key;
+    memset(&key, 0, sizeof(key));
+    key.opcode = opcode;
+
+    switch (opcode) {
+        case NOP:
+        case JZ: case JNZ: case JL: case JG: case JLE: case JGE:
+        case JMP: case RET:
+            return;
+
+        case MOV: {
+            if (!is_tracked(dest)) {
+                clobber(dest);
+                return;
+            }
+            int source = (uint8_t)instruction->arg2;
+            if (source == dest) {
+                instruction->opcode = NOP;
+                return;
+            }
+            if (is_tracked(source)) {
+                registers[dest - R0] = registers[source - R0];
+                return;
+            }
+            // immediates and fixed registers are treated as constants
+            key.operand1 = operand(instruction->arg2);
+            compute(instruction, &key, dest);
+            return;
+        }
+
+        case ZERO:
+            if (!is_tracked(dest))
+                return;
+            key.opcode = MOV;
+            key.operand1 = 0;
+            compute(instruction, &key, dest);
+            return;
+
+        case IMW:
+            if (!is_tracked(dest))
+                return;
+            key.argtypes = instruction->argtypes;
+            if (instruction->argtypes == ARGTYPE_NUMBER) {
+                key.number = instruction->number;
+            } else if (instruction->argtypes == ARGTYPE_NAME) {
+                key.invocation_type = instruction->invocation_type;
+                key.label = instruction->invocation_label;
+            } else {
+                key.invocation_type = instruction->invocation_type;
+                key.label = instruction->invocation_prefix;
+                key.number = instruction->invocation_number;
+            }
+            compute(instruction, &key, dest);
+            return;
+
+        case LDW: case LDS: case LDB:
+            if (block_volatile) {
+                invalidate_loads(true);
+                clobber(dest);
+                return;
+            }
+            if (!is_tracked(dest)) {
+                clobber(dest);
+                return;
+            }
+            key.operand1 = operand(instruction->arg2);
+            key.operand2 = operand(instruction->arg3);
+            key.is_load = true;
+            if (key.operand1 == OPERAND_VALUE + VALUE_RFP && key.operand2 < OPERAND_VALUE) {
+                key.is_slot = true;
+                key.offset = key.operand2;
+                key.size = load_size(opcode);
+            }
+            compute(instruction, &key, dest);
+            return;
+
+        case STW: case STS: case STB: {
+            int base = (uint8_t)instruction->arg2;
+            int offset = instruction->arg3;
+            int size = opcode == STW ? 4 : opcode == STS ? 2 : 1;
+            if (base == RFP && !is_register(instruction->arg3)) {
+                invalidate_loads(false);
+                invalidate_slot(offset, size);
+
+                // forward the stored word to later loads of the same slot
+                int stored = (uint8_t)instruction->arg1;
+                if (opcode == STW && is_tracked(stored)) {
+                    key.opcode = LDW;
+                    key.operand1 = OPERAND_VALUE + VALUE_RFP;
+                    key.operand2 = offset;
+                    key.is_load = true;
+                    key.is_slot = true;
+                    key.offset = offset;
+                    key.size = 4;
+                    value_add(&key, registers[stored - R0]);
+                }
+            } else {
+                invalidate_loads(true);
+            }
+            return;
+        }
+
+        case PUSH:
+            invalidate_loads(true);
+            return;
+
+        case POP:
+            clobber(dest);
+            return;
+
+        case CALL:
+        case SYS:
+        case ENTER:
+        case LEAVE:
+            invalidate_loads(true);
+            reset_registers();
+            return;
+
+        default:
+            break;
+    }
+
+    if (is_pure_binary(opcode) && is_tracked(dest)) {
+        key.operand1 = operand(instruction->arg2);
+        key.operand2 = operand(instruction->arg3);
+        if (is_commutative(opcode) && key.operand1 > key.operand2) {
+            int temp = key.operand1;
+            key.operand1 = key.operand2;
+            key.operand2 = temp;
+        }
+        compute(instruction, &key, dest);
+        return;
+    }
+
+    if (is_pure_unary(opcode) && is_tracked(dest)) {
+        key.operand1 = operand(instruction->arg2);
+        compute(instruction, &key, dest);
+        return;
+    }
+
+    // Everything else (inc, dec, not, and writes to rsp) just overwrites its
+    // first argument as far as we're concerned.
+    clobber(dest);
+}
+
+static void optimize_block(block_t* block) {
+    values_count = 0;
+    next_value_number = VALUE_FIRST;
+    block_volatile = block->has_volatile;
+    reset_registers();
+    for (size_t i = 0; i < block_count(block); ++i)
+        optimize_instruction(block_at(block, i));
+}
 
 void optimize_asm(function_t* function) {
+    size_t count = vector_count(&function->blocks);
+    for (size_t i = 0; i < count; ++i)
+        optimize_block(vector_at(&function->blocks, i));
+
+    free(values);
+    values = NULL;
+    values_count = 0;
+    values_capacity = 0;
 }
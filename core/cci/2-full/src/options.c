@@ -394,18 +394,96 @@ typedef enum flag_spec_t {
     flag_spec_off,       // specified with -fno-...
 } flag_spec_t;
 
+/*
+ * The specification of all flags, indexed by `flag_t`.
+ */
+static flag_spec_t* flag_specs;
+
+/*
+ * The resolved value of all flags, indexed by `flag_t`.
+ */
+static bool* flag_values;
+
+/*
+ * The argument string of all flags (not including `-f` or `-fno-`.)
+ *
+ * There are few enough flags that we just search this linearly.
+ */
+static const char** flag_args;
+
 static void flags_init(void) {
-    // TODO
+    flag_args = calloc(flag_count, sizeof(const char*));
+    flag_specs = calloc(flag_count, sizeof(flag_spec_t));
+    flag_values = calloc(flag_count, sizeof(bool));
+
+    flag_args[flag_gnu_extensions] = "gnu-extensions";
+    flag_args[flag_ms_extensions] = "ms-extensions";
+    flag_args[flag_plan9_extensions] = "plan9-extensions";
+    flag_args[flag_optimize_sibling_calls] = "optimize-sibling-calls";
 }
 
 static void flags_destroy(void) {
+    free(flag_args);
+    free(flag_specs);
+    free(flag_values);
 }
 
 static bool flag_parse(const char* arg) {
-    // TODO
+    if (!starts_with(arg, "-f"))
+        return false;
+
+    flag_spec_t spec;
+    if (starts_with(arg, "-fno-")) {
+        spec = flag_spec_off;
+        arg += strlen("-fno-");
+    } else {
+        spec = flag_spec_on;
+        arg += strlen("-f");
+    }
+
+    for (int flag = 0; flag < flag_count; ++flag) {
+        if (0 == strcmp(arg, flag_args[flag])) {
+            flag_specs[flag] = spec;
+            return true;
+        }
+    }
+
+    // cc accepts any `-f` flag and passes it along to us. Most of them (e.g.
+    // -fPIC, -fno-builtin) don't mean anything to us so we ignore them.
+    return true;
+}
+
+/*
+ * Returns the default value of a flag that wasn't specified on the
+ * command-line.
+ */
+static bool flag_default(flag_t flag) {
+    switch (flag) {
+        case flag_optimize_sibling_calls:
+            // Sibling calls remove frames from the call stack so they make
+            // debugging harder. They're only on by default with -O and
+            // without -g.
+            return optimization && !option_debug_info;
+        default:
+            break;
+    }
     return false;
 }
 
+static void flags_resolve(void) {
+    for (int flag = 0; flag < flag_count; ++flag) {
+        switch (flag_specs[flag]) {
+            case flag_spec_on: flag_values[flag] = true; break;
+            case flag_spec_off: flag_values[flag] = false; break;
+            default: flag_values[flag] = flag_default(flag); break;
+        }
+    }
+}
+
+bool flag_enabled(flag_t flag) {
+    return flag_values[flag];
+}
+
 
 
 /****************************************
@@ -510,4 +588,5 @@ bool options_parse(const char* arg) {
 
 void options_resolve(void) {
     warnings_resolve();
+    flags_resolve();
 }
@@ -79,9 +79,20 @@ typedef enum flag_t {
     flag_ms_extensions,      // -fms-extensions
     flag_plan9_extensions,   // -fplan9-extensions
 
+    // optimizations
+    flag_optimize_sibling_calls,  // -foptimize-sibling-calls: tail calls become jumps
+
     flag_count,
 } flag_t;
 
+/**
+ * Returns true if the given flag is enabled, either explicitly on the
+ * command-line or by default.
+ *
+ * This is only valid after options_resolve().
+ */
+bool flag_enabled(flag_t flag);
+
 /**
  * All other options (except `-o` and the mode options) are indexed by this enum.
  */
@@ -47,6 +47,7 @@ static int next_string;
 static node_t* parse_unary_expression(void);
 
 void parse_expr_init(void) {
+    next_string = 0;
 }
 
 void parse_expr_destroy(void) {
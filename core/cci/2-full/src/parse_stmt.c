@@ -45,6 +45,10 @@ static node_t* switch_list;         // the previous case/default in a `switch`,
 static void parse_statement(node_t* parent, bool cast_to_void);
 
 void parse_stmt_init(void) {
+    break_container = NULL;
+    continue_container = NULL;
+    switch_container = NULL;
+    switch_list = NULL;
 }
 
 void parse_stmt_destroy(void) {
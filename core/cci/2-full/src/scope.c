@@ -34,6 +34,7 @@
 #include "token.h"
 #include "generate.h"
 
+scope_t* scope_builtin;
 scope_t* scope_global;
 scope_t* scope_current;
 
@@ -109,15 +110,29 @@ void scope_deref(scope_t* scope) {
     free(scope);
 }
 
+void scope_builtin_init(void) {
+    assert(scope_builtin == NULL);
+    scope_builtin = scope_new(NULL);
+}
+
+void scope_builtin_destroy(void) {
+    assert(scope_global == NULL);
+    assert(scope_builtin->refcount == 1);
+    scope_deref(scope_builtin);
+    scope_builtin = NULL;
+}
+
 void scope_global_init(void) {
+    assert(scope_builtin != NULL);
     assert(scope_global == NULL);
-    scope_global = (scope_current = scope_new(NULL));
+    scope_global = (scope_current = scope_new(scope_builtin));
 }
 
 void scope_global_destroy(void) {
     assert(scope_global == scope_current);
     assert(scope_global->refcount == 1);
     scope_deref(scope_global);
+    scope_global = (scope_current = NULL);
 }
 
 void scope_push(void) {
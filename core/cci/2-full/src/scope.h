@@ -48,11 +48,24 @@ typedef struct scope_t {
     vector_t records;
 } scope_t;
 
+/**
+ * The builtin scope contains compiler builtins (e.g. `__builtin_va_list`.) It
+ * is the parent of the global scope and it persists across all translation
+ * units compiled in a single run.
+ */
+void scope_builtin_init(void);
+void scope_builtin_destroy(void);
+
+/**
+ * The global scope contains the file scope declarations of the current
+ * translation unit.
+ */
 void scope_global_init(void);
 void scope_global_destroy(void);
 
 void scope_deref(scope_t* scope);
 
+extern scope_t* scope_builtin;
 extern scope_t* scope_global;
 extern scope_t* scope_current;
 void scope_push(void);
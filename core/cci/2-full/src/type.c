@@ -783,7 +783,7 @@ bool type_is_flexible_array(type_t* type) {
 static void type_add_builtin(const char* cname, base_t base) {
     type_t* type = type_new_base(base);
     token_t* token = token_new_builtin(cname);
-    scope_add_type(scope_global, NAMESPACE_TYPEDEF, token, type);
+    scope_add_type(scope_builtin, NAMESPACE_TYPEDEF, token, type);
     token_deref(token);
     type_deref(type);
 }
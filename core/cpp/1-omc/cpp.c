@@ -143,18 +143,61 @@ static char current_char;
 /* The next character after current_char, which has not yet been scanned. */
 static char next_scan_char;
 
+/* The input buffer of the current file. We read large chunks of the file at a
+ * time; input_pos is the next unread character and input_end is the end of
+ * the data read. Each file has its own buffer, which is stored on the call
+ * stack along with the file when an #include is parsed. */
+static char* input_buffer;
+static char* input_pos;
+static char* input_end;
+static int input_buffer_size;
+
 const char* input_filename;
 const char* output_filename;
 const char* force_include_filename;
+const char* save_snapshot_filename;
+const char* include_snapshot_filename;
 static FILE* output_file;
 
+/* The output is accumulated in a buffer and written in large chunks. */
+static char* output_buffer;
+static char* output_pos;
+static char* output_end;
+
+/* Whether we are recording the `-include` file for a snapshot. While
+ * recording, all output is kept in the output buffer, the path of every
+ * file read is added to snapshot_files and the path of every include file
+ * searched for and not found is added to snapshot_missing. */
+static bool snapshot_recording;
+static void** snapshot_files;
+static void** snapshot_missing;
+
 /* Depth of true conditionals */
 static int depth;
 
+/* Include guard detection for the current file. The state is:
+ *     0: nothing but whitespace seen yet
+ *     1: seen `#ifndef guard_macro` as the first directive
+ *     2: seen `#define guard_macro` right after it; inside the guard
+ *     3: seen the #endif that closes the guard
+ *    -1: the file is not wrapped in a canonical include guard
+ * guard_once is set if the file contains `#pragma once`. */
+static int guard_state;
+static char* guard_macro;
+static bool guard_once;
+
 // options
 static bool opt_nostddef;
 static bool opt_dump_macros;
 
+// dependency options
+static bool opt_deps;              // -M, -MM, -MD or -MMD
+static bool opt_deps_only;         // -M or -MM: no preprocessed output
+static bool opt_deps_user_only;    // -MM or -MMD: omit system headers
+static bool opt_deps_phony;        // -MP
+static const char* deps_filename;  // -MF
+static const char* deps_target;    // -MT
+
 
 
 /*
@@ -162,6 +205,7 @@ static bool opt_dump_macros;
  */
 
 static void preprocess(const char* new_filename, FILE* new_file);
+static int find_slash(const char* str);
 
 
 
@@ -169,20 +213,76 @@ static void preprocess(const char* new_filename, FILE* new_file);
  * File and error handling helpers
  */
 
-static void write_number(FILE* file, int number) {
-    fputd(number, file);
+/**
+ * Doubles the size of the output buffer, keeping its contents.
+ */
+static void grow_output_buffer(void) {
+    int size;
+    int used;
+    size = (output_end - output_buffer);
+    used = (output_pos - output_buffer);
+    char* buffer;
+    buffer = malloc(size * 2);
+    if (buffer == 0) {
+        fatal("Out of memory.");
+    }
+    memcpy(buffer, output_buffer, used);
+    free(output_buffer);
+    output_buffer = buffer;
+    output_pos = (buffer + used);
+    output_end = (buffer + (size * 2));
+}
+
+static void flush_output(void) {
+    // While recording a snapshot, the output stays in memory so that it can
+    // be saved.
+    if (snapshot_recording) {
+        grow_output_buffer();
+        return;
+    }
+
+    // With -M or -MM, the preprocessed output is discarded.
+    if (opt_deps_only) {
+        output_pos = output_buffer;
+        return;
+    }
+
+    size_t count;
+    count = (output_pos - output_buffer);
+    // The first stage libc doesn't return a useful count from fwrite() so we
+    // don't check it.
+    fwrite(output_buffer, 1, count, output_file);
+    output_pos = output_buffer;
 }
 
 static void emit_char(char c) {
-    fputc(c, output_file);
+    if (output_pos == output_end) {
+        flush_output();
+    }
+    *output_pos = c;
+    output_pos = (output_pos + 1);
+}
+
+static void emit_string(const char* s) {
+    while (*s != 0) {
+        emit_char(*s);
+        s = (s + 1);
+    }
+}
+
+static void emit_number(int number) {
+    if (number >= 10) {
+        emit_number(number / 10);
+    }
+    emit_char('0' + (number - ((number / 10) * 10)));
 }
 
 static void emit_line_directive(void) {
-    fputs("#line ", output_file);
-    write_number(output_file, current_line);
+    emit_string("#line ");
+    emit_number(current_line);
     emit_char(' ');
     emit_char('"');
-    fputs(current_filename, output_file);
+    emit_string(current_filename);
     emit_char('"');
     emit_char('\n');
 }
@@ -205,6 +305,21 @@ static void emit_line_directive(void) {
  * This is equivalent to the first two phases of translation.
  */
 
+/**
+ * Reads the next chunk of the current file into its input buffer.
+ */
+static void fill_input_buffer(void) {
+    size_t count;
+    count = fread(input_buffer, 1, input_buffer_size, current_file);
+    if (count == 0) {
+        if (!feof(current_file)) {
+            fatal("Failed to read input file.");
+        }
+    }
+    input_pos = input_buffer;
+    input_end = (input_buffer + count);
+}
+
 /**
  * Reads a single character from the current file.
  *
@@ -212,13 +327,15 @@ static void emit_line_directive(void) {
  * bytes.)
  */
 static char read_char(void) {
-    char c;
-    if (1 != fread(&c, 1, 1, current_file)) {
-        if (!feof(current_file)) {
-            fatal("Failed to read input file.");
+    if (input_pos == input_end) {
+        fill_input_buffer();
+        if (input_pos == input_end) {
+            return 0;
         }
-        return 0;
     }
+    char c;
+    c = *input_pos;
+    input_pos = (input_pos + 1);
     if (c == 0) {
         fatal("Input file cannot contain a null byte.");
     }
@@ -522,7 +639,7 @@ static void consume_expansion(void) {
 
 
 /*
- * We store macros in a linked list.
+ * We store macros in a hashtable.
  *
  * We'd like our macro struct to look something like this:
  *
@@ -531,12 +648,19 @@ static void consume_expansion(void) {
  *         const char* name;
  *         const char* expansion;
  *         bool in_use;
+ *         struct macro_t* next_in_bucket;
+ *         int hash;
  *      };
  *
- * Since we don't have structs, we'll just make it an array of four void
+ * Since we don't have structs, we'll just make it an array of six void
  * pointers.
  *
- * We insert new macros at the front of the linked list, that way if a macro is
+ * Each macro is in a linked list of all macros and in the linked list of its
+ * bucket in the hashtable. The hashtable is an array of pointers to the first
+ * macro of each bucket. We don't have `%` so the number of buckets is a power
+ * of two; we double it when there are more macros than buckets.
+ *
+ * We insert new macros at the front of both lists, that way if a macro is
  * redefined, we find the latest definition first. We don't bother to free()
  * replaced macros and #undef is not supported.
  */
@@ -545,28 +669,107 @@ int MACRO_NEXT;
 int MACRO_NAME;
 int MACRO_EXPANSION;
 int MACRO_IN_USE;
+int MACRO_NEXT_IN_BUCKET;
+int MACRO_HASH;
+
+// The linked list of all macros.
+static void** macros;
+static int macros_count;
+
+// The hashtable of macros.
+static void** macro_buckets;
+static int macro_buckets_count;
+
+static void** buckets_new(int count) {
+    void** buckets = (void**)malloc(sizeof(void*) * count);
+    if (buckets == 0) {
+        fatal("Out of memory.");
+    }
+    int i = 0;
+    while (i < count) {
+        *(buckets + i) = 0;
+        i = (i + 1);
+    }
+    return buckets;
+}
 
 static void macros_init(void) {
     MACRO_NEXT = 0;
     MACRO_NAME = 1;
     MACRO_EXPANSION = 2;
     MACRO_IN_USE = 3;
+    MACRO_NEXT_IN_BUCKET = 4;
+    MACRO_HASH = 5;
+
+    macro_buckets_count = 256;
+    macro_buckets = buckets_new(macro_buckets_count);
 }
 
-// The linked list of macros.
-static void** macros;
+/**
+ * Hashes a macro name or include path. The hash is kept to 24 bits so that it can't overflow
+ * an int.
+ */
+static int hash_string(const char* name) {
+    int hash = 0;
+    while (*name != 0) {
+        hash = (((hash * 31) + *name) & 0xFFFFFF);
+        name = (name + 1);
+    }
+    return hash;
+}
+
+static void*** macro_bucket(int hash) {
+    return (void***)(macro_buckets + (hash & (macro_buckets_count - 1)));
+}
+
+/**
+ * Doubles the number of buckets.
+ *
+ * We walk the list of all macros from newest to oldest, appending each one to
+ * the end of its new bucket so that the newest definition of a name stays
+ * first.
+ */
+static void macro_buckets_grow(void) {
+    free(macro_buckets);
+    macro_buckets_count = (macro_buckets_count * 2);
+    macro_buckets = buckets_new(macro_buckets_count);
+
+    void** macro = macros;
+    while (macro != 0) {
+        *(macro + MACRO_NEXT_IN_BUCKET) = 0;
+        void*** link = macro_bucket((int)(intptr_t)*(macro + MACRO_HASH));
+        while (*link != 0) {
+            link = (void***)(*link + MACRO_NEXT_IN_BUCKET);
+        }
+        *link = macro;
+        macro = (void**)*(macro + MACRO_NEXT);
+    }
+}
 
 static void macro_new(char* name, char* expansion) {
     if ((name == 0) | (expansion == 0)) {
         fatal("Out of memory.");
     }
     //printf("define macro %s %s\n", name, expansion);
-    void** macro = (void**)malloc(sizeof(void*) * 4);
+    int hash = hash_string(name);
+    void*** bucket = macro_bucket(hash);
+    void** macro = (void**)malloc(sizeof(void*) * 6);
+    if (macro == 0) {
+        fatal("Out of memory.");
+    }
     *(macro + MACRO_NEXT) = (void*)macros;
     *(macro + MACRO_NAME) = (void*)name;
     *(macro + MACRO_EXPANSION) = (void*)expansion;
     *(macro + MACRO_IN_USE) = 0;
+    *(macro + MACRO_NEXT_IN_BUCKET) = (void*)*bucket;
+    *(macro + MACRO_HASH) = (void*)(intptr_t)hash;
     macros = macro;
+    *bucket = macro;
+
+    macros_count = (macros_count + 1);
+    if (macros_count > macro_buckets_count) {
+        macro_buckets_grow();
+    }
 }
 
 static void macro_delete(void** macro) {
@@ -576,20 +779,77 @@ static void macro_delete(void** macro) {
 }
 
 static void** macro_find(const char* name) {
-    void** macro = macros;
+    int hash = hash_string(name);
+    void** macro = *macro_bucket(hash);
     while (macro != 0) {
-        char* other_name;
-        other_name = (char*)*(macro + MACRO_NAME);
-        if (0 == strcmp(name, other_name)) {
-            return macro;
+        if ((int)(intptr_t)*(macro + MACRO_HASH) == hash) {
+            char* other_name;
+            other_name = (char*)*(macro + MACRO_NAME);
+            if (0 == strcmp(name, other_name)) {
+                return macro;
+            }
         }
-        macro = (void**)*(macro + MACRO_NEXT);
+        macro = (void**)*(macro + MACRO_NEXT_IN_BUCKET);
     }
     return 0;
 }
 
 
 
+/*
+ * Guarded files are stored in a linked list.
+ *
+ * When a file is wrapped in a canonical include guard or contains `#pragma
+ * once`, we remember its path. Later includes of the same path are skipped
+ * without opening the file, as long as the guard macro is still defined (or
+ * always for `#pragma once`.)
+ *
+ * The struct for a guarded file would look something like this:
+ *
+ *     struct guarded_file_t {
+ *         struct guarded_file_t* next;
+ *         char* path;
+ *         char* macro;  // null for `#pragma once`
+ *     };
+ */
+
+static void** guarded_files;
+
+static void guarded_file_new(const char* path, char* macro) {
+    void** entry;
+    entry = (void**)malloc(sizeof(void*) * 3);
+    if (entry == 0) {
+        fatal("Out of memory.");
+    }
+    *entry = (void*)guarded_files;
+    *(entry + 1) = (void*)strdup(path);
+    *(entry + 2) = (void*)macro;
+    guarded_files = entry;
+}
+
+/**
+ * Returns true if the file at the given path has already been included and
+ * its guard means it would expand to nothing.
+ */
+static bool is_guarded(const char* path) {
+    void** entry;
+    entry = guarded_files;
+    while (entry != 0) {
+        if (0 == strcmp(path, (const char*)*(entry + 1))) {
+            const char* macro;
+            macro = (const char*)*(entry + 2);
+            if (macro == 0) {
+                return true;
+            }
+            return macro_find(macro) != 0;
+        }
+        entry = (void**)*entry;
+    }
+    return false;
+}
+
+
+
 /*
  * Include paths are also stored in a linked list.
  *
@@ -598,9 +858,10 @@ static void** macro_find(const char* name) {
  *     struct include_path_t {
  *         struct include_path_t* next;
  *         const char* path;
+ *         bool system;  // added with -isystem
  *     };
  *
- * Like macros, we use an array of two void pointers. Unlike macros, we append
+ * Like macros, we use an array of void pointers. Unlike macros, we append
  * paths at the end so that priority is in the order specified on the
  * command-line.
  */
@@ -608,15 +869,16 @@ static void** macro_find(const char* name) {
 static void** include_paths;
 static void** last_include_path;
 
-static void include_path_new(const char* path) {
+static void include_path_new(const char* path, bool system) {
     if (strlen(path) == 0) {
         fatal("Empty include path.");
     }
 
     void** entry;
-    entry = (void**)malloc(sizeof(void*) * 2);
+    entry = (void**)malloc(sizeof(void*) * 3);
     *entry = 0;
     *(entry + 1) = (void*)path;
+    *(entry + 2) = (void*)(intptr_t)system;
 
     /* The first one goes at the head of the list */
     if (last_include_path == 0) {
@@ -632,6 +894,262 @@ static void include_path_new(const char* path) {
 
 
 
+/*
+ * The include cache is a hashtable from strings to values.
+ *
+ * Searching for an include file means trying to open it under each include
+ * path in order until one succeeds. Each failed fopen() is a syscall (and a
+ * VM syscall when running in the VM), and the same few headers are included
+ * over and over by other headers, so we cache two things:
+ *
+ * - include_files maps a full path (an include path or the directory of an
+ *   including file joined with the included name) to whether or not a file
+ *   exists there. Misses are cached per path: each directory that doesn't
+ *   contain a given header is probed only once.
+ * - include_names maps the name in an #include to the entry of the include
+ *   path under which it was found. Only names that were found are recorded;
+ *   a name that isn't found anywhere is a fatal error.
+ *
+ * A quoted #include first checks the directory of the including file, which
+ * hits include_files, and then falls back to include_names.
+ *
+ * The struct for a cache entry would look something like this:
+ *
+ *     struct include_cache_entry_t {
+ *         struct include_cache_entry_t* next;
+ *         char* key;
+ *         void* value;
+ *     };
+ *
+ * The number of buckets is fixed; there aren't many include files.
+ */
+
+static int include_cache_buckets_count;
+static void** include_files;
+static void** include_names;
+
+static void include_cache_init(void) {
+    include_cache_buckets_count = 1024;
+    include_files = buckets_new(include_cache_buckets_count);
+    include_names = buckets_new(include_cache_buckets_count);
+}
+
+static void*** include_cache_bucket(void** buckets, const char* key) {
+    return (void***)(buckets + (hash_string(key) & (include_cache_buckets_count - 1)));
+}
+
+/**
+ * Returns the entry for the given key or null if it's not in the cache.
+ */
+static void** include_cache_find(void** buckets, const char* key) {
+    void** entry = *include_cache_bucket(buckets, key);
+    while (entry != 0) {
+        if (0 == strcmp(key, (const char*)*(entry + 1))) {
+            return entry;
+        }
+        entry = (void**)*entry;
+    }
+    return 0;
+}
+
+static void include_cache_add(void** buckets, const char* key, void* value) {
+    void*** bucket = include_cache_bucket(buckets, key);
+    void** entry = (void**)malloc(sizeof(void*) * 3);
+    char* key_copy = strdup(key);
+    if ((entry == 0) | (key_copy == 0)) {
+        fatal("Out of memory.");
+    }
+    *entry = (void*)*bucket;
+    *(entry + 1) = (void*)key_copy;
+    *(entry + 2) = value;
+    *bucket = entry;
+}
+
+static void include_cache_delete(void** buckets) {
+    int i = 0;
+    while (i < include_cache_buckets_count) {
+        void** entry = (void**)*(buckets + i);
+        while (entry != 0) {
+            void** next = (void**)*entry;
+            free(*(entry + 1));
+            free(entry);
+            entry = next;
+        }
+        i = (i + 1);
+    }
+    free(buckets);
+}
+
+
+
+/*
+ * Dependencies are stored in a linked list in the order they were first
+ * opened, starting with the input file.
+ *
+ * With -MM or -MMD, system headers (those found in an -isystem include path,
+ * and everything they include) are left out.
+ *
+ * The struct for a dependency would look something like this:
+ *
+ *     struct dependency_t {
+ *         struct dependency_t* next;
+ *         char* path;
+ *     };
+ */
+
+static void** dependencies;
+static void** last_dependency;
+
+// Whether the include path being tried for an include is a system path
+static bool include_is_system;
+
+// Whether the current file is a system header or is included by one
+static bool in_system_header;
+
+static void dependency_add(const char* path) {
+    void** entry;
+    entry = dependencies;
+    while (entry != 0) {
+        if (0 == strcmp(path, (const char*)*(entry + 1))) {
+            return;
+        }
+        entry = (void**)*entry;
+    }
+
+    entry = (void**)malloc(sizeof(void*) * 2);
+    if (entry == 0) {
+        fatal("Out of memory.");
+    }
+    *entry = 0;
+    *(entry + 1) = (void*)strdup(path);
+    if (last_dependency == 0) {
+        dependencies = entry;
+    }
+    if (last_dependency != 0) {
+        *last_dependency = entry;
+    }
+    last_dependency = entry;
+}
+
+/**
+ * Returns a new string of the given filename with the extension of its
+ * basename replaced by the given extension (or appended if it has none.)
+ */
+static char* replace_extension(const char* filename, const char* extension) {
+    int end;
+    end = strlen(filename);
+    int i;
+    i = (find_slash(filename) + 1);
+    while (*(filename + i) != 0) {
+        if (*(filename + i) == '.') {
+            end = i;
+        }
+        i = (i + 1);
+    }
+
+    char* ret;
+    ret = malloc((end + strlen(extension)) + 1);
+    if (ret == 0) {
+        fatal("Out of memory.");
+    }
+    memcpy(ret, filename, end);
+    strcpy(ret + end, extension);
+    return ret;
+}
+
+/**
+ * Writes a path to a Make rule, escaping spaces and dollar signs.
+ */
+static void write_dependency_path(FILE* file, const char* path) {
+    while (*path != 0) {
+        if (*path == ' ') {
+            fputc('\\', file);
+        }
+        if (*path == '$') {
+            fputc('$', file);
+        }
+        fputc(*path, file);
+        path = (path + 1);
+    }
+}
+
+/**
+ * Writes a Make rule for the dependencies of the input file.
+ */
+static void write_dependencies(FILE* file) {
+
+    // The default target is the basename of the input file with a .o
+    // extension.
+    if (deps_target != 0) {
+        fputs(deps_target, file);
+    }
+    if (deps_target == 0) {
+        char* target;
+        target = replace_extension(input_filename + (find_slash(input_filename) + 1), ".o");
+        write_dependency_path(file, target);
+        free(target);
+    }
+    fputc(':', file);
+
+    void** entry;
+    entry = dependencies;
+    while (entry != 0) {
+        if (entry != dependencies) {
+            fputs(" \\\n ", file);
+        }
+        fputc(' ', file);
+        write_dependency_path(file, (const char*)*(entry + 1));
+        entry = (void**)*entry;
+    }
+    fputc('\n', file);
+
+    // With -MP, each header gets an empty phony rule so that Make doesn't
+    // fail if it's deleted.
+    if (opt_deps_phony) {
+        entry = (void**)*dependencies;
+        while (entry != 0) {
+            fputc('\n', file);
+            write_dependency_path(file, (const char*)*(entry + 1));
+            fputs(":\n", file);
+            entry = (void**)*entry;
+        }
+    }
+}
+
+static void do_write_dependencies(void) {
+    if (!opt_deps) {
+        return;
+    }
+
+    // With -M or -MM, the dependencies replace the preprocessed output unless
+    // -MF is given.
+    if (opt_deps_only & (deps_filename == 0)) {
+        write_dependencies(output_file);
+        return;
+    }
+
+    // With -MD or -MMD, the default is the output file with a .d extension.
+    char* filename = 0;
+    if (deps_filename == 0) {
+        filename = replace_extension(output_filename, ".d");
+    }
+    FILE* file;
+    if (deps_filename != 0) {
+        file = fopen(deps_filename, "w");
+    }
+    if (deps_filename == 0) {
+        file = fopen(filename, "w");
+    }
+    if (file == 0) {
+        fatal("Failed to open dependency file.");
+    }
+    write_dependencies(file);
+    fclose(file);
+    free(filename);
+}
+
+
+
 /*
  * Include path searching
  */
@@ -668,17 +1186,65 @@ static bool try_include(const char* prefix) {
     path_length = (path_length + suffix_length);
     *(path + path_length) = 0;
 
+    // If we've already included this file and it's guarded, there's nothing
+    // to do. We don't even need to open it.
+    if (is_guarded(path)) {
+        free(path);
+        return true;
+    }
+
+    // If we've already looked for this file and it doesn't exist, we don't
+    // need to try again.
+    void** cached;
+    cached = include_cache_find(include_files, path);
+    if (cached != 0) {
+        if (*(cached + 2) == 0) {
+            free(path);
+            return false;
+        }
+    }
+
     // Try to open the file
     FILE* file;
     file = fopen(path, "r");
+    if (cached == 0) {
+        include_cache_add(include_files, path, (void*)(intptr_t)(file != 0));
+    }
     if (file == 0) {
+        // A snapshot is stale if this file appears later since it would
+        // shadow whatever we find in a later include path.
+        if (snapshot_recording) {
+            void** entry;
+            entry = (void**)malloc(sizeof(void*) * 2);
+            if (entry == 0) {
+                fatal("Out of memory.");
+            }
+            *entry = (void*)snapshot_missing;
+            *(entry + 1) = (void*)path;
+            snapshot_missing = entry;
+            return false;
+        }
         free(path);
         return false;
     }
 
-    fputs("#pragma onramp file push\n", output_file);
+    // Record the dependency, unless it's a system header and we're
+    // omitting them.
+    bool system;
+    system = (in_system_header | include_is_system);
+    if (opt_deps) {
+        if (!(opt_deps_user_only & system)) {
+            dependency_add(path);
+        }
+    }
+
+    emit_string("#pragma onramp file push\n");
+    bool old_in_system_header;
+    old_in_system_header = in_system_header;
+    in_system_header = system;
     preprocess(path, file);
-    fputs("#pragma onramp file pop\n", output_file);
+    in_system_header = old_in_system_header;
+    emit_string("#pragma onramp file pop\n");
 
     // Emit a line directive for the parent file to get us back where we were.
     // (The parent file is NULL if we're processing `-include`.)
@@ -721,15 +1287,24 @@ static int find_slash(const char* str) {
 
 static void search_include(char quote_style) {
     //printf("search include %s\n", current_string);
+    include_is_system = in_system_header;
 
     // The path is in current_string. If it starts with /, it's an absolute
     // path so we just open that file directly.
     if (*current_string == '/') {
+        if (is_guarded(current_string)) {
+            return;
+        }
         FILE* file;
         file = fopen(current_string, "r");
         if (file == 0) {
             fatal("Failed to open include file with absolute path.");
         }
+        if (opt_deps) {
+            if (!(opt_deps_user_only & (in_system_header | include_is_system))) {
+                dependency_add(current_string);
+            }
+        }
         preprocess(current_string, file);
         return;
     }
@@ -760,17 +1335,37 @@ static void search_include(char quote_style) {
         }
     }
 
-    // Search through our include paths.
+    // If we've found this file in our include paths before, go straight to
+    // the include path where we found it.
     void** entry;
+    void** cached;
+    cached = include_cache_find(include_names, current_string);
+    if (cached != 0) {
+        entry = (void**)*(cached + 2);
+        include_is_system = (bool)(intptr_t)*(entry + 2);
+        if (!try_include((const char*)*(entry + 1))) {
+            fatal("Include file has disappeared.");
+        }
+        return;
+    }
+
+    // Search through our include paths. The name in current_string is
+    // clobbered by try_include() so we need a copy of it for the cache.
+    char* name;
+    name = strdup(current_string);
     entry = include_paths;
     while (entry != 0) {
         //printf("entry %s\n", (const char*)*(entry + 1));
+        include_is_system = (bool)(intptr_t)*(entry + 2);
         if (try_include((const char*)*(entry + 1))) {
+            include_cache_add(include_names, name, (void*)entry);
+            free(name);
             return;
         }
         entry = (void**)*entry;
     }
 
+    free(name);
     fatal("include file not found.");
 }
 
@@ -858,6 +1453,16 @@ static void handle_define(void) {
     macro_new(name, expansion);
 }
 
+static void handle_pragma(void) {
+    consume_horizontal_whitespace();
+    consume_identifier();
+    if (0 != strcmp(current_string, "once")) {
+        fatal("Only `#pragma once` is supported by the omC preprocessor.");
+    }
+    consume_end_of_line();
+    guard_once = true;
+}
+
 static void handle_conditional(int predicate) {
     if (predicate) {
         /* The #ifdef/#ifndef is true. Keep parsing. */
@@ -1036,22 +1641,53 @@ static void preprocess(const char* new_filename, FILE* new_file) {
     char* old_filename;
     int old_line;
     int old_depth;
+    int old_guard_state;
+    char* old_guard_macro;
+    bool old_guard_once;
     char old_current_char;
     char old_next_scan_char;
+    char* old_input_buffer;
+    char* old_input_pos;
+    char* old_input_end;
     old_file = current_file;
     old_filename = current_filename;
     old_line = current_line;
     old_depth = depth;
+    old_guard_state = guard_state;
+    old_guard_macro = guard_macro;
+    old_guard_once = guard_once;
     old_current_char = current_char;
     old_next_scan_char = next_scan_char;
+    old_input_buffer = input_buffer;
+    old_input_pos = input_pos;
+    old_input_end = input_end;
 
     // setup the new file
     depth = 0;
+    guard_state = 0;
+    guard_macro = 0;
+    guard_once = false;
     current_filename = strdup(new_filename);
     current_file = new_file;
     current_line = 1;
     current_char = 0;
     next_scan_char = 0;
+    input_buffer = malloc(input_buffer_size);
+    if (input_buffer == 0) {
+        fatal("Out of memory.");
+    }
+    input_pos = input_buffer;
+    input_end = input_buffer;
+    if (snapshot_recording) {
+        void** entry;
+        entry = (void**)malloc(sizeof(void*) * 2);
+        if (entry == 0) {
+            fatal("Out of memory.");
+        }
+        *entry = (void*)snapshot_files;
+        *(entry + 1) = (void*)strdup(new_filename);
+        snapshot_files = entry;
+    }
     emit_line_directive();
     next_char();
     next_char();
@@ -1071,6 +1707,17 @@ static void preprocess(const char* new_filename, FILE* new_file) {
             }
 
             consume_identifier();
+
+            /* Outside of the include guard, the only directives allowed are
+             * the #ifndef and #define that open it. */
+            if (guard_state != 2) {
+                if (!((guard_state == 0) & (0 == strcmp(current_string, "ifndef")))) {
+                    if (!((guard_state == 1) & (0 == strcmp(current_string, "define")))) {
+                        guard_state = -1;
+                    }
+                }
+            }
+
             if (0 == strcmp(current_string, "line")) {
                 handle_line();
                 continue;
@@ -1081,6 +1728,12 @@ static void preprocess(const char* new_filename, FILE* new_file) {
             }
             if (0 == strcmp(current_string, "define")) {
                 handle_define();
+                if (guard_state == 1) {
+                    guard_state = -1;
+                    if (0 == strcmp(guard_macro, (const char*)*(macros + MACRO_NAME))) {
+                        guard_state = 2;
+                    }
+                }
                 continue;
             }
             if (0 == strcmp(current_string, "ifdef")) {
@@ -1089,10 +1742,26 @@ static void preprocess(const char* new_filename, FILE* new_file) {
             }
             if (0 == strcmp(current_string, "ifndef")) {
                 handle_ifndef();
+                if (guard_state == 0) {
+                    guard_state = -1;
+                    /* If the #ifndef is true, current_string still contains
+                     * its macro name. */
+                    if (depth == 1) {
+                        guard_state = 1;
+                        guard_macro = strdup(current_string);
+                    }
+                }
                 continue;
             }
             if (0 == strcmp(current_string, "endif")) {
                 handle_endif();
+                if ((guard_state == 2) & (depth == 0)) {
+                    guard_state = 3;
+                }
+                continue;
+            }
+            if (0 == strcmp(current_string, "pragma")) {
+                handle_pragma();
                 continue;
             }
             if (0 == strcmp(current_string, "error")) {
@@ -1101,6 +1770,16 @@ static void preprocess(const char* new_filename, FILE* new_file) {
             fatal("Unrecognized preprocessor directive.");
         }
 
+        /* Anything other than whitespace outside of the include guard means
+         * the file isn't guarded. */
+        if (guard_state != 2) {
+            if (!((((current_char == ' ') | (current_char == '\t')) |
+                    (current_char == '\n')) | (current_char == 0)))
+            {
+                guard_state = -1;
+            }
+        }
+
         /* Expand identifiers */
         if (is_identifier_char(current_char, true)) {
             consume_identifier();
@@ -1141,14 +1820,35 @@ static void preprocess(const char* new_filename, FILE* new_file) {
         fatal("Unclosed if; expected endif before end of file");
     }
 
+    // remember this file if it's guarded
+    if (guard_once) {
+        guarded_file_new(new_filename, 0);
+        free(guard_macro);
+    }
+    if (!guard_once) {
+        if (guard_state == 3) {
+            guarded_file_new(new_filename, guard_macro);
+        }
+        if (guard_state != 3) {
+            free(guard_macro);
+        }
+    }
+
     // restore previous file
     current_file = old_file;
     free(current_filename);
     current_filename = old_filename;
     current_line = old_line;
     depth = old_depth;
+    guard_state = old_guard_state;
+    guard_macro = old_guard_macro;
+    guard_once = old_guard_once;
     current_char = old_current_char;
     next_scan_char = old_next_scan_char;
+    free(input_buffer);
+    input_buffer = old_input_buffer;
+    input_pos = old_input_pos;
+    input_end = old_input_end;
 }
 
 
@@ -1159,9 +1859,21 @@ static void preprocess(const char* new_filename, FILE* new_file) {
 
 static void initialize(void) {
     macros_init();
+    include_cache_init();
 
     current_string_capacity = 256;
     current_string = malloc(current_string_capacity);
+
+    input_buffer_size = 16384;
+
+    int output_buffer_size;
+    output_buffer_size = 65536;
+    output_buffer = malloc(output_buffer_size);
+    if (output_buffer == 0) {
+        fatal("Out of memory.");
+    }
+    output_pos = output_buffer;
+    output_end = (output_buffer + output_buffer_size);
 }
 
 static void define_default_macros(void) {
@@ -1181,6 +1893,46 @@ static void deinitialize(void) {
         macro_delete(macro);
         macro = next;
     }
+    free(macro_buckets);
+
+    // free guarded files
+    void** guarded = guarded_files;
+    while (guarded != 0) {
+        void** next = (void**)*guarded;
+        free(*(guarded + 1));
+        free(*(guarded + 2));
+        free(guarded);
+        guarded = next;
+    }
+
+    // free the lists of files read and not found for the snapshot
+    void** file = snapshot_files;
+    while (file != 0) {
+        void** next = (void**)*file;
+        free(*(file + 1));
+        free(file);
+        file = next;
+    }
+    file = snapshot_missing;
+    while (file != 0) {
+        void** next = (void**)*file;
+        free(*(file + 1));
+        free(file);
+        file = next;
+    }
+
+    // free dependencies
+    void** dependency = dependencies;
+    while (dependency != 0) {
+        void** next = (void**)*dependency;
+        free(*(dependency + 1));
+        free(dependency);
+        dependency = next;
+    }
+
+    // free the include cache
+    include_cache_delete(include_files);
+    include_cache_delete(include_names);
 
     // free include paths
     void** entry = include_paths;
@@ -1191,6 +1943,7 @@ static void deinitialize(void) {
     }
 
     free(current_string);
+    free(output_buffer);
 }
 
 static void parse_command_line(int argc, char** argv) {
@@ -1260,7 +2013,17 @@ static void parse_command_line(int argc, char** argv) {
             }
 
             //printf("-I path %s\n", path);
-            include_path_new(path);
+            include_path_new(path, false);
+            continue;
+        }
+
+        /* System include path on command-line */
+        if (0 == strcmp(arg, "-isystem")) {
+            i = (i + 1);
+            if (i == argc) {
+                fatal("`-isystem` must be followed by a path.");
+            }
+            include_path_new(*(argv + i), true);
             continue;
         }
 
@@ -1298,6 +2061,54 @@ static void parse_command_line(int argc, char** argv) {
             continue;
         }
 
+        /* Snapshots */
+        if (0 == strcmp(arg, "-save-snapshot")) {
+            i = (i + 1);
+            if (i == argc) {
+                fatal("`-save-snapshot` must be followed by a filename.");
+            }
+            save_snapshot_filename = *(argv + i);
+            continue;
+        }
+        if (0 == strcmp(arg, "-include-snapshot")) {
+            i = (i + 1);
+            if (i == argc) {
+                fatal("`-include-snapshot` must be followed by a filename.");
+            }
+            include_snapshot_filename = *(argv + i);
+            continue;
+        }
+
+        /* Dependency options */
+        if ((0 == strcmp(arg, "-M")) | (0 == strcmp(arg, "-MM"))) {
+            opt_deps = true;
+            opt_deps_only = true;
+            opt_deps_user_only = (0 == strcmp(arg, "-MM"));
+            continue;
+        }
+        if ((0 == strcmp(arg, "-MD")) | (0 == strcmp(arg, "-MMD"))) {
+            opt_deps = true;
+            opt_deps_user_only = (0 == strcmp(arg, "-MMD"));
+            continue;
+        }
+        if (0 == strcmp(arg, "-MP")) {
+            opt_deps_phony = true;
+            continue;
+        }
+        if ((0 == strcmp(arg, "-MF")) | (0 == strcmp(arg, "-MT"))) {
+            i = (i + 1);
+            if (i == argc) {
+                fatal("`-MF` and `-MT` must be followed by a filename.");
+            }
+            if (0 == strcmp(arg, "-MF")) {
+                deps_filename = *(argv + i);
+            }
+            if (0 == strcmp(arg, "-MT")) {
+                deps_target = *(argv + i);
+            }
+            continue;
+        }
+
         /* Other options */
         if (0 == strcmp(arg, "-nostddef")) {
             opt_nostddef = true;
@@ -1321,6 +2132,14 @@ static void parse_command_line(int argc, char** argv) {
     if (output_filename == 0) {
         fatal("An output file is required.");
     }
+    if ((save_snapshot_filename != 0) & (force_include_filename == 0)) {
+        fatal("`-save-snapshot` requires an `-include` file.");
+    }
+    if ((include_snapshot_filename != 0) & ((force_include_filename != 0) |
+                (save_snapshot_filename != 0)))
+    {
+        fatal("`-include-snapshot` cannot be used with `-include` or `-save-snapshot`.");
+    }
 }
 
 void do_force_include(void) {
@@ -1338,6 +2157,473 @@ void do_force_include(void) {
     search_include('"');
 }
 
+
+
+/*
+ * Snapshots
+ *
+ * A snapshot saves the state of the preprocessor after the `-include` file has
+ * been preprocessed: the macros it defined, the guarded files and the output
+ * it emitted. A later run can load it with `-include-snapshot` instead of
+ * preprocessing the `-include` file (and all of the headers it includes)
+ * again.
+ *
+ * The snapshot is a text file of lines. (None of the strings it contains can
+ * have newlines.) It contains, in order:
+ *
+ * - The line `onramp-cpp-snapshot 2`;
+ * - The `-include` filename;
+ * - The number of include paths, followed by each path;
+ * - The number of macros defined before the `-include` file, followed by the
+ *   name and expansion of each, newest first;
+ * - The number of files read, followed by the size, contents hash and path
+ *   of each;
+ * - The number of include files searched for and not found, followed by the
+ *   path of each;
+ * - The number of guarded files, followed by the path and guard macro of
+ *   each (the macro is blank for `#pragma once`);
+ * - The number of macros defined by the `-include` file, followed by the name
+ *   and expansion of each, oldest first;
+ * - The length of the output, followed by the output itself.
+ *
+ * A snapshot is only used if the include paths and the macros defined
+ * beforehand are the same, if every file read still has the same size and
+ * contents, and if every include file that wasn't found still doesn't exist.
+ * (The VM doesn't give us modification times.) Otherwise it's stale and we
+ * preprocess the `-include` file instead.
+ */
+
+static char* snapshot_pos;
+static char* snapshot_end;
+
+/**
+ * Hashes the contents of a file, placing its size and hash in the given
+ * pointers.
+ *
+ * Returns false if the file can't be opened.
+ */
+static bool hash_file(const char* path, int* size_out, int* hash_out) {
+    FILE* file;
+    file = fopen(path, "r");
+    if (file == 0) {
+        return false;
+    }
+    char* buffer;
+    buffer = malloc(input_buffer_size);
+    if (buffer == 0) {
+        fatal("Out of memory.");
+    }
+
+    int size = 0;
+    int hash = 0;
+    while (1) {
+        int count;
+        count = fread(buffer, 1, input_buffer_size, file);
+        if (count == 0) {
+            break;
+        }
+        size = (size + count);
+        int i = 0;
+        while (i < count) {
+            hash = (((hash * 31) + *(buffer + i)) & 0xFFFFFF);
+            i = (i + 1);
+        }
+    }
+
+    free(buffer);
+    fclose(file);
+    *size_out = size;
+    *hash_out = hash;
+    return true;
+}
+
+static void snapshot_write_line(FILE* file, const char* line) {
+    fputs(line, file);
+    fputs("\n", file);
+}
+
+static void snapshot_write_number(FILE* file, int number) {
+    fputd(number, file);
+    fputs("\n", file);
+}
+
+/**
+ * Writes the macros from the given one up to (but not including) the stop
+ * macro, oldest first.
+ */
+static void snapshot_write_macros(FILE* file, void** macro, void** stop) {
+    if (macro == stop) {
+        return;
+    }
+    snapshot_write_macros(file, (void**)*(macro + MACRO_NEXT), stop);
+    snapshot_write_line(file, (const char*)*(macro + MACRO_NAME));
+    snapshot_write_line(file, (const char*)*(macro + MACRO_EXPANSION));
+}
+
+/**
+ * Saves a snapshot. This is called right after the `-include` file has been
+ * preprocessed. old_macros is the list of macros from before it.
+ */
+static void snapshot_save(void** old_macros) {
+    FILE* file;
+    file = fopen(save_snapshot_filename, "w");
+    if (file == 0) {
+        fatal("Failed to open snapshot file for writing.");
+    }
+
+    snapshot_write_line(file, "onramp-cpp-snapshot 2");
+    snapshot_write_line(file, force_include_filename);
+
+    // include paths
+    int count = 0;
+    void** entry = include_paths;
+    while (entry != 0) {
+        count = (count + 1);
+        entry = (void**)*entry;
+    }
+    snapshot_write_number(file, count);
+    entry = include_paths;
+    while (entry != 0) {
+        snapshot_write_line(file, (const char*)*(entry + 1));
+        entry = (void**)*entry;
+    }
+
+    // macros defined before the -include file
+    count = 0;
+    void** macro = old_macros;
+    while (macro != 0) {
+        count = (count + 1);
+        macro = (void**)*(macro + MACRO_NEXT);
+    }
+    snapshot_write_number(file, count);
+    macro = old_macros;
+    while (macro != 0) {
+        snapshot_write_line(file, (const char*)*(macro + MACRO_NAME));
+        snapshot_write_line(file, (const char*)*(macro + MACRO_EXPANSION));
+        macro = (void**)*(macro + MACRO_NEXT);
+    }
+
+    // files read
+    count = 0;
+    entry = snapshot_files;
+    while (entry != 0) {
+        count = (count + 1);
+        entry = (void**)*entry;
+    }
+    snapshot_write_number(file, count);
+    entry = snapshot_files;
+    while (entry != 0) {
+        int size;
+        int hash;
+        if (!hash_file((const char*)*(entry + 1), &size, &hash)) {
+            fatal("Failed to re-open an included file for the snapshot.");
+        }
+        snapshot_write_number(file, size);
+        snapshot_write_number(file, hash);
+        snapshot_write_line(file, (const char*)*(entry + 1));
+        entry = (void**)*entry;
+    }
+
+    // include files not found
+    count = 0;
+    entry = snapshot_missing;
+    while (entry != 0) {
+        count = (count + 1);
+        entry = (void**)*entry;
+    }
+    snapshot_write_number(file, count);
+    entry = snapshot_missing;
+    while (entry != 0) {
+        snapshot_write_line(file, (const char*)*(entry + 1));
+        entry = (void**)*entry;
+    }
+
+    // guarded files
+    count = 0;
+    entry = guarded_files;
+    while (entry != 0) {
+        count = (count + 1);
+        entry = (void**)*entry;
+    }
+    snapshot_write_number(file, count);
+    entry = guarded_files;
+    while (entry != 0) {
+        snapshot_write_line(file, (const char*)*(entry + 1));
+        if (*(entry + 2) == 0) {
+            snapshot_write_line(file, "");
+        }
+        if (*(entry + 2) != 0) {
+            snapshot_write_line(file, (const char*)*(entry + 2));
+        }
+        entry = (void**)*entry;
+    }
+
+    // macros defined by the -include file
+    count = 0;
+    macro = macros;
+    while (macro != old_macros) {
+        count = (count + 1);
+        macro = (void**)*(macro + MACRO_NEXT);
+    }
+    snapshot_write_number(file, count);
+    snapshot_write_macros(file, macros, old_macros);
+
+    // output
+    count = (output_pos - output_buffer);
+    snapshot_write_number(file, count);
+    fwrite(output_buffer, 1, count, file);
+
+    fclose(file);
+}
+
+/**
+ * Reads the next line of the snapshot, returning it null-terminated.
+ */
+static char* snapshot_read_line(void) {
+    char* line;
+    line = snapshot_pos;
+    while (1) {
+        if (snapshot_pos == snapshot_end) {
+            fatal("Snapshot file is truncated.");
+        }
+        if (*snapshot_pos == '\n') {
+            break;
+        }
+        snapshot_pos = (snapshot_pos + 1);
+    }
+    *snapshot_pos = 0;
+    snapshot_pos = (snapshot_pos + 1);
+    return line;
+}
+
+static int snapshot_read_number(void) {
+    char* line;
+    line = snapshot_read_line();
+    if (*line == 0) {
+        fatal("Expected a number in snapshot file.");
+    }
+    int number = 0;
+    while (*line != 0) {
+        if (!isdigit(*line)) {
+            fatal("Expected a number in snapshot file.");
+        }
+        number = ((number * 10) + (*line - '0'));
+        line = (line + 1);
+    }
+    return number;
+}
+
+/**
+ * Reads a whole file into a new buffer, placing its size in size_out.
+ */
+static char* read_file(const char* path, int* size_out) {
+    FILE* file;
+    file = fopen(path, "r");
+    if (file == 0) {
+        return 0;
+    }
+    int capacity = input_buffer_size;
+    int size = 0;
+    char* buffer;
+    buffer = malloc(capacity);
+    if (buffer == 0) {
+        fatal("Out of memory.");
+    }
+    while (1) {
+        if (size == capacity) {
+            char* new_buffer;
+            new_buffer = malloc(capacity * 2);
+            if (new_buffer == 0) {
+                fatal("Out of memory.");
+            }
+            memcpy(new_buffer, buffer, size);
+            free(buffer);
+            buffer = new_buffer;
+            capacity = (capacity * 2);
+        }
+        int count;
+        count = fread(buffer + size, 1, capacity - size, file);
+        if (count == 0) {
+            break;
+        }
+        size = (size + count);
+    }
+    fclose(file);
+    *size_out = size;
+    return buffer;
+}
+
+/**
+ * Checks that the environment and the files read are the same as when the
+ * snapshot was saved.
+ */
+static bool snapshot_is_current(void) {
+
+    // include paths
+    int count;
+    count = snapshot_read_number();
+    void** entry = include_paths;
+    while (count > 0) {
+        if (entry == 0) {
+            return false;
+        }
+        if (0 != strcmp(snapshot_read_line(), (const char*)*(entry + 1))) {
+            return false;
+        }
+        entry = (void**)*entry;
+        count = (count - 1);
+    }
+    if (entry != 0) {
+        return false;
+    }
+
+    // macros defined before the -include file
+    count = snapshot_read_number();
+    void** macro = macros;
+    while (count > 0) {
+        if (macro == 0) {
+            return false;
+        }
+        if (0 != strcmp(snapshot_read_line(), (const char*)*(macro + MACRO_NAME))) {
+            return false;
+        }
+        if (0 != strcmp(snapshot_read_line(), (const char*)*(macro + MACRO_EXPANSION))) {
+            return false;
+        }
+        macro = (void**)*(macro + MACRO_NEXT);
+        count = (count - 1);
+    }
+    if (macro != 0) {
+        return false;
+    }
+
+    // files read
+    count = snapshot_read_number();
+    while (count > 0) {
+        int expected_size;
+        int expected_hash;
+        expected_size = snapshot_read_number();
+        expected_hash = snapshot_read_number();
+        char* path;
+        path = snapshot_read_line();
+        int size;
+        int hash;
+        if (!hash_file(path, &size, &hash)) {
+            return false;
+        }
+        // We don't know which of these are system headers so they are all
+        // dependencies, even with -MM.
+        if (opt_deps) {
+            dependency_add(path);
+        }
+        if ((size != expected_size) | (hash != expected_hash)) {
+            return false;
+        }
+        count = (count - 1);
+    }
+
+    // include files not found
+    count = snapshot_read_number();
+    while (count > 0) {
+        FILE* file;
+        file = fopen(snapshot_read_line(), "r");
+        if (file != 0) {
+            fclose(file);
+            return false;
+        }
+        count = (count - 1);
+    }
+
+    return true;
+}
+
+/**
+ * Loads the remainder of a current snapshot: the guarded files, the macros
+ * and the output.
+ */
+static void snapshot_apply(void) {
+
+    // guarded files
+    int count;
+    count = snapshot_read_number();
+    while (count > 0) {
+        char* path;
+        char* macro;
+        path = snapshot_read_line();
+        macro = snapshot_read_line();
+        if (*macro == 0) {
+            guarded_file_new(path, 0);
+        }
+        if (*macro != 0) {
+            guarded_file_new(path, strdup(macro));
+        }
+        count = (count - 1);
+    }
+
+    // macros
+    count = snapshot_read_number();
+    while (count > 0) {
+        char* name;
+        name = snapshot_read_line();
+        macro_new(strdup(name), strdup(snapshot_read_line()));
+        count = (count - 1);
+    }
+
+    // output
+    count = snapshot_read_number();
+    if (count > (snapshot_end - snapshot_pos)) {
+        fatal("Snapshot file is truncated.");
+    }
+    while (count > 0) {
+        emit_char(*snapshot_pos);
+        snapshot_pos = (snapshot_pos + 1);
+        count = (count - 1);
+    }
+}
+
+/**
+ * Loads the `-include-snapshot` file. If it's stale, we preprocess its
+ * `-include` file instead.
+ */
+static void do_include_snapshot(void) {
+    if (include_snapshot_filename == 0) {
+        return;
+    }
+
+    int size;
+    char* buffer;
+    buffer = read_file(include_snapshot_filename, &size);
+    if (buffer == 0) {
+        fatal("Failed to open snapshot file.");
+    }
+    snapshot_pos = buffer;
+    snapshot_end = (buffer + size);
+    if (opt_deps) {
+        dependency_add(include_snapshot_filename);
+    }
+
+    if (0 != strcmp(snapshot_read_line(), "onramp-cpp-snapshot 2")) {
+        fatal("Not a snapshot file, or the snapshot version is not supported.");
+    }
+    char* prefix;
+    prefix = strdup(snapshot_read_line());
+
+    bool current;
+    current = snapshot_is_current();
+    if (current) {
+        snapshot_apply();
+    }
+    free(buffer);
+
+    // The snapshot is stale. Preprocess its -include file instead.
+    if (!current) {
+        force_include_filename = prefix;
+        do_force_include();
+        force_include_filename = 0;
+    }
+    free(prefix);
+}
+
 void dump_macros(void) {
     void** macro = macros;
     while (macro != 0) {
@@ -1360,13 +2646,33 @@ int main(int argc, char** argv) {
     parse_command_line(argc, argv);
     define_default_macros();
 
-    output_file = fopen(output_filename, "w");
+    /* An output filename of `-` is standard output */
+    if (0 == strcmp(output_filename, "-")) {
+        output_file = stdout;
+    }
     if (output_file == 0) {
-        fatal("Failed to open output file");
+        output_file = fopen(output_filename, "w");
+        if (output_file == 0) {
+            fatal("Failed to open output file");
+        }
+    }
+
+    /* The input file is the first dependency */
+    if (opt_deps) {
+        dependency_add(input_filename);
     }
 
-    /* Preprocess `-include` file */
+    /* Preprocess `-include` file, saving a snapshot if requested */
+    void** old_macros = macros;
+    snapshot_recording = (save_snapshot_filename != 0);
     do_force_include();
+    if (snapshot_recording) {
+        snapshot_save(old_macros);
+        snapshot_recording = false;
+    }
+
+    /* Load `-include-snapshot` file */
+    do_include_snapshot();
 
     /* Preprocess input file */
     FILE* input_file = fopen(input_filename, "r");
@@ -1376,7 +2682,11 @@ int main(int argc, char** argv) {
     preprocess(input_filename, input_file);
 
     fclose(input_file);
-    fclose(output_file);
+    flush_output();
+    do_write_dependencies();
+    if (output_file != stdout) {
+        fclose(output_file);
+    }
 
     if (opt_dump_macros) {
         dump_macros();
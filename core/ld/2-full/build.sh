@@ -28,6 +28,12 @@ mkdir -p build/intermediate/ld-2-full
 echo
 echo === Building ld/2-full
 
+echo Compiling ld/2-full archive.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/ld/2-full/build-ccargs \
+    -c core/ld/2-full/src/archive.c \
+    -o build/intermediate/ld-2-full/archive.oo
+
 echo Compiling ld/2-full common.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/ld/2-full/build-ccargs \
@@ -40,6 +46,12 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/ld/2-full/src/emit.c \
     -o build/intermediate/ld-2-full/emit.oo
 
+echo Compiling ld/2-full fold.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/ld/2-full/build-ccargs \
+    -c core/ld/2-full/src/fold.c \
+    -o build/intermediate/ld-2-full/fold.oo
+
 echo Compiling ld/2-full label.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/ld/2-full/build-ccargs \
@@ -52,12 +64,30 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/ld/2-full/src/main.c \
     -o build/intermediate/ld-2-full/main.oo
 
+echo Compiling ld/2-full map.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/ld/2-full/build-ccargs \
+    -c core/ld/2-full/src/map.c \
+    -o build/intermediate/ld-2-full/map.oo
+
+echo Compiling ld/2-full object.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/ld/2-full/build-ccargs \
+    -c core/ld/2-full/src/object.c \
+    -o build/intermediate/ld-2-full/object.oo
+
 echo Compiling ld/2-full parse.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/ld/2-full/build-ccargs \
     -c core/ld/2-full/src/parse.c \
     -o build/intermediate/ld-2-full/parse.oo
 
+echo Compiling ld/2-full relocatable.c
+onrampvm build/intermediate/cc/cc.oe \
+    @core/ld/2-full/build-ccargs \
+    -c core/ld/2-full/src/relocatable.c \
+    -o build/intermediate/ld-2-full/relocatable.oo
+
 echo Compiling ld/2-full symbol.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/ld/2-full/build-ccargs \
@@ -68,10 +98,15 @@ echo Linking ld/2-full
 onrampvm build/intermediate/ld-1-omc/ld.oe \
     build/intermediate/libc-2-opc/libc.oa \
     build/intermediate/libo-1-opc/libo.oa \
+    build/intermediate/ld-2-full/archive.oo \
     build/intermediate/ld-2-full/common.oo \
     build/intermediate/ld-2-full/emit.oo \
+    build/intermediate/ld-2-full/fold.oo \
     build/intermediate/ld-2-full/label.oo \
     build/intermediate/ld-2-full/main.oo \
+    build/intermediate/ld-2-full/map.oo \
+    build/intermediate/ld-2-full/object.oo \
     build/intermediate/ld-2-full/parse.oo \
+    build/intermediate/ld-2-full/relocatable.oo \
     build/intermediate/ld-2-full/symbol.oo \
     -o build/intermediate/ld-2-full/ld.oe
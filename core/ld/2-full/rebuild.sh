@@ -28,6 +28,12 @@ mkdir -p build/intermediate/ld-2-full-re
 echo
 echo === Rebuilding ld/2-full
 
+echo Compiling ld/2-full archive.c
+onrampvm build/output/bin/cc.oe \
+    @core/ld/2-full/rebuild-ccargs \
+    -c core/ld/2-full/src/archive.c \
+    -o build/intermediate/ld-2-full-re/archive.oo
+
 echo Compiling ld/2-full common.c
 onrampvm build/output/bin/cc.oe \
     @core/ld/2-full/rebuild-ccargs \
@@ -40,6 +46,12 @@ onrampvm build/output/bin/cc.oe \
     -c core/ld/2-full/src/emit.c \
     -o build/intermediate/ld-2-full-re/emit.oo
 
+echo Compiling ld/2-full fold.c
+onrampvm build/output/bin/cc.oe \
+    @core/ld/2-full/rebuild-ccargs \
+    -c core/ld/2-full/src/fold.c \
+    -o build/intermediate/ld-2-full-re/fold.oo
+
 echo Compiling ld/2-full label.c
 onrampvm build/output/bin/cc.oe \
     @core/ld/2-full/rebuild-ccargs \
@@ -52,12 +64,30 @@ onrampvm build/output/bin/cc.oe \
     -c core/ld/2-full/src/main.c \
     -o build/intermediate/ld-2-full-re/main.oo
 
+echo Compiling ld/2-full map.c
+onrampvm build/output/bin/cc.oe \
+    @core/ld/2-full/rebuild-ccargs \
+    -c core/ld/2-full/src/map.c \
+    -o build/intermediate/ld-2-full-re/map.oo
+
+echo Compiling ld/2-full object.c
+onrampvm build/output/bin/cc.oe \
+    @core/ld/2-full/rebuild-ccargs \
+    -c core/ld/2-full/src/object.c \
+    -o build/intermediate/ld-2-full-re/object.oo
+
 echo Compiling ld/2-full parse.c
 onrampvm build/output/bin/cc.oe \
     @core/ld/2-full/rebuild-ccargs \
     -c core/ld/2-full/src/parse.c \
     -o build/intermediate/ld-2-full-re/parse.oo
 
+echo Compiling ld/2-full relocatable.c
+onrampvm build/output/bin/cc.oe \
+    @core/ld/2-full/rebuild-ccargs \
+    -c core/ld/2-full/src/relocatable.c \
+    -o build/intermediate/ld-2-full-re/relocatable.oo
+
 echo Compiling ld/2-full symbol.c
 onrampvm build/output/bin/cc.oe \
     @core/ld/2-full/rebuild-ccargs \
@@ -68,10 +98,15 @@ echo Linking ld/2-full
 onrampvm build/output/bin/cc.oe \
     @core/ld/2-full/rebuild-ccargs \
     build/intermediate/libo-1-opc-re/libo.oa \
+    build/intermediate/ld-2-full-re/archive.oo \
     build/intermediate/ld-2-full-re/common.oo \
     build/intermediate/ld-2-full-re/emit.oo \
+    build/intermediate/ld-2-full-re/fold.oo \
     build/intermediate/ld-2-full-re/label.oo \
     build/intermediate/ld-2-full-re/main.oo \
+    build/intermediate/ld-2-full-re/map.oo \
+    build/intermediate/ld-2-full-re/object.oo \
     build/intermediate/ld-2-full-re/parse.oo \
+    build/intermediate/ld-2-full-re/relocatable.oo \
     build/intermediate/ld-2-full-re/symbol.oo \
     -o build/output/bin/ld.oe
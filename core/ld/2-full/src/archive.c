@@ -0,0 +1,345 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "archive.h"
+
+#include "libo-table.h"
+
+#include "common.h"
+#include "object.h"
+#include "parse.h"
+#include "symbol.h"
+
+typedef struct archive_t archive_t;
+
+typedef struct archive_member_t {
+    archive_t* archive;
+    size_t offset; // The offset of the member's `%` line from the members' start
+    size_t size;
+    bool keep;     // Whether the member has constructors or destructors
+    bool loaded;
+} archive_member_t;
+
+struct archive_t {
+    string_t* filename;
+    char* bytes;             // The entire contents of the archive file
+    const char* members;     // The start of the first member after the index
+    const char* end;
+    archive_member_t* member_list;
+    size_t members_count;
+};
+
+/**
+ * A global symbol defined by an archive member.
+ *
+ * If more than one member defines a symbol, the first one in link order wins.
+ *
+ * The table entry must be first. (We can't use containerof() since we're
+ * preprocessed by cpp/1 which doesn't support function-like macros.)
+ */
+typedef struct archive_symbol_t {
+    table_entry_t entry;
+    string_t* name;
+    archive_member_t* member;
+} archive_symbol_t;
+
+static archive_t** archives;
+static size_t archives_count;
+static size_t archives_capacity;
+
+// A map of archive_symbol_t by name. Names are interned so they are compared
+// by pointer.
+static table_t archive_symbols;
+
+void archives_init(void) {
+    archives = NULL;
+    archives_count = 0;
+    archives_capacity = 0;
+    table_init(&archive_symbols);
+}
+
+void archives_destroy(void) {
+    table_entry_t** bucket = table_first_bucket(&archive_symbols);
+    while (bucket) {
+        table_entry_t* entry = *bucket;
+        while (entry) {
+            table_entry_t* next = table_entry_next(entry);
+            archive_symbol_t* symbol = (archive_symbol_t*)entry;
+            string_deref(symbol->name);
+            free(symbol);
+            entry = next;
+        }
+        bucket = table_next_bucket(&archive_symbols, bucket);
+    }
+    table_destroy(&archive_symbols);
+
+    for (size_t i = 0; i < archives_count; ++i) {
+        archive_t* archive = archives[i];
+        string_deref(archive->filename);
+        free(archive->bytes);
+        free(archive->member_list);
+        free(archive);
+    }
+    free(archives);
+}
+
+bool archive_has_index(const char* bytes, size_t size) {
+    return size >= 3 && bytes[0] == '%' && bytes[1] == '/' &&
+            (bytes[2] == '\n' || bytes[2] == '\r');
+}
+
+static archive_symbol_t* archive_symbols_find(string_t* name) {
+    table_entry_t* entry = table_bucket(&archive_symbols, string_hash(name));
+    while (entry) {
+        archive_symbol_t* symbol = (archive_symbol_t*)entry;
+        if (symbol->name == name) {
+            return symbol;
+        }
+        entry = table_entry_next(entry);
+    }
+    return NULL;
+}
+
+
+
+/*
+ * Index parsing
+ */
+
+static const char* index_pos;
+static const char* index_end;
+
+static void index_invalid(void) {
+    fatal("Archive index is invalid or out of date.");
+}
+
+/** Consumes the given word if it's next on the current index line. */
+static bool index_word(const char* word) {
+    size_t length = strlen(word);
+    if ((size_t)(index_end - index_pos) < length || 0 != memcmp(index_pos, word, length)) {
+        return false;
+    }
+    index_pos += length;
+    return true;
+}
+
+static size_t index_number(void) {
+    if (index_pos == index_end || *index_pos != ' ') {
+        index_invalid();
+    }
+    ++index_pos;
+    if (index_pos == index_end || !isdigit((unsigned char)*index_pos)) {
+        index_invalid();
+    }
+    size_t value = 0;
+    while (index_pos != index_end && isdigit((unsigned char)*index_pos)) {
+        size_t next = value * 10 + (*index_pos++ - '0');
+        if (next < value) {
+            index_invalid();
+        }
+        value = next;
+    }
+    return value;
+}
+
+static void index_end_of_line(void) {
+    if (index_pos != index_end && *index_pos == '\r') {
+        ++index_pos;
+    }
+    if (index_pos == index_end || *index_pos != '\n') {
+        index_invalid();
+    }
+    ++index_pos;
+}
+
+static void index_define(archive_member_t* member) {
+    const char* name = index_pos;
+    while (index_pos != index_end && *index_pos != '\n' && *index_pos != '\r') {
+        ++index_pos;
+    }
+    if (name == index_pos) {
+        index_invalid();
+    }
+
+    string_t* string = string_intern_bytes(name, index_pos - name);
+    if (archive_symbols_find(string)) {
+        // an earlier member already defines it
+        string_deref(string);
+        return;
+    }
+
+    archive_symbol_t* symbol = malloc(sizeof(archive_symbol_t));
+    if (symbol == NULL) {
+        fatal("Out of memory.");
+    }
+    symbol->name = string;
+    symbol->member = member;
+    table_put(&archive_symbols, &symbol->entry, string_hash(string));
+}
+
+static void archive_parse_index(archive_t* archive) {
+    index_pos = archive->bytes + 2; // skip "%/"
+    index_end = archive->end;
+    index_end_of_line();
+
+    if (!index_word(";index")) {
+        index_invalid();
+    }
+    size_t count = index_number();
+    index_end_of_line();
+    if (count > (size_t)(index_end - index_pos)) {
+        index_invalid();
+    }
+    archive->member_list = calloc(count + 1, sizeof(archive_member_t));
+    if (archive->member_list == NULL) {
+        fatal("Out of memory.");
+    }
+
+    archive_member_t* member = NULL;
+    while (index_pos != index_end && *index_pos == ';') {
+        if (index_word(";member")) {
+            if (archive->members_count == count) {
+                index_invalid();
+            }
+            member = archive->member_list + archive->members_count++;
+            member->archive = archive;
+            member->offset = index_number();
+            member->size = index_number();
+            member->keep = index_word(" keep");
+        } else if (index_word(";define ")) {
+            if (member == NULL) {
+                index_invalid();
+            }
+            index_define(member);
+        } else {
+            index_invalid();
+        }
+        index_end_of_line();
+    }
+    if (archive->members_count != count) {
+        index_invalid();
+    }
+
+    // Check that every member is where the index says it is.
+    archive->members = index_pos;
+    for (size_t i = 0; i < count; ++i) {
+        member = archive->member_list + i;
+        size_t available = archive->end - archive->members;
+        if (member->offset >= available || member->size > available - member->offset ||
+                archive->members[member->offset] != '%')
+        {
+            index_invalid();
+        }
+    }
+}
+
+static void archive_load_member(archive_member_t* member) {
+    member->loaded = true;
+    const char* start = member->archive->members + member->offset;
+    parse_archive_member(member->archive->filename->bytes, start, start + member->size);
+}
+
+void archives_add(const char* filename, char* bytes, size_t size) {
+    archive_t* archive = calloc(1, sizeof(archive_t));
+    if (archive == NULL) {
+        fatal("Out of memory.");
+    }
+    archive->filename = string_intern_cstr(filename);
+    archive->bytes = bytes;
+    archive->end = bytes + size;
+
+    if (archives_count == archives_capacity) {
+        size_t new_capacity = archives_capacity * 2;
+        if (new_capacity < 4)
+            new_capacity = 4;
+        archives = realloc(archives, new_capacity * sizeof(archive_t*));
+        if (archives == NULL)
+            fatal("Out of memory.");
+        archives_capacity = new_capacity;
+    }
+    archives[archives_count++] = archive;
+
+    set_current_filename(filename);
+    current_line = 1;
+    archive_parse_index(archive);
+
+    // The entry point must be the first symbol so we load it right away.
+    string_t* name = string_intern_cstr("__start");
+    if (symbols_find(name, -1) == NULL) {
+        archive_symbol_t* symbol = archive_symbols_find(name);
+        if (symbol && !symbol->member->loaded) {
+            archive_load_member(symbol->member);
+        }
+    }
+    string_deref(name);
+}
+
+void archives_load_members(void) {
+
+    // With -r, all members are merged into the output.
+    if (option_relocatable) {
+        for (size_t i = 0; i < archives_count; ++i) {
+            archive_t* archive = archives[i];
+            for (size_t j = 0; j < archive->members_count; ++j) {
+                archive_member_t* member = archive->member_list + j;
+                if (!member->loaded) {
+                    archive_load_member(member);
+                }
+            }
+        }
+    }
+
+    // Load members with constructors and destructors. Nothing references
+    // them but they are always linked.
+    for (size_t i = 0; i < archives_count; ++i) {
+        archive_t* archive = archives[i];
+        for (size_t j = 0; j < archive->members_count; ++j) {
+            archive_member_t* member = archive->member_list + j;
+            if (member->keep && !member->loaded) {
+                archive_load_member(member);
+            }
+        }
+    }
+
+    // Walk all invocations of all objects looking for undefined symbols.
+    // Loading a member appends a new object so we keep going until no
+    // objects are left.
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+            if (record->type != RECORD_INVOKE_SYMBOL) {
+                continue;
+            }
+            string_t* name = record->pointer;
+            if (symbols_find(name, object->file_index)) {
+                continue;
+            }
+            archive_symbol_t* symbol = archive_symbols_find(name);
+            if (symbol && !symbol->member->loaded) {
+                archive_load_member(symbol->member);
+            }
+        }
+    }
+}
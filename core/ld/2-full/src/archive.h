@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ARCHIVE_H_INCLUDED
+#define ARCHIVE_H_INCLUDED
+
+#include "common.h"
+
+/*
+ * Indexed static archives
+ *
+ * An archive written by the final stage archiver starts with an index member
+ * which lists the offset and size of each member along with the global symbols
+ * it defines. (See docs/object-code.md.)
+ *
+ * The members of an indexed archive are not parsed up front. Instead, once all
+ * other input files are parsed, members are loaded on demand to resolve
+ * undefined symbols until no more can be resolved. Members we don't need are
+ * never tokenized.
+ *
+ * Archives without an index are parsed in their entirety as before.
+ */
+
+void archives_init(void);
+
+void archives_destroy(void);
+
+/**
+ * Returns true if the given input file contents start with an archive index.
+ */
+bool archive_has_index(const char* bytes, size_t size);
+
+/**
+ * Adds an indexed archive, taking ownership of its contents.
+ *
+ * If the entry point `__start` is not yet defined and this archive defines it,
+ * its member is loaded immediately so that `__start` remains the first symbol.
+ */
+void archives_add(const char* filename, char* bytes, size_t size);
+
+/**
+ * Loads all archive members needed to resolve undefined symbols, iterating
+ * until no more can be resolved. Members that contain constructors or
+ * destructors are always loaded.
+ *
+ * This is called after all input files are parsed.
+ */
+void archives_load_members(void);
+
+#endif
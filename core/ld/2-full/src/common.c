@@ -26,18 +26,11 @@
 
 bool line_manual;
 
-int current_char;
 int current_address;
-int file_start_address;
 int file_index;
-bool optimize;
 
 FILE* output_file;
-FILE* input_file;
 FILE* debug_file;
-fpos_t file_start_pos;
-int pass;
-char file_first_char;
 
 char* buffer;
 size_t buffer_length;
@@ -46,6 +39,8 @@ struct symbol_t* current_symbol;
 
 bool option_optimize;
 bool option_debug;
+bool option_debug_compact;
+bool option_relocatable;
 
 // TODO this should be in libo
 int hex_to_int(char c) {
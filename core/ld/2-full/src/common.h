@@ -43,18 +43,11 @@ struct symbol_t;
 
 extern bool line_manual; // whether #line is in manual mode
 
-extern int current_char;
 extern int current_address; // within the current symbol
-extern int file_start_address;
 extern int file_index;
-extern bool optimize;
 
-extern FILE* input_file;
 extern FILE* output_file;
 extern FILE* debug_file;
-extern fpos_t file_start_pos;
-extern int pass;
-extern char file_first_char;
 
 extern char* buffer;
 extern size_t buffer_length;
@@ -64,6 +57,8 @@ extern struct symbol_t* current_symbol;
 
 extern bool option_optimize;
 extern bool option_debug;
+extern bool option_debug_compact;
+extern bool option_relocatable;
 
 int hex_to_int(char c);
 
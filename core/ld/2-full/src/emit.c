@@ -29,11 +29,187 @@ char* emit_current_symbol;
 int emit_line;
 static int bytes_emitted;
 
+
+
+/*
+ * Compact debug info
+ *
+ * With -compact-debug, debug info is collected in memory while emitting and
+ * written in the binary format (see docs/debug-info.md) at the end. Bytes are
+ * gathered into runs of the same source location. Each run is encoded as a
+ * line delta from the previous run, a file number if the file changed and a
+ * byte count.
+ */
+
+typedef struct compact_buffer_t {
+    char* bytes;
+    size_t size;
+    size_t capacity;
+    size_t count; // The number of entries encoded in the buffer
+} compact_buffer_t;
+
+static compact_buffer_t compact_symbols;
+static compact_buffer_t compact_runs;
+
+// The file table. File number n is at index n-1; 0 means unknown.
+static string_t** compact_files;
+static size_t compact_files_count;
+static size_t compact_files_capacity;
+
+static int compact_file;        // The file number of the current location
+static int compact_address;     // The number of bytes emitted so far
+static int compact_symbol_address; // The address of the previous symbol
+
+// The pending run
+static int run_file;
+static int run_line;
+static int run_bytes;
+
+// The previous run written
+static int previous_file;
+static int previous_line;
+
+static void compact_byte(compact_buffer_t* buffer, int byte) {
+    if (buffer->size == buffer->capacity) {
+        size_t new_capacity = buffer->capacity * 2;
+        if (new_capacity < 256)
+            new_capacity = 256;
+        buffer->bytes = realloc(buffer->bytes, new_capacity);
+        if (buffer->bytes == NULL)
+            fatal("Out of memory.");
+        buffer->capacity = new_capacity;
+    }
+    buffer->bytes[buffer->size++] = (char)byte;
+}
+
+/** Appends an unsigned LEB128 number. */
+static void compact_number(compact_buffer_t* buffer, unsigned value) {
+    while (value >= 0x80) {
+        compact_byte(buffer, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    compact_byte(buffer, value);
+}
+
+static void compact_string(compact_buffer_t* buffer, const char* string) {
+    size_t length = strlen(string);
+    compact_number(buffer, length);
+    for (size_t i = 0; i < length; ++i) {
+        compact_byte(buffer, string[i]);
+    }
+}
+
+static void compact_flush_run(void) {
+    if (run_bytes == 0) {
+        return;
+    }
+
+    // the line delta is zigzag encoded with the file change flag in the low bit
+    int delta = run_line - previous_line;
+    unsigned op = delta >= 0 ? (unsigned)delta * 2 : (unsigned)(-delta) * 2 - 1;
+    op = op * 2 + (run_file != previous_file);
+    compact_number(&compact_runs, op);
+    if (run_file != previous_file) {
+        compact_number(&compact_runs, run_file);
+    }
+    compact_number(&compact_runs, run_bytes);
+    ++compact_runs.count;
+
+    previous_file = run_file;
+    previous_line = run_line;
+    run_bytes = 0;
+}
+
+/** Attributes the given number of bytes to the current source location. */
+static void compact_count(int bytes) {
+    if (run_file != compact_file || run_line != emit_line) {
+        compact_flush_run();
+        run_file = compact_file;
+        run_line = emit_line;
+    }
+    run_bytes += bytes;
+    compact_address += bytes;
+}
+
+static void compact_set_file(const char* filename) {
+    string_t* name = string_intern_cstr(filename);
+    for (size_t i = 0; i < compact_files_count; ++i) {
+        if (compact_files[i] == name) {
+            string_deref(name);
+            compact_file = i + 1;
+            return;
+        }
+    }
+
+    if (compact_files_count == compact_files_capacity) {
+        size_t new_capacity = compact_files_capacity * 2;
+        if (new_capacity < 16)
+            new_capacity = 16;
+        compact_files = realloc(compact_files, new_capacity * sizeof(string_t*));
+        if (compact_files == NULL)
+            fatal("Out of memory.");
+        compact_files_capacity = new_capacity;
+    }
+    compact_files[compact_files_count++] = name;
+    compact_file = compact_files_count;
+}
+
+static void compact_write_buffer(compact_buffer_t* buffer) {
+    compact_buffer_t count;
+    memset(&count, 0, sizeof(count));
+    compact_number(&count, buffer->count);
+    fwrite(count.bytes, 1, count.size, debug_file);
+    free(count.bytes);
+    if (buffer->size != fwrite(buffer->bytes, 1, buffer->size, debug_file)) {
+        fatal("Failed to write debug file.");
+    }
+}
+
+/** Writes the compact debug info file. */
+static void compact_write(void) {
+    compact_flush_run();
+
+    // header
+    fputc(0x7F, debug_file);
+    fputc('O', debug_file);
+    fputc('D', debug_file);
+    fputc(1, debug_file);
+
+    compact_buffer_t files;
+    memset(&files, 0, sizeof(files));
+    for (size_t i = 0; i < compact_files_count; ++i) {
+        compact_string(&files, compact_files[i]->bytes);
+        ++files.count;
+    }
+    compact_write_buffer(&files);
+    free(files.bytes);
+
+    compact_write_buffer(&compact_symbols);
+    compact_write_buffer(&compact_runs);
+}
+
+static void compact_destroy(void) {
+    for (size_t i = 0; i < compact_files_count; ++i) {
+        string_deref(compact_files[i]);
+    }
+    free(compact_files);
+    free(compact_symbols.bytes);
+    free(compact_runs.bytes);
+}
+
+
+
+/*
+ * Emit
+ */
+
 void emit_byte_count(void) {
     if (bytes_emitted == 0) {
         return;
     }
-    if (option_debug && emit_filename) {
+    if (option_debug_compact) {
+        compact_count(bytes_emitted);
+    } else if (option_debug && emit_filename) {
         fprintf(debug_file, "%i\n", bytes_emitted);
     }
     bytes_emitted = 0;
@@ -45,16 +221,24 @@ void emit_init(void) {
 
 void emit_destroy(void) {
     emit_byte_count();
+    if (option_debug_compact && debug_file) {
+        compact_write();
+    }
+    compact_destroy();
     free(emit_filename);
     free(emit_current_symbol);
 }
 
 void emit_byte(char c) {
-    //printf("emit byte '%x pass %i\n", c, pass);
-    if (pass == 3) {
-        fputc(c, output_file);
-        ++bytes_emitted;
+    fputc(c, output_file);
+    ++bytes_emitted;
+}
+
+void emit_bytes(const char* bytes, size_t count) {
+    if (count != fwrite(bytes, 1, count, output_file)) {
+        fatal("Failed to write output file.");
     }
+    bytes_emitted += count;
 }
 
 void emit_short(int s) {
@@ -70,9 +254,6 @@ void emit_int(int s) {
 }
 
 void emit_debug(char c) {
-    if (pass != 3) {
-        return;
-    }
     if (!option_debug) {
         return;
     }
@@ -80,11 +261,18 @@ void emit_debug(char c) {
 }
 
 void emit_source_location(const char* /*nullable*/ filename, int line) {
-    //printf("set source %s %i %i\n",filename,line, pass);
-    if (pass != 3) {
+    if (!option_debug) {
         return;
     }
-    if (!option_debug) {
+
+    if (option_debug_compact) {
+        emit_byte_count();
+        if (filename != NULL && (emit_filename == NULL || 0 != strcmp(filename, emit_filename))) {
+            free(emit_filename);
+            emit_filename = strdup(filename);
+            compact_set_file(filename);
+        }
+        emit_line = line;
         return;
     }
 
@@ -119,9 +307,6 @@ void emit_source_location(const char* /*nullable*/ filename, int line) {
 }
 
 void emit_symbol(const char* symbol) {
-    if (pass != 3) {
-        return;
-    }
     if (!option_debug) {
         return;
     }
@@ -135,6 +320,13 @@ void emit_symbol(const char* symbol) {
     emit_byte_count();
     free(emit_current_symbol);
     emit_current_symbol = strdup(symbol);
+    if (option_debug_compact) {
+        compact_number(&compact_symbols, compact_address - compact_symbol_address);
+        compact_string(&compact_symbols, symbol);
+        ++compact_symbols.count;
+        compact_symbol_address = compact_address;
+        return;
+    }
     fprintf(debug_file, "#symbol %s\n", emit_current_symbol);
 }
 
@@ -31,6 +31,7 @@ void emit_init(void);
 void emit_destroy(void);
 
 void emit_byte(char c);
+void emit_bytes(const char* bytes, size_t count);
 void emit_short(int s);
 void emit_int(int s);
 
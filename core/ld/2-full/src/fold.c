@@ -0,0 +1,608 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "fold.h"
+
+#include "common.h"
+#include "object.h"
+#include "symbol.h"
+
+// The Onramp C compilers emit string literals as static symbols whose names
+// start with this prefix. String literals are read-only so identical ones can
+// share storage.
+#define STRING_LITERAL_PREFIX "_Sx"
+
+/**
+ * A symbol that can be folded.
+ *
+ * The contents of the symbol are the records of its object from `first` up to
+ * (but not including) `last`.
+ */
+typedef struct fold_t {
+    table_entry_t entry; // The entry in the fold table (must be first)
+    symbol_t* symbol;
+    object_t* object;
+    size_t first;
+    size_t last;
+    bool is_string;
+} fold_t;
+
+/**
+ * A position within the contents of a foldable symbol.
+ */
+typedef struct fold_cursor_t {
+    fold_t* fold;
+    size_t index; // The index of the current record
+    int offset;   // The offset within the current run of bytes
+} fold_cursor_t;
+
+static fold_t* folds;
+static size_t folds_count;
+static size_t folds_capacity;
+
+static int strings_folded;
+static int strings_bytes_saved;
+static int functions_folded;
+static int functions_bytes_saved;
+
+static fold_t* fold_append(symbol_t* symbol, object_t* object, size_t first) {
+    if (folds_count == folds_capacity) {
+        size_t new_capacity = folds_capacity * 2;
+        if (new_capacity < 64)
+            new_capacity = 64;
+        if (new_capacity <= folds_capacity)
+            fatal("Out of memory.");
+        folds = realloc(folds, new_capacity * sizeof(fold_t));
+        if (folds == NULL)
+            fatal("Out of memory.");
+        folds_capacity = new_capacity;
+    }
+
+    fold_t* fold = folds + folds_count++;
+    fold->symbol = symbol;
+    fold->object = object;
+    fold->first = first;
+    fold->last = first;
+    fold->is_string = false;
+    return fold;
+}
+
+static void fold_cursor_init(fold_cursor_t* cursor, fold_t* fold) {
+    cursor->fold = fold;
+    cursor->index = fold->first;
+    cursor->offset = 0;
+}
+
+/**
+ * Returns the record at the cursor, skipping records that don't contribute to
+ * the contents of the symbol, or null at the end of the symbol.
+ *
+ * To advance past bytes, add to the offset. To advance past an invocation,
+ * increment the index.
+ */
+static record_t* fold_cursor_record(fold_cursor_t* cursor) {
+    fold_t* fold = cursor->fold;
+    while (cursor->index < fold->last) {
+        record_t* record = fold->object->records + cursor->index;
+        if (record->type == RECORD_BYTES && cursor->offset < record->length) {
+            return record;
+        }
+        if (record->type == RECORD_INVOKE_SYMBOL || record->type == RECORD_INVOKE_LABEL) {
+            return record;
+        }
+        ++cursor->index;
+        cursor->offset = 0;
+    }
+    return NULL;
+}
+
+/**
+ * Returns the symbol invoked by the given record of the given foldable symbol
+ * and stores the address invoked within it in `offset`.
+ *
+ * Symbols that have been folded are replaced by the symbol they were folded
+ * into. Returns null if the symbol doesn't exist.
+ */
+static symbol_t* fold_target(fold_t* fold, record_t* record, int* offset) {
+    symbol_t* target;
+    if (record->type == RECORD_INVOKE_LABEL) {
+        target = record->pointer;
+        *offset = record->value;
+    } else {
+        target = symbols_find(record->pointer, fold->object->file_index);
+        *offset = 0;
+    }
+    while (target != NULL && target->folded != NULL) {
+        target = target->folded;
+    }
+    return target;
+}
+
+/**
+ * Returns true if the given symbol starts with the standard function prologue
+ * emitted by the `enter` instruction (`push rfp` and `mov rfp rsp`.) Symbols
+ * are only folded as functions if they start with it.
+ */
+static bool fold_has_prologue(fold_t* fold) {
+    // the prologue bytes as little-endian words
+    uint32_t prologue[3];
+    prologue[0] = 0x048C8C71u;
+    prologue[1] = 0x8C008D79u;
+    prologue[2] = 0x008C8D70u;
+
+    fold_cursor_t cursor;
+    fold_cursor_init(&cursor, fold);
+    for (int i = 0; i < 12; ++i) {
+        record_t* record = fold_cursor_record(&cursor);
+        if (record == NULL || record->type != RECORD_BYTES) {
+            return false;
+        }
+        uint8_t byte = fold->object->bytes[record->value + cursor.offset];
+        if (byte != ((prologue[i >> 2] >> ((i & 3) << 3)) & 0xFFu)) {
+            return false;
+        }
+        ++cursor.offset;
+    }
+    return true;
+}
+
+/**
+ * Returns true if the contents of the given object starting at the given
+ * record and offset are the given bytes (packed into little-endian words.)
+ * Records that don't emit anything are skipped. On success the record index
+ * and offset are advanced past the bytes.
+ */
+static bool fold_match_bytes(object_t* object, size_t* index, int* offset,
+        uint32_t* words, int count)
+{
+    size_t i = *index;
+    int o = *offset;
+    for (int n = 0; n < count; ++n) {
+        record_t* record = NULL;
+        while (i < object->records_count) {
+            record = object->records + i;
+            if (record->type == RECORD_BYTES && o < record->length) {
+                break;
+            }
+            if (record->type != RECORD_BYTES && record->type != RECORD_LOCATION &&
+                    record->type != RECORD_LINES && record->type != RECORD_INCREMENT)
+            {
+                return false;
+            }
+            ++i;
+            o = 0;
+        }
+        if (i == object->records_count) {
+            return false;
+        }
+        uint8_t byte = object->bytes[record->value + o];
+        if (byte != ((words[n >> 2] >> ((n & 3) << 3)) & 0xFFu)) {
+            return false;
+        }
+        ++o;
+    }
+    *index = i;
+    *offset = o;
+    return true;
+}
+
+/**
+ * Returns true if the invocation at the given record of the given object is
+ * the start of a `call ^symbol` or `jmp ^symbol` of the given symbol.
+ *
+ * The assembler emits both as `imw ra ^symbol` (`ims ra <symbol ims ra
+ * >symbol`) followed by `add rip rpp ra`; a call first pushes the return
+ * address. The given record is the high invocation.
+ */
+static bool fold_is_call(object_t* object, size_t index, symbol_t* symbol) {
+    record_t* high = object->records + index;
+    if (high->type != RECORD_INVOKE_SYMBOL || high->kind != '<' || index == 0) {
+        return false;
+    }
+
+    // ims ra
+    uint32_t ims_ra[1];
+    ims_ra[0] = 0x00008A7Cu;
+
+    // the first ims ra directly precedes the high invocation
+    record_t* before = high - 1;
+    if (before->type != RECORD_BYTES || before->length < 2) {
+        return false;
+    }
+    size_t i = index - 1;
+    int offset = before->length - 2;
+    if (!fold_match_bytes(object, &i, &offset, ims_ra, 2)) {
+        return false;
+    }
+
+    // the second ims ra and the low invocation of the same symbol
+    i = index + 1;
+    offset = 0;
+    if (!fold_match_bytes(object, &i, &offset, ims_ra, 2)) {
+        return false;
+    }
+    if (offset != object->records[i].length) {
+        return false;
+    }
+    ++i;
+    if (i == object->records_count) {
+        return false;
+    }
+    record_t* low = object->records + i;
+    if (low->type != RECORD_INVOKE_SYMBOL || low->kind != '>' ||
+            symbols_find(low->pointer, object->file_index) != symbol)
+    {
+        return false;
+    }
+
+    // add rip rpp ra (jmp)
+    uint32_t jump[1];
+    jump[0] = 0x8A8E8F70u;
+
+    // push the return address and add rip rpp ra (call)
+    uint32_t call[4];
+    call[0] = 0x048C8C71u;
+    call[1] = 0x088F8B70u;
+    call[2] = 0x8C008B79u;
+    call[3] = 0x8A8E8F70u;
+
+    size_t after = i + 1;
+    offset = 0;
+    if (fold_match_bytes(object, &after, &offset, jump, 4)) {
+        return true;
+    }
+    after = i + 1;
+    offset = 0;
+    return fold_match_bytes(object, &after, &offset, call, 16);
+}
+
+/**
+ * Marks the symbols whose address is taken.
+ *
+ * C requires distinct functions to have distinct addresses so a function can
+ * only be folded if nothing can observe its address, i.e. if every invocation
+ * of it in a used symbol is a call or jump. Invocations of a symbol's own
+ * labels don't count.
+ */
+static void fold_mark_address_taken(void) {
+    // Bytes at the start of an object belong to the last symbol of the
+    // previous object.
+    symbol_t* current = NULL;
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+
+            if (record->type == RECORD_SYMBOL) {
+                current = record->pointer;
+                continue;
+            }
+            if (current != NULL && !current->is_used) {
+                continue;
+            }
+
+            if (record->type == RECORD_INVOKE_LABEL) {
+                symbol_t* target = record->pointer;
+                if (target != current) {
+                    target->address_taken = true;
+                }
+                continue;
+            }
+            if (record->type != RECORD_INVOKE_SYMBOL) {
+                continue;
+            }
+
+            symbol_t* target = symbols_find(record->pointer, object->file_index);
+            if (target == NULL) {
+                continue;
+            }
+            if (fold_is_call(object, j, target)) {
+                // skip the low invocation
+                while (object->records[j].type != RECORD_INVOKE_SYMBOL ||
+                        object->records[j].kind != '>')
+                {
+                    ++j;
+                }
+                continue;
+            }
+            target->address_taken = true;
+        }
+    }
+}
+
+static uint32_t fold_hash_int(uint32_t hash, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        hash = ((hash ^ (value & 0xFFu)) * 16777619u);
+        value >>= 8;
+    }
+    return hash;
+}
+
+/**
+ * Hashes the contents of a foldable symbol. Symbols that are equal according
+ * to fold_equal() have the same hash.
+ */
+static uint32_t fold_hash(fold_t* fold) {
+    uint32_t hash = 2166136261u;
+    fold_cursor_t cursor;
+    fold_cursor_init(&cursor, fold);
+
+    for (;;) {
+        record_t* record = fold_cursor_record(&cursor);
+        if (record == NULL) {
+            break;
+        }
+
+        if (record->type == RECORD_BYTES) {
+            const char* p = fold->object->bytes + record->value + cursor.offset;
+            const char* end = fold->object->bytes + record->value + record->length;
+            while (p != end) {
+                hash = ((hash ^ (*p++ & 0xFFu)) * 16777619u);
+            }
+            cursor.offset = record->length;
+            continue;
+        }
+
+        int offset;
+        symbol_t* target = fold_target(fold, record, &offset);
+        hash = fold_hash_int(hash, record->kind);
+        hash = fold_hash_int(hash, offset);
+        if (target != NULL && target != fold->symbol) {
+            hash = fold_hash_int(hash, string_hash(target->name));
+        }
+        ++cursor.index;
+    }
+
+    return hash;
+}
+
+/**
+ * Returns true if the given foldable symbols have identical contents.
+ *
+ * Invocations must have the same type and target. Invocations of a symbol
+ * itself (for example recursive calls or jumps to its own labels) match each
+ * other.
+ */
+static bool fold_equal(fold_t* a, fold_t* b) {
+    if (a->symbol->size != b->symbol->size) {
+        return false;
+    }
+
+    fold_cursor_t cursor_a;
+    fold_cursor_t cursor_b;
+    fold_cursor_init(&cursor_a, a);
+    fold_cursor_init(&cursor_b, b);
+
+    for (;;) {
+        record_t* record_a = fold_cursor_record(&cursor_a);
+        record_t* record_b = fold_cursor_record(&cursor_b);
+        if (record_a == NULL || record_b == NULL) {
+            return record_a == record_b;
+        }
+
+        // Compare bytes. The runs of bytes may be split differently by line
+        // information so we compare as much as we can of both.
+        bool bytes_a = record_a->type == RECORD_BYTES;
+        bool bytes_b = record_b->type == RECORD_BYTES;
+        if (bytes_a != bytes_b) {
+            return false;
+        }
+        if (bytes_a) {
+            int count = record_a->length - cursor_a.offset;
+            if (count > record_b->length - cursor_b.offset) {
+                count = record_b->length - cursor_b.offset;
+            }
+            if (0 != memcmp(a->object->bytes + record_a->value + cursor_a.offset,
+                        b->object->bytes + record_b->value + cursor_b.offset, count))
+            {
+                return false;
+            }
+            cursor_a.offset += count;
+            cursor_b.offset += count;
+            continue;
+        }
+
+        // Compare invocations.
+        if (record_a->kind != record_b->kind) {
+            return false;
+        }
+        int offset_a;
+        int offset_b;
+        symbol_t* target_a = fold_target(a, record_a, &offset_a);
+        symbol_t* target_b = fold_target(b, record_b, &offset_b);
+        if (target_a == NULL || target_b == NULL || offset_a != offset_b) {
+            return false;
+        }
+        bool self_a = target_a == a->symbol;
+        bool self_b = target_b == b->symbol;
+        if (self_a != self_b) {
+            return false;
+        }
+        if (!self_a && target_a != target_b) {
+            return false;
+        }
+        ++cursor_a.index;
+        ++cursor_b.index;
+    }
+}
+
+static bool fold_is_candidate(symbol_t* symbol) {
+    return symbol->is_used && !symbol->zero &&
+            !symbol->constructor && !symbol->destructor;
+}
+
+/**
+ * Collects the symbols that can be folded along with the range of records
+ * that contain them.
+ */
+static void fold_collect(void) {
+    fold_t* current = NULL;
+    bool first_symbol = true;
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+
+        // Bytes at the start of an object belong to the last symbol of the
+        // previous object. Such a symbol is split across objects so we don't
+        // fold it. (It's always the last one collected.)
+        fold_t* previous = current;
+        current = NULL;
+
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+
+            if (record->type == RECORD_SYMBOL) {
+                if (current != NULL) {
+                    current->last = j;
+                }
+                current = NULL;
+                previous = NULL;
+
+                // The first symbol is the entry point so it is never folded.
+                symbol_t* symbol = record->pointer;
+                if (!first_symbol && fold_is_candidate(symbol)) {
+                    current = fold_append(symbol, object, j + 1);
+                }
+                first_symbol = false;
+                continue;
+            }
+
+            if (previous != NULL && (record->type == RECORD_BYTES ||
+                        record->type == RECORD_INVOKE_SYMBOL ||
+                        record->type == RECORD_INVOKE_LABEL))
+            {
+                --folds_count;
+                previous = NULL;
+            }
+        }
+
+        if (current != NULL) {
+            current->last = object->records_count;
+        }
+    }
+
+    // Keep only string literals and functions.
+    size_t count = 0;
+    for (size_t i = 0; i < folds_count; ++i) {
+        fold_t* fold = folds + i;
+        symbol_t* symbol = fold->symbol;
+        fold->is_string = symbol->file_index != -1 && symbol->name->length > 3 &&
+                0 == memcmp(symbol->name->bytes, STRING_LITERAL_PREFIX, 3);
+        if (fold->is_string || fold_has_prologue(fold)) {
+            if (count != i) {
+                memcpy(folds + count, fold, sizeof(fold_t));
+            }
+            ++count;
+        }
+    }
+    folds_count = count;
+}
+
+static void fold_symbol(fold_t* fold, fold_t* into) {
+    symbol_t* symbol = fold->symbol;
+    symbol->folded = into->symbol;
+    symbol->is_used = false;
+
+    // the bytes removed from the output, including its alignment padding
+    int size = symbol_image_size(symbol);
+    if (fold->is_string) {
+        ++strings_folded;
+        strings_bytes_saved += size;
+    } else {
+        ++functions_folded;
+        functions_bytes_saved += size;
+    }
+}
+
+/**
+ * Folds symbols into identical symbols that precede them. Returns true if any
+ * symbols were folded.
+ */
+static bool fold_pass(void) {
+    bool folded = false;
+    table_t table;
+    table_init(&table);
+
+    for (size_t i = 0; i < folds_count; ++i) {
+        fold_t* fold = folds + i;
+        if (fold->symbol->folded != NULL) {
+            continue;
+        }
+
+        // A function whose address is taken is never folded but other
+        // functions can still be folded into it.
+        uint32_t hash = fold_hash(fold);
+        table_entry_t* entry = NULL;
+        if (fold->is_string || !fold->symbol->address_taken) {
+            entry = table_bucket(&table, hash);
+        }
+
+        // The fold table entry is the first field of the fold.
+        while (entry) {
+            fold_t* other = (fold_t*)entry;
+            if (table_entry_hash(entry) == hash &&
+                    other->is_string == fold->is_string &&
+                    fold_equal(fold, other))
+            {
+                fold_symbol(fold, other);
+                folded = true;
+                break;
+            }
+            entry = table_entry_next(entry);
+        }
+
+        if (fold->symbol->folded == NULL) {
+            table_put(&table, &fold->entry, hash);
+        }
+    }
+
+    table_destroy(&table);
+    return folded;
+}
+
+void symbols_fold(void) {
+    fold_collect();
+    fold_mark_address_taken();
+
+    // Folding symbols can make the symbols that invoke them identical so we
+    // repeat until nothing changes.
+    while (fold_pass()) {
+    }
+
+    free(folds);
+    folds = NULL;
+    folds_count = 0;
+    folds_capacity = 0;
+}
+
+void symbols_fold_print_stats(void) {
+    printf("Folded %i identical string literals, saving %i bytes.\n",
+            strings_folded, strings_bytes_saved);
+    printf("Folded %i identical functions, saving %i bytes.\n",
+            functions_folded, functions_bytes_saved);
+    printf("Saved %i bytes in total.\n",
+            strings_bytes_saved + functions_bytes_saved);
+}
@@ -0,0 +1,51 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FOLD_H_INCLUDED
+#define FOLD_H_INCLUDED
+
+#include "common.h"
+
+/**
+ * Folds identical symbols.
+ *
+ * This is called with -O after used symbols are marked. Symbols whose bytes
+ * and invocations are identical are folded into the first of them: the copies
+ * are no longer emitted and their addresses become that of the first.
+ *
+ * Only string literals and functions are folded. We can't tell whether other
+ * symbols are writable so they are always kept distinct. Functions whose
+ * address is taken (that are invoked other than by a call or jump) are never
+ * folded since they must have distinct addresses.
+ */
+void symbols_fold(void);
+
+/**
+ * Prints a summary of the symbols folded and the bytes they took up in the
+ * output (including alignment padding.)
+ */
+void symbols_fold_print_stats(void);
+
+#endif
@@ -34,13 +34,19 @@
  */
 
 label_t* label_new(string_t* name) {
-    label_t* label = malloc(sizeof(label_t));
+    label_t* label = calloc(1, sizeof(label_t));
+    if (label == NULL) {
+        fatal("Out of memory.");
+    }
     label->name = name;
     return label;
 }
 
 void label_delete(label_t* label) {
     string_deref(label->name);
+    if (label->filename) {
+        string_deref(label->filename);
+    }
     free(label);
 }
 
@@ -50,53 +56,43 @@ void label_delete(label_t* label) {
  * Label hashtable
  */
 
-// label hashtable (in the current file)
-static label_t** labels;
-#define LABELS_SIZE 128
-#define LABELS_MASK 127
+// label hashtable (in the current file). Names are interned so they are
+// compared by pointer.
+static table_t labels;
 
 void labels_init(void) {
-    labels = calloc(LABELS_SIZE, sizeof(label_t*));
+    table_init(&labels);
 }
 
 void labels_destroy(void) {
-    labels_clear();
-    free(labels);
+    table_destroy(&labels);
 }
 
-label_t* labels_find(const char* bytes, size_t length) {
-    uint32_t hash = fnv1a_bytes(bytes, length);
-    label_t* label = labels[hash & LABELS_MASK];
-    while (label) {
-        if (string_equal_bytes(label->name, bytes, length)) {
+label_t* labels_find(string_t* name) {
+    // The label table entry is the first field of the label.
+    table_entry_t* entry = table_bucket(&labels, string_hash(name));
+    while (entry) {
+        label_t* label = (label_t*)entry;
+        if (label->name == name) {
             return label;
         }
-        label = label->next;
+        entry = table_entry_next(entry);
     }
     return NULL;
 }
 
 void labels_insert(label_t* label) {
-    size_t index = string_hash(label->name) & LABELS_MASK;
-    label->next = labels[index];
-    labels[index] = label;
+    table_put(&labels, &label->entry, string_hash(label->name));
 }
 
 void labels_clear(void) {
-    for (size_t i = 0; i < LABELS_SIZE; ++i) {
-        label_t* label = labels[i];
-        while (label) {
-            label_t* next = label->next;
-            label_delete(label);
-            label = next;
-        }
-        labels[i] = NULL;
-    }
+    // The labels are owned by their objects so we just drop the table.
+    table_destroy(&labels);
+    table_init(&labels);
 }
 
-label_t* labels_define(const char* bytes, size_t length) {
-    string_t* string = string_intern_bytes(bytes, length);
-    label_t* label = label_new(string);
+label_t* labels_define(string_t* name) {
+    label_t* label = label_new(name);
     labels_insert(label);
     return label;
 }
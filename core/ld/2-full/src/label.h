@@ -36,10 +36,14 @@ struct symbol_t;
  */
 
 typedef struct label_t {
+    table_entry_t entry; // The entry in the label table (must be first)
     struct symbol_t* symbol;
-    struct label_t* next;
     string_t* name;
     size_t address; // relative to start of symbol
+
+    // The source location of the label definition (for error messages)
+    string_t* filename;
+    int line;
 } label_t;
 
 /**
@@ -65,11 +69,25 @@ void labels_init(void);
 
 void labels_destroy(void);
 
+/**
+ * Removes all labels from the hashtable.
+ *
+ * This does not delete the labels. They are owned by the object in which they
+ * are defined.
+ */
 void labels_clear(void);
 
-label_t* labels_define(const char* bytes, size_t length);
+/**
+ * Defines a new label with the given name, inserting it into the hashtable.
+ *
+ * The label takes ownership of the given string.
+ */
+label_t* labels_define(string_t* name);
 
-label_t* labels_find(const char* bytes, size_t length);
+/**
+ * Finds a label with the given interned name, or null if it isn't defined.
+ */
+label_t* labels_find(string_t* name);
 
 void labels_insert(label_t* label);
 
@@ -37,6 +37,11 @@
 #include "common.h"
 #include "symbol.h"
 #include "label.h"
+#include "object.h"
+#include "archive.h"
+#include "fold.h"
+#include "map.h"
+#include "relocatable.h"
 #include "parse.h"
 #include "emit.h"
 
@@ -46,6 +51,8 @@ static size_t input_filenames_capacity;
 
 static const char* output_filename;
 static const char* wrap_header;
+static const char* map_filename;
+static bool option_stats;
 
 static void parse_args(const char** argv) {
     input_filenames_count = 0;
@@ -67,6 +74,20 @@ static void parse_args(const char** argv) {
             continue;
         }
 
+        // relocatable output
+        if (0 == strcmp(*argv, "-r")) {
+            option_relocatable = true;
+            ++argv;
+            continue;
+        }
+
+        // statistics
+        if (0 == strcmp(*argv, "-stats")) {
+            option_stats = true;
+            ++argv;
+            continue;
+        }
+
         // debug info
         if (0 == strcmp(*argv, "-g")) {
             option_debug = true;
@@ -74,6 +95,14 @@ static void parse_args(const char** argv) {
             continue;
         }
 
+        // compact binary debug info
+        if (0 == strcmp(*argv, "-compact-debug")) {
+            option_debug = true;
+            option_debug_compact = true;
+            ++argv;
+            continue;
+        }
+
         // wrap header
         if (0 == strcmp(*argv, "-wrap-header")) {
             if (*++argv == 0) {
@@ -86,6 +115,18 @@ static void parse_args(const char** argv) {
             continue;
         }
 
+        // map file
+        if (0 == strcmp(*argv, "-Map")) {
+            if (*++argv == 0) {
+                fatal("-Map must be followed by an output file.");
+            }
+            if (map_filename != NULL) {
+                fatal("Only one -Map file can be specified.");
+            }
+            map_filename = *argv++;
+            continue;
+        }
+
         // output file
         if (0 == strcmp(*argv, "-o")) {
             if (*++argv == 0) {
@@ -119,6 +160,19 @@ static void parse_args(const char** argv) {
     if (output_filename == NULL) {
         fatal("No -o output file specified.");
     }
+
+    // a relocatable object has no addresses yet
+    if (option_relocatable) {
+        if (option_optimize) {
+            fatal("-r cannot be combined with -O.");
+        }
+        if (wrap_header != NULL) {
+            fatal("-r cannot be combined with -wrap-header.");
+        }
+        if (map_filename != NULL) {
+            fatal("-r cannot be combined with -Map.");
+        }
+    }
 }
 
 static void open_output_files(void) {
@@ -150,7 +204,8 @@ static void open_output_files(void) {
         free(buffer);
     }
 
-    if (option_debug) {
+    // with -r, debug lines are kept in the output itself
+    if (option_debug && !option_relocatable) {
         char* debug_filename = 0;
         if (-1 == asprintf(&debug_filename, "%s.od", output_filename)) {
             fatal("Out of memory.");
@@ -161,10 +216,31 @@ static void open_output_files(void) {
         }
         free(debug_filename);
 
-        fputs("; Onramp debug info for: ", debug_file);
-        fputs(output_filename, debug_file);
-        fputc('\n', debug_file);
+        // compact debug info is written when we're done (see emit.c)
+        if (!option_debug_compact) {
+            fputs("; Onramp debug info for: ", debug_file);
+            fputs(output_filename, debug_file);
+            fputc('\n', debug_file);
+        }
+    }
+}
+
+static void link_objects(void) {
+    if (option_optimize) {
+        // collect symbol usage information and walk from the roots to mark
+        // used symbols
+        objects_collect_use();
+        symbols_walk_use();
+
+        // merge identical string literals and functions
+        symbols_fold();
     }
+
+    symbols_assign_addresses();
+
+    // output all used symbols, followed by generated symbols.
+    objects_emit();
+    symbols_emit_generated();
 }
 
 int main(int argc, const char** argv) {
@@ -172,52 +248,51 @@ int main(int argc, const char** argv) {
     emit_init();
     symbols_init();
     labels_init();
+    objects_init();
+    archives_init();
 
     buffer = malloc(BUFFER_SIZE);
 
     parse_args(argv);
 
-    // first pass: collect all symbol names and measure sizes.
-    pass = 0;
-    perform_pass(input_filenames, input_filenames_count);
-    symbols_create_generated();
-
-    if (optimize) {
-        // second pass: collect symbol usage information.
-        pass = 1;
-        perform_pass(input_filenames, input_filenames_count);
-
-        // walk from the roots to mark used symbols
-        symbols_walk_use();
+    // read all input files once, collecting symbols and measuring sizes.
+    parse_input_files(input_filenames, input_filenames_count);
+    if (!option_relocatable) {
+        symbols_create_generated();
     }
+    objects_check_labels();
 
-    symbols_assign_addresses();
     open_output_files();
-
-    // third and fourth passes: collect labels and output symbols.
-    pass = 2;
-    perform_pass(input_filenames, input_filenames_count);
-
-    // emit generated symbols. (we have to manually set the pass to 3 because
-    // emit calls are ignored otherwise.)
-    pass = 3;
-    symbols_emit_generated();
+    if (option_relocatable) {
+        // merge all objects into one object file
+        relocatable_write();
+    } else {
+        link_objects();
+    }
 
     set_current_filename(NULL);
     free(buffer);
 
+    if (map_filename != NULL) {
+        map_write(map_filename, output_filename);
+    }
+
+    if (option_stats) {
+        symbols_fold_print_stats();
+    }
+
+    objects_destroy();
+    archives_destroy();
     labels_destroy();
     symbols_destroy();
     emit_destroy();
     string_table_destroy();
 
-    ;//printf("closing output\n");
     if (debug_file) {
         fclose(debug_file);
     }
     fclose(output_file);
 
-    //printf("total %i\n",total_labels);
     return EXIT_SUCCESS;
 }
 
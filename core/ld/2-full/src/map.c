@@ -0,0 +1,265 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "map.h"
+
+#include "common.h"
+#include "object.h"
+#include "symbol.h"
+
+/**
+ * The total size of the symbols of an archive or object.
+ */
+typedef struct map_total_t {
+    string_t* name;
+    int kept;    // The size of the symbols that were emitted
+    int removed; // The size of the symbols that were removed
+} map_total_t;
+
+static FILE* map_file;
+
+static map_total_t* archive_totals;
+static size_t archive_totals_count;
+static size_t archive_totals_capacity;
+
+static void map_hex(uint32_t value) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        int digit = (value >> shift) & 0xF;
+        if (digit < 10) {
+            fputc('0' + digit, map_file);
+        } else {
+            fputc('A' + digit - 10, map_file);
+        }
+    }
+}
+
+/** Writes a number in decimal, right-aligned in the given width. */
+static void map_decimal(int value, int width) {
+    char buffer[12];
+    itoa_d(value, buffer);
+    for (int i = strlen(buffer); i < width; ++i) {
+        fputc(' ', map_file);
+    }
+    fputs(buffer, map_file);
+}
+
+/** Writes the name of an object, including its archive if any. */
+static void map_object_name(object_t* object) {
+    if (object == NULL) {
+        fputs("<builtin>", map_file);
+        return;
+    }
+    if (object->archive) {
+        fputs(object->archive->bytes, map_file);
+        fputc('(', map_file);
+        fputs(object->filename->bytes, map_file);
+        fputc(')', map_file);
+        return;
+    }
+    fputs(object->filename->bytes, map_file);
+}
+
+/** Writes the reason a symbol was kept. */
+static void map_kept_reason(symbol_t* symbol) {
+    if (symbol->used_by) {
+        fputs("used by ", map_file);
+        fputs(symbol->used_by->name->bytes, map_file);
+    } else if (symbol->object == NULL) {
+        fputs("generated", map_file);
+    } else if (symbol == symbols_first()) {
+        fputs("entry point", map_file);
+    } else if (symbol->constructor) {
+        fputs("constructor", map_file);
+    } else if (symbol->destructor) {
+        fputs("destructor", map_file);
+    }
+}
+
+static void map_write_kept(void) {
+    fputs("\n; Symbols\n;\n", map_file);
+    if (option_optimize) {
+        fputs("; address      size  name  object  reason kept\n", map_file);
+    } else {
+        fputs("; address      size  name  object\n", map_file);
+    }
+
+    for (symbol_t* symbol = symbols_first(); symbol; symbol = symbol->next_all) {
+        if (!symbol->is_used) {
+            continue;
+        }
+        map_hex(symbol->address);
+        map_decimal(symbol_image_size(symbol), 10);
+        fputs("  ", map_file);
+        fputs(symbol->name->bytes, map_file);
+        fputs("  ", map_file);
+        map_object_name(symbol->object);
+        if (option_optimize) {
+            fputs("  ", map_file);
+            map_kept_reason(symbol);
+        }
+        fputc('\n', map_file);
+    }
+}
+
+static void map_write_removed(void) {
+    fputs("\n; Removed symbols\n;\n", map_file);
+    fputs(";     size  name  object  reason removed\n", map_file);
+
+    for (symbol_t* symbol = symbols_first(); symbol; symbol = symbol->next_all) {
+        if (symbol->is_used) {
+            continue;
+        }
+        map_decimal(symbol_image_size(symbol), 10);
+        fputs("  ", map_file);
+        fputs(symbol->name->bytes, map_file);
+        fputs("  ", map_file);
+        map_object_name(symbol->object);
+        if (symbol->folded) {
+            fputs("  folded into ", map_file);
+            fputs(symbol->folded->name->bytes, map_file);
+            fputs(" in ", map_file);
+            map_object_name(symbol->folded->object);
+        } else {
+            fputs("  unused", map_file);
+        }
+        fputc('\n', map_file);
+    }
+}
+
+static map_total_t* map_archive_total(string_t* archive) {
+    for (size_t i = 0; i < archive_totals_count; ++i) {
+        if (archive_totals[i].name == archive) {
+            return archive_totals + i;
+        }
+    }
+
+    if (archive_totals_count == archive_totals_capacity) {
+        size_t new_capacity = archive_totals_capacity * 2;
+        if (new_capacity < 4)
+            new_capacity = 4;
+        archive_totals = realloc(archive_totals, new_capacity * sizeof(map_total_t));
+        if (archive_totals == NULL)
+            fatal("Out of memory.");
+        archive_totals_capacity = new_capacity;
+    }
+
+    map_total_t* total = archive_totals + archive_totals_count++;
+    total->name = archive;
+    total->kept = 0;
+    total->removed = 0;
+    return total;
+}
+
+static void map_write_totals(void) {
+    fputs("\n; Objects\n;\n", map_file);
+    fputs(";     kept   removed  object\n", map_file);
+
+    int kept = 0;
+    int removed = 0;
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        int object_kept = 0;
+        int object_removed = 0;
+        bool has_symbols = false;
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+            if (record->type != RECORD_SYMBOL) {
+                continue;
+            }
+            symbol_t* symbol = record->pointer;
+            has_symbols = true;
+            if (symbol->is_used) {
+                object_kept += symbol_image_size(symbol);
+            } else {
+                object_removed += symbol_image_size(symbol);
+            }
+        }
+
+        // skip objects that define nothing (e.g. the file containing the
+        // members of an unindexed archive)
+        if (!has_symbols) {
+            continue;
+        }
+
+        map_decimal(object_kept, 10);
+        map_decimal(object_removed, 10);
+        fputs("  ", map_file);
+        map_object_name(object);
+        fputc('\n', map_file);
+
+        if (object->archive) {
+            map_total_t* total = map_archive_total(object->archive);
+            total->kept += object_kept;
+            total->removed += object_removed;
+        }
+        kept += object_kept;
+        removed += object_removed;
+    }
+
+    if (archive_totals_count > 0) {
+        fputs("\n; Archives (members that were loaded)\n;\n", map_file);
+        fputs(";     kept   removed  archive\n", map_file);
+        for (size_t i = 0; i < archive_totals_count; ++i) {
+            map_total_t* total = archive_totals + i;
+            map_decimal(total->kept, 10);
+            map_decimal(total->removed, 10);
+            fputs("  ", map_file);
+            fputs(total->name->bytes, map_file);
+            fputc('\n', map_file);
+        }
+    }
+
+    fputs("\n; Total\n;\n", map_file);
+    fputs(";     kept   removed\n", map_file);
+    map_decimal(kept, 10);
+    map_decimal(removed, 10);
+    fputc('\n', map_file);
+}
+
+void map_write(const char* map_filename, const char* output_filename) {
+    map_file = fopen(map_filename, "w");
+    if (map_file == NULL) {
+        fatal("Failed to open map file.");
+    }
+
+    fputs("; Onramp link map for: ", map_file);
+    fputs(output_filename, map_file);
+    fputc('\n', map_file);
+
+    map_write_kept();
+    if (option_optimize) {
+        map_write_removed();
+    }
+    map_write_totals();
+
+    free(archive_totals);
+    archive_totals = NULL;
+    archive_totals_count = 0;
+    archive_totals_capacity = 0;
+
+    fclose(map_file);
+    map_file = NULL;
+}
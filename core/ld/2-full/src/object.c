@@ -0,0 +1,387 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "object.h"
+
+#include "common.h"
+#include "emit.h"
+#include "label.h"
+#include "symbol.h"
+
+
+
+/*
+ * Object
+ */
+
+object_t* object_new(const char* filename, int file_index) {
+    object_t* object = calloc(1, sizeof(object_t));
+    if (object == NULL) {
+        fatal("Out of memory.");
+    }
+    object->filename = string_intern_cstr(filename);
+    object->file_index = file_index;
+    return object;
+}
+
+static void object_delete_labels(object_t* object) {
+    for (size_t i = 0; i < object->labels_count; ++i) {
+        label_delete(object->labels[i]);
+    }
+    free(object->labels);
+    object->labels = NULL;
+    object->labels_count = 0;
+    object->labels_capacity = 0;
+}
+
+void object_clear_records(object_t* object) {
+    for (size_t i = 0; i < object->records_count; ++i) {
+        record_t* record = object->records + i;
+        if (record->type == RECORD_INVOKE_SYMBOL) {
+            string_deref(record->pointer);
+        }
+        if (record->type == RECORD_LOCATION && record->pointer) {
+            string_deref(record->pointer);
+        }
+    }
+    object->records_count = 0;
+}
+
+void object_delete(object_t* object) {
+    object_clear_records(object);
+    object_delete_labels(object);
+    string_deref(object->filename);
+    if (object->archive) {
+        string_deref(object->archive);
+    }
+    free(object->records);
+    free(object->bytes);
+    free(object);
+}
+
+record_t* object_append(object_t* object, record_type_t type) {
+    if (object->records_count == object->records_capacity) {
+        size_t new_capacity = object->records_capacity * 2;
+        if (new_capacity < 16)
+            new_capacity = 16;
+        if (new_capacity <= object->records_capacity)
+            fatal("Out of memory.");
+        object->records = realloc(object->records, new_capacity * sizeof(record_t));
+        if (object->records == NULL)
+            fatal("Out of memory.");
+        object->records_capacity = new_capacity;
+    }
+
+    record_t* record = object->records + object->records_count++;
+    record->type = type;
+    record->kind = 0;
+    record->value = 0;
+    record->length = 0;
+    record->pointer = NULL;
+    return record;
+}
+
+static record_t* object_last(object_t* object) {
+    if (object->records_count == 0) {
+        return NULL;
+    }
+    return object->records + (object->records_count - 1);
+}
+
+void object_append_byte(object_t* object, char byte) {
+    if (object->bytes_count == object->bytes_capacity) {
+        size_t new_capacity = object->bytes_capacity * 2;
+        if (new_capacity < 64)
+            new_capacity = 64;
+        if (new_capacity <= object->bytes_capacity)
+            fatal("Out of memory.");
+        object->bytes = realloc(object->bytes, new_capacity);
+        if (object->bytes == NULL)
+            fatal("Out of memory.");
+        object->bytes_capacity = new_capacity;
+    }
+
+    // extend the previous run of bytes if possible
+    record_t* record = object_last(object);
+    if (record == NULL || record->type != RECORD_BYTES) {
+        record = object_append(object, RECORD_BYTES);
+        record->value = object->bytes_count;
+    }
+    ++record->length;
+
+    object->bytes[object->bytes_count++] = byte;
+}
+
+void object_append_line(object_t* object) {
+    // extend the previous run of line endings if possible
+    record_t* record = object_last(object);
+    if (record == NULL || record->type != RECORD_LINES) {
+        record = object_append(object, RECORD_LINES);
+    }
+    ++record->length;
+}
+
+void object_add_label(object_t* object, label_t* label) {
+    if (object->labels_count == object->labels_capacity) {
+        size_t new_capacity = object->labels_capacity * 2;
+        if (new_capacity < 16)
+            new_capacity = 16;
+        if (new_capacity <= object->labels_capacity)
+            fatal("Out of memory.");
+        object->labels = realloc(object->labels, new_capacity * sizeof(label_t*));
+        if (object->labels == NULL)
+            fatal("Out of memory.");
+        object->labels_capacity = new_capacity;
+    }
+    object->labels[object->labels_count++] = label;
+}
+
+void object_resolve_labels(object_t* object) {
+    for (size_t i = 0; i < object->records_count; ++i) {
+        record_t* record = object->records + i;
+        if (record->type != RECORD_INVOKE_SYMBOL) {
+            continue;
+        }
+        string_t* name = record->pointer;
+        label_t* label = labels_find(name);
+        if (label) {
+            record->type = RECORD_INVOKE_LABEL;
+            record->pointer = label->symbol;
+            record->value = label->address;
+            string_deref(name);
+        }
+    }
+}
+
+
+
+/*
+ * Object list
+ */
+
+object_t** objects;
+size_t objects_count;
+static size_t objects_capacity;
+
+void objects_init(void) {
+    objects = NULL;
+    objects_count = 0;
+    objects_capacity = 0;
+}
+
+void objects_destroy(void) {
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_delete(objects[i]);
+    }
+    free(objects);
+}
+
+void objects_append(object_t* object) {
+    if (objects_count == objects_capacity) {
+        size_t new_capacity = objects_capacity * 2;
+        if (new_capacity < 16)
+            new_capacity = 16;
+        if (new_capacity <= objects_capacity)
+            fatal("Out of memory.");
+        objects = realloc(objects, new_capacity * sizeof(object_t*));
+        if (objects == NULL)
+            fatal("Out of memory.");
+        objects_capacity = new_capacity;
+    }
+    objects[objects_count++] = object;
+}
+
+void objects_check_labels(void) {
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        for (size_t j = 0; j < object->labels_count; ++j) {
+            label_t* label = object->labels[j];
+            if (symbols_find(label->name, object->file_index)) {
+                set_current_filename(label->filename->bytes);
+                current_line = label->line;
+                fatal("Label is already defined as a symbol");
+            }
+        }
+        // With -r the labels are kept to place the labels we write.
+        if (!option_relocatable) {
+            object_delete_labels(object);
+        }
+    }
+}
+
+void objects_collect_use(void) {
+    symbol_t* symbol = NULL;
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+
+            if (record->type == RECORD_SYMBOL) {
+                symbol = record->pointer;
+                continue;
+            }
+
+            symbol_t* target = NULL;
+            if (record->type == RECORD_INVOKE_LABEL) {
+                target = record->pointer;
+            }
+            if (record->type == RECORD_INVOKE_SYMBOL) {
+                string_t* name = record->pointer;
+                target = symbols_find(name, object->file_index);
+            }
+
+            // Missing symbols are reported when emitting.
+            if (target == NULL || symbol == NULL || target == symbol) {
+                continue;
+            }
+
+            // Skip consecutive uses of the same symbol.
+            if (symbol->use_count > 0 && symbol->use[symbol->use_count - 1] == target) {
+                continue;
+            }
+            symbol_add_use(symbol, target);
+        }
+    }
+}
+
+// Whether the bytes we're emitting belong to a used symbol. (Bytes are
+// attributed to the most recent symbol, even across objects.)
+static bool emitting;
+
+static void object_emit_invoke(char type, int address) {
+
+    // increment current address. if ^ it's 4, otherwise it's 2.
+    if (type == '^') {
+        current_address = (current_address + 4);
+    }
+    if (type != '^') {
+        current_address = (current_address + 2);
+    }
+
+    // emit the address
+    if (type == '^') {
+        emit_int(address);
+    }
+    if (type == '<') {
+        emit_short(address >> 16);
+    }
+    if (type == '>') {
+        emit_short(address);
+    }
+    if (type == '&') {
+        int offset = address - (current_address + current_symbol->address);
+        if ((offset < -0x8000) | (offset > 0xFFFF)) {
+            fatal("Relative invocation out of bounds.");
+        }
+        if (offset & 0x3) {
+            fatal("Relative invocation is misaligned.");
+        }
+        offset >>= 2;
+        emit_short(offset);
+    }
+}
+
+static void object_emit_record(object_t* object, record_t* record) {
+    switch (record->type) {
+
+        case RECORD_SYMBOL: {
+            symbol_t* symbol = record->pointer;
+            emitting = symbol->is_used;
+            if (!emitting) {
+                break;
+            }
+            // pad the previous symbol to a word boundary
+            for (int i = current_address; i & 3; ++i) {
+                emit_byte(0);
+            }
+            current_address = 0;
+            current_symbol = symbol;
+            emit_symbol(symbol->name->bytes);
+            break;
+        }
+
+        case RECORD_BYTES:
+            if (emitting) {
+                emit_bytes(object->bytes + record->value, record->length);
+                current_address += record->length;
+            }
+            break;
+
+        case RECORD_INVOKE_LABEL:
+            if (emitting) {
+                symbol_t* symbol = record->pointer;
+                object_emit_invoke(record->kind, symbol->address + record->value);
+            }
+            break;
+
+        case RECORD_INVOKE_SYMBOL:
+            if (emitting) {
+                string_t* name = record->pointer;
+                symbol_t* symbol = symbols_find(name, object->file_index);
+                if (!symbol) {
+                    fatal("Definition not found: %s", name->bytes);
+                }
+                object_emit_invoke(record->kind, symbol->address);
+            }
+            break;
+
+        case RECORD_LOCATION:
+            if (record->pointer) {
+                string_t* filename = record->pointer;
+                set_current_filename(filename->bytes);
+                emit_source_location(filename->bytes, record->value);
+            } else {
+                emit_source_location(NULL, record->value);
+            }
+            current_line = record->length;
+            break;
+
+        case RECORD_LINES:
+            for (int i = 0; i < record->length; ++i) {
+                ++current_line;
+                emit_source_location(NULL, current_line);
+            }
+            break;
+
+        case RECORD_INCREMENT:
+            current_line = record->length;
+            emit_increment_line(current_line);
+            break;
+    }
+}
+
+void objects_emit(void) {
+    current_address = 0;
+    current_symbol = NULL;
+    emitting = true;
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        set_current_filename(object->filename->bytes);
+        current_line = 0;
+        for (size_t j = 0; j < object->records_count; ++j) {
+            object_emit_record(object, object->records + j);
+        }
+    }
+}
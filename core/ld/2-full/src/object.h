@@ -0,0 +1,185 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OBJECT_H_INCLUDED
+#define OBJECT_H_INCLUDED
+
+#include "common.h"
+
+struct symbol_t;
+struct label_t;
+
+
+
+/*
+ * Record
+ */
+
+typedef enum record_type_t {
+    RECORD_SYMBOL,        // the start of a symbol definition
+    RECORD_BYTES,         // a run of raw bytes
+    RECORD_INVOKE_SYMBOL, // an invocation of a symbol by name
+    RECORD_INVOKE_LABEL,  // an invocation of a label (resolved to its symbol)
+    RECORD_LOCATION,      // a new source location (a #line directive)
+    RECORD_LINES,         // one or more line endings
+    RECORD_INCREMENT,     // a bare `#` line increment
+} record_type_t;
+
+/**
+ * A record in the contents of an object file.
+ *
+ * An object file is parsed into a list of records which together replay
+ * everything that would be emitted by linking the original text.
+ *
+ * - RECORD_SYMBOL: `pointer` is the symbol_t.
+ * - RECORD_BYTES: `value` is the offset and `length` is the number of bytes
+ *   in the object's byte buffer.
+ * - RECORD_INVOKE_SYMBOL: `pointer` is the name (a string_t) and `kind` is
+ *   the invocation type.
+ * - RECORD_INVOKE_LABEL: `pointer` is the symbol containing the label,
+ *   `value` is the address of the label in it and `kind` is the invocation
+ *   type.
+ * - RECORD_LOCATION: `pointer` is the new filename (a string_t, or null if
+ *   unchanged), `value` is the line number to emit and `length` is the line
+ *   number at which parsing continued.
+ * - RECORD_LINES: `length` is the number of line endings.
+ * - RECORD_INCREMENT: `length` is the line number after the increment.
+ */
+typedef struct record_t {
+    record_type_t type;
+    char kind;
+    int value;
+    int length;
+    void* pointer;
+} record_t;
+
+
+
+/*
+ * Object
+ */
+
+/**
+ * An object file, either a file on its own or a member of a static archive.
+ *
+ * Input files are read and parsed exactly once into a list of objects. Symbol
+ * sizes are known once all objects are parsed and labels are resolved at the
+ * end of each object. Address assignment, garbage collection and emission then
+ * run over the objects without going back to the input files.
+ */
+typedef struct object_t {
+    string_t* filename;
+    string_t* archive; // The archive containing this object, or null
+    int file_index;
+
+    record_t* records;
+    size_t records_count;
+    size_t records_capacity;
+
+    char* bytes;
+    size_t bytes_count;
+    size_t bytes_capacity;
+
+    // The labels defined in this object. These are kept until all symbols
+    // are known so we can check that no label shadows a symbol.
+    struct label_t** labels;
+    size_t labels_count;
+    size_t labels_capacity;
+} object_t;
+
+object_t* object_new(const char* filename, int file_index);
+
+void object_delete(object_t* object);
+
+/**
+ * Discards all of the object's records.
+ */
+void object_clear_records(object_t* object);
+
+/**
+ * Appends a new record to the object, returning it.
+ */
+record_t* object_append(object_t* object, record_type_t type);
+
+/**
+ * Appends a byte to the object's contents.
+ */
+void object_append_byte(object_t* object, char byte);
+
+/**
+ * Appends a line ending to the object's contents.
+ */
+void object_append_line(object_t* object);
+
+/**
+ * Adds a label to the object's list of labels, taking ownership of it.
+ */
+void object_add_label(object_t* object, struct label_t* label);
+
+/**
+ * Resolves invocations of labels in this object.
+ *
+ * This is called after the object is fully parsed. Invocations that name a
+ * label are replaced by the address of the label within its symbol.
+ */
+void object_resolve_labels(object_t* object);
+
+
+
+/*
+ * Object list
+ */
+
+/**
+ * All parsed objects in the order in which they were parsed.
+ */
+extern object_t** objects;
+extern size_t objects_count;
+
+void objects_init(void);
+
+void objects_destroy(void);
+
+/**
+ * Appends a parsed object to the list of all objects.
+ */
+void objects_append(object_t* object);
+
+/**
+ * Checks that no label in any object is also defined as a symbol visible to
+ * that object. This frees the labels (except with -r.)
+ */
+void objects_check_labels(void);
+
+/**
+ * Collects symbol usage information from all invocations.
+ */
+void objects_collect_use(void);
+
+/**
+ * Emits all used symbols of all objects.
+ */
+void objects_emit(void);
+
+#endif
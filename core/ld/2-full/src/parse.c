@@ -24,49 +24,114 @@
 
 #include "parse.h"
 
+#include "archive.h"
 #include "common.h"
-#include "emit.h"
 #include "label.h"
+#include "object.h"
 #include "symbol.h"
 
-/** Starts a new file, either a real file or a file in a static archive. */
-static void start_file(const char* new_filename) {
-    ++file_index;
-    set_current_filename(new_filename);
-    if (pass != 0) {
-        labels_clear();
+// The contents of the input file being parsed. Each input file is read into
+// memory in its entirety and parsed exactly once.
+static char* input_bytes;
+static size_t input_capacity;
+static const char* input_pos;
+static const char* input_end;
+
+static int current_char;
+
+// The input file being parsed. For an indexed archive this is the archive
+// containing the member being parsed.
+static const char* current_input_filename;
+
+// The object (file or archive member) being parsed.
+static object_t* current_object;
+
+// The current source filename, as set by the start of a file or a #line
+// directive. This is referenced by source location records and labels.
+static string_t* location_filename;
+
+static void set_location_filename(const char* filename) {
+    set_current_filename(filename);
+    if (location_filename) {
+        string_deref(location_filename);
     }
+    location_filename = string_intern_cstr(filename);
 }
 
-static void save_file_state(void) {
-    // We store the state of all these things so we can restore them later.
-    if (0 != fgetpos(input_file, &file_start_pos))
-        fatal("Failed to seek input file.");
-    file_start_address = current_address;
-    file_first_char = current_char;
+/** Finishes the current object, adding it to the list of objects. */
+static void end_object(void) {
+    if (current_object == NULL) {
+        return;
+    }
+    object_resolve_labels(current_object);
+    labels_clear();
+    objects_append(current_object);
+    current_object = NULL;
 }
 
-/** Restarts a file for another parsing pass. */
-static void restore_file_state(void) {
-    if (0 != fsetpos(input_file, &file_start_pos))
-        fatal("Failed to seek input file.");
-    current_line = 1;
-    current_address = file_start_address;
-    current_char = file_first_char;
-    emit_source_location(current_filename, 1);
+/**
+ * Starts a new object, either a real file or a file in a static archive.
+ *
+ * The given line is the line number at which parsing continues: 1 for a file
+ * or 0 for an archive member (since the line ending of the archive metadata
+ * line has not yet been parsed.)
+ */
+static void start_object(const char* new_filename, int line) {
+    end_object();
+    ++file_index;
+    line_manual = false;
+    set_location_filename(new_filename);
+    current_object = object_new(new_filename, file_index);
+
+    record_t* record = object_append(current_object, RECORD_LOCATION);
+    record->pointer = string_ref(location_filename);
+    record->value = 1;
+    record->length = line;
+    current_line = line;
 }
 
-static void next_char(void) {
-    //printf("last char %x\n",current_char);
-    //printf("reading char...\n");
-    if (1 != fread(&current_char, 1, 1, input_file)) {
-        //printf("EOF\n");
-        if (!feof(input_file)) {
-            fatal("Failed to read input file.");
+/** Reads the entire contents of the given file into memory. */
+static void read_input_file(const char* input_filename) {
+    FILE* input_file = fopen(input_filename, "rb");
+    if (input_file == NULL) {
+        fatal("Failed to open input file.");
+    }
+
+    size_t count = 0;
+    for (;;) {
+        if (count == input_capacity) {
+            size_t new_capacity = input_capacity * 2;
+            if (new_capacity < 4096)
+                new_capacity = 4096;
+            if (new_capacity <= input_capacity)
+                fatal("Out of memory.");
+            input_bytes = realloc(input_bytes, new_capacity);
+            if (input_bytes == NULL)
+                fatal("Out of memory.");
+            input_capacity = new_capacity;
         }
+        size_t step = fread(input_bytes + count, 1, input_capacity - count, input_file);
+        count += step;
+        if (step == 0) {
+            if (!feof(input_file)) {
+                fatal("Failed to read input file.");
+            }
+            break;
+        }
+    }
+    fclose(input_file);
+
+    input_pos = input_bytes;
+    input_end = input_bytes + count;
+}
+
+static void next_char(void) {
+    if (input_pos == input_end) {
         current_char = EOF;
+        return;
     }
-    //printf("read char %x\n",current_char);
+    current_char = (unsigned char)*input_pos;
+    ++input_pos;
 }
 
 static void read_name(void) {
@@ -105,10 +170,8 @@ static bool try_parse_whitespace(void) {
 
     bool was_carriage_return = (current_char == '\r');
     if (!line_manual && (was_carriage_return || (current_char == '\n'))) {
-        if (!line_manual) {
-            ++current_line;
-            emit_source_location(NULL, current_line);
-        }
+        ++current_line;
+        object_append_line(current_object);
     }
     next_char();
 
@@ -139,6 +202,56 @@ static bool try_parse_comment(void) {
     return true;
 }
 
+/**
+ * Switches to manual line mode.
+ *
+ * If the object hasn't recorded anything but its starting location and line
+ * endings yet, we drop them. The tool that generated the object provides its
+ * own locations from here on, and the object's filename is often just a
+ * compiler's temporary file, which shouldn't leak into the debug info.
+ */
+static void set_line_manual(void) {
+    line_manual = true;
+    for (size_t i = 0; i < current_object->records_count; ++i) {
+        record_type_t type = (current_object->records + i)->type;
+        if (type != RECORD_LOCATION && type != RECORD_LINES) {
+            return;
+        }
+    }
+    object_clear_records(current_object);
+}
+
+/**
+ * Records a bare `#` debug line, which increments the line number for
+ * subsequent bytes. We only increment our own line number in manual mode
+ * because we're not consuming the trailing line ending.
+ */
+static void increment_line(void) {
+    if (line_manual) {
+        ++current_line;
+    }
+    record_t* record = object_append(current_object, RECORD_INCREMENT);
+    record->length = current_line;
+}
+
+/**
+ * Records a #line directive. If the directive has a filename, it must already
+ * have been set with set_location_filename().
+ */
+static void set_line(int line, bool has_filename) {
+
+    // We reduce the given line number by 1 because we aren't going to consume
+    // the line ending of the directive here.
+    current_line = line - 1;
+
+    record_t* record = object_append(current_object, RECORD_LOCATION);
+    if (has_filename) {
+        record->pointer = string_ref(location_filename);
+    }
+    record->value = line;
+    record->length = current_line;
+}
+
 static bool try_parse_debug(void) {
     if (current_char != '#') {
         return false;
@@ -151,10 +264,7 @@ static bool try_parse_debug(void) {
     // If it's a bare '#', it's a line increment. We only increment in manual
     // mode because we're not consuming the trailing '#'.
     if (is_end_of_line(current_char)) {
-        if (line_manual) {
-            ++current_line;
-        }
-        emit_increment_line(current_line - 1); // TODO get rid of argument
+        increment_line();
         return true;
     }
 
@@ -173,7 +283,7 @@ static bool try_parse_debug(void) {
         if (0 != strcmp(buffer, "manual")) {
             fatal("Unsupported command in #line directive.");
         }
-        line_manual = true;
+        set_line_manual();
         consume_horizontal_whitespace();
         if (!is_end_of_line(current_char)) {
             fatal("Extra characters after `#line manual`.");
@@ -182,27 +292,23 @@ static bool try_parse_debug(void) {
     }
 
     // Otherwise #line is followed by a line number
-    current_line = 0;
+    int line = 0;
     if (!isdigit(current_char)) {
         fatal("#line must be followed by a line number.");
     }
     do {
-        int new_line = current_line * 10 + (current_char - '0');
-        if (new_line <= current_line) {
+        int new_line = line * 10 + (current_char - '0');
+        if (new_line <= line) {
             fatal("#line number is out of bounds.");
         }
-        current_line = new_line;
+        line = new_line;
         next_char();
     } while (isdigit(current_char));
     consume_horizontal_whitespace();
 
-    // We reduce the given line number by 1 because we aren't going to consume
-    // the line ending here.
-    --current_line;
-
     // The filename is optional. If omitted, we emit without it
     if (is_end_of_line(current_char)) {
-        emit_source_location(NULL, current_line + 1);
+        set_line(line, false);
         return true;
     }
 
@@ -230,7 +336,7 @@ static bool try_parse_debug(void) {
     next_char();
 
     // Save the new filename
-    set_current_filename(buffer);
+    set_location_filename(buffer);
 
     // The line must now end
     consume_horizontal_whitespace();
@@ -238,8 +344,7 @@ static bool try_parse_debug(void) {
         fatal("Unexpected trailing characters in #line directive");
     }
 
-    // Emit it
-    emit_source_location(current_filename, current_line + 1);
+    set_line(line, true);
     return true;
 }
 
@@ -259,15 +364,14 @@ static bool try_parse_hex(void) {
     }
 
     current_address = (current_address + 1);
-    emit_byte(value);
+    object_append_byte(current_object, value);
     return true;
 }
 
-static bool try_parse_invoke(void) {
-    char type;
-    type = current_char;
-    if ((type != '&') && (type != '^') && (type != '<') && (type != '>')) {
-        return false;
+/** Adds an invocation of the name in the buffer. */
+static void add_invocation(char type) {
+    if (current_symbol == NULL) {
+        fatal("An invocation cannot appear outside of a symbol.");
     }
 
     // increment current address. if ^ it's 4, otherwise it's 2.
@@ -278,51 +382,24 @@ static bool try_parse_invoke(void) {
         current_address = (current_address + 2);
     }
 
-    // read the label name into the buffer
-    next_char();
-    read_name();
+    // the target is resolved once all labels and symbols are known
+    record_t* record = object_append(current_object, RECORD_INVOKE_SYMBOL);
+    record->kind = type;
+    record->pointer = string_intern_bytes(buffer, buffer_length);
+}
 
-    // we only check for validity and emit the address in the final pass
-    if (pass != 3) {
-        return true;
+static bool try_parse_invoke(void) {
+    char type;
+    type = current_char;
+    if ((type != '&') && (type != '^') && (type != '<') && (type != '>')) {
+        return false;
     }
 
-    // find the label or symbol address
-    int address;
-    label_t* label = labels_find(buffer, buffer_length);
-    if (label) {
-        address = label->symbol->address + label->address;
-        //printf("invocation %c is label: sym %i + label %i == %i\n", type, (int)label->symbol->address, (int)label->address, address);
-    } else {
-        symbol_t* symbol = symbols_find(buffer, buffer_length, file_index);
-        if (!symbol) {
-            fatal("Definition not found: %s", buffer);
-        }
-        address = symbol->address;
-        //printf("invocation %c is symbol: %i\n", type, address);
-    }
+    // read the label name into the buffer
+    next_char();
+    read_name();
 
-    // emit the address
-    if (type == '^') {
-        emit_int(address);
-    }
-    if (type == '<') {
-        emit_short(address >> 16);
-    }
-    if (type == '>') {
-        emit_short(address);
-    }
-    if (type == '&') {
-        int offset = address - (current_address + current_symbol->address);
-        if ((offset < -0x8000) | (offset > 0xFFFF)) {
-            fatal("Relative invocation out of bounds.");
-        }
-        if (offset & 0x3) {
-            fatal("Relative invocation is misaligned.");
-        }
-        offset >>= 2;
-        emit_short(offset);
-    }
+    add_invocation(type);
     return true;
 }
 
@@ -349,6 +426,31 @@ static int parse_priority(void) {
     return priority;
 }
 
+/**
+ * Defines a symbol with the name in the buffer, returning it. The caller must
+ * configure it and then call start_symbol().
+ */
+static symbol_t* define_symbol(bool global) {
+
+    // assign the size of the previous symbol
+    assign_current_symbol_size();
+
+    // define the new symbol
+    return symbols_define(buffer, buffer_length, global ? -1 : file_index);
+}
+
+/** Makes the given newly defined symbol the current symbol. */
+static void start_symbol(symbol_t* symbol) {
+    symbol->object = current_object;
+    symbols_insert(symbol);
+
+    record_t* record = object_append(current_object, RECORD_SYMBOL);
+    record->pointer = symbol;
+
+    current_symbol = symbol;
+    current_address = 0;
+}
+
 static bool try_parse_symbol(void) {
     int type = current_char;
     if (type != '=' && type != '@') {
@@ -400,39 +502,38 @@ done_flags:
     read_name();
     //printf("define symbol %c%s %i\n",type,buffer,file_index);
 
-    // symbols are defined only on the first pass. on subsequent passes we
-    // restore the current symbol and pad to a word boundary.
-    if (pass != 0) {
-        for (int i = current_address; i & 3; ++i) {
-            emit_byte(0);
-        }
-        current_address = 0;
-        current_symbol = symbols_find(buffer, buffer_length, file_index);
-        assert(current_symbol != NULL);
-        emit_symbol(buffer);
-        return true;
-    }
-
-    // assign the size of the previous symbol
-    assign_current_symbol_size();
-
-    // define the new symbol
-    //printf("symbol %s index %i\n", buffer,(type == '=') ? -1 : file_index);
-    symbol_t* symbol = symbols_define(buffer, buffer_length,
-            (type == '=') ? -1 : file_index);
-
+    symbol_t* symbol = define_symbol(type == '=');
     symbol->weak = weak;
     symbol->zero = zero;
     symbol->constructor = constructor;
     symbol->destructor = destructor;
     symbol->constructor_priority = constructor_priority;
     symbol->destructor_priority = destructor_priority;
+    start_symbol(symbol);
+    return true;
+}
 
-    symbols_insert(symbol);
+/** Defines a label with the name in the buffer. */
+static void define_label(void) {
+    if (current_symbol == NULL) {
+        fatal("A label cannot appear outside of a symbol.");
+    }
 
-    current_symbol = symbol;
-    current_address = 0;
-    return true;
+    // check that this label isn't already defined. (we can't check whether
+    // it's also defined as a symbol until all symbols are known; see
+    // objects_check_labels().)
+    string_t* name = string_intern_bytes(buffer, buffer_length);
+    if (labels_find(name) != 0) {
+        fatal("Duplicate label definition");
+    }
+
+    // define the label
+    label_t* label = labels_define(name);
+    label->symbol = current_symbol;
+    label->address = current_address;
+    label->filename = string_ref(location_filename);
+    label->line = current_line;
+    object_add_label(current_object, label);
 }
 
 static bool try_parse_label(void) {
@@ -442,31 +543,249 @@ static bool try_parse_label(void) {
     }
     //printf("define label %c addr %i\n",type,current_address);
 
-    if (current_symbol == NULL) {
-        fatal("A label cannot appear outside of a symbol.");
-    }
-
     // read the label name into the buffer
     next_char();
     read_name();
 
-    // locals are defined in pass 2.
-    if (pass != 2) {
-        return true;
+    define_label();
+    return true;
+}
+
+/*
+ * Binary object code
+ *
+ * A binary object is a header followed by a sequence of records which
+ * correspond one to one with plain text syntax. See docs/object-code.md.
+ */
+
+#define BINARY_END 0x00
+#define BINARY_STRING 0x01
+#define BINARY_BYTES 0x02
+#define BINARY_LINES 0x03
+#define BINARY_SYMBOL 0x04
+#define BINARY_LABEL 0x05
+#define BINARY_INVOKE 0x06
+#define BINARY_LINE 0x07
+#define BINARY_MANUAL 0x08
+#define BINARY_INCREMENT 0x09
+#define BINARY_DEBUG 0x0A
+
+#define BINARY_SYMBOL_STATIC 1
+#define BINARY_SYMBOL_WEAK 2
+#define BINARY_SYMBOL_ZERO 4
+#define BINARY_SYMBOL_CONSTRUCTOR 8
+#define BINARY_SYMBOL_DESTRUCTOR 16
+
+#define BINARY_INVOKE_WEAK 2
+
+// The string table of the binary object being parsed. Strings point into the
+// input file contents.
+static const char** binary_strings;
+static int* binary_string_lengths;
+static size_t binary_strings_count;
+static size_t binary_strings_capacity;
+
+static int binary_byte(void) {
+    if (input_pos == input_end) {
+        fatal("Unexpected end of binary object.");
+    }
+    int byte = (unsigned char)*input_pos;
+    ++input_pos;
+    return byte;
+}
+
+static int binary_number(void) {
+    int value = 0;
+    int shift = 0;
+    for (;;) {
+        int byte = binary_byte();
+        if (shift > 28) {
+            fatal("Number in binary object is out of bounds.");
+        }
+        value |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    if (value < 0) {
+        fatal("Number in binary object is out of bounds.");
     }
+    return value;
+}
 
-    // check that this label isn't already defined
-    if (labels_find(buffer, buffer_length) != 0) {
-        fatal("Duplicate label definition");
+static const char* binary_bytes(int length) {
+    if (input_end - input_pos < length) {
+        fatal("Unexpected end of binary object.");
+    }
+    const char* bytes = input_pos;
+    input_pos += length;
+    return bytes;
+}
+
+static void binary_add_string(void) {
+    if (binary_strings_count == binary_strings_capacity) {
+        size_t new_capacity = binary_strings_capacity * 2;
+        if (new_capacity < 64)
+            new_capacity = 64;
+        binary_strings = realloc(binary_strings, new_capacity * sizeof(char*));
+        binary_string_lengths = realloc(binary_string_lengths, new_capacity * sizeof(int));
+        if (binary_strings == NULL || binary_string_lengths == NULL)
+            fatal("Out of memory.");
+        binary_strings_capacity = new_capacity;
+    }
+    int length = binary_number();
+    binary_strings[binary_strings_count] = binary_bytes(length);
+    binary_string_lengths[binary_strings_count] = length;
+    ++binary_strings_count;
+}
+
+/** Copies the string with the given index into the buffer. */
+static void binary_copy_string(int index) {
+    if ((size_t)index >= binary_strings_count) {
+        fatal("Invalid string index in binary object.");
     }
-    if (symbols_find(buffer, buffer_length, file_index) != 0) {
-        fatal("Label is already defined as a symbol");
+    int length = binary_string_lengths[index];
+    if (length >= BUFFER_SIZE) {
+        fatal("Name is too long.");
     }
+    memcpy(buffer, binary_strings[index], length);
+    buffer[length] = 0;
+    buffer_length = length;
+}
 
-    // define the label
-    label_t* label = labels_define(buffer, buffer_length);
-    label->symbol = current_symbol;
-    label->address = current_address;
+/** Reads a string table index and copies the string into the buffer. */
+static void binary_read_name(void) {
+    binary_copy_string(binary_number());
+}
+
+static void binary_parse_symbol(void) {
+    int flags = binary_number();
+    int constructor_priority = -1;
+    int destructor_priority = -1;
+    if (flags & BINARY_SYMBOL_CONSTRUCTOR) {
+        constructor_priority = binary_number() - 1;
+    }
+    if (flags & BINARY_SYMBOL_DESTRUCTOR) {
+        destructor_priority = binary_number() - 1;
+    }
+    binary_read_name();
+
+    symbol_t* symbol = define_symbol(!(flags & BINARY_SYMBOL_STATIC));
+    symbol->weak = (flags & BINARY_SYMBOL_WEAK) != 0;
+    symbol->zero = (flags & BINARY_SYMBOL_ZERO) != 0;
+    symbol->constructor = (flags & BINARY_SYMBOL_CONSTRUCTOR) != 0;
+    symbol->destructor = (flags & BINARY_SYMBOL_DESTRUCTOR) != 0;
+    symbol->constructor_priority = constructor_priority;
+    symbol->destructor_priority = destructor_priority;
+    start_symbol(symbol);
+}
+
+static void binary_parse_invoke(void) {
+    int type = binary_number();
+    int flags = binary_number();
+    binary_read_name();
+    if ((type != '&') && (type != '^') && (type != '<') && (type != '>')) {
+        fatal("Invalid invocation type in binary object.");
+    }
+    if (flags & BINARY_INVOKE_WEAK) {
+        fatal("Weak invocations are not supported.");
+    }
+    add_invocation(type);
+}
+
+static void binary_parse_line(void) {
+    int line = binary_number();
+    int filename = binary_number();
+    if (filename != 0) {
+        binary_copy_string(filename - 1);
+        set_location_filename(buffer);
+    }
+    set_line(line, filename != 0);
+}
+
+/** Parses a binary object. The header byte has been read into current_char. */
+static bool try_parse_binary(void) {
+    if (current_char != 0x7F) {
+        return false;
+    }
+    if (binary_byte() != 'o' || binary_byte() != 'o') {
+        fatal("Invalid binary object header.");
+    }
+    if (binary_byte() != 1) {
+        fatal("Unsupported binary object version.");
+    }
+
+    binary_strings_count = 0;
+    for (;;) {
+        int type = binary_byte();
+        if (type == BINARY_END) {
+            break;
+        }
+        switch (type) {
+            case BINARY_STRING:
+                binary_add_string();
+                break;
+
+            case BINARY_BYTES: {
+                if (current_symbol == NULL) {
+                    fatal("Bytes cannot appear outside of a symbol.");
+                }
+                int length = binary_number();
+                const char* bytes = binary_bytes(length);
+                for (int i = 0; i < length; ++i) {
+                    object_append_byte(current_object, bytes[i]);
+                }
+                current_address += length;
+                break;
+            }
+
+            case BINARY_LINES: {
+                int count = binary_number();
+                if (!line_manual) {
+                    for (int i = 0; i < count; ++i) {
+                        ++current_line;
+                        object_append_line(current_object);
+                    }
+                }
+                break;
+            }
+
+            case BINARY_SYMBOL:
+                binary_parse_symbol();
+                break;
+
+            case BINARY_LABEL:
+                binary_read_name();
+                define_label();
+                break;
+
+            case BINARY_INVOKE:
+                binary_parse_invoke();
+                break;
+
+            case BINARY_LINE:
+                binary_parse_line();
+                break;
+
+            case BINARY_MANUAL:
+                set_line_manual();
+                break;
+
+            case BINARY_INCREMENT:
+                increment_line();
+                break;
+
+            case BINARY_DEBUG:
+                fatal("Unrecognized debug directive");
+
+            default:
+                fatal("Invalid record type in binary object.");
+        }
+    }
+
+    // Continue parsing plain text after the end record.
+    next_char();
     return true;
 }
 
@@ -475,46 +794,23 @@ static bool try_parse_archive(void) {
     if (current_char != '%') {
         return false;
     }
-    //printf("found archive line, pass %i\n", pass);
-
-    // If we're in pass 2, we jump back to the top and start pass 3.
-    if (pass == 2) {
-        //printf("restoring file state, moving to pass 2\n");
-        pass = 3;
-        restore_file_state();
-
-        // We haven't parsed the line ending of the archive metadata yet so we
-        // start at line 0.
-        current_line = 0;
-        return true;
-    }
 
     // Read the filename
     next_char();
-    // TODO use arrays
     buffer_length = 0;
     while (!is_end_of_line(current_char)) {
-        *(buffer + buffer_length) = current_char;
-        buffer_length = (buffer_length + 1);
+        buffer[buffer_length++] = current_char;
         if (buffer_length == BUFFER_SIZE) {
             fatal("Filename of file in archive is too long.");
         }
         next_char();
     }
-    *(buffer + buffer_length) = 0;
-    //printf("archive line file: %s\n",buffer);
-
-    // If we're in pass 3, we'll start pass 2 for the next file
-    if (pass == 3) {
-        //printf("saving file state, moving to pass 1\n");
-        pass = 2;
-        save_file_state();
-    }
+    buffer[buffer_length] = 0;
 
     // We haven't parsed the line ending of the archive metadata yet so we
     // start at line 0.
-    current_line = 0;
-    start_file(buffer);
+    start_object(buffer, 0);
+    current_object->archive = string_intern_cstr(current_input_filename);
     return true;
 }
 
@@ -545,55 +841,73 @@ static void parse(void) {
     if (try_parse_archive()) {
         return;
     }
+    if (try_parse_binary()) {
+        return;
+    }
     fatal("Invalid character.");
 }
 
-/** Performs a full pass of parsing on the given input file. */
-static void perform_pass_input(const char* input_filename) {
-    start_file(input_filename);
-    current_line = 0;
-
-    input_file = fopen(input_filename, "r");
-    if (input_file == NULL) {
-        fatal("Failed to open input file.");
+/** Parses the given input file into one or more objects. */
+static void parse_input_file(const char* input_filename) {
+    current_input_filename = input_filename;
+    read_input_file(input_filename);
+
+    // The members of an indexed archive are parsed later, only if needed. The
+    // archive takes the buffer.
+    if (archive_has_index(input_bytes, input_end - input_pos)) {
+        char* bytes = input_bytes;
+        size_t size = input_end - input_pos;
+        input_bytes = NULL;
+        input_capacity = 0;
+        archives_add(input_filename, bytes, size);
+        return;
     }
 
-    current_char = 0;
+    start_object(input_filename, 1);
+
     next_char();
-    save_file_state();
-    current_line = 1;
+    while (current_char != EOF) {
+        parse();
+    }
 
-    while (1) {
-        if (current_char == EOF) {
-            if (pass == 2) {
-                pass = 3;
-                restore_file_state();
-                continue;
-            }
-            if (pass == 3) {
-                // Pass three of this file or archive is done. Switch back to
-                // pass two for the next file.
-                pass = 2;
-            }
-            break;
-        }
+    end_object();
+}
+
+void parse_archive_member(const char* archive_filename, const char* start, const char* end) {
+    current_input_filename = archive_filename;
+    input_pos = start;
+    input_end = end;
+
+    next_char();
+    while (current_char != EOF) {
         parse();
     }
 
-    symbols_emit_generated();
-    fclose(input_file);
+    end_object();
 }
 
-void perform_pass(const char** input_filenames, size_t input_filenames_count) {
+void parse_input_files(const char** input_filenames, size_t input_filenames_count) {
     current_address = 0;
     file_index = -1;
 
     for (size_t i = 0; i < input_filenames_count; ++i) {
-        perform_pass_input(input_filenames[i]);
+        parse_input_file(input_filenames[i]);
     }
+    archives_load_members();
 
     // assign the size of the last symbol
-    if (pass == 0) {
-        assign_current_symbol_size();
+    assign_current_symbol_size();
+
+    free(input_bytes);
+    input_bytes = NULL;
+    input_capacity = 0;
+    free(binary_strings);
+    free(binary_string_lengths);
+    binary_strings = NULL;
+    binary_string_lengths = NULL;
+    binary_strings_capacity = 0;
+    if (location_filename) {
+        string_deref(location_filename);
+        location_filename = NULL;
     }
 }
@@ -27,6 +27,17 @@
 
 #include <stddef.h>
 
-void perform_pass(const char** input_filenames, size_t input_filenames_count);
+/**
+ * Reads and parses all input files into objects.
+ *
+ * This defines all symbols and measures their sizes.
+ */
+void parse_input_files(const char** input_filenames, size_t input_filenames_count);
+
+/**
+ * Parses a single member of the given indexed archive. The given range starts
+ * with the member's `%` line.
+ */
+void parse_archive_member(const char* archive_filename, const char* start, const char* end);
 
 #endif
@@ -0,0 +1,412 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "relocatable.h"
+
+#include "libo-table.h"
+
+#include "common.h"
+#include "label.h"
+#include "object.h"
+#include "symbol.h"
+
+/**
+ * A position in a symbol that is invoked by something other than a relative
+ * invocation from within the same symbol. We define a generated label for it
+ * in the output.
+ *
+ * The table entry must be first. (We can't use containerof() since we're
+ * preprocessed by cpp/1 which doesn't support function-like macros.)
+ */
+typedef struct relocatable_label_t {
+    table_entry_t entry;
+    symbol_t* symbol;
+    int address;
+    int number;   // The generated label is named `$L<number>`
+    bool written; // Whether the label has been defined in the output
+} relocatable_label_t;
+
+// A map of relocatable_label_t by symbol and address
+static table_t relocatable_labels;
+static int relocatable_labels_count;
+
+// The number of tokens on the current output line
+static int column;
+
+// The last line written in a debug directive
+static int written_line;
+
+// The index of the next label of the current object that might be written
+static size_t next_label;
+
+static uint32_t relocatable_label_hash(symbol_t* symbol, int address) {
+    return string_hash(symbol->name) + (uint32_t)address * 31;
+}
+
+static relocatable_label_t* relocatable_label_find(symbol_t* symbol, int address) {
+    uint32_t hash = relocatable_label_hash(symbol, address);
+    table_entry_t* entry = table_bucket(&relocatable_labels, hash);
+    while (entry) {
+        relocatable_label_t* label = (relocatable_label_t*)entry;
+        if (label->symbol == symbol && label->address == address) {
+            return label;
+        }
+        entry = table_entry_next(entry);
+    }
+    return NULL;
+}
+
+static void relocatable_label_need(symbol_t* symbol, int address) {
+    if (relocatable_label_find(symbol, address)) {
+        return;
+    }
+    relocatable_label_t* label = malloc(sizeof(relocatable_label_t));
+    if (label == NULL) {
+        fatal("Out of memory.");
+    }
+    label->symbol = symbol;
+    label->address = address;
+    label->number = relocatable_labels_count++;
+    label->written = false;
+    table_put(&relocatable_labels, &label->entry, relocatable_label_hash(symbol, address));
+}
+
+static void relocatable_labels_destroy(void) {
+    table_entry_t** bucket = table_first_bucket(&relocatable_labels);
+    while (bucket) {
+        table_entry_t* entry = *bucket;
+        while (entry) {
+            table_entry_t* next = table_entry_next(entry);
+            free(entry);
+            entry = next;
+        }
+        bucket = table_next_bucket(&relocatable_labels, bucket);
+    }
+    table_destroy(&relocatable_labels);
+}
+
+/**
+ * Renames static symbols that would clash once all objects are in one file,
+ * and finds the label positions that need a generated label.
+ *
+ * A static symbol clashes if another symbol has the same name, or if an
+ * invocation in another object names an undefined symbol of the same name
+ * (since the static would capture it.)
+ */
+static void relocatable_prepare(void) {
+    for (symbol_t* symbol = symbols_first(); symbol; symbol = symbol->next_all) {
+        if (symbol->file_index != -1 && symbols_count_named(symbol->name) > 1) {
+            symbols_rename_statics(symbol->name);
+        }
+    }
+
+    symbol_t* symbol = NULL;
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        for (size_t j = 0; j < object->records_count; ++j) {
+            record_t* record = object->records + j;
+            if (record->type == RECORD_SYMBOL) {
+                symbol = record->pointer;
+            }
+            if (record->type == RECORD_INVOKE_SYMBOL) {
+                string_t* name = record->pointer;
+                if (!symbols_find(name, object->file_index)) {
+                    symbols_rename_statics(name);
+                }
+            }
+            if (record->type == RECORD_INVOKE_LABEL) {
+                if (record->kind != '&' || record->pointer != symbol) {
+                    relocatable_label_need(record->pointer, record->value);
+                }
+            }
+        }
+    }
+}
+
+
+
+/*
+ * Output
+ */
+
+static void relocatable_end_line(void) {
+    if (column > 0) {
+        fputc('\n', output_file);
+        column = 0;
+    }
+}
+
+/** Starts a new token on the current line. */
+static void relocatable_token(void) {
+    if (column == 16) {
+        relocatable_end_line();
+    }
+    if (column > 0) {
+        fputc(' ', output_file);
+    }
+    ++column;
+}
+
+static void relocatable_hex_digit(int digit) {
+    if (digit < 10) {
+        fputc('0' + digit, output_file);
+    } else {
+        fputc('A' + digit - 10, output_file);
+    }
+}
+
+static void relocatable_byte(int byte) {
+    relocatable_token();
+    relocatable_hex_digit((byte >> 4) & 0xF);
+    relocatable_hex_digit(byte & 0xF);
+}
+
+static void relocatable_number(int number) {
+    char digits[12];
+    itoa_d(number, digits);
+    fputs(digits, output_file);
+}
+
+/** Writes the output name of a symbol. */
+static void relocatable_symbol_name(symbol_t* symbol) {
+    fputs(symbol->name->bytes, output_file);
+    if (symbol->renamed) {
+        char digits[12];
+        itoa_d(symbol->file_index, digits);
+        if (symbol->name->length + 1 + strlen(digits) >= BUFFER_SIZE) {
+            fatal("Symbol name is too long to rename: %s", symbol->name->bytes);
+        }
+        fputc('$', output_file);
+        fputs(digits, output_file);
+    }
+}
+
+static void relocatable_symbol(symbol_t* symbol) {
+    relocatable_end_line();
+    fputc('\n', output_file);
+    fputc(symbol->file_index == -1 ? '=' : '@', output_file);
+    if (symbol->weak) {
+        fputc('?', output_file);
+    }
+    if (symbol->zero) {
+        fputc('+', output_file);
+    }
+    if (symbol->constructor) {
+        fputc('{', output_file);
+        if (symbol->constructor_priority >= 0) {
+            relocatable_number(symbol->constructor_priority);
+        }
+    }
+    if (symbol->destructor) {
+        fputc('}', output_file);
+        if (symbol->destructor_priority >= 0) {
+            relocatable_number(symbol->destructor_priority);
+        }
+    }
+    relocatable_symbol_name(symbol);
+    fputc('\n', output_file);
+}
+
+/**
+ * Writes a source location. The output is in manual line mode so this
+ * reproduces exactly the locations that linking the inputs would emit.
+ */
+static void relocatable_location(string_t* filename, int line) {
+    if (filename == NULL && line == written_line) {
+        return;
+    }
+    relocatable_end_line();
+    if (filename == NULL && line == written_line + 1) {
+        fputs("#\n", output_file);
+    } else {
+        fputs("#line ", output_file);
+        relocatable_number(line);
+        if (filename) {
+            fputs(" \"", output_file);
+            fputs(filename->bytes, output_file);
+            fputc('"', output_file);
+        }
+        fputc('\n', output_file);
+    }
+    written_line = line;
+}
+
+/**
+ * Writes the needed labels of the current symbol of the given object up to
+ * the given address.
+ */
+static void relocatable_labels_to(object_t* object, int address) {
+    while (next_label < object->labels_count) {
+        label_t* label = object->labels[next_label];
+        if (label->symbol != current_symbol || (int)label->address > address) {
+            break;
+        }
+        ++next_label;
+
+        relocatable_label_t* needed = relocatable_label_find(label->symbol, label->address);
+        if (needed && !needed->written) {
+            needed->written = true;
+            relocatable_end_line();
+            fputs(":$L", output_file);
+            relocatable_number(needed->number);
+            fputc('\n', output_file);
+        }
+    }
+}
+
+static void relocatable_bytes(object_t* object, record_t* record) {
+    int start = 0;
+    while (start < record->length) {
+        relocatable_labels_to(object, current_address);
+
+        // stop at the next label, if any, so it can be written in place
+        int end = record->length;
+        if (next_label < object->labels_count) {
+            label_t* label = object->labels[next_label];
+            if (label->symbol == current_symbol) {
+                int split = (int)label->address - current_address + start;
+                if (split < end) {
+                    end = split;
+                }
+            }
+        }
+
+        for (int i = start; i < end; ++i) {
+            relocatable_byte(object->bytes[record->value + i]);
+        }
+        current_address += end - start;
+        start = end;
+    }
+}
+
+static void relocatable_invoke_label(record_t* record) {
+    symbol_t* symbol = record->pointer;
+
+    // A relative invocation within the same symbol never changes so we
+    // replace it by its offset.
+    if (record->kind == '&' && symbol == current_symbol) {
+        current_address += 2;
+        int offset = record->value - current_address;
+        if ((offset < -0x8000) | (offset > 0xFFFF)) {
+            fatal("Relative invocation out of bounds.");
+        }
+        if (offset & 0x3) {
+            fatal("Relative invocation is misaligned.");
+        }
+        offset >>= 2;
+        relocatable_byte(offset);
+        relocatable_byte(offset >> 8);
+        return;
+    }
+
+    relocatable_label_t* label = relocatable_label_find(symbol, record->value);
+    relocatable_token();
+    fputc(record->kind, output_file);
+    fputs("$L", output_file);
+    relocatable_number(label->number);
+    current_address += record->kind == '^' ? 4 : 2;
+}
+
+static void relocatable_invoke_symbol(object_t* object, record_t* record) {
+    string_t* name = record->pointer;
+    symbol_t* symbol = symbols_find(name, object->file_index);
+    relocatable_token();
+    fputc(record->kind, output_file);
+    if (symbol) {
+        relocatable_symbol_name(symbol);
+    } else {
+        // undefined; it must be defined by whatever we're linked with
+        fputs(name->bytes, output_file);
+    }
+    current_address += record->kind == '^' ? 4 : 2;
+}
+
+static void relocatable_record(object_t* object, record_t* record) {
+    switch (record->type) {
+
+        case RECORD_SYMBOL:
+            relocatable_labels_to(object, current_address);
+            current_symbol = record->pointer;
+            current_address = 0;
+            relocatable_symbol(current_symbol);
+            break;
+
+        case RECORD_BYTES:
+            relocatable_bytes(object, record);
+            break;
+
+        case RECORD_INVOKE_LABEL:
+            relocatable_labels_to(object, current_address);
+            relocatable_invoke_label(record);
+            break;
+
+        case RECORD_INVOKE_SYMBOL:
+            relocatable_labels_to(object, current_address);
+            relocatable_invoke_symbol(object, record);
+            break;
+
+        case RECORD_LOCATION:
+            relocatable_location(record->pointer, record->value);
+            current_line = record->length;
+            break;
+
+        case RECORD_LINES:
+            for (int i = 0; i < record->length; ++i) {
+                ++current_line;
+                relocatable_location(NULL, current_line);
+            }
+            break;
+
+        case RECORD_INCREMENT:
+            current_line = record->length;
+            relocatable_location(NULL, written_line + 1);
+            break;
+    }
+}
+
+void relocatable_write(void) {
+    table_init(&relocatable_labels);
+    relocatable_labels_count = 0;
+    relocatable_prepare();
+
+    fputs("; Onramp relocatable object\n#line manual\n", output_file);
+    column = 0;
+    written_line = 0;
+    current_address = 0;
+    current_symbol = NULL;
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_t* object = objects[i];
+        set_current_filename(object->filename->bytes);
+        current_line = 0;
+        next_label = 0;
+        for (size_t j = 0; j < object->records_count; ++j) {
+            relocatable_record(object, object->records + j);
+        }
+        relocatable_labels_to(object, current_address);
+    }
+    relocatable_end_line();
+
+    relocatable_labels_destroy();
+}
@@ -56,7 +56,7 @@ void symbol_add_use(symbol_t* symbol, symbol_t* other) {
             new_capacity = 2;
         if (new_capacity <= symbol->use_capacity)
             fatal("Out of memory.");
-        symbol->use = realloc(symbol->use, new_capacity);
+        symbol->use = realloc(symbol->use, new_capacity * sizeof(symbol_t*));
         if (symbol->use == NULL)
             fatal("Out of memory.");
         symbol->use_capacity = new_capacity;
@@ -65,13 +65,18 @@ void symbol_add_use(symbol_t* symbol, symbol_t* other) {
     symbol->use[symbol->use_count++] = other;
 }
 
-static void symbol_walk(symbol_t* symbol) {
+size_t symbol_image_size(symbol_t* symbol) {
+    return (symbol->size + 3) & (~3);
+}
+
+static void symbol_walk(symbol_t* symbol, symbol_t* used_by) {
     if (symbol->is_used) {
         return;
     }
     symbol->is_used = true;
+    symbol->used_by = used_by;
     for (size_t i = 0; i < symbol->use_count; ++i) {
-        symbol_walk(symbol->use[i]);
+        symbol_walk(symbol->use[i], symbol);
     }
 }
 
@@ -94,7 +99,7 @@ static int destructors_count;
 
 static void symbol_node_walk(symbol_node_t* node) {
     while (node) {
-        symbol_walk(node->symbol);
+        symbol_walk(node->symbol, NULL);
         node = node->next;
     }
 }
@@ -113,17 +118,17 @@ static void symbol_node_destroy(symbol_node_t* node) {
  * Symbol hashtable
  */
 
-// The hashtable that contains all symbols, global and static.
-static symbol_t** symbols;
-#define SYMBOLS_SIZE 1024
-#define SYMBOLS_MASK 1023
+// The hashtable that contains all symbols, global and static. Symbols are
+// hashed by name so static symbols of the same name share a bucket. Names are
+// interned so they are compared by pointer.
+static table_t symbols;
 
 // The linked list of all symbols in the order they are encountered.
 static symbol_t* all_symbols;
 static symbol_t* all_symbols_end;
 
 void symbols_init(void) {
-    symbols = calloc(SYMBOLS_SIZE, sizeof(symbol_t*));
+    table_init(&symbols);
 }
 
 void symbols_destroy(void) {
@@ -134,20 +139,21 @@ void symbols_destroy(void) {
         symbol = next;
     }
 
-    free(symbols);
+    table_destroy(&symbols);
 
     symbol_node_destroy(constructors);
     symbol_node_destroy(destructors);
 }
 
-symbol_t* symbols_find(const char* bytes, size_t length, int file_index) {
-    uint32_t hash = fnv1a_bytes(bytes, length);
-    //printf("%s %i %x\n", bytes, (int)(hash & SYMBOLS_MASK), (int)hash);
+symbol_t* symbols_find(string_t* name, int file_index) {
+    uint32_t hash = string_hash(name);
     symbol_t* global = NULL;
 
-    symbol_t* symbol = symbols[hash & SYMBOLS_MASK];
-    while (symbol) {
-        if (string_equal_bytes(symbol->name, bytes, length)) {
+    // The symbol table entry is the first field of the symbol.
+    table_entry_t* entry = table_bucket(&symbols, hash);
+    while (entry) {
+        symbol_t* symbol = (symbol_t*)entry;
+        if (symbol->name == name) {
             // Prefer a matching static symbol to a global symbol.
             if (symbol->file_index == file_index)
                 return symbol;
@@ -156,7 +162,7 @@ symbol_t* symbols_find(const char* bytes, size_t length, int file_index) {
                 global = symbol;
             }
         }
-        symbol = symbol->next_bucket;
+        entry = table_entry_next(entry);
     }
     // If no static symbol was found, return the global if any.
     return global;
@@ -164,22 +170,22 @@ symbol_t* symbols_find(const char* bytes, size_t length, int file_index) {
 
 symbol_t* symbols_define(const char* bytes, size_t length, int file_index) {
     string_t* name = string_intern_bytes(bytes, length);
-    uint32_t hash = fnv1a_bytes(bytes, length);
 
     // walk through symbols looking for a match
-    symbol_t* symbol = symbols[hash & SYMBOLS_MASK];
-    while (symbol) {
-        if (string_equal(symbol->name, name) && symbol->file_index == file_index) {
+    table_entry_t* entry = table_bucket(&symbols, string_hash(name));
+    while (entry) {
+        symbol_t* symbol = (symbol_t*)entry;
+        if (symbol->name == name && symbol->file_index == file_index) {
             fatal("Duplicate %s symbol: %s", file_index == -1 ? "global" : "static",
                     symbol->name->bytes);
         }
-        symbol = symbol->next_bucket;
+        entry = table_entry_next(entry);
     }
 
     // create the symbol
-    symbol = symbol_new(name);
+    symbol_t* symbol = symbol_new(name);
     symbol->file_index = file_index;
-    if (!optimize) {
+    if (!option_optimize) {
         symbol->is_used = true;
     }
     return symbol;
@@ -187,12 +193,11 @@ symbol_t* symbols_define(const char* bytes, size_t length, int file_index) {
 
 void symbols_insert(symbol_t* symbol) {
     assert(symbol->next_all == NULL);
-    assert(symbol->next_bucket == NULL);
 
     // Insert the symbol into the global symbol list
     if (all_symbols == NULL) {
         // This is the first symbol. Make sure its name is __start.
-        if (!string_equal_cstr(symbol->name, "__start")) {
+        if (!option_relocatable && !string_equal_cstr(symbol->name, "__start")) {
             print_warning("The first symbol is not named `__start`!");
         }
         all_symbols = symbol;
@@ -202,10 +207,7 @@ void symbols_insert(symbol_t* symbol) {
     all_symbols_end = symbol;
 
     // Insert the symbol into the hashtable
-    size_t index = string_hash(symbol->name) & SYMBOLS_MASK;
-    //printf("%s %i %x\n", symbol->name->bytes, (int)index, symbol->name->hash);
-    symbol->next_bucket = symbols[index];
-    symbols[index] = symbol;
+    table_put(&symbols, &symbol->entry, string_hash(symbol->name));
 
     // If it's a constructor, append it to the constructor list
     if (symbol->constructor) {
@@ -231,11 +233,39 @@ void symbols_insert(symbol_t* symbol) {
     }
 }
 
+size_t symbols_count_named(string_t* name) {
+    size_t count = 0;
+    table_entry_t* entry = table_bucket(&symbols, string_hash(name));
+    while (entry) {
+        symbol_t* symbol = (symbol_t*)entry;
+        if (symbol->name == name) {
+            ++count;
+        }
+        entry = table_entry_next(entry);
+    }
+    return count;
+}
+
+void symbols_rename_statics(string_t* name) {
+    table_entry_t* entry = table_bucket(&symbols, string_hash(name));
+    while (entry) {
+        symbol_t* symbol = (symbol_t*)entry;
+        if (symbol->name == name && symbol->file_index != -1) {
+            symbol->renamed = true;
+        }
+        entry = table_entry_next(entry);
+    }
+}
+
+symbol_t* symbols_first(void) {
+    return all_symbols;
+}
+
 void symbols_walk_use(void) {
 
     // The first symbol is the entry point.
     if (all_symbols != NULL) {
-        symbol_walk(all_symbols);
+        symbol_walk(all_symbols, NULL);
     }
 
     // Constructors and destructors are always kept.
@@ -249,8 +279,20 @@ void symbols_assign_addresses(void) {
     while (symbol) {
         if (symbol->is_used) {
             symbol->address = address;
-            address += symbol->size;
-            address = (address + 3) & (~3); // align to a word boundary
+            address += symbol_image_size(symbol);
+        }
+        symbol = symbol->next_all;
+    }
+
+    // folded symbols take the address of the symbol they were folded into
+    symbol = all_symbols;
+    while (symbol) {
+        symbol_t* target = symbol->folded;
+        while (target && target->folded) {
+            target = target->folded;
+        }
+        if (target) {
+            symbol->address = target->address;
         }
         symbol = symbol->next_all;
     }
@@ -259,6 +301,7 @@ void symbols_assign_addresses(void) {
 static void symbols_create_generated_list(const char* name, size_t count) {
     symbol_t* symbol = symbols_define(name, strlen(name), -1);
     symbol->size = 4 * (count + 1);
+    symbol->is_used = true; // generated symbols are always emitted
     symbols_insert(symbol);
 }
 
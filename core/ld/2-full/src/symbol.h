@@ -34,14 +34,24 @@
  */
 
 typedef struct symbol_t {
+    table_entry_t entry;           // The entry in the symbol table (must be first)
     struct symbol_t* next_all;     // The next symbol in the list of all symbols
-    struct symbol_t* next_bucket;  // The next symbol in this hashtable bucket
 
     string_t* name;
+    struct object_t* object; // The object that defines this symbol, or null if it's generated
     size_t address; // The address assigned to this symbol in the output
     size_t size; // The size of the symbol in bytes
     bool is_used; // Whether this symbol is use (transitively from a root)
 
+    // With -O, the symbol through which this symbol was first reached when
+    // marking used symbols, or null if it's a root
+    struct symbol_t* used_by;
+
+    // The identical symbol this symbol was folded into, or null if it wasn't
+    // folded. A folded symbol is not emitted; it shares the address of the
+    // symbol it was folded into.
+    struct symbol_t* folded;
+
     // The index of the file in which this static symbol is defined, or -1 if
     // it's global
     int file_index;
@@ -56,6 +66,15 @@ typedef struct symbol_t {
     bool destructor : 1;
     bool weak : 1;
     bool zero : 1;
+
+    // With -O, whether this symbol is invoked other than as the target of a
+    // call or jump (so its address may be compared)
+    bool address_taken : 1;
+
+    // With -r, whether this static symbol is renamed in the output because
+    // its name would clash once all objects are merged
+    bool renamed : 1;
+
     int constructor_priority;
     int destructor_priority;
 } symbol_t;
@@ -78,6 +97,12 @@ void symbol_delete(symbol_t* symbol);
  */
 void symbol_add_use(symbol_t* symbol, symbol_t* other);
 
+/**
+ * Returns the number of bytes the symbol takes up in the output: its size
+ * plus the padding that aligns the symbol after it to a word boundary.
+ */
+size_t symbol_image_size(symbol_t* symbol);
+
 
 
 /*
@@ -101,11 +126,31 @@ symbol_t* symbols_define(const char* bytes, size_t length, int file_index);
 /**
  * Finds a static symbol in the given file with the given name, or a global
  * symbol with the given name, or null if the symbol isn't found.
+ *
+ * The name must be interned.
  */
-symbol_t* symbols_find(const char* bytes, size_t length, int file_index);
+symbol_t* symbols_find(string_t* name, int file_index);
 
 void symbols_insert(symbol_t* symbol);
 
+/**
+ * Returns the number of symbols (global or static) with the given interned
+ * name.
+ */
+size_t symbols_count_named(string_t* name);
+
+/**
+ * Marks all static symbols with the given interned name to be renamed in
+ * relocatable output.
+ */
+void symbols_rename_statics(string_t* name);
+
+/**
+ * Returns the first symbol in the list of all symbols in the order they were
+ * defined. Follow next_all to walk the list.
+ */
+symbol_t* symbols_first(void);
+
 void symbols_walk_use(void);
 
 void symbols_assign_addresses(void);
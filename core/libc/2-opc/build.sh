@@ -41,6 +41,12 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/libc/2-opc/src/assert.c \
     -o build/intermediate/libc-2-opc/assert.oo
 
+echo Assembling libc/2-opc block.os
+onrampvm build/intermediate/cc/cc.oe \
+    @core/libc/2-opc/build-ccargs \
+    -c core/libc/2-opc/src/block.os \
+    -o build/intermediate/libc-2-opc/block.oo
+
 echo Compiling libc/2-opc ctype.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/libc/2-opc/build-ccargs \
@@ -146,6 +152,7 @@ onrampvm build/intermediate/ar-0-cat/ar.oe \
     build/intermediate/libc-1-omc/strtol.oo \
     \
     build/intermediate/libc-2-opc/assert.oo \
+    build/intermediate/libc-2-opc/block.oo \
     build/intermediate/libc-2-opc/ctype.oo \
     build/intermediate/libc-2-opc/environ.oo \
     build/intermediate/libc-2-opc/file.oo \
@@ -832,8 +832,12 @@ int remove(const char* filename) {
 }
 
 int rename(const char* old, const char* new) {
-    // TODO
-    return -1;
+    if (__sys_rename(old, new) < 0) {
+        // TODO parse out error codes
+        errno = EIO;
+        return -1;
+    }
+    return 0;
 }
 
 FILE* tmpfile(void) {
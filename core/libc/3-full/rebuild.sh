@@ -60,6 +60,12 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/libc/2-opc/src/assert.c \
     -o build/intermediate/libc-3-full-re/assert.oo
 
+echo Assembling libc/2-opc block.os
+onrampvm build/intermediate/cc/cc.oe \
+    @core/libc/3-full/rebuild-ccargs \
+    -c core/libc/2-opc/src/block.os \
+    -o build/intermediate/libc-3-full-re/block.oo
+
 echo Compiling libc/2-opc ctype.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/libc/3-full/rebuild-ccargs \
@@ -209,6 +215,7 @@ onrampvm build/intermediate/ar-0-cat/ar.oe \
     build/intermediate/libc-3-full-re/strtol.oo \
     \
     build/intermediate/libc-3-full-re/assert.oo \
+    build/intermediate/libc-3-full-re/block.oo \
     build/intermediate/libc-3-full-re/ctype.oo \
     build/intermediate/libc-3-full-re/environ.oo \
     build/intermediate/libc-3-full-re/file.oo \
@@ -102,6 +102,7 @@ int fseek(FILE* file, long offset, int whence);
 long ftell(FILE* file);
 
 int remove(const char* filename);
+int rename(const char* old, const char* new);
 
 int chmod(const char* filename, int mode); // TODO this belongs in sys/stat.h
 
@@ -111,7 +112,6 @@ int chmod(const char* filename, int mode); // TODO this belongs in sys/stat.h
 
 #ifndef __onramp_cci_omc__
 
-int rename(const char* old, const char* new);
 FILE* tmpfile(void);
 char* tmpnam(char* s);
 int fflush(FILE* file);
@@ -26,6 +26,7 @@
 #define ONRAMP_LIBO_UTIL_H_INCLUDED
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /**
@@ -33,6 +34,18 @@
  */
 int fnv1a_cstr(const char* s);
 
+/**
+ * Initializes a 64-bit FNV-1a hash.
+ *
+ * The hash is stored in two words, low word first.
+ */
+void fnv1a64_init(int32_t* hash);
+
+/**
+ * Adds the given bytes to a 64-bit FNV-1a hash.
+ */
+void fnv1a64_bytes(int32_t* hash, const char* p, size_t count);
+
 char* itoa_d(int value, char* buffer);
 
 void fputd(int number, FILE* file);
@@ -61,6 +61,18 @@ uint32_t fnv1a_cstr(const char* s);
  */
 uint32_t fnv1a_bytes(const char* p, size_t count);
 
+/**
+ * Initializes a 64-bit FNV-1a hash.
+ *
+ * The hash is stored in two words, low word first.
+ */
+void fnv1a64_init(int32_t* hash);
+
+/**
+ * Adds the given bytes to a 64-bit FNV-1a hash.
+ */
+void fnv1a64_bytes(int32_t* hash, const char* p, size_t count);
+
 /**
  * Converts a number to decimal.
  */
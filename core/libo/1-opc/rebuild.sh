@@ -34,6 +34,12 @@ onrampvm build/intermediate/cc/cc.oe \
     -c core/libo/1-opc/src/libo-data.os \
     -o build/intermediate/libo-1-opc-re/libo-data.oo
 
+echo Assembling libo/1-opc libo-hash.os
+onrampvm build/intermediate/cc/cc.oe \
+    @core/libo/1-opc/build-ccargs \
+    -c core/libo/1-opc/src/libo-hash.os \
+    -o build/intermediate/libo-1-opc-re/libo-hash.oo
+
 echo Compiling libo/1-opc libo-error.c
 onrampvm build/intermediate/cc/cc.oe \
     @core/libo/1-opc/build-ccargs \
@@ -69,6 +75,7 @@ onrampvm build/intermediate/ar-0-cat/ar.oe \
     rc build/intermediate/libo-1-opc-re/libo.oa \
         build/intermediate/libo-1-opc-re/libo-data.oo \
         build/intermediate/libo-1-opc-re/libo-error.oo \
+        build/intermediate/libo-1-opc-re/libo-hash.oo \
         build/intermediate/libo-1-opc-re/libo-string.oo \
         build/intermediate/libo-1-opc-re/libo-table.oo \
         build/intermediate/libo-1-opc-re/libo-util.oo \
@@ -44,6 +44,41 @@ uint32_t fnv1a_bytes(const char* p, size_t count) {
     return hash;
 }
 
+// Onramp uses the assembly version in libo-hash.os.
+#ifndef __onramp__
+void fnv1a64_init(int32_t* hash) {
+    // offset basis 0xCBF29CE484222325
+    *hash = (int32_t)0x84222325u;
+    *(hash + 1) = (int32_t)0xCBF29CE4u;
+}
+
+void fnv1a64_bytes(int32_t* hash, const char* p, size_t count) {
+
+    // The 64-bit FNV prime is 2^40 + 0x1B3. We multiply in 16-bit limbs the
+    // same way as the assembly version.
+    uint32_t h0 = (uint32_t)*hash & 0xFFFFu;
+    uint32_t h1 = (uint32_t)*hash >> 16;
+    uint32_t h2 = (uint32_t)*(hash + 1) & 0xFFFFu;
+    uint32_t h3 = (uint32_t)*(hash + 1) >> 16;
+
+    const char* end = p + count;
+    while (p != end) {
+        h0 = h0 ^ (*p++ & 0xFFu);
+        uint32_t t0 = h0 * 0x1B3u;
+        uint32_t t1 = h1 * 0x1B3u + (t0 >> 16);
+        uint32_t t2 = h2 * 0x1B3u + (t1 >> 16) + (h0 << 8);
+        uint32_t t3 = h3 * 0x1B3u + (t2 >> 16) + (h1 << 8);
+        h0 = t0 & 0xFFFFu;
+        h1 = t1 & 0xFFFFu;
+        h2 = t2 & 0xFFFFu;
+        h3 = t3 & 0xFFFFu;
+    }
+
+    *hash = (int32_t)(h0 | (h1 << 16));
+    *(hash + 1) = (int32_t)(h2 | (h3 << 16));
+}
+#endif
+
 // TODO our opc libc will have sprintf(), move this there to become part of
 // string formatting and just call sprintf() here
 
@@ -0,0 +1,917 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023-2024 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * This is the Onramp object code converter.
+ *
+ * It converts Onramp object files and static libraries between plain text and
+ * binary object code. The conversion is lossless except for comments and
+ * horizontal whitespace: line endings are preserved so line numbers in error
+ * messages and debug info are unchanged, and converting the output back
+ * produces an equivalent file.
+ *
+ * See docs/object-code.md for a description of both formats.
+ */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BINARY_END 0x00
+#define BINARY_STRING 0x01
+#define BINARY_BYTES 0x02
+#define BINARY_LINES 0x03
+#define BINARY_SYMBOL 0x04
+#define BINARY_LABEL 0x05
+#define BINARY_INVOKE 0x06
+#define BINARY_LINE 0x07
+#define BINARY_MANUAL 0x08
+#define BINARY_INCREMENT 0x09
+#define BINARY_DEBUG 0x0A
+
+#define BINARY_SYMBOL_STATIC 1
+#define BINARY_SYMBOL_WEAK 2
+#define BINARY_SYMBOL_ZERO 4
+#define BINARY_SYMBOL_CONSTRUCTOR 8
+#define BINARY_SYMBOL_DESTRUCTOR 16
+
+#define BINARY_INVOKE_WEAK 2
+
+#define BINARY_HEADER_SIZE 4
+static const uint8_t binary_header[BINARY_HEADER_SIZE] = {0x7F, 'o', 'o', 0x01};
+
+static const char* input_filename;
+static int input_line;
+
+static _Noreturn void fatal(const char* message) {
+    fprintf(stderr, "ERROR at %s:%d: %s\n", input_filename, input_line, message);
+    exit(EXIT_FAILURE);
+}
+
+static void* checked_realloc(void* pointer, size_t size) {
+    pointer = realloc(pointer, size);
+    if (pointer == NULL)
+        fatal("Out of memory.");
+    return pointer;
+}
+
+
+
+/*
+ * Output
+ *
+ * The reader calls the write_*() functions below for each piece of syntax. The
+ * writer converts them to the output format.
+ */
+
+static FILE* output_file;
+static bool output_binary;
+
+// text output state
+static bool output_line_start = true;   // whether nothing has been written on this line
+static bool output_debug_line = false;  // whether this line is a debug line
+
+// binary output state
+static bool output_object_open = false; // whether we've written the header
+static uint8_t* pending_bytes;
+static size_t pending_bytes_count;
+static size_t pending_bytes_capacity;
+static unsigned pending_lines;
+
+typedef struct output_string_t {
+    char* name;
+    size_t length;
+    uint32_t hash;
+    unsigned index;
+} output_string_t;
+
+static output_string_t* output_strings;
+static size_t output_strings_capacity; // always a power of two
+static size_t output_strings_count;
+
+static void output_number(uint32_t value) {
+    while (value >= 0x80) {
+        fputc((int)((value & 0x7F) | 0x80), output_file);
+        value >>= 7;
+    }
+    fputc((int)value, output_file);
+}
+
+static void output_flush(void) {
+    if (pending_bytes_count != 0) {
+        fputc(BINARY_BYTES, output_file);
+        output_number(pending_bytes_count);
+        fwrite(pending_bytes, 1, pending_bytes_count, output_file);
+        pending_bytes_count = 0;
+    }
+    if (pending_lines != 0) {
+        fputc(BINARY_LINES, output_file);
+        output_number(pending_lines);
+        pending_lines = 0;
+    }
+}
+
+/** Starts a binary object if one isn't started already. */
+static void output_open(void) {
+    if (!output_object_open) {
+        fwrite(binary_header, 1, BINARY_HEADER_SIZE, output_file);
+        output_object_open = true;
+    }
+}
+
+static void output_strings_clear(void) {
+    size_t i;
+    for (i = 0; i < output_strings_capacity; ++i)
+        free(output_strings[i].name);
+    free(output_strings);
+    output_strings = NULL;
+    output_strings_capacity = 0;
+    output_strings_count = 0;
+}
+
+static uint32_t hash_bytes(const char* bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        hash ^= (uint8_t)bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void output_strings_grow(void) {
+    output_string_t* old_strings = output_strings;
+    size_t old_capacity = output_strings_capacity;
+    size_t i;
+
+    output_strings_capacity = old_capacity ? old_capacity * 2 : 256;
+    output_strings = calloc(output_strings_capacity, sizeof(output_string_t));
+    if (output_strings == NULL)
+        fatal("Out of memory.");
+
+    for (i = 0; i < old_capacity; ++i) {
+        size_t index;
+        if (old_strings[i].name == NULL)
+            continue;
+        index = old_strings[i].hash & (output_strings_capacity - 1);
+        while (output_strings[index].name != NULL)
+            index = (index + 1) & (output_strings_capacity - 1);
+        output_strings[index] = old_strings[i];
+    }
+    free(old_strings);
+}
+
+/**
+ * Returns the string table index of the given string, writing a string record
+ * if it isn't in the table yet.
+ */
+static unsigned output_string(const char* name, size_t length) {
+    uint32_t hash = hash_bytes(name, length);
+    output_string_t* string;
+    size_t index;
+
+    if (output_strings_count * 2 >= output_strings_capacity)
+        output_strings_grow();
+
+    index = hash & (output_strings_capacity - 1);
+    for (;;) {
+        string = output_strings + index;
+        if (string->name == NULL)
+            break;
+        if (string->hash == hash && string->length == length &&
+                0 == memcmp(string->name, name, length))
+            return string->index;
+        index = (index + 1) & (output_strings_capacity - 1);
+    }
+
+    string->name = malloc(length + 1);
+    if (string->name == NULL)
+        fatal("Out of memory.");
+    memcpy(string->name, name, length);
+    string->name[length] = 0;
+    string->length = length;
+    string->hash = hash;
+    string->index = output_strings_count++;
+
+    output_open();
+    output_flush();
+    fputc(BINARY_STRING, output_file);
+    output_number(length);
+    fwrite(name, 1, length, output_file);
+    return string->index;
+}
+
+/** Starts a new record in binary, or a new token in text. */
+static void output_token(void) {
+    if (output_binary) {
+        output_open();
+        output_flush();
+        return;
+    }
+    if (output_debug_line) {
+        // A debug line runs to the end of the line so anything else has to
+        // go on the next. (This only happens for a malformed binary object.)
+        fputc('\n', output_file);
+        output_line_start = true;
+        output_debug_line = false;
+    }
+    if (!output_line_start)
+        fputc(' ', output_file);
+    output_line_start = false;
+}
+
+static void write_bytes(const uint8_t* bytes, size_t count) {
+    size_t i;
+    if (output_binary) {
+        output_open();
+        if (pending_lines != 0)
+            output_flush();
+        if (pending_bytes_count + count > pending_bytes_capacity) {
+            pending_bytes_capacity = (pending_bytes_count + count) * 2;
+            pending_bytes = checked_realloc(pending_bytes, pending_bytes_capacity);
+        }
+        memcpy(pending_bytes + pending_bytes_count, bytes, count);
+        pending_bytes_count += count;
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        output_token();
+        fputc("0123456789ABCDEF"[bytes[i] >> 4], output_file);
+        fputc("0123456789ABCDEF"[bytes[i] & 0xF], output_file);
+    }
+}
+
+static void write_lines(unsigned count) {
+    if (output_binary) {
+        output_open();
+        if (pending_bytes_count != 0)
+            output_flush();
+        pending_lines += count;
+        return;
+    }
+    while (count-- > 0)
+        fputc('\n', output_file);
+    output_line_start = true;
+    output_debug_line = false;
+}
+
+static void write_name(const char* name, size_t length) {
+    if (output_binary) {
+        output_number(output_string(name, length));
+        return;
+    }
+    fwrite(name, 1, length, output_file);
+}
+
+static void write_symbol(unsigned flags, int constructor_priority,
+        int destructor_priority, const char* name, size_t length)
+{
+    if (output_binary) {
+        unsigned index = output_string(name, length);
+        output_token();
+        fputc(BINARY_SYMBOL, output_file);
+        output_number(flags);
+        if (flags & BINARY_SYMBOL_CONSTRUCTOR)
+            output_number(constructor_priority + 1);
+        if (flags & BINARY_SYMBOL_DESTRUCTOR)
+            output_number(destructor_priority + 1);
+        output_number(index);
+        return;
+    }
+    output_token();
+    fputc((flags & BINARY_SYMBOL_STATIC) ? '@' : '=', output_file);
+    if (flags & BINARY_SYMBOL_WEAK)
+        fputc('?', output_file);
+    if (flags & BINARY_SYMBOL_ZERO)
+        fputc('+', output_file);
+    if (flags & BINARY_SYMBOL_CONSTRUCTOR) {
+        fputc('{', output_file);
+        if (constructor_priority != -1)
+            fprintf(output_file, "%d", constructor_priority);
+    }
+    if (flags & BINARY_SYMBOL_DESTRUCTOR) {
+        fputc('}', output_file);
+        if (destructor_priority != -1)
+            fprintf(output_file, "%d", destructor_priority);
+    }
+    write_name(name, length);
+}
+
+static void write_label(const char* name, size_t length) {
+    if (output_binary) {
+        unsigned index = output_string(name, length);
+        output_token();
+        fputc(BINARY_LABEL, output_file);
+        output_number(index);
+        return;
+    }
+    output_token();
+    fputc(':', output_file);
+    write_name(name, length);
+}
+
+static void write_invoke(char type, unsigned flags, const char* name, size_t length) {
+    if (output_binary) {
+        unsigned index = output_string(name, length);
+        output_token();
+        fputc(BINARY_INVOKE, output_file);
+        output_number((uint8_t)type);
+        output_number(flags);
+        output_number(index);
+        return;
+    }
+    output_token();
+    fputc(type, output_file);
+    if (flags & BINARY_INVOKE_WEAK)
+        fputc('?', output_file);
+    write_name(name, length);
+}
+
+/** Writes a #line directive. The filename is optional. */
+static void write_line(int line, const char* filename, size_t length) {
+    if (output_binary) {
+        unsigned index = filename ? output_string(filename, length) + 1 : 0;
+        output_token();
+        fputc(BINARY_LINE, output_file);
+        output_number(line);
+        output_number(index);
+        return;
+    }
+    output_token();
+    fprintf(output_file, "#line %d", line);
+    if (filename) {
+        fputs(" \"", output_file);
+        fwrite(filename, 1, length, output_file);
+        fputc('"', output_file);
+    }
+    output_debug_line = true;
+}
+
+/**
+ * Writes a debug line other than #line. The text is everything after the `#`
+ * (nothing for a line increment.)
+ */
+static void write_debug(int type, const char* text, size_t length) {
+    if (output_binary) {
+        unsigned index = 0;
+        if (type == BINARY_DEBUG)
+            index = output_string(text, length);
+        output_token();
+        fputc(type, output_file);
+        if (type == BINARY_DEBUG)
+            output_number(index);
+        return;
+    }
+    output_token();
+    fputc('#', output_file);
+    if (type == BINARY_MANUAL)
+        fputs("line manual", output_file);
+    if (type == BINARY_DEBUG)
+        fwrite(text, 1, length, output_file);
+    output_debug_line = true;
+}
+
+/** Ends the current object (at the end of the file or an archive member.) */
+static void write_end(void) {
+    if (output_binary) {
+        if (!output_object_open)
+            return;
+        output_flush();
+        fputc(BINARY_END, output_file);
+        output_object_open = false;
+        output_strings_clear();
+    }
+}
+
+/**
+ * Writes an archive member line. The given text includes the `%` and the line
+ * ending.
+ */
+static void write_member(const char* text, size_t length) {
+    write_end();
+    if (!output_binary && !output_line_start) {
+        // the `%` must start a line
+        fputc('\n', output_file);
+    }
+    fwrite(text, 1, length, output_file);
+    output_line_start = true;
+    output_debug_line = false;
+}
+
+
+
+/*
+ * Input
+ */
+
+static const char* input_start;
+static const char* input_pos;
+static const char* input_end;
+
+static void read_input_file(void) {
+    FILE* file = fopen(input_filename, "rb");
+    char* bytes = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    if (file == NULL)
+        fatal("Failed to open input file.");
+    for (;;) {
+        size_t step;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            bytes = checked_realloc(bytes, capacity);
+        }
+        step = fread(bytes + count, 1, capacity - count, file);
+        if (step == 0) {
+            if (ferror(file))
+                fatal("Failed to read input file.");
+            break;
+        }
+        count += step;
+    }
+    fclose(file);
+
+    input_start = bytes;
+    input_pos = bytes;
+    input_end = bytes + count;
+}
+
+static bool is_end_of_line(const char* p) {
+    return p == input_end || *p == '\n' || *p == '\r';
+}
+
+static bool is_name_start(char c) {
+    return isalpha((unsigned char)c) || c == '_' || c == '$';
+}
+
+static bool is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/** Reads a name, returning its length. */
+static size_t read_name(const char** out_name) {
+    const char* start = input_pos;
+    if (input_pos == input_end || !is_name_start(*input_pos))
+        fatal("Expected label, symbol or directive name to start with a letter, underscore or dollar sign.");
+    while (input_pos != input_end && is_name_char(*input_pos))
+        ++input_pos;
+    *out_name = start;
+    return input_pos - start;
+}
+
+/** Reads an optional constructor or destructor priority. */
+static int read_priority(void) {
+    int priority = -1;
+    while (input_pos != input_end && isdigit((unsigned char)*input_pos)) {
+        if (priority == -1)
+            priority = 0;
+        priority = priority * 10 + (*input_pos++ - '0');
+        if (priority > 65535)
+            fatal("The maximum constructor/destructor priority is 65535.");
+    }
+    return priority;
+}
+
+static void read_text_symbol(void) {
+    unsigned flags = (*input_pos++ == '@') ? BINARY_SYMBOL_STATIC : 0;
+    int constructor_priority = -1;
+    int destructor_priority = -1;
+    const char* name;
+    size_t length;
+
+    for (;;) {
+        char c = input_pos == input_end ? 0 : *input_pos;
+        if (c == '?') {
+            flags |= BINARY_SYMBOL_WEAK;
+        } else if (c == '+') {
+            flags |= BINARY_SYMBOL_ZERO;
+        } else if (c == '{') {
+            flags |= BINARY_SYMBOL_CONSTRUCTOR;
+            ++input_pos;
+            constructor_priority = read_priority();
+            continue;
+        } else if (c == '}') {
+            flags |= BINARY_SYMBOL_DESTRUCTOR;
+            ++input_pos;
+            destructor_priority = read_priority();
+            continue;
+        } else {
+            break;
+        }
+        ++input_pos;
+    }
+
+    length = read_name(&name);
+    write_symbol(flags, constructor_priority, destructor_priority, name, length);
+}
+
+/**
+ * Reads a debug line. The `#` has been consumed. The line ending is not
+ * consumed.
+ */
+static void read_text_debug(void) {
+    const char* start = input_pos;
+    const char* end;
+    const char* p;
+
+    while (!is_end_of_line(input_pos))
+        ++input_pos;
+    end = input_pos;
+
+    // bare `#`
+    p = start;
+    while (p != end && (*p == ' ' || *p == '\t'))
+        ++p;
+    if (p == end) {
+        write_debug(BINARY_INCREMENT, NULL, 0);
+        return;
+    }
+
+    // #line
+    if (end - p > 4 && 0 == memcmp(p, "line", 4) && (p[4] == ' ' || p[4] == '\t')) {
+        const char* q = p + 4;
+        const char* trimmed = end;
+        while (q != end && (*q == ' ' || *q == '\t'))
+            ++q;
+        while (trimmed != q && (trimmed[-1] == ' ' || trimmed[-1] == '\t'))
+            --trimmed;
+        if (trimmed - q == 6 && 0 == memcmp(q, "manual", 6)) {
+            write_debug(BINARY_MANUAL, NULL, 0);
+            return;
+        }
+        if (q != trimmed && isdigit((unsigned char)*q)) {
+            long line = 0;
+            while (q != trimmed && isdigit((unsigned char)*q) && line <= 0x7FFFFFFF)
+                line = line * 10 + (*q++ - '0');
+            while (q != trimmed && (*q == ' ' || *q == '\t'))
+                ++q;
+            if (line > 0 && line <= 0x7FFFFFFF) {
+                if (q == trimmed) {
+                    write_line((int)line, NULL, 0);
+                    return;
+                }
+                if (trimmed - q >= 2 && *q == '"' && trimmed[-1] == '"' &&
+                        NULL == memchr(q + 1, '"', trimmed - q - 2))
+                {
+                    write_line((int)line, q + 1, trimmed - q - 2);
+                    return;
+                }
+            }
+        }
+    }
+
+    // anything else is kept verbatim
+    write_debug(BINARY_DEBUG, start, end - start);
+}
+
+/** Reads the remainder of a binary object. The header has been consumed. */
+static void read_binary(void);
+
+/** Reads plain text (possibly containing binary objects) until the end. */
+static void read_text(void) {
+    while (input_pos != input_end) {
+        char c = *input_pos;
+
+        // line endings
+        if (c == '\n' || c == '\r') {
+            ++input_pos;
+            if (c == '\r' && input_pos != input_end && *input_pos == '\n')
+                ++input_pos;
+            ++input_line;
+            write_lines(1);
+            continue;
+        }
+
+        // horizontal whitespace
+        if (isspace((unsigned char)c)) {
+            ++input_pos;
+            continue;
+        }
+
+        // comments
+        if (c == ';') {
+            while (!is_end_of_line(input_pos))
+                ++input_pos;
+            continue;
+        }
+
+        // debug lines
+        if (c == '#') {
+            ++input_pos;
+            read_text_debug();
+            continue;
+        }
+
+        // hex bytes
+        if (hex_value(c) != -1) {
+            uint8_t byte;
+            if (input_end - input_pos < 2 || hex_value(input_pos[1]) == -1)
+                fatal("Expected hexadecimal character.");
+            byte = (uint8_t)((hex_value(c) << 4) | hex_value(input_pos[1]));
+            input_pos += 2;
+            write_bytes(&byte, 1);
+            continue;
+        }
+
+        // invocations
+        if (c == '^' || c == '<' || c == '>' || c == '&') {
+            unsigned flags = 0;
+            const char* name;
+            size_t length;
+            ++input_pos;
+            if (input_pos != input_end && *input_pos == '?') {
+                flags |= BINARY_INVOKE_WEAK;
+                ++input_pos;
+            }
+            length = read_name(&name);
+            write_invoke(c, flags, name, length);
+            continue;
+        }
+
+        // labels
+        if (c == ':') {
+            const char* name;
+            size_t length;
+            ++input_pos;
+            length = read_name(&name);
+            write_label(name, length);
+            continue;
+        }
+
+        // symbols
+        if (c == '=' || c == '@') {
+            read_text_symbol();
+            continue;
+        }
+
+        // archive members (including the line ending)
+        if (c == '%') {
+            const char* start = input_pos;
+            while (!is_end_of_line(input_pos))
+                ++input_pos;
+            if (input_pos != input_end) {
+                if (*input_pos++ == '\r' && input_pos != input_end && *input_pos == '\n')
+                    ++input_pos;
+            }
+            write_member(start, input_pos - start);
+            input_line = 1;
+            continue;
+        }
+
+        // binary objects
+        if ((uint8_t)c == binary_header[0]) {
+            if (input_end - input_pos < BINARY_HEADER_SIZE ||
+                    0 != memcmp(input_pos, binary_header, BINARY_HEADER_SIZE))
+                fatal("Invalid binary object header.");
+            input_pos += BINARY_HEADER_SIZE;
+            read_binary();
+            continue;
+        }
+
+        fatal("Invalid character.");
+    }
+}
+
+static const char** input_strings;
+static size_t* input_string_lengths;
+static size_t input_strings_count;
+static size_t input_strings_capacity;
+
+static uint8_t binary_byte(void) {
+    if (input_pos == input_end)
+        fatal("Unexpected end of binary object.");
+    return (uint8_t)*input_pos++;
+}
+
+static uint32_t binary_number(void) {
+    uint32_t value = 0;
+    int shift = 0;
+    for (;;) {
+        uint8_t byte = binary_byte();
+        if (shift > 28)
+            fatal("Number in binary object is out of bounds.");
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+        shift += 7;
+    }
+}
+
+static const char* binary_bytes(size_t length) {
+    const char* bytes = input_pos;
+    if ((size_t)(input_end - input_pos) < length)
+        fatal("Unexpected end of binary object.");
+    input_pos += length;
+    return bytes;
+}
+
+static size_t binary_string(uint32_t index, const char** out_name) {
+    if (index >= input_strings_count)
+        fatal("Invalid string index in binary object.");
+    *out_name = input_strings[index];
+    return input_string_lengths[index];
+}
+
+static size_t binary_name(const char** out_name) {
+    return binary_string(binary_number(), out_name);
+}
+
+static void read_binary(void) {
+    input_strings_count = 0;
+    for (;;) {
+        uint8_t type = binary_byte();
+        const char* name;
+        size_t length;
+
+        switch (type) {
+            case BINARY_END:
+                write_end();
+                return;
+
+            case BINARY_STRING:
+                if (input_strings_count == input_strings_capacity) {
+                    input_strings_capacity = input_strings_capacity ? input_strings_capacity * 2 : 256;
+                    input_strings = checked_realloc(input_strings,
+                            input_strings_capacity * sizeof(char*));
+                    input_string_lengths = checked_realloc(input_string_lengths,
+                            input_strings_capacity * sizeof(size_t));
+                }
+                length = binary_number();
+                input_strings[input_strings_count] = binary_bytes(length);
+                input_string_lengths[input_strings_count] = length;
+                ++input_strings_count;
+                break;
+
+            case BINARY_BYTES:
+                length = binary_number();
+                write_bytes((const uint8_t*)binary_bytes(length), length);
+                break;
+
+            case BINARY_LINES: {
+                uint32_t count = binary_number();
+                input_line += count;
+                write_lines(count);
+                break;
+            }
+
+            case BINARY_SYMBOL: {
+                unsigned flags = binary_number();
+                int constructor_priority = -1;
+                int destructor_priority = -1;
+                if (flags & BINARY_SYMBOL_CONSTRUCTOR)
+                    constructor_priority = (int)binary_number() - 1;
+                if (flags & BINARY_SYMBOL_DESTRUCTOR)
+                    destructor_priority = (int)binary_number() - 1;
+                length = binary_name(&name);
+                write_symbol(flags, constructor_priority, destructor_priority, name, length);
+                break;
+            }
+
+            case BINARY_LABEL:
+                length = binary_name(&name);
+                write_label(name, length);
+                break;
+
+            case BINARY_INVOKE: {
+                uint32_t invoke_type = binary_number();
+                unsigned flags = binary_number();
+                if (invoke_type != '^' && invoke_type != '<' &&
+                        invoke_type != '>' && invoke_type != '&')
+                    fatal("Invalid invocation type in binary object.");
+                length = binary_name(&name);
+                write_invoke((char)invoke_type, flags, name, length);
+                break;
+            }
+
+            case BINARY_LINE: {
+                uint32_t line = binary_number();
+                uint32_t filename = binary_number();
+                if (filename == 0) {
+                    write_line(line, NULL, 0);
+                } else {
+                    length = binary_string(filename - 1, &name);
+                    write_line(line, name, length);
+                }
+                break;
+            }
+
+            case BINARY_MANUAL:
+            case BINARY_INCREMENT:
+                write_debug(type, NULL, 0);
+                break;
+
+            case BINARY_DEBUG:
+                length = binary_name(&name);
+                write_debug(type, name, length);
+                break;
+
+            default:
+                fatal("Invalid record type in binary object.");
+        }
+    }
+}
+
+
+
+/*
+ * Main
+ */
+
+static _Noreturn void usage(void) {
+    fputs("Usage: objconv [-binary | -text] <input> -o <output>\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+/** Returns true if the first object in the input is binary. */
+static bool input_is_binary(void) {
+    const char* p = input_start;
+    if (p != input_end && *p == '%') {
+        while (!is_end_of_line(p))
+            ++p;
+        while (p != input_end && (*p == '\r' || *p == '\n'))
+            ++p;
+    }
+    return p != input_end && (uint8_t)*p == binary_header[0];
+}
+
+int main(int argc, const char** argv) {
+    const char* output_filename = NULL;
+    int format = 0; // 1 for binary, -1 for text, 0 for the opposite of the input
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-binary")) {
+            format = 1;
+        } else if (0 == strcmp(argv[i], "-text")) {
+            format = -1;
+        } else if (0 == strcmp(argv[i], "-o")) {
+            if (output_filename != NULL || i + 1 == argc)
+                usage();
+            output_filename = argv[++i];
+        } else {
+            if (input_filename != NULL)
+                usage();
+            input_filename = argv[i];
+        }
+    }
+    if (input_filename == NULL || output_filename == NULL)
+        usage();
+
+    read_input_file();
+    output_binary = format == 0 ? !input_is_binary() : format == 1;
+
+    output_file = fopen(output_filename, "wb");
+    if (output_file == NULL)
+        fatal("Failed to open output file.");
+
+    input_line = 1;
+    read_text();
+    write_end();
+
+    if (!output_binary && !output_line_start)
+        fputc('\n', output_file);
+    if (fclose(output_file) != 0)
+        fatal("Failed to write output file.");
+
+    output_strings_clear();
+    free(pending_bytes);
+    free(input_strings);
+    free(input_string_lengths);
+    free((char*)input_start);
+    return EXIT_SUCCESS;
+}
@@ -54,7 +54,6 @@ static const char* intern(const char* cstr) {
 }
 
 typedef struct debug_block_t {
-    const char* symbol;
     const char* filename;
     int line;
     size_t start_address;
@@ -65,13 +64,24 @@ debug_block_t* debug_blocks;
 size_t debug_blocks_capacity;
 size_t debug_blocks_count;
 
-static void debug_add_block(const char* symbol, const char* filename,
-        int line, size_t address, size_t byte_count)
-{
+/*
+ * Symbols are stored separately in a flat array sorted by address. A symbol
+ * covers all bytes up to the next symbol.
+ */
+typedef struct debug_symbol_t {
+    const char* name;
+    size_t address;
+} debug_symbol_t;
+
+debug_symbol_t* debug_symbols;
+size_t debug_symbols_capacity;
+size_t debug_symbols_count;
+
+static void debug_add_block(const char* filename, int line, size_t address, size_t byte_count) {
     if (byte_count == 0) {
         return;
     }
-    //printf("add block: %s %s:%i 0x%zX %zi\n", symbol, filename, line, address, byte_count);
+    //printf("add block: %s:%i 0x%zX %zi\n", filename, line, address, byte_count);
 
     // grow if needed
     if (debug_blocks_count == debug_blocks_capacity) {
@@ -89,30 +99,37 @@ static void debug_add_block(const char* symbol, const char* filename,
 
     debug_block_t* block = debug_blocks + debug_blocks_count++;
     block->filename = filename;
-    block->symbol = symbol;
     block->line = line;
     block->start_address = address;
     block->end_address = address + byte_count;
 }
 
-void debug_load(const char* executable_filename, size_t address) {
-    char* debug_filename = 0;
-    if (-1 == asprintf(&debug_filename, "%s.od", executable_filename)) {
-        fatal("Out of memory.");
-    }
-    FILE* file = fopen(debug_filename, "r");
-    free(debug_filename);
+static void debug_add_symbol(const char* name, size_t address) {
 
-    if (file == NULL) {
-        //printf("No debug info.\n");
-        return;
-    }
-    if (debug_blocks_count > 0) {
-        fatal("Debug info already loaded.");
+    // grow if needed
+    if (debug_symbols_count == debug_symbols_capacity) {
+        size_t new_capacity = debug_symbols_capacity * 2;
+        if (new_capacity < debug_symbols_capacity) {
+            fatal("Out of memory.");
+        }
+        debug_symbol_t* new_symbols = realloc(debug_symbols, new_capacity * sizeof(debug_symbol_t));
+        if (new_symbols == NULL) {
+            fatal("Out of memory.");
+        }
+        debug_symbols = new_symbols;
+        debug_symbols_capacity = new_capacity;
     }
 
+    debug_symbol_t* symbol = debug_symbols + debug_symbols_count++;
+    symbol->name = name;
+    symbol->address = address;
+}
+
+/**
+ * Loads debug info in the plain text format.
+ */
+static void debug_load_text(FILE* file, size_t address) {
     const char* current_filename = "<unknown>";
-    const char* current_symbol = "<unknown>";
     int current_linenum = 0;
     size_t current_address = address;
 
@@ -173,7 +190,7 @@ void debug_load(const char* executable_filename, size_t address) {
 
         // if it's a bare #, it's a line increment. finish the previous block.
         if (*line == 0) {
-            debug_add_block(current_symbol, current_filename, current_linenum, current_address, byte_count);
+            debug_add_block(current_filename, current_linenum, current_address, byte_count);
             current_address += byte_count;
             byte_count = 0;
             ++current_linenum;
@@ -193,7 +210,7 @@ void debug_load(const char* executable_filename, size_t address) {
             }
 
             // finish the previous block
-            debug_add_block(current_symbol, current_filename, current_linenum, current_address, byte_count);
+            debug_add_block(current_filename, current_linenum, current_address, byte_count);
             current_address += byte_count;
             byte_count = 0;
 
@@ -203,7 +220,7 @@ void debug_load(const char* executable_filename, size_t address) {
                 ++line;
             }
             *line = 0;
-            current_symbol = intern(new_symbol);
+            debug_add_symbol(intern(new_symbol), current_address);
             continue;
         }
 
@@ -251,16 +268,177 @@ void debug_load(const char* executable_filename, size_t address) {
         }
 
         // finish the previous block
-        debug_add_block(current_symbol, current_filename, current_linenum, current_address, byte_count);
+        debug_add_block(current_filename, current_linenum, current_address, byte_count);
         current_address += byte_count;
         byte_count = 0;
-        current_filename = intern(new_filename);
+        if (new_filename) {
+            current_filename = intern(new_filename);
+        }
         current_linenum = new_linenum;
     }
 
+    // finish the last block
+    debug_add_block(current_filename, current_linenum, current_address, byte_count);
+}
+
+/*
+ * Compact debug info is a binary file (see docs/debug-info.md.) We read the
+ * whole thing into memory and decode it.
+ */
+
+static const unsigned char* compact_pos;
+static const unsigned char* compact_end;
+
+static size_t debug_compact_number(void) {
+    size_t value = 0;
+    int shift = 0;
+    for (;;) {
+        if (compact_pos == compact_end || shift > 28) {
+            fatal("Invalid debug info");
+        }
+        unsigned char byte = *compact_pos++;
+        value |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+static const char* debug_compact_string(void) {
+    size_t length = debug_compact_number();
+    if (length > (size_t)(compact_end - compact_pos)) {
+        fatal("Invalid debug info");
+    }
+    string_t* string = string_intern_bytes((const char*)compact_pos, length);
+    compact_pos += length;
+    return string->bytes;
+}
+
+/**
+ * Loads debug info in the compact binary format. The header has already been
+ * read.
+ */
+static void debug_load_compact(FILE* file, size_t address) {
+    size_t capacity = 4096;
+    size_t size = 0;
+    unsigned char* bytes = malloc(capacity);
+    if (bytes == NULL) {
+        fatal("Out of memory.");
+    }
+    for (;;) {
+        size += fread(bytes + size, 1, capacity - size, file);
+        if (size < capacity) {
+            break;
+        }
+        capacity *= 2;
+        bytes = realloc(bytes, capacity);
+        if (bytes == NULL) {
+            fatal("Out of memory.");
+        }
+    }
+    compact_pos = bytes;
+    compact_end = bytes + size;
+
+    // file table
+    size_t files_count = debug_compact_number();
+    if (files_count > size) {
+        fatal("Invalid debug info");
+    }
+    const char** files = malloc((files_count + 1) * sizeof(const char*));
+    if (files == NULL) {
+        fatal("Out of memory.");
+    }
+    files[0] = "<unknown>";
+    for (size_t i = 1; i <= files_count; ++i) {
+        files[i] = debug_compact_string();
+    }
+
+    // symbol index
+    size_t symbols_count = debug_compact_number();
+    size_t symbol_address = address;
+    for (size_t i = 0; i < symbols_count; ++i) {
+        symbol_address += debug_compact_number();
+        debug_add_symbol(debug_compact_string(), symbol_address);
+    }
+
+    // line runs
+    size_t runs_count = debug_compact_number();
+    size_t current_address = address;
+    size_t current_file = 0;
+    int current_line = 0;
+    for (size_t i = 0; i < runs_count; ++i) {
+        size_t op = debug_compact_number();
+        size_t zigzag = op >> 1;
+        if (zigzag & 1) {
+            current_line -= (int)((zigzag + 1) / 2);
+        } else {
+            current_line += (int)(zigzag / 2);
+        }
+        if (op & 1) {
+            current_file = debug_compact_number();
+            if (current_file > files_count) {
+                fatal("Invalid debug info");
+            }
+        }
+        size_t byte_count = debug_compact_number();
+        debug_add_block(files[current_file], current_line, current_address, byte_count);
+        current_address += byte_count;
+    }
+
+    free(files);
+    free(bytes);
+}
+
+void debug_load(const char* executable_filename, size_t address) {
+    char* debug_filename = 0;
+    if (-1 == asprintf(&debug_filename, "%s.od", executable_filename)) {
+        fatal("Out of memory.");
+    }
+    FILE* file = fopen(debug_filename, "rb");
+    free(debug_filename);
+
+    if (file == NULL) {
+        //printf("No debug info.\n");
+        return;
+    }
+    if (debug_blocks_count > 0) {
+        fatal("Debug info already loaded.");
+    }
+
+    // check for the compact format header
+    unsigned char header[4];
+    if (4 == fread(header, 1, 4, file) &&
+            header[0] == 0x7F && header[1] == 'O' && header[2] == 'D' && header[3] == 1)
+    {
+        debug_load_compact(file, address);
+    } else {
+        rewind(file);
+        debug_load_text(file, address);
+    }
+
     fclose(file);
 }
 
+static const char* debug_find_symbol(size_t address) {
+
+    // binary search for the last symbol at or before the address
+    size_t left = 0;
+    size_t right = debug_symbols_count;
+    while (left != right) {
+        size_t mid = (left + right) / 2;
+        if (debug_symbols[mid].address <= address) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    if (left == 0) {
+        return "<unknown>";
+    }
+    return debug_symbols[left - 1].name;
+}
+
 bool debug_find(size_t address, const char** out_symbol, const char** out_filename, int* out_line) {
     *out_filename = "<unknown>";
     *out_line = 0;
@@ -289,7 +467,7 @@ bool debug_find(size_t address, const char** out_symbol, const char** out_filena
 
     // found
     debug_block_t* block = debug_blocks + left;
-    *out_symbol = block->symbol;
+    *out_symbol = debug_find_symbol(address);
     *out_filename = block->filename;
     *out_line = block->line;
     return true;
@@ -396,11 +574,14 @@ bool debug_stack_has_return(uint32_t return_address) {
 void debug_init(void) {
     debug_blocks_capacity = 128;
     debug_blocks = malloc(debug_blocks_capacity * sizeof(debug_block_t));
+    debug_symbols_capacity = 64;
+    debug_symbols = malloc(debug_symbols_capacity * sizeof(debug_symbol_t));
     debug_frames_capacity = 16;
     debug_frames = malloc(debug_frames_capacity * sizeof(debug_frame_t));
 }
 
 void debug_destroy(void) {
     free(debug_blocks);
+    free(debug_symbols);
     free(debug_frames);
 }
@@ -617,6 +617,17 @@ static uint32_t vm_fopen(vm_t* vm) {
         panic("No free I/O handles");
     }
 
+    // a null path opens an anonymous file
+    if (path_addr == 0) {
+        vm->files[file_index] = tmpfile();
+        if (vm->files[file_index] == vm_ghost_null) {
+            strace("sys fopen() anonymous file failed.\n");
+            return VM_ERR_GENERIC;
+        }
+        strace("sys fopen() anonymous file returning handle 0x%x\n", file_index + FILES_OFFSET);
+        return file_index + FILES_OFFSET;
+    }
+
     if (!vm_is_string_valid(vm, path_addr)) {
         fputs("ERROR: Invalid path.\n", stderr);
         exit(125);
@@ -764,7 +775,19 @@ static uint32_t vm_stat(vm_t* vm) {
 }
 
 static uint32_t vm_rename(vm_t* vm) {
-    panic("TODO rename syscall not yet implemented");
+    uint32_t from_addr = vm->registers[0];
+    uint32_t to_addr = vm->registers[1];
+    if (!vm_is_string_valid(vm, from_addr) || !vm_is_string_valid(vm, to_addr)) {
+        fputs("ERROR: Invalid path.\n", stderr);
+        exit(125);
+    }
+    const char* from = (const char*)(vm->memory + (from_addr - vm->memory_base));
+    const char* to = (const char*)(vm->memory + (to_addr - vm->memory_base));
+    strace("sys rename() %s to %s\n", from, to);
+    if (0 == rename(from, to))
+        return 0;
+    // TODO correct error codes
+    return VM_ERR_GENERIC;
 }
 
 static uint32_t vm_symlink(vm_t* vm) {
@@ -23,11 +23,12 @@
 # SOFTWARE.
 
 
-# This script runs the VM tests on the debugger. (We don't actually have any
-# debugger-specific tests.)
+# This script runs the VM tests on the debugger, followed by the
+# debugger-specific tests of its debug info support.
 
 
 set -e
 "$(dirname "$0")/build.sh"
 cd "$(dirname "$0")/../../.."
 test/vm/run.sh build/test/vm-c-debugger/vm
+test/vm/c-debugger/run.sh build/test/vm-c-debugger/vm
@@ -517,10 +517,6 @@ static void vm_fopen(void) {
     uint32_t handle;
     size_t i;
 
-    vm_check_string(path_addr);
-    path = (const char*)vm_memory + path_addr;
-    /*fprintf(stderr, "open %s %u\n", path, mode);*/
-
     /* find a free handle (not the standard streams 0,1,2) */
     handle = UINT32_MAX;
     for (i = 3; i < (size_t)VM_MAX_FILES; ++i) {
@@ -531,6 +527,17 @@ static void vm_fopen(void) {
     }
     vm_check(handle != UINT32_MAX, "No free file descriptors");
 
+    /* a null path opens an anonymous file */
+    if (path_addr == 0) {
+        vm_files[handle] = tmpfile();
+        vm_registers[0] = vm_files[handle] == NULL ? VM_ERR_GENERIC : handle;
+        return;
+    }
+
+    vm_check_string(path_addr);
+    path = (const char*)vm_memory + path_addr;
+    /*fprintf(stderr, "open %s %u\n", path, mode);*/
+
     /* open it */
     vm_files[handle] = fopen(path, mode ? "a+b" : "rb");
     if (vm_files[handle] == NULL) {
@@ -684,6 +691,18 @@ static void vm_chmod(void) {
     #endif
 }
 
+static void vm_rename(void) {
+    uint32_t from_addr = vm_registers[0];
+    uint32_t to_addr = vm_registers[1];
+    const char* from;
+    const char* to;
+    vm_check_string(from_addr);
+    vm_check_string(to_addr);
+    from = (const char*)vm_memory + from_addr;
+    to = (const char*)vm_memory + to_addr;
+    vm_registers[0] = rename(from, to) ? VM_ERR_GENERIC : 0;
+}
+
 static void vm_sys(uint8_t syscall) {
     /*printf("%u %u\n",arg1,arg2);*/
 
@@ -715,6 +734,9 @@ static void vm_sys(uint8_t syscall) {
         case 0x09: /* ftrunc */
             vm_ftrunc();
             return;
+        case 0x0E: /* rename */
+            vm_rename();
+            return;
         case 0x11: /* chmod */
             vm_chmod();
             return;
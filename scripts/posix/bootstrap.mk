@@ -0,0 +1,127 @@
+
+# The MIT License (MIT)
+#
+# Copyright (c) 2023-2024 Fraser Heavy Software
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# This is the stage graph for the parallel and incremental bootstrap. It's run
+# by `scripts/posix/build.sh -j N` or `--incremental` after the hex tool, VM
+# and shell have been set up; it runs the same stage scripts as core/build.sh,
+# which must be kept in sync with it.
+#
+# The prerequisites of each stage are all stages whose outputs it uses,
+# including the tools named in its ccargs files, not just the previous stage.
+# Each stage is run by stage.sh which skips it if its inputs are unchanged and
+# runs the independent commands within it in parallel.
+
+STAGE = +@MAKE="$(MAKE)" sh scripts/posix/stage.sh $@
+
+# All stages in the order of core/build.sh. This is the order of the timing
+# summary.
+STAGES = \
+	ld-0-global ar-0-cat libc-0-oo libo-0-oo as-0-basic as-1-compound \
+	cpp-0-strip cci-0-omc cpp-1-omc ld-1-omc libc-1-omc cc \
+	cci-1-opc libc-2-opc libo-1-opc ld-2-full cci-2-full cpp-2-full \
+	libc-3-full as-2-full libc-common \
+	libc-3-full-re libo-1-opc-re cc-re ld-2-full-re as-2-full-re \
+	cci-2-full-re cpp-2-full-re \
+	ar-1-unix hex-1-c89 objconv
+
+.PHONY: all $(STAGES)
+
+all: $(STAGES)
+	@echo Indexing libc
+	@onrampvm build/output/bin/ar.oe s build/output/lib/libc.oa
+	@sh scripts/posix/stage.sh --summary $(STAGES)
+
+# Hand-written stages: ld/0, ar/0, libc/0, libo/0, as/0, as/1, cpp/0, cci/0
+ld-0-global:
+	$(STAGE) core/ld/0-global/build.sh $^
+ar-0-cat: ld-0-global
+	$(STAGE) core/ar/0-cat/build.sh $^
+libc-0-oo: ar-0-cat
+	$(STAGE) core/libc/0-oo/build.sh $^
+libo-0-oo: ar-0-cat
+	$(STAGE) core/libo/0-oo/build.sh $^
+as-0-basic: ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/as/0-basic/build.sh $^
+as-1-compound: as-0-basic ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/as/1-compound/build.sh $^
+cpp-0-strip: as-1-compound ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/cpp/0-strip/build.sh $^
+cci-0-omc: as-1-compound ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/cci/0-omc/build.sh $^
+
+# omC stages: cpp/1, ld/1, libc/1 and the driver
+cpp-1-omc: cpp-0-strip cci-0-omc as-1-compound ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/cpp/1-omc/build.sh $^
+ld-1-omc: cpp-1-omc cci-0-omc as-1-compound ld-0-global libc-0-oo libo-0-oo
+	$(STAGE) core/ld/1-omc/build.sh $^
+libc-1-omc: cpp-1-omc cci-0-omc as-1-compound ar-0-cat
+	$(STAGE) core/libc/1-omc/build.sh $^
+cc: cpp-1-omc cci-0-omc as-1-compound ld-1-omc libc-1-omc libo-0-oo
+	$(STAGE) core/cc/build.sh $^
+
+# opC stages, compiled with cci/1 (and cci/2 once it exists)
+cci-1-opc: cc cpp-1-omc cci-0-omc as-1-compound ld-1-omc libc-1-omc libo-0-oo
+	$(STAGE) core/cci/1-opc/build.sh $^
+libc-2-opc: cc cpp-1-omc cci-1-opc as-1-compound ar-0-cat libc-1-omc
+	$(STAGE) core/libc/2-opc/build.sh $^
+libo-1-opc: cc cpp-1-omc cci-1-opc as-1-compound ar-0-cat
+	$(STAGE) core/libo/1-opc/build.sh $^
+ld-2-full: cc cpp-1-omc cci-1-opc as-1-compound ld-1-omc libc-2-opc libo-1-opc
+	$(STAGE) core/ld/2-full/build.sh $^
+cci-2-full: cc cpp-1-omc cci-1-opc as-1-compound ld-2-full libc-2-opc libo-1-opc
+	$(STAGE) core/cci/2-full/build.sh $^
+cpp-2-full: cc cpp-1-omc cci-2-full as-1-compound ld-2-full libc-2-opc libo-1-opc
+	$(STAGE) core/cpp/2-full/build.sh $^
+libc-3-full: cc cpp-2-full cci-2-full as-1-compound ar-0-cat libc-1-omc libc-2-opc
+	$(STAGE) core/libc/3-full/build.sh $^
+as-2-full: cc cpp-2-full cci-2-full as-1-compound ld-2-full libc-3-full libo-1-opc
+	$(STAGE) core/as/2-full/build.sh $^
+libc-common:
+	$(STAGE) core/libc/common/build.sh $^
+
+# Rebuilds with the final toolchain. Tools not named in a rebuild's ccargs
+# default to those in build/output/, so the later rebuilds depend on the
+# earlier ones.
+libc-3-full-re: cc cpp-2-full cci-2-full as-2-full ar-0-cat libc-2-opc
+	$(STAGE) core/libc/3-full/rebuild.sh $^
+libo-1-opc-re: cc cpp-1-omc cci-1-opc as-1-compound ar-0-cat
+	$(STAGE) core/libo/1-opc/rebuild.sh $^
+cc-re: cc cpp-2-full cci-2-full as-2-full ld-2-full libc-3-full-re libo-1-opc-re
+	$(STAGE) core/cc/rebuild.sh $^
+ld-2-full-re: cc-re cpp-2-full cci-2-full as-2-full ld-2-full libc-3-full-re libo-1-opc-re libc-common
+	$(STAGE) core/ld/2-full/rebuild.sh $^
+as-2-full-re: cc-re cpp-2-full cci-2-full as-2-full ld-2-full-re libc-3-full-re libo-1-opc-re libc-common
+	$(STAGE) core/as/2-full/rebuild.sh $^
+cci-2-full-re: cc-re cpp-2-full cci-2-full as-2-full-re ld-2-full-re libc-3-full-re libo-1-opc-re libc-common
+	$(STAGE) core/cci/2-full/rebuild.sh $^
+cpp-2-full-re: cc-re cpp-2-full cci-2-full-re as-2-full-re ld-2-full-re libc-3-full-re libo-1-opc-re libc-common
+	$(STAGE) core/cpp/2-full/rebuild.sh $^
+
+# Tools built with the final toolchain in build/output/
+FINAL = cc-re ld-2-full-re as-2-full-re cci-2-full-re cpp-2-full-re libc-3-full-re libc-common
+ar-1-unix: $(FINAL)
+	$(STAGE) core/ar/1-unix/build.sh $^
+hex-1-c89: $(FINAL)
+	$(STAGE) core/hex/1-c89/build.sh $^
+objconv: $(FINAL)
+	$(STAGE) core/objconv/build.sh $^
@@ -416,6 +416,10 @@ usage() {
     echo "    --min            Use only tools with no additional dependencies (i.e. a shell"
     echo "                         hex tool and machine code VM), fail otherwise"
     echo "    --setup          Skip the core bootstrap; setup the VM, hex and shell only"
+    echo "    -j, --jobs <n>   Run the core bootstrap with make, running up to n commands"
+    echo "                         at once"
+    echo "    --incremental    Keep build/ and skip stages whose inputs haven't changed"
+    echo "                         (implies the make bootstrap)"
     echo
     echo "Look in platform/hex/ and platform/vm/ for the names of tools. Only those tools"
     echo "that support POSIX platforms can be built by this script."
@@ -425,6 +429,8 @@ usage() {
 DEV=0
 MIN=0
 SETUP_ONLY=0
+JOBS=
+INCREMENTAL=0
 HEX_CHOICE=
 VM_CHOICE=
 while [ "x$1" != "x" ]; do
@@ -459,6 +465,19 @@ while [ "x$1" != "x" ]; do
         SETUP_ONLY=1
         shift
 
+    elif [ "$1" = "-j" ] || [ "$1" = "--jobs" ]; then
+        shift
+        if [ "x$1" = "x" ]; then
+            echo "ERROR: --jobs must be followed by a number of jobs."
+            exit 1
+        fi
+        JOBS=$1
+        shift
+
+    elif [ "$1" = "--incremental" ]; then
+        INCREMENTAL=1
+        shift
+
     elif [ "$1" = "--help" ] || [ "$1" = "-h" ] || [ "$1" = "-?" ]; then
         usage
         exit 0
@@ -507,8 +526,19 @@ fi
 # Main build
 #######################################################
 
-echo "Cleaning build/"
-rm -rf build
+# The make bootstrap is used for parallel or incremental builds
+if [ "x$JOBS" = "x" ] && [ $INCREMENTAL -eq 1 ]; then
+    JOBS=1
+fi
+
+if [ $INCREMENTAL -eq 1 ]; then
+    # The VM and wrappers are set up again; everything else is kept.
+    echo "Keeping build/ for an incremental build"
+    rm -f $VM_PATH
+else
+    echo "Cleaning build/"
+    rm -rf build
+fi
 
 # Setup basic POSIX paths
 mkdir -p \
@@ -554,7 +584,16 @@ onrampvm build/intermediate/hex-0-onramp/hex.oe core/sh/sh.oe.ohx -o build/inter
 
 # Now that we have everything we need we can jump inside the VM for the rest
 # of the bootstrap process.
-if [ $SETUP_ONLY -eq 0 ]; then
+if [ $SETUP_ONLY -eq 0 ] && [ "x$JOBS" != "x" ]; then
+    # The make bootstrap runs the same stage scripts as core/build.sh, in
+    # parallel where possible. See scripts/posix/bootstrap.mk.
+    echo
+    echo "Running the Onramp bootstrap with $JOBS jobs..."
+    START=$(awk 'BEGIN { srand(); print srand() }')
+    make --no-print-directory -j "$JOBS" -f scripts/posix/bootstrap.mk all
+    END=$(awk 'BEGIN { srand(); print srand() }')
+    echo "    total (wall)     $((END - START))s"
+elif [ $SETUP_ONLY -eq 0 ]; then
     echo
     echo "Entering Onramp virtual machine..."
     # TODO since our sh tool is incomplete we run this script directly.
@@ -0,0 +1,289 @@
+#!/bin/sh
+
+
+# The MIT License (MIT)
+#
+# Copyright (c) 2023-2024 Fraser Heavy Software
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# This script runs one stage of the parallel and incremental bootstrap. It's
+# run from the root of the repo by bootstrap.mk.
+#
+# Usage:
+#
+#     stage.sh <name> <script> [<dependency> ...]
+#     stage.sh --block <block>
+#     stage.sh --summary <name> ...
+#
+# A stage is skipped if its inputs are unchanged since it last ran and all of
+# its outputs still exist. Its inputs are:
+#
+# - its script, its ccargs files, and all files in the directories of the
+#   core/ files they name (to pick up headers);
+# - the outputs of its dependency stages;
+# - any other existing files it names under build/ (e.g. the hex tool.)
+#
+# Input files are compared by checksum, not by timestamp. A dependency that
+# is rebuilt with identical outputs doesn't cause its dependents to rebuild.
+#
+# Otherwise the script is split into blocks at blank lines. Consecutive blocks
+# that preprocess, compile or assemble the same file form a job. Jobs between
+# other blocks (e.g. linking) run in parallel through a generated makefile
+# that shares the job slots of the parent make. Each job has its own TMPDIR
+# and its output is printed when it finishes.
+
+set -e
+
+STAGES=build/stages
+
+# Prints the current time in seconds. (srand() returns the previous seed,
+# which awk initializes from the time of day.)
+now() {
+    awk 'BEGIN { srand(); print srand() }'
+}
+
+# Lists the files named by the given scripts, one per line, each prefixed
+# with "src", "in", "out" or "args" (for @ files.)
+scan() {
+    awk '
+        /^[ \t]*#/ { next }
+        $1 == "mkdir" { next }
+        {
+            for (i = 1; i <= NF; ++i) {
+                word = $i
+                if (word == "\\") {
+                    continue
+                }
+                if (prev == "-o" || prev == "rc" || ($1 == "cp" && i == NF)) {
+                    print "out " word
+                } else {
+                    if (word ~ /^@/) {
+                        print "args " substr(word, 2)
+                    }
+                    sub(/^(-I|-with-[a-z]+=|@)/, "", word)
+                    if (word ~ /^core\//) {
+                        print "src " word
+                    }
+                    if (word ~ /^build\//) {
+                        print "in " word
+                    }
+                }
+                prev = word
+            }
+        }' "$@"
+}
+
+# Lists the source files of the stage: everything in the directories of the
+# core/ files it names, and everything under the directories it names.
+list_sources() {
+    sed -n 's/^src //p' "$DIR/scan" | sort -u | while read -r path; do
+        if [ -d "$path" ]; then
+            find "$path" -type f
+        else
+            for file in "$(dirname "$path")"/*; do
+                if [ -f "$file" ]; then
+                    echo "$file"
+                fi
+            done
+        fi
+    done | sort -u
+}
+
+# Prints the input signature of the stage.
+input_signature() {
+    # the outputs of our dependencies
+    : > "$DIR/dependency-outputs"
+    for dependency in $DEPENDENCIES; do
+        echo "$dependency $(cat "$STAGES/$dependency/output-signature")"
+        cat "$STAGES/$dependency/outputs" >> "$DIR/dependency-outputs"
+    done
+
+    # our sources
+    list_sources | while read -r file; do
+        cksum "$file"
+    done
+
+    # other files under build/ that aren't produced by us or by a dependency
+    sort -u "$DIR/dependency-outputs" "$DIR/outputs" > "$DIR/known-outputs"
+    sed -n 's/^in //p' "$DIR/scan" | sort -u | comm -23 - "$DIR/known-outputs" |
+    while read -r file; do
+        if ! [ -e "$file" ]; then
+            echo "ERROR: $NAME needs $file which isn't produced by any of its dependencies." 1>&2
+            echo "       Is a dependency missing from scripts/posix/bootstrap.mk?" 1>&2
+            exit 1
+        fi
+        if [ -f "$file" ]; then
+            cksum "$file"
+        fi
+    done
+}
+
+# Prints the output signature of the stage.
+output_signature() {
+    while read -r file; do
+        cksum "$file"
+    done < "$DIR/outputs" | cksum
+}
+
+# Returns true if all outputs from the last run of the stage exist.
+outputs_exist() {
+    while read -r file; do
+        if ! [ -e "$file" ]; then
+            return 1
+        fi
+    done < "$DIR/outputs"
+}
+
+# Splits the stage script into blocks, writing each one to a file and
+# printing "job <n>" or "barrier <n>" for each.
+split_blocks() {
+    awk -v dir="$DIR" '
+        function flush() {
+            if (text == "") {
+                return
+            }
+            job = (first ~ /^echo (Preprocessing|Compiling|Assembling) /)
+            key = first
+            sub(/^echo [A-Za-z]* /, "", key)
+            if (!(job && last_job && key == last_key)) {
+                ++count
+                print (job ? "job " : "barrier ") count
+                print "set -e" > (dir "/block-" count ".sh")
+            }
+            printf "%s", text >> (dir "/block-" count ".sh")
+            close(dir "/block-" count ".sh")
+            last_job = job
+            last_key = key
+            text = ""
+            first = ""
+        }
+        /^[ \t]*$/ { flush(); next }
+        {
+            if (first == "" && $0 !~ /^[ \t]*#/) {
+                first = $0
+            }
+            text = text $0 "\n"
+        }
+        END { flush() }' "$SCRIPT"
+}
+
+# Writes a makefile that runs the blocks of the stage. Each job depends on
+# the barrier before it and each barrier depends on everything before it.
+write_blocks_makefile() {
+    barrier=
+    jobs=
+    split_blocks > "$DIR/blocks"
+    while read -r type block; do
+        if [ "$type" = "job" ]; then
+            echo "block-$block:$barrier"
+            jobs="$jobs block-$block"
+        else
+            echo "block-$block:$barrier$jobs"
+            barrier=" block-$block"
+            jobs=
+        fi
+        printf '\t@sh scripts/posix/stage.sh --block %s/block-%s\n' "$DIR" "$block"
+    done < "$DIR/blocks"
+    echo "all:$barrier$jobs"
+    echo ".PHONY: all$(awk '{ printf " block-%s", $2 }' "$DIR/blocks")"
+}
+
+# Runs one block of a stage script, printing its output when it finishes.
+#
+# Each block gets its own TMPDIR because cc numbers its temporary files per
+# process so parallel blocks would clash in /tmp. The tools leave temporary
+# filenames out of their outputs so this doesn't change what gets built.
+run_block() {
+    tmpdir="$1.tmp"
+    rm -rf "$tmpdir"
+    mkdir -p "$tmpdir"
+    if TMPDIR="$(pwd)/$tmpdir" sh "$1.sh" > "$1.log" 2>&1; then
+        cat "$1.log"
+        rm -rf "$tmpdir"
+    else
+        cat "$1.log"
+        echo "ERROR: Command failed in $1.sh"
+        exit 1
+    fi
+}
+
+# Prints the time taken by each stage.
+print_summary() {
+    echo
+    echo "Stage times (wall clock):"
+    total=0
+    for name in "$@"; do
+        time="$(cat "$STAGES/$name/time" 2>/dev/null || echo "?")"
+        if [ "$time" = "skipped" ] || [ "$time" = "?" ]; then
+            printf '    %-16s %8s\n' "$name" "$time"
+        else
+            printf '    %-16s %7ss\n' "$name" "$time"
+            total=$((total + time))
+        fi
+    done
+    printf '    %-16s %7ss\n' "(sum)" "$total"
+}
+
+if [ "$1" = "--block" ]; then
+    run_block "$2"
+    exit 0
+fi
+if [ "$1" = "--summary" ]; then
+    shift
+    print_summary "$@"
+    exit 0
+fi
+
+NAME="$1"
+SCRIPT="$2"
+shift 2
+DEPENDENCIES="$*"
+DIR="$STAGES/$NAME"
+mkdir -p "$DIR"
+
+# Find the files the stage uses and produces
+scan "$SCRIPT" > "$DIR/scan"
+ARGS="$(sed -n 's/^args //p' "$DIR/scan" | sort -u)"
+scan "$SCRIPT" $ARGS > "$DIR/scan"
+echo "src $SCRIPT" >> "$DIR/scan"
+sed -n 's/^out //p' "$DIR/scan" | sort -u > "$DIR/outputs"
+
+# Skip the stage if nothing changed
+input_signature > "$DIR/input-signature.new"
+if [ -f "$DIR/input-signature" ] && cmp -s "$DIR/input-signature" "$DIR/input-signature.new" && outputs_exist; then
+    echo
+    echo "=== Skipping $NAME (up to date)"
+    echo skipped > "$DIR/time"
+    rm -f "$DIR/input-signature.new"
+    exit 0
+fi
+rm -f "$DIR/input-signature" "$DIR/time"
+
+# Run it
+start=$(now)
+rm -f "$DIR"/block-*
+write_blocks_makefile > "$DIR/blocks.mk"
+${MAKE:-make} --no-print-directory -f "$DIR/blocks.mk" all
+end=$(now)
+
+# Record our signatures for dependents and for the next run
+output_signature > "$DIR/output-signature"
+mv "$DIR/input-signature.new" "$DIR/input-signature"
+echo $((end - start)) > "$DIR/time"
@@ -1,4 +1,86 @@
-#!/bin/sh
+#!/bin/bash
 
-# TODO we don't have any archiver tests yet.
-exit 0
+# This script tests the given archiver by running it against all .args files
+# in the given folder.
+#
+# Each .args file contains the arguments to pass to the archiver. `$OUTPUT`
+# in the arguments is replaced with the path of a temporary archive. The
+# archiver is run from the folder containing the test so that member names
+# don't depend on where the tests are run from. (The command must therefore
+# use absolute paths.)
+#
+# If a corresponding .before file exists, it is copied to the output archive
+# before running the archiver.
+#
+# If a corresponding .oa file exists, the archiver must succeed and the output
+# archive must match it. If a corresponding .stdout file exists, the archiver
+# must succeed and its output must match it. If neither exist, the archiver
+# must fail.
+
+if [ "$1" == "" ]; then
+    echo "Need folder to test."
+    exit 1
+fi
+if [ "$2" == "" ]; then
+    echo "Need command to test."
+    exit 1
+fi
+
+SOURCE_FOLDER="$1"
+shift
+COMMAND="$@"
+TEMP_OA=/tmp/onramp-test.oa
+TEMP_STDOUT=/tmp/onramp-test.stdout
+ERROR=0
+
+TESTS_PATH="$(basename $(realpath $SOURCE_FOLDER/..))/$(basename $(realpath $SOURCE_FOLDER))"
+echo "Running $TESTS_PATH tests on: $COMMAND"
+
+for TESTFILE in $(find $SOURCE_FOLDER/* -name '*.args' | sort); do
+    echo "Testing $TESTFILE"
+    BASENAME=$(echo $TESTFILE|sed 's/\.args$//')
+
+    rm -f $TEMP_OA
+    if [ -e $BASENAME.before ]; then
+        cp $BASENAME.before $TEMP_OA
+    fi
+
+    OUTPUT=$TEMP_OA
+    # eval echo to expand shell macros
+    ARGS=$(eval echo $(cat $TESTFILE))
+
+    ( cd $(dirname $TESTFILE) && $COMMAND $ARGS ) > $TEMP_STDOUT 2> /dev/null
+    RET=$?
+
+    if [ -e $BASENAME.oa ] || [ -e $BASENAME.stdout ]; then
+        if [ $RET -ne 0 ]; then
+            echo "ERROR: $TESTFILE failed; expected success."
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        elif [ -e $BASENAME.oa ] && ! diff -q $BASENAME.oa $TEMP_OA > /dev/null; then
+            echo "ERROR: $TESTFILE did not match expected $BASENAME.oa"
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        elif [ -e $BASENAME.stdout ] && ! diff -q $BASENAME.stdout $TEMP_STDOUT > /dev/null; then
+            echo "ERROR: $TESTFILE output did not match expected $BASENAME.stdout"
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        fi
+    else
+        if [ $RET -eq 0 ]; then
+            echo "ERROR: $TESTFILE succeeded; expected error."
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        fi
+    fi
+done
+
+rm -f $TEMP_OA
+rm -f $TEMP_STDOUT
+
+if [ $ERROR -eq 1 ]; then
+    echo "Errors occurred."
+    exit 1
+fi
+
+echo "Pass."
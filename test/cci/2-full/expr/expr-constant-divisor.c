@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// Multiplication, division, modulo and shifts by constants are compiled to
+// special sequences. We check them against the same operations on variables,
+// which use the general instructions.
+
+typedef struct three_t {
+    char c[3];
+} three_t;
+
+typedef struct twelve_t {
+    int i[3];
+} twelve_t;
+
+static int values[] = {
+    0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 100, 1023, 1024, 1025, 65535,
+    -1, -2, -3, -5, -7, -8, -9, -15, -16, -17, -100, -1023, -1024, -1025,
+    0x7FFFFFFF, -0x7FFFFFFF - 1,
+};
+
+static int check_signed(int x) {
+    int d1 = 1, d2 = 2, d4 = 4, d8 = 8, d16 = 16, d256 = 256, d3 = 3, d5 = 5;
+    int n4 = -4, n1 = -1;
+    if (x * 8 != x * d8) return 1;
+    if (x * 3 != x * d3) return 2;
+    if (x * 0 != 0) return 3;
+    if (x / 1 != x / d1) return 4;
+    if (x / 2 != x / d2) return 5;
+    if (x / 4 != x / d4) return 6;
+    if (x / 16 != x / d16) return 7;
+    if (x / 256 != x / d256) return 8;
+    if (x / 5 != x / d5) return 9;
+    if (x % 1 != x % d1) return 10;
+    if (x % 2 != x % d2) return 11;
+    if (x % 8 != x % d8) return 12;
+    if (x % 256 != x % d256) return 13;
+    if (x % 3 != x % d3) return 14;
+    if (x % -4 != x % n4) return 15;
+    if (x >> 1 != x >> d1) return 16;
+    if (x >> 4 != x >> d4) return 17;
+    if (x >> 31 != x >> (d16 + 15)) return 18;
+    if (x != -0x7FFFFFFF - 1 && x / -1 != x / n1) return 19;
+    return 0;
+}
+
+static int check_unsigned(unsigned x) {
+    unsigned d1 = 1, d4 = 4, d8 = 8, d3 = 3, d256 = 256, dbig = 0x80000000u;
+    if (x * 4u != x * d4) return 1;
+    if (x / 1u != x / d1) return 2;
+    if (x / 8u != x / d8) return 3;
+    if (x / 3u != x / d3) return 4;
+    if (x / 0x80000000u != x / dbig) return 5;
+    if (x % 8u != x % d8) return 6;
+    if (x % 256u != x % d256) return 7;
+    if (x % 3u != x % d3) return 8;
+    if (x % 0x80000000u != x % dbig) return 9;
+    return 0;
+}
+
+static int check_pointers(void) {
+    three_t threes[10];
+    twelve_t twelves[10];
+    int ints[10];
+    for (int i = 0; i < 10; ++i) {
+        if (&threes[9] - &threes[i] != 9 - i) return 1;
+        if (&threes[i] - &threes[9] != i - 9) return 2;
+        if (&twelves[9] - &twelves[i] != 9 - i) return 3;
+        if (&twelves[i] - &twelves[9] != i - 9) return 4;
+        if (&ints[i] - &ints[0] != i) return 5;
+        if (&ints[0] - &ints[i] != -i) return 6;
+    }
+    if ((char*)&twelves[3] - (char*)twelves != 36) return 7;
+    if ((char*)(twelves + 2) - (char*)twelves != 24) return 8;
+    twelve_t* p = twelves + 5;
+    if (p - 2 != &twelves[3]) return 9;
+    p -= 3;
+    if (p != &twelves[2]) return 10;
+    ints[7] = 42;
+    if (ints[7] != 42 || *(ints + 7) != 42) return 11;
+    return 0;
+}
+
+int main(void) {
+    for (int i = 0; i < (int)(sizeof(values) / sizeof(*values)); ++i) {
+        int ret = check_signed(values[i]);
+        if (ret) return ret;
+        ret = check_unsigned((unsigned)values[i]);
+        if (ret) return 20 + ret;
+    }
+    int x = 100;
+    x /= 8;
+    if (x != 12) return 40;
+    x %= 8;
+    if (x != 4) return 41;
+    x = -100;
+    x /= 8;
+    if (x != -12) return 42;
+    x = -100;
+    x %= 8;
+    if (x != -4) return 43;
+    return check_pointers() ? 50 + check_pointers() : 0;
+}
@@ -0,0 +1,246 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// Struct copies and array zeroing are unrolled, looped or done with a libc
+// helper depending on their size and alignment. This tests sizes on either
+// side of the thresholds with byte, short and word alignment.
+
+#include <string.h>
+
+// (these are mixed but have no padding so we can check every byte)
+typedef struct tail_t { int i[3]; short s; char c[2]; } tail_t;
+typedef struct big_tail_t { int i[80]; short s; char c[2]; } big_tail_t;
+
+static void fill(void* p, size_t size, int seed) {
+    for (size_t i = 0; i < size; ++i)
+        ((unsigned char*)p)[i] = (unsigned char)(i * 7 + seed);
+}
+
+static int is_zero(void* p, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+        if (((unsigned char*)p)[i] != 0)
+            return 0;
+    return 1;
+}
+
+typedef struct bytes6 { char a[6]; } bytes6;
+
+static int check_bytes6(void) {
+    bytes6 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    bytes6 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct bytes9 { char a[9]; } bytes9;
+
+static int check_bytes9(void) {
+    bytes9 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    bytes9 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct bytes41 { char a[41]; } bytes41;
+
+static int check_bytes41(void) {
+    bytes41 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    bytes41 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct shorts5 { short a[5]; } shorts5;
+
+static int check_shorts5(void) {
+    shorts5 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    shorts5 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct shorts33 { short a[33]; } shorts33;
+
+static int check_shorts33(void) {
+    shorts33 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    shorts33 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words4 { int a[4]; } words4;
+
+static int check_words4(void) {
+    words4 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words4 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words9 { int a[9]; } words9;
+
+static int check_words9(void) {
+    words9 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words9 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words37 { int a[37]; } words37;
+
+static int check_words37(void) {
+    words37 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words37 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words63 { int a[63]; } words63;
+
+static int check_words63(void) {
+    words63 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words63 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words64 { int a[64]; } words64;
+
+static int check_words64(void) {
+    words64 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words64 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct words203 { int a[203]; } words203;
+
+static int check_words203(void) {
+    words203 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    words203 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct tails { tail_t a[1]; } tails;
+
+static int check_tails(void) {
+    tails x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    tails z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct tails7 { tail_t a[7]; } tails7;
+
+static int check_tails7(void) {
+    tails7 x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    tails7 z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+typedef struct big_tails { big_tail_t a[1]; } big_tails;
+
+static int check_big_tails(void) {
+    big_tails x, y;
+    fill(&x, sizeof(x), 1);
+    fill(&y, sizeof(y), 2);
+    y = x;
+    if (0 != memcmp(&x, &y, sizeof(x))) return 1;
+    big_tails z = {0};
+    if (!is_zero(&z, sizeof(z))) return 2;
+    return 0;
+}
+
+static big_tail_t return_big(int v) {
+    big_tail_t b;
+    for (int i = 0; i < 80; ++i)
+        b.i[i] = v + i;
+    b.s = 5;
+    b.c[0] = 6;
+    b.c[1] = 7;
+    return b;
+}
+
+int main(void) {
+    if (check_bytes6()) return 1;
+    if (check_bytes9()) return 2;
+    if (check_bytes41()) return 3;
+    if (check_shorts5()) return 4;
+    if (check_shorts33()) return 5;
+    if (check_words4()) return 6;
+    if (check_words9()) return 7;
+    if (check_words37()) return 8;
+    if (check_words63()) return 9;
+    if (check_words64()) return 10;
+    if (check_words203()) return 11;
+    if (check_tails()) return 12;
+    if (check_tails7()) return 13;
+    if (check_big_tails()) return 14;
+
+    big_tail_t b = return_big(100);
+    for (int i = 0; i < 80; ++i)
+        if (b.i[i] != 100 + i) return 20;
+    if (b.s != 5 || b.c[0] != 6 || b.c[1] != 7) return 21;
+
+    // partially initialized arrays are zeroed
+    int partial[50] = {1, 2};
+    if (!is_zero(partial + 2, sizeof(partial) - 2 * sizeof(int))) return 30;
+    char string[40] = "hello";
+    if (!is_zero(string + 5, sizeof(string) - 5)) return 31;
+    return 0;
+}
@@ -0,0 +1,10 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// The first -o comes before its input and the second follows the wrong one.
+// The compiler must reject this rather than pair them by position.
+
+int main(void) {
+    return 0;
+}
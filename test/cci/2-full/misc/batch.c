@@ -0,0 +1,31 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// This file is compiled twice in a single run of the compiler. The second
+// translation unit must not see any declarations from the first, but the
+// builtins must still be available.
+
+#include <string.h>
+#include <stdarg.h>
+
+int x = 5;
+static int y;
+
+static int sum(int count, ...) {
+    va_list args;
+    va_start(args, count);
+    int total = 0;
+    while (count--)
+        total += va_arg(args, int);
+    va_end(args);
+    return total;
+}
+
+int main(void) {
+    if (sum(3, x, 2, 3) != 10) return 1;
+    if (y != 0) return 2;
+    if (0 != strcmp("main", __func__)) return 3;
+    if (0 != strcmp("hello", "hello")) return 4;
+    return 0;
+}
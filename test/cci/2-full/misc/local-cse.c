@@ -0,0 +1,78 @@
+// Tests that common subexpressions are still recomputed when a store or call
+// may have changed the memory they were loaded from.
+
+typedef struct point_t {
+    int x;
+    int y;
+} point_t;
+
+static int counter;
+
+static int bump(void) {
+    return ++counter;
+}
+
+static void set(int* p, int value) {
+    *p = value;
+}
+
+static int sum(point_t* points, int i) {
+    // p[i] is computed several times
+    return points[i].x + points[i].y + points[i].x * points[i].y;
+}
+
+int main(void) {
+    point_t points[4] = {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+    int i = 2;
+
+    // store through the same address between loads
+    points[i].x = points[i].y + 1;
+    if (points[i].x != 7)
+        return 1;
+    points[i].y = points[i].x + points[i].x;
+    if (points[i].y != 14)
+        return 2;
+    if (sum(points, i) != 7 + 14 + 7 * 14)
+        return 3;
+
+    // store through an aliasing pointer
+    int a = 5;
+    int* p = &a;
+    int b = a + 1;
+    *p = 10;
+    int c = a + 1;
+    if (b != 6 || c != 11)
+        return 4;
+
+    // store through a call
+    b = a * 3;
+    set(&a, 20);
+    c = a * 3;
+    if (b != 30 || c != 60)
+        return 5;
+
+    // globals across calls
+    int g1 = counter + bump();
+    int g2 = counter + bump();
+    if (g1 != 1 || g2 != 3)
+        return 6;
+
+    // local reassigned between uses
+    int j = 1;
+    int k = points[j].x;
+    j = 3;
+    k += points[j].x;
+    if (k != 3 + 7)
+        return 7;
+
+    // sub-word store into part of a word
+    union { int w; char c[4]; } u;
+    u.w = 0;
+    int before = u.w;
+    u.c[0] = 1;
+    int after = u.w;
+    if (before != 0 || after == 0)
+        return 8;
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// Sibling calls are enabled by -O (see the .args file.) These are all calls
+// in return position; some can be turned into jumps and some can't.
+
+#include <stdarg.h>
+
+typedef struct big_t {
+    int a, b, c;
+} big_t;
+
+static int is_even(unsigned n);
+
+static int is_odd(unsigned n) {
+    if (n == 0)
+        return 0;
+    return is_even(n - 1);
+}
+
+static int is_even(unsigned n) {
+    if (n == 0)
+        return 1;
+    return is_odd(n - 1);
+}
+
+static int count_down(int n, int total) {
+    if (n == 0)
+        return total;
+    return count_down(n - 1, total + n);
+}
+
+static int sum6(int a, int b, int c, int d, int e, int f) {
+    return a + 2*b + 3*c + 4*d + 5*e + 6*f;
+}
+
+// stack arguments fit in our own incoming stack arguments
+static int reverse6(int a, int b, int c, int d, int e, int f) {
+    return sum6(f, e, d, c, b, a);
+}
+
+// stack arguments don't fit; this must be a normal call
+static int extend4(int a, int b, int c, int d) {
+    return sum6(a, b, c, d, 5, 6);
+}
+
+static int sum_varargs(int count, ...) {
+    va_list args;
+    va_start(args, count);
+    int total = 0;
+    for (int i = 0; i < count; ++i)
+        total += va_arg(args, int);
+    va_end(args);
+    return total;
+}
+
+// variadic arguments past the fourth go on the stack
+static int forward_varargs(int a, int b, int c, int d, int e, int f) {
+    return sum_varargs(5, f, e, d, c, b);
+}
+
+static int sum_big(big_t big) {
+    return big.a + big.b + big.c;
+}
+
+// struct passed by value on the stack
+static int forward_big(int x, big_t big) {
+    big.a += x;
+    return sum_big(big);
+}
+
+static int deref(int* p) {
+    return *p;
+}
+
+// the callee points into our frame; this must be a normal call
+static int escape(int x) {
+    int y = x + 1;
+    return deref(&y);
+}
+
+static int first(int* array) {
+    return array[0];
+}
+
+// array decay also exposes our frame
+static int escape_array(int x) {
+    int array[2];
+    array[0] = x;
+    array[1] = 0;
+    return first(array);
+}
+
+int main(void) {
+    if (!is_even(100000)) return 1;
+    if (is_odd(100000)) return 2;
+    if (count_down(1000, 0) != 500500) return 3;
+    if (reverse6(1, 2, 3, 4, 5, 6) != 56) return 4;
+    if (extend4(1, 2, 3, 4) != 91) return 5;
+    if (forward_varargs(1, 2, 3, 4, 5, 6) != 20) return 6;
+    big_t big = {1, 2, 3};
+    if (forward_big(10, big) != 16) return 7;
+    if (big.a != 1) return 8;
+    if (escape(4) != 5) return 9;
+    if (escape_array(7) != 7) return 10;
+    return 0;
+}
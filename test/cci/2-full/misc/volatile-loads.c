@@ -0,0 +1,15 @@
+// The MIT License (MIT)
+// Copyright (c) 2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// Volatile loads must not be merged by -O (see the .args file.) The .check
+// file counts the loads through the pointer in the generated assembly.
+
+int twice(volatile int* p) {
+    return *p + *p;
+}
+
+int main(void) {
+    int x = 3;
+    return twice(&x) != 6;
+}
@@ -31,6 +31,10 @@
 # - If a corresponding .stdout file exists, the program's output must match the
 #   contents.
 #
+# - If a corresponding .check file exists, it is run with sh after the compiler
+#   succeeds, with $INPUT and $OUTPUT in its environment. It must succeed. Use
+#   this to check the generated assembly.
+#
 # - If a corresponding .status file exists, the program must return with the
 #   given status code. Otherwise, the program must return with status 0
 #   (success.) (TODO this is deprecated; remove this.)
@@ -192,6 +196,14 @@ for TESTFILE in $FILES; do
         fi
     fi
 
+    # run the check script
+    if [ $THIS_ERROR -ne 1 ] && [ -e $BASENAME.check ] && ! [ -e $BASENAME.fail ]; then
+        if ! INPUT="$INPUT" OUTPUT="$OUTPUT" sh $BASENAME.check; then
+            echo "ERROR: $BASENAME check script failed."
+            THIS_ERROR=1
+        fi
+    fi
+
     if ! [ -e $BASENAME.fail ]; then
 
         # assemble, link and run
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# This script benchmarks the given preprocessor by preprocessing a file that
+# includes all of the libc headers in core/libc/common/include (except those
+# that need function-like macros) followed by a large synthetic body.
+#
+# The body has many lines of declarations that use the macros defined by the
+# headers as well as identifiers that aren't macros. Every identifier is looked
+# up in the macro table so this stresses macro lookup.
+#
+# Pass the number of lines in the body to change the size, e.g.:
+#
+#     ./benchmark.sh 20000 ../../../build/test/cpp-1-omc/cpp
+
+LINES=5000
+if [[ "$1" =~ ^[0-9]+$ ]]; then
+    LINES=$1
+    shift
+fi
+
+if [ "$1" == "" ]; then
+    echo "Need command to benchmark."
+    exit 1
+fi
+
+ROOT="$(realpath "$(dirname "$0")/../../..")"
+INCLUDE="$ROOT/core/libc/common/include"
+
+# Resolve relative paths in the command since we run in the temp dir.
+COMMAND=
+for ARG in "$@"; do
+    if [ -e "$ARG" ]; then
+        ARG="$(realpath "$ARG")"
+    fi
+    COMMAND="$COMMAND $ARG"
+done
+TEMP_DIR=$(mktemp -d)
+
+echo "Generating a file including all libc headers with $LINES lines of code"
+{
+    for HEADER in $(cd "$INCLUDE" && ls *.h); do
+        # stdckdint.h is made entirely of function-like macros.
+        if [ "$HEADER" != "stdckdint.h" ]; then
+            echo "#include <$HEADER>"
+        fi
+    done
+    awk -v lines=$LINES 'BEGIN {
+        for (i = 0; i < lines; ++i) {
+            printf "static int value_%d = INT_MAX + EOF + CHAR_BIT + SEEK_SET + EXIT_FAILURE + value_%d;\n", i, i
+            printf "static size_t size_%d = SIZE_MAX + BUFSIZ + RAND_MAX + size_%d + sizeof(FILE*);\n", i, i
+        }
+    }'
+} > $TEMP_DIR/input.c
+
+echo "Benchmarking: $COMMAND"
+cd $TEMP_DIR
+time $COMMAND -D__onramp__=1 -D__onramp_cci_opc__=1 -D__onramp_libc_opc__=1 \
+    -I"$INCLUDE" -include __onramp/__predef.h input.c -o output.i || exit 1
+cd - > /dev/null
+
+rm -rf $TEMP_DIR
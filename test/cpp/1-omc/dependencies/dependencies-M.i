@@ -0,0 +1,5 @@
+dependencies-M.o: ./dependencies/dependencies-M.c \
+  ./dependencies/system/dependencies-system.h \
+  ./dependencies/system/dependencies-system-nested.h \
+  ./dependencies/user/dependencies-user.h \
+  ./dependencies/dependencies-local.h
@@ -0,0 +1,55 @@
+#line 1 "./dependencies/dependencies-MD.c"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./dependencies/system/dependencies-system.h"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./dependencies/system/dependencies-system-nested.h"
+ 
+ 
+ 
+
+system_nested
+#pragma onramp file pop
+#line 6 "./dependencies/system/dependencies-system.h"
+system
+#pragma onramp file pop
+#line 6 "./dependencies/dependencies-MD.c"
+
+#pragma onramp file push
+#line 1 "./dependencies/user/dependencies-user.h"
+ 
+ 
+ 
+
+user
+#pragma onramp file pop
+#line 7 "./dependencies/dependencies-MD.c"
+
+#pragma onramp file push
+#line 1 "./dependencies/dependencies-local.h"
+ 
+ 
+ 
+
+local
+#pragma onramp file pop
+#line 8 "./dependencies/dependencies-MD.c"
+
+#pragma onramp file push
+#line 1 "./dependencies/dependencies-local.h"
+ 
+ 
+ 
+
+local
+#pragma onramp file pop
+#line 9 "./dependencies/dependencies-MD.c"
@@ -0,0 +1,3 @@
+dependencies-MM.o: ./dependencies/dependencies-MM.c \
+  ./dependencies/user/dependencies-user.h \
+  ./dependencies/dependencies-local.h
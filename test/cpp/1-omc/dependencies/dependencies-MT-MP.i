@@ -0,0 +1,7 @@
+out/dependencies.o: ./dependencies/dependencies-MT-MP.c \
+  ./dependencies/user/dependencies-user.h \
+  ./dependencies/dependencies-local.h
+
+./dependencies/user/dependencies-user.h:
+
+./dependencies/dependencies-local.h:
@@ -0,0 +1,9 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+#ifndef D
+#define D
+d
+#endif
+trailing
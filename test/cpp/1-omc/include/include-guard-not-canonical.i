@@ -0,0 +1,59 @@
+#line 1 "./include/include-guard-not-canonical.c"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./include/include-d.h"
+ 
+ 
+ 
+
+
+
+d
+
+trailing
+#pragma onramp file pop
+#line 6 "./include/include-guard-not-canonical.c"
+
+#pragma onramp file push
+#line 1 "./include/include-d.h"
+ 
+ 
+ 
+
+
+
+
+
+trailing
+#pragma onramp file pop
+#line 7 "./include/include-guard-not-canonical.c"
+
+#pragma onramp file push
+#line 1 "./include/include-e.h"
+ 
+ 
+ 
+
+
+
+e
+
+#pragma onramp file pop
+#line 8 "./include/include-guard-not-canonical.c"
+
+#pragma onramp file push
+#line 1 "./include/include-e.h"
+ 
+ 
+ 
+
+
+
+e
+
+#pragma onramp file pop
+#line 9 "./include/include-guard-not-canonical.c"
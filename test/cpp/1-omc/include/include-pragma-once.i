@@ -0,0 +1,18 @@
+#line 1 "./include/include-pragma-once.c"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./include/include-once.h"
+ 
+ 
+ 
+
+
+once
+#pragma onramp file pop
+#line 6 "./include/include-pragma-once.c"
+
+
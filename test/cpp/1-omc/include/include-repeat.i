@@ -17,45 +17,9 @@ a
 #pragma onramp file pop
 #line 6 "./include/include-repeat.c"
 
-#pragma onramp file push
-#line 1 "./include/include-a.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 7 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-a.h"
- 
- 
- 
-
 
 
 
-
-#pragma onramp file pop
-#line 8 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-a.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 9 "./include/include-repeat.c"
-
 #pragma onramp file push
 #line 1 "./include/include-b.h"
  
@@ -69,45 +33,9 @@ b
 #pragma onramp file pop
 #line 10 "./include/include-repeat.c"
 
-#pragma onramp file push
-#line 1 "./include/include-b.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 11 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-b.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 12 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-b.h"
- 
- 
- 
 
 
 
-
-
-#pragma onramp file pop
-#line 13 "./include/include-repeat.c"
-
 #pragma onramp file push
 #line 1 "./include/include-c.h"
  
@@ -121,54 +49,6 @@ c
 #pragma onramp file pop
 #line 14 "./include/include-repeat.c"
 
-#pragma onramp file push
-#line 1 "./include/include-c.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 15 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-c.h"
- 
- 
- 
 
 
 
-
-
-#pragma onramp file pop
-#line 16 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-c.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 17 "./include/include-repeat.c"
-
-#pragma onramp file push
-#line 1 "./include/include-c.h"
- 
- 
- 
-
-
-
-
-
-#pragma onramp file pop
-#line 18 "./include/include-repeat.c"
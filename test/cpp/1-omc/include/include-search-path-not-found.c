@@ -0,0 +1,6 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+#include <include-search-b.h>
+#include <include-search-b.h>
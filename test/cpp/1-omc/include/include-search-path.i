@@ -0,0 +1,45 @@
+#line 1 "./include/include-search-path.c"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./include/search-b/include-search-b.h"
+ 
+ 
+ 
+
+search_b
+#pragma onramp file pop
+#line 6 "./include/include-search-path.c"
+
+#pragma onramp file push
+#line 1 "./include/search-a/include-search-a.h"
+ 
+ 
+ 
+
+search_a
+#pragma onramp file pop
+#line 7 "./include/include-search-path.c"
+
+#pragma onramp file push
+#line 1 "./include/search-b/include-search-b.h"
+ 
+ 
+ 
+
+search_b
+#pragma onramp file pop
+#line 8 "./include/include-search-path.c"
+
+#pragma onramp file push
+#line 1 "./include/search-b/include-search-b.h"
+ 
+ 
+ 
+
+search_b
+#pragma onramp file pop
+#line 9 "./include/include-search-path.c"
@@ -0,0 +1,8 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+#ifndef SNAPSHOT_ANGLE
+#define SNAPSHOT_ANGLE
+#include <snapshot-shadowed.h>
+#endif
@@ -0,0 +1,57 @@
+#pragma onramp file push
+#line 1 "././snapshot/snapshot-prelude.h"
+ 
+ 
+ 
+
+
+
+
+#pragma onramp file push
+#line 1 "././snapshot/snapshot-once.h"
+ 
+ 
+ 
+
+
+
+int once;
+#pragma onramp file pop
+#line 8 "././snapshot/snapshot-prelude.h"
+
+int prelude;
+
+#pragma onramp file pop
+#line 1 "./snapshot/snapshot-load.c"
+ 
+ 
+ 
+
+
+#pragma onramp file push
+#line 1 "./snapshot/snapshot-prelude.h"
+ 
+ 
+ 
+
+
+
+
+
+
+
+#pragma onramp file pop
+#line 6 "./snapshot/snapshot-load.c"
+
+#pragma onramp file push
+#line 1 "./snapshot/snapshot-once.h"
+ 
+ 
+ 
+
+
+
+int once;
+#pragma onramp file pop
+#line 7 "./snapshot/snapshot-load.c"
+int x = 42 + 7;
@@ -0,0 +1,7 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+#pragma once
+#define ONCE_VALUE 7
+int once;
@@ -0,0 +1,10 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+#ifndef SNAPSHOT_PRELUDE
+#define SNAPSHOT_PRELUDE
+#include "snapshot-once.h"
+#define PRELUDE_VALUE 42
+int prelude;
+#endif
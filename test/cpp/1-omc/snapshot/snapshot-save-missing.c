@@ -0,0 +1,8 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// The first include path has no snapshot-shadowed.h so the snapshot must
+// record it as missing.
+
+int x = SHADOWED_VALUE;
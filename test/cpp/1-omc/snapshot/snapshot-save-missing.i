@@ -0,0 +1,29 @@
+#pragma onramp file push
+#line 1 "././snapshot/snapshot-angle.h"
+ 
+ 
+ 
+
+
+
+
+#pragma onramp file push
+#line 1 "./snapshot/include/snapshot-shadowed.h"
+ 
+ 
+ 
+
+
+#pragma onramp file pop
+#line 8 "././snapshot/snapshot-angle.h"
+
+#pragma onramp file pop
+#line 1 "./snapshot/snapshot-save-missing.c"
+ 
+ 
+ 
+
+ 
+ 
+
+int x = 1;
@@ -0,0 +1,8 @@
+// The MIT License (MIT)
+// Copyright (c) 2023-2024 Fraser Heavy Software
+// This test case is part of the Onramp compiler project.
+
+// The snapshot was saved before shadow/snapshot-shadowed.h existed. It
+// shadows include/snapshot-shadowed.h so the snapshot is stale.
+
+int x = SHADOWED_VALUE;
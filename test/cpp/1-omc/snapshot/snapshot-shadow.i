@@ -0,0 +1,29 @@
+#pragma onramp file push
+#line 1 "././snapshot/snapshot-angle.h"
+ 
+ 
+ 
+
+
+
+
+#pragma onramp file push
+#line 1 "./snapshot/shadow/snapshot-shadowed.h"
+ 
+ 
+ 
+
+
+#pragma onramp file pop
+#line 8 "././snapshot/snapshot-angle.h"
+
+#pragma onramp file pop
+#line 1 "./snapshot/snapshot-shadow.c"
+ 
+ 
+ 
+
+ 
+ 
+
+int x = 2;
@@ -33,18 +33,25 @@ for TESTCASE in $(find $SOURCE_FOLDER/* -name '*.c'); do
         ARGS="$INPUT -o $OUTPUT"
     fi
 
+    rm -f $TEMP_I $TEMP_I.*
     $COMMAND $ARGS &> /dev/null
     RET=$?
 
     if [ $RET -eq 0 ]; then
         cp $TEMP_I $BASENAME.i
         echo "Generated $BASENAME.i"
+        for EXTRA in $TEMP_I.*; do
+            if [ -e "$EXTRA" ]; then
+                cp $EXTRA $BASENAME.${EXTRA#$TEMP_I.}
+                echo "Generated $BASENAME.${EXTRA#$TEMP_I.}"
+            fi
+        done
     else
         rm -f $BASENAME.i
         echo "Failed, deleted $BASENAME.i *****"
     fi
 
-    rm -f $TEMP_I
+    rm -f $TEMP_I $TEMP_I.*
 done
 
 # Run the test script to make sure we generated correctly
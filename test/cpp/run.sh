@@ -14,6 +14,11 @@
 #
 # If a corresponding .strict file exists, the test is only performed in
 # --strict mode. (This is typically used to test optional error-checking.)
+# A test can write additional files named $OUTPUT plus an extension (for
+# example `-MF $OUTPUT.d`.) Each one must match the file with the same
+# extension next to the test (for example `foo.d`.)
+# With --output <folder>, the output files are placed in the given folder
+# instead of /tmp.
 #
 # TODO we should have a special exit code so that we can differentiate between
 # the preprocessor crashing as opposed to printing an error and exiting.
@@ -21,6 +26,14 @@
 # same code for a vm crash so we can detect crashes in both, need to do the
 # same here
 
+OUTPUT_FOLDER=/tmp
+if [ "$1" == "--output" ]; then
+    OUTPUT_FOLDER="$2"
+    shift
+    shift
+    mkdir -p "$OUTPUT_FOLDER"
+fi
+
 if [ "$1" == "" ]; then
     echo "Need command to test."
     exit 1
@@ -34,7 +47,7 @@ fi
 SOURCE_FOLDER="$1"
 shift
 COMMAND="$@"
-TEMP_I=/tmp/onramp-test.i
+TEMP_I=$OUTPUT_FOLDER/onramp-test.i
 ERROR=0
 
 TESTS_PATH="$(basename $(realpath $SOURCE_FOLDER/..))/$(basename $(realpath $SOURCE_FOLDER))"
@@ -54,6 +67,7 @@ for TESTCASE in $(find $SOURCE_FOLDER/* -name '*.c'); do
         ARGS="$INPUT -o $OUTPUT"
     fi
 
+    rm -f $TEMP_I $TEMP_I.*
     $COMMAND $ARGS &> /dev/null
     RET=$?
 
@@ -75,7 +89,24 @@ for TESTCASE in $(find $SOURCE_FOLDER/* -name '*.c'); do
         fi
     fi
 
-    rm -f $TEMP_I
+    # check additional outputs
+    for EXTRA in $TEMP_I.*; do
+        if ! [ -e "$EXTRA" ]; then
+            continue
+        fi
+        EXPECTED=$BASENAME.${EXTRA#$TEMP_I.}
+        if ! [ -e $EXPECTED ]; then
+            echo "ERROR: $TESTCASE wrote $EXTRA but $EXPECTED does not exist"
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        elif ! diff -q $EXPECTED $EXTRA > /dev/null; then
+            echo "ERROR: $EXTRA did not match expected $EXPECTED"
+            echo "Command: $COMMAND $ARGS"
+            ERROR=1
+        fi
+    done
+
+    rm -f $TEMP_I $TEMP_I.*
 done
 
 if [ $ERROR -eq 1 ]; then
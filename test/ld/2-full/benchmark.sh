@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# This script benchmarks the given linker by linking a large synthetic program.
+#
+# The program has 100 object files of 500 symbols each (50,000 symbols in
+# total.) Each file has global symbols that invoke symbols in other files and
+# static symbols with the same names in every file, and each symbol has a few
+# labels. This stresses the symbol and label tables. The link is run with and
+# without -O.
+#
+# Pass the number of files and symbols per file to change the size, e.g.:
+#
+#     ./benchmark.sh 200 500 ../../../build/test/ld-2-full/ld
+
+FILES=100
+SYMBOLS=500
+if [[ "$1" =~ ^[0-9]+$ ]] && [[ "$2" =~ ^[0-9]+$ ]]; then
+    FILES=$1
+    SYMBOLS=$2
+    shift 2
+fi
+
+if [ "$1" == "" ]; then
+    echo "Need command to benchmark."
+    exit 1
+fi
+
+# Resolve a relative command path since we run in the temp dir.
+if [[ "$1" == */* ]]; then
+    COMMAND="$(realpath "$1") ${@:2}"
+else
+    COMMAND="$@"
+fi
+TEMP_DIR=$(mktemp -d)
+
+echo "Generating $FILES files of $SYMBOLS symbols each"
+
+# __start invokes the first symbol of every file so nothing is collected
+# with -O.
+{
+    echo "=__start"
+    for (( f = 0; f < FILES; ++f )); do
+        echo "^f${f}_s0"
+    done
+} > $TEMP_DIR/start.oo
+
+# Each global symbol invokes the next global symbol in the same file, the
+# same symbol in the next file and a static symbol, and jumps to its own
+# labels.
+awk -v files=$FILES -v symbols=$SYMBOLS -v dir=$TEMP_DIR 'BEGIN {
+    for (f = 0; f < files; ++f) {
+        out = dir "/file" f ".oo"
+        next_file = (f + 1) % files
+        for (s = 0; s < symbols; ++s) {
+            next_symbol = (s + 1) % symbols
+            printf "=f%d_s%d\n", f, s > out
+            printf ":loop_%d\n7C 8A 00 00 ^f%d_s%d ^f%d_s%d\n", s, f, next_symbol, next_file, s > out
+            printf ":skip_%d\n7E 00 &loop_%d 7E 00 &skip_%d ^static_s%d\n", s, s, s, s > out
+            printf "@static_s%d\n01 02 03 04\n", s > out
+        }
+        close(out)
+    }
+}'
+
+echo "Benchmarking: $COMMAND"
+cd $TEMP_DIR
+time $COMMAND start.oo $(ls file*.oo | sort -V) -o out.oe || exit 1
+time $COMMAND -O start.oo $(ls file*.oo | sort -V) -o out.oe || exit 1
+cd - > /dev/null
+
+rm -rf $TEMP_DIR
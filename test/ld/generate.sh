@@ -1,6 +1,7 @@
 #!/bin/bash
 
 # This script generates .oe files in the given folder using the given linker.
+# It also regenerates any existing .od and .map files.
 #
 # Note that any bugs in the linker may result in bugs in the generated tests.
 #
@@ -33,12 +34,19 @@ for TESTFILE in $(find $SOURCE_FOLDER/* -name '*.oo'); do
         ARGS="$INPUT -o $OUTPUT"
     fi
 
+    rm -f $TEMP_OE.od $TEMP_OE.map
     $COMMAND $ARGS &> /dev/null
     RET=$?
 
     if [ $RET -eq 0 ]; then
         cp $TEMP_OE $BASENAME.oe
         echo -n "Generated $BASENAME.oe"
+        for EXT in od map; do
+            if [ -e $BASENAME.$EXT ] && [ -e $TEMP_OE.$EXT ]; then
+                cp $TEMP_OE.$EXT $BASENAME.$EXT
+                echo -n ", $BASENAME.$EXT"
+            fi
+        done
         rm -f $BASENAME.stdout
         onrampvm $TEMP_OE > $TEMP_STDOUT 2>/dev/null
         if [ $? -eq 0 ] && [ -s $TEMP_STDOUT ]; then
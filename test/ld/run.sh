@@ -20,6 +20,10 @@
 #
 # - If a corresponding .stdout file exists, the resulting program is run, and the
 # output must match the file's contents.
+#
+# - If a corresponding .od or .map file exists, the linker must also have
+# written $OUTPUT.od (the debug info) or $OUTPUT.map (the link map, e.g. with
+# `-Map $OUTPUT.map` in the .args) and it must match the file's contents.
 
 if [ "$1" == "" ]; then
     echo "Need folder to test."
@@ -51,6 +55,7 @@ for TESTFILE in $(find $SOURCE_FOLDER/* -name '*.oo'); do
 
     INPUT=$TESTFILE
     OUTPUT=$TEMP_OE
+    rm -f $TEMP_OE $TEMP_OE.od $TEMP_OE.map
     ARGS=
     if [ -e $BASENAME.args ]; then
         # eval echo to expand shell macros
@@ -72,6 +77,13 @@ for TESTFILE in $(find $SOURCE_FOLDER/* -name '*.oo'); do
             echo "Command: make build && $COMMAND $ARGS"
             ERROR=1
         fi
+        for EXT in od map; do
+            if [ -e $BASENAME.$EXT ] && ! diff -q $BASENAME.$EXT $TEMP_OE.$EXT > /dev/null 2>&1; then
+                echo "ERROR: $TESTFILE did not match expected $BASENAME.$EXT"
+                echo "Command: make build && $COMMAND $ARGS"
+                ERROR=1
+            fi
+        done
     else
         if [ $RET -eq 0 ]; then
             echo "ERROR: $TESTFILE linking succeeded; expected error."
@@ -89,7 +101,7 @@ for TESTFILE in $(find $SOURCE_FOLDER/* -name '*.oo'); do
         fi
     fi
 
-    rm -f $TEMP_OE
+    rm -f $TEMP_OE $TEMP_OE.od $TEMP_OE.map
     rm -f $TEMP_STDOUT
 done
 
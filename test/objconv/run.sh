@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# This script tests the given object code converter by running it against all
+# .oo files in the tests/ folder.
+#
+# If a corresponding .expected file exists, the file is converted to binary
+# and back to text and the text must match the expected file. The result is
+# then converted to binary again, which must match the first binary exactly.
+#
+# If no corresponding .expected file exists, converting the file must fail.
+
+if [ "$1" == "" ]; then
+    echo "Need command to test."
+    exit 1
+fi
+
+COMMAND="$@"
+TEMPDIR=$(mktemp -d)
+ERROR=0
+
+echo "Running objconv tests on: $COMMAND"
+
+for TESTCASE in $(find "$(dirname $0)"/tests -name '*.oo' | sort); do
+    EXPECTED=$(echo $TESTCASE|sed 's/\.oo$/.expected/')
+    echo "Testing $TESTCASE"
+
+    if ! [ -e $EXPECTED ]; then
+        if $COMMAND -binary $TESTCASE -o $TEMPDIR/binary &> /dev/null; then
+            echo "ERROR: $TESTCASE succeeded; expected error."
+            echo "Command: $COMMAND -binary $TESTCASE -o $TEMPDIR/binary"
+            ERROR=1
+        fi
+        continue
+    fi
+
+    if ! $COMMAND -binary $TESTCASE -o $TEMPDIR/binary || \
+            ! $COMMAND -text $TEMPDIR/binary -o $TEMPDIR/text || \
+            ! $COMMAND -binary $TEMPDIR/text -o $TEMPDIR/binary2
+    then
+        echo "ERROR: $TESTCASE failed; expected success."
+        ERROR=1
+    elif ! diff -q $EXPECTED $TEMPDIR/text > /dev/null; then
+        echo "ERROR: $TESTCASE did not match expected $EXPECTED"
+        ERROR=1
+    elif ! cmp -s $TEMPDIR/binary $TEMPDIR/binary2; then
+        echo "ERROR: $TESTCASE binary did not survive a round trip"
+        ERROR=1
+    fi
+done
+
+rm -rf $TEMPDIR
+
+if [ $ERROR -eq 1 ]; then
+    echo "Errors occurred."
+    exit 1
+fi
+
+echo "Pass."
@@ -125,7 +125,8 @@ core/libc/common/build.sh
 ( core/cpp/2-full/rebuild.sh && cd test/cpp/1-omc && ../run.sh . onrampvm ../../../build/output/bin/cpp.oe )
 
 # Build the last few tools we need
+( core/ar/1-unix/build.sh && cd test/ar/1-unix && \
+    ../run.sh . onrampvm $(realpath ../../../build/output/bin/ar.oe) )
 ( core/hex/1-c89/build.sh && test/hex/run.sh onrampvm build/output/bin/hex.oe )
-# TODO ar/1 does not exist yet
-## core/ar/1-unix/build.sh
-cp build/intermediate/ar-0-cat/ar.oe build/output/bin/ar.oe
+( core/objconv/build.sh && test/objconv/run.sh onrampvm build/output/bin/objconv.oe )
+onrampvm build/output/bin/ar.oe s build/output/lib/libc.oa
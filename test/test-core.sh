@@ -80,6 +80,7 @@ make -C test/as/2-full
 
 # extra tools
 platform/hex/c89/test.sh
-#make -C test/ar/1-unix
+make -C test/objconv
+make -C test/ar/1-unix
 
 echo "All tests pass."
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# This script tests the debug info support of the given C debugger.
+#
+#     Usage: run.sh <run commands>
+#
+# e.g.
+#
+#     test/vm/c-debugger/run.sh build/test/vm-c-debugger/vm
+#
+# It must be run from the Onramp root.
+#
+# Each .oo file in this folder is linked by the final stage linker twice: once
+# with plain text debug info (-g) and once with compact debug info
+# (-compact-debug). Each program must abort and the stack trace printed by the
+# debugger must match the corresponding .stdout file in both cases.
+
+if [ "$1" == "" ]; then
+    echo "Need command to test."
+    exit 1
+fi
+
+if [ "$(realpath $(dirname $0)/../../..)" != "$(realpath $(pwd))" ]; then
+    echo "ERROR: This script must be run from the Onramp root."
+    exit 1
+fi
+
+make -C test/ld/2-full build > /dev/null || exit $?
+LD=build/test/ld-2-full/ld
+
+COMMAND="$@"
+TEMP_OE=/tmp/onramp-test-debugger.oe
+TEMP_STDOUT=/tmp/onramp-test-debugger.stdout
+ANY_ERROR=0
+
+echo "Running debugger tests on: $COMMAND"
+
+for TESTFILE in $(find $(dirname $0)/* -name '*.oo'); do
+    BASENAME=$(echo $TESTFILE|sed 's/\.oo$//')
+    echo "Testing $BASENAME"
+
+    for FORMAT in -g -compact-debug; do
+        THIS_ERROR=0
+
+        if ! $LD $FORMAT $TESTFILE -o $TEMP_OE; then
+            echo "ERROR: $BASENAME failed to link with $FORMAT."
+            THIS_ERROR=1
+        else
+            $COMMAND $TEMP_OE 1>$TEMP_STDOUT 2>/dev/null
+            RET=$?
+            if [ $RET -ne 125 ]; then
+                echo "ERROR: $BASENAME with $FORMAT exited with status $RET, expected VM to abort with status 125"
+                THIS_ERROR=1
+            elif ! diff -q $BASENAME.stdout $TEMP_STDOUT > /dev/null; then
+                echo "ERROR: $BASENAME with $FORMAT stdout did not match expected"
+                THIS_ERROR=1
+            fi
+        fi
+
+        if [ $THIS_ERROR -ne 0 ]; then
+            ANY_ERROR=1
+            echo "Commands:"
+            echo "    $LD $FORMAT $TESTFILE -o $TEMP_OE && \\"
+            echo "        $COMMAND $TEMP_OE"
+        fi
+
+        rm -f $TEMP_OE $TEMP_OE.od $TEMP_STDOUT
+    done
+done
+
+if [ $ANY_ERROR -eq 1 ]; then
+    echo "Errors occurred."
+    exit 1
+fi
+
+echo "Pass."